@@ -0,0 +1,685 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <limits>
+
+// SSE2 is part of x86-64, so the 4-wide box tests need no runtime check.
+#if SIMD_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BVH_SSE 1
+#else
+#define BVH_SSE 0
+#endif
+
+namespace
+{
+	const float Infinity = std::numeric_limits<float>::infinity();
+	const int BinCount = 16;
+	// Cost of visiting a node relative to testing one triangle.
+	const float TraversalCost = 1.0f;
+	// Traversal stack entries kept on the call stack: trees up to 21 levels
+	// of 4-wide nodes, which covers the binned build on real meshes.
+	const std::uint32_t StackSize = 64;
+
+	struct Aabb
+	{
+		Vec3 lo = { Infinity, Infinity, Infinity };
+		Vec3 hi = { -Infinity, -Infinity, -Infinity };
+
+		void grow(const Vec3& p)
+		{
+			lo = Vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+			hi = Vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+		}
+		void grow(const Aabb& b)
+		{
+			grow(b.lo);
+			grow(b.hi);
+		}
+		float area()const
+		{
+			if (lo.x > hi.x)
+				return 0.0f;
+			Vec3 d = hi - lo;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+	};
+
+	inline float component(const Vec3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	struct BuildNode
+	{
+		Aabb bounds;
+		// Leaf: range of the reference array. Inner: count is 0.
+		std::uint32_t first = 0;
+		std::uint32_t count = 0;
+		std::uint32_t left = 0;
+		std::uint32_t right = 0;
+	};
+
+	// Binary SAH tree over triangle references, built top down.
+	class BinaryBuilder
+	{
+	public:
+		BinaryBuilder(const Vec3* positions, const std::uint32_t* indices, std::uint32_t triangleCount)
+			: m_Bounds(triangleCount), m_Centroids(triangleCount), m_Refs(triangleCount)
+		{
+			for (std::uint32_t t = 0; t < triangleCount; ++t)
+			{
+				Aabb b;
+				b.grow(positions[indices[3 * t + 0]]);
+				b.grow(positions[indices[3 * t + 1]]);
+				b.grow(positions[indices[3 * t + 2]]);
+				m_Bounds[t] = b;
+				m_Centroids[t] = (b.lo + b.hi) * 0.5f;
+				m_Refs[t] = t;
+			}
+			m_Nodes.reserve(2 * static_cast<size_t>(triangleCount) / Bvh::LeafSize + 1);
+			buildRange(0, triangleCount);
+		}
+
+		const std::vector<BuildNode>& nodes()const { return m_Nodes; }
+		const std::vector<std::uint32_t>& refs()const { return m_Refs; }
+
+	private:
+		std::uint32_t buildRange(std::uint32_t first, std::uint32_t count)
+		{
+			const std::uint32_t index = static_cast<std::uint32_t>(m_Nodes.size());
+			m_Nodes.emplace_back();
+			Aabb bounds;
+			Aabb centroidBounds;
+			for (std::uint32_t i = first; i < first + count; ++i)
+			{
+				bounds.grow(m_Bounds[m_Refs[i]]);
+				centroidBounds.grow(m_Centroids[m_Refs[i]]);
+			}
+			m_Nodes[index].bounds = bounds;
+
+			int bestAxis = -1;
+			int bestSplit = 0;
+			float bestCost = Infinity;
+			if (count > 1)
+				findSplit(first, count, bounds, centroidBounds, bestAxis, bestSplit, bestCost);
+
+			const float leafCost = static_cast<float>(count);
+			if (count <= Bvh::LeafSize && leafCost <= bestCost)
+			{
+				m_Nodes[index].first = first;
+				m_Nodes[index].count = count;
+				return index;
+			}
+
+			std::uint32_t middle = first + count / 2;
+			if (bestAxis >= 0)
+			{
+				const float lo = component(centroidBounds.lo, bestAxis);
+				const float scale = BinCount / (component(centroidBounds.hi, bestAxis) - lo);
+				auto it = std::partition(m_Refs.begin() + first, m_Refs.begin() + first + count,
+					[&](std::uint32_t t) { return binOf(component(m_Centroids[t], bestAxis), lo, scale) < bestSplit; });
+				middle = static_cast<std::uint32_t>(it - m_Refs.begin());
+			}
+			// All centroids coincide: there is nothing to sort by, so halve the range.
+			if (middle == first || middle == first + count)
+				middle = first + count / 2;
+
+			std::uint32_t left = buildRange(first, middle - first);
+			std::uint32_t right = buildRange(middle, first + count - middle);
+			m_Nodes[index].left = left;
+			m_Nodes[index].right = right;
+			return index;
+		}
+
+		static int binOf(float c, float lo, float scale)
+		{
+			return std::min(BinCount - 1, static_cast<int>((c - lo) * scale));
+		}
+
+		// Bin the centroids along every axis and sweep the bins from both
+		// sides; the split cost is TraversalCost + (A_l*N_l + A_r*N_r) / A.
+		void findSplit(std::uint32_t first, std::uint32_t count, const Aabb& bounds, const Aabb& centroidBounds,
+			int& bestAxis, int& bestSplit, float& bestCost)const
+		{
+			const float invArea = 1.0f / std::max(bounds.area(), 1e-30f);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float lo = component(centroidBounds.lo, axis);
+				const float extent = component(centroidBounds.hi, axis) - lo;
+				if (extent <= 0.0f)
+					continue;
+				const float scale = BinCount / extent;
+				Aabb binBounds[BinCount];
+				std::uint32_t binCounts[BinCount] = {};
+				for (std::uint32_t i = first; i < first + count; ++i)
+				{
+					std::uint32_t t = m_Refs[i];
+					int b = binOf(component(m_Centroids[t], axis), lo, scale);
+					binBounds[b].grow(m_Bounds[t]);
+					binCounts[b]++;
+				}
+
+				float rightCost[BinCount];
+				Aabb acc;
+				std::uint32_t n = 0;
+				for (int b = BinCount - 1; b > 0; --b)
+				{
+					acc.grow(binBounds[b]);
+					n += binCounts[b];
+					rightCost[b] = acc.area() * n;
+				}
+				acc = Aabb();
+				n = 0;
+				for (int b = 1; b < BinCount; ++b)
+				{
+					acc.grow(binBounds[b - 1]);
+					n += binCounts[b - 1];
+					if (n == 0 || n == count)
+						continue;
+					float cost = TraversalCost + (acc.area() * n + rightCost[b]) * invArea;
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+		}
+
+	private:
+		std::vector<Aabb> m_Bounds;
+		std::vector<Vec3> m_Centroids;
+		std::vector<std::uint32_t> m_Refs;
+		std::vector<BuildNode> m_Nodes;
+	};
+
+	// Per ray constants. Each axis reads the near and far bound from the
+	// min or max array depending on the direction sign, so an empty child
+	// (min = +inf, max = -inf) can never be hit.
+	struct RayData
+	{
+		Vec3 origin;
+		Vec3 dir;
+		Vec3 invDir;
+		int nearX, nearY, nearZ;
+	};
+
+	inline float safeInverse(float d)
+	{
+		const float tiny = 1e-30f;
+		if (std::abs(d) < tiny)
+			d = d < 0.0f ? -tiny : tiny;
+		return 1.0f / d;
+	}
+
+	inline const float* nodeBound(const BvhNode& node, int axis, bool upper)
+	{
+		switch (axis)
+		{
+		case 0: return upper ? node.maxX : node.minX;
+		case 1: return upper ? node.maxY : node.minY;
+		default: return upper ? node.maxZ : node.minZ;
+		}
+	}
+
+	int rayNodeScalar(const BvhNode& node, const RayData& r, float tBest, float tNear[4])
+	{
+		const float* nx = nodeBound(node, 0, r.nearX != 0);
+		const float* ny = nodeBound(node, 1, r.nearY != 0);
+		const float* nz = nodeBound(node, 2, r.nearZ != 0);
+		const float* fx = nodeBound(node, 0, r.nearX == 0);
+		const float* fy = nodeBound(node, 1, r.nearY == 0);
+		const float* fz = nodeBound(node, 2, r.nearZ == 0);
+		int mask = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			float t0 = std::max(std::max((nx[k] - r.origin.x) * r.invDir.x, (ny[k] - r.origin.y) * r.invDir.y),
+				std::max((nz[k] - r.origin.z) * r.invDir.z, 0.0f));
+			float t1 = std::min(std::min((fx[k] - r.origin.x) * r.invDir.x, (fy[k] - r.origin.y) * r.invDir.y),
+				std::min((fz[k] - r.origin.z) * r.invDir.z, tBest));
+			tNear[k] = t0;
+			if (t0 <= t1)
+				mask |= 1 << k;
+		}
+		return mask;
+	}
+
+	float boxDistanceSq(float lo, float hi, float c)
+	{
+		float d = std::max(std::max(lo - c, c - hi), 0.0f);
+		return d * d;
+	}
+
+	int pointNodeScalar(const BvhNode& node, const Vec3& c, float bestSq, float distSq[4])
+	{
+		int mask = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			float d = boxDistanceSq(node.minX[k], node.maxX[k], c.x) +
+				boxDistanceSq(node.minY[k], node.maxY[k], c.y) +
+				boxDistanceSq(node.minZ[k], node.maxZ[k], c.z);
+			distSq[k] = d;
+			if (d <= bestSq)
+				mask |= 1 << k;
+		}
+		return mask;
+	}
+
+#if BVH_SSE
+	int rayNodeSse(const BvhNode& node, const RayData& r, float tBest, float tNear[4])
+	{
+		const __m128 ox = _mm_set1_ps(r.origin.x), oy = _mm_set1_ps(r.origin.y), oz = _mm_set1_ps(r.origin.z);
+		const __m128 ix = _mm_set1_ps(r.invDir.x), iy = _mm_set1_ps(r.invDir.y), iz = _mm_set1_ps(r.invDir.z);
+		__m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 0, r.nearX != 0)), ox), ix);
+		__m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 1, r.nearY != 0)), oy), iy);
+		__m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 2, r.nearZ != 0)), oz), iz);
+		__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 0, r.nearX == 0)), ox), ix);
+		__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 1, r.nearY == 0)), oy), iy);
+		__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nodeBound(node, 2, r.nearZ == 0)), oz), iz);
+		__m128 t0 = _mm_max_ps(_mm_max_ps(tx0, ty0), _mm_max_ps(tz0, _mm_setzero_ps()));
+		__m128 t1 = _mm_min_ps(_mm_min_ps(tx1, ty1), _mm_min_ps(tz1, _mm_set1_ps(tBest)));
+		_mm_storeu_ps(tNear, t0);
+		return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+	}
+
+	inline __m128 boxDistanceSq4(const float* lo, const float* hi, __m128 c)
+	{
+		__m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(lo), c), _mm_sub_ps(c, _mm_load_ps(hi))), _mm_setzero_ps());
+		return _mm_mul_ps(d, d);
+	}
+
+	int pointNodeSse(const BvhNode& node, const Vec3& c, float bestSq, float distSq[4])
+	{
+		__m128 d = _mm_add_ps(boxDistanceSq4(node.minX, node.maxX, _mm_set1_ps(c.x)),
+			_mm_add_ps(boxDistanceSq4(node.minY, node.maxY, _mm_set1_ps(c.y)),
+				boxDistanceSq4(node.minZ, node.maxZ, _mm_set1_ps(c.z))));
+		_mm_storeu_ps(distSq, d);
+		return _mm_movemask_ps(_mm_cmple_ps(d, _mm_set1_ps(bestSq)));
+	}
+#endif
+
+	template<bool Wide>
+	inline int rayNode(const BvhNode& node, const RayData& r, float tBest, float tNear[4])
+	{
+#if BVH_SSE
+		if (Wide)
+			return rayNodeSse(node, r, tBest, tNear);
+#endif
+		return rayNodeScalar(node, r, tBest, tNear);
+	}
+
+	template<bool Wide>
+	inline int pointNode(const BvhNode& node, const Vec3& c, float bestSq, float distSq[4])
+	{
+#if BVH_SSE
+		if (Wide)
+			return pointNodeSse(node, c, bestSq, distSq);
+#endif
+		return pointNodeScalar(node, c, bestSq, distSq);
+	}
+
+	// Order the hit children of a node by key, nearest first.
+	int sortHits(int mask, const float key[4], int order[4])
+	{
+		int n = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			if ((mask & (1 << k)) == 0)
+				continue;
+			int j = n++;
+			while (j > 0 && key[order[j - 1]] > key[k])
+			{
+				order[j] = order[j - 1];
+				--j;
+			}
+			order[j] = k;
+		}
+		return n;
+	}
+
+	// Moller-Trumbore, accepting both sides.
+	bool intersectTriangle(const BvhTriangle& tri, const RayData& r, float tBest, float& t, float& u, float& v)
+	{
+		Vec3 p = cross(r.dir, tri.e2);
+		float det = dot(tri.e1, p);
+		if (std::abs(det) < 1e-12f)
+			return false;
+		float invDet = 1.0f / det;
+		Vec3 s = r.origin - tri.v0;
+		u = dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+		Vec3 q = cross(s, tri.e1);
+		v = dot(r.dir, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+		t = dot(tri.e2, q) * invDet;
+		return t >= 0.0f && t <= tBest;
+	}
+
+	// Closest point on triangle (a, a + e1, a + e2) to p, from Ericson's
+	// Real-Time Collision Detection, 5.1.5.
+	Vec3 closestOnTriangle(const BvhTriangle& tri, const Vec3& p)
+	{
+		const Vec3& a = tri.v0;
+		const Vec3& ab = tri.e1;
+		const Vec3& ac = tri.e2;
+		Vec3 ap = p - a;
+		float d1 = dot(ab, ap);
+		float d2 = dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+		Vec3 bp = ap - ab;
+		float d3 = dot(ab, bp);
+		float d4 = dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return a + ab;
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+		Vec3 cp = ap - ac;
+		float d5 = dot(ab, cp);
+		float d6 = dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return a + ac;
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	struct StackEntry
+	{
+		std::uint32_t node;
+		float key;
+	};
+
+	// The traversal stack, on the call stack unless the tree needs more
+	// entries than that holds.
+	class TraversalStack
+	{
+	public:
+		explicit TraversalStack(std::uint32_t size)
+		{
+			if (size > StackSize)
+			{
+				m_Deep.resize(size);
+				m_Entries = m_Deep.data();
+			}
+		}
+		TraversalStack(const TraversalStack& rhs) = delete;
+		TraversalStack& operator=(const TraversalStack& rhs) = delete;
+
+		StackEntry& operator[](int i) { return m_Entries[i]; }
+
+	private:
+		StackEntry m_Fixed[StackSize];
+		std::vector<StackEntry> m_Deep;
+		StackEntry* m_Entries = m_Fixed;
+	};
+}
+
+Bvh::Bvh()
+	: m_SimdLevel(detectSimdLevel())
+{
+}
+
+void Bvh::build(const Vec3* positions, const std::uint32_t* indices, std::uint32_t triangleCount)
+{
+	auto start = std::chrono::steady_clock::now();
+	m_Nodes.clear();
+	m_Triangles.clear();
+	m_TriangleIds.clear();
+	m_BoundsMin = Vec3();
+	m_BoundsMax = Vec3();
+	m_StackSize = 1;
+	if (triangleCount == 0)
+	{
+		m_BuildSeconds = 0.0;
+		return;
+	}
+
+	BinaryBuilder builder(positions, indices, triangleCount);
+	const std::vector<BuildNode>& tree = builder.nodes();
+	const std::vector<std::uint32_t>& refs = builder.refs();
+	m_BoundsMin = tree[0].bounds.lo;
+	m_BoundsMax = tree[0].bounds.hi;
+
+	// Leaves point into the reference array, so the triangles are stored in
+	// that order and each leaf reads a contiguous run.
+	m_TriangleIds = refs;
+	m_Triangles.resize(triangleCount);
+	for (std::uint32_t i = 0; i < triangleCount; ++i)
+	{
+		std::uint32_t t = refs[i];
+		const Vec3& v0 = positions[indices[3 * t + 0]];
+		m_Triangles[i].v0 = v0;
+		m_Triangles[i].e1 = positions[indices[3 * t + 1]] - v0;
+		m_Triangles[i].e2 = positions[indices[3 * t + 2]] - v0;
+	}
+
+	// Collapse the binary tree: every 4-wide node takes the children of its
+	// binary node and keeps opening the inner child with the largest surface
+	// area until it has four.
+	m_Nodes.reserve(tree.size() / 2 + 1);
+	struct Collapse
+	{
+		const std::vector<BuildNode>& tree;
+		std::vector<BvhNode, AlignedAllocator<BvhNode, 64>>& nodes;
+		std::uint32_t depth = 0;
+
+		std::uint32_t operator()(std::uint32_t root, std::uint32_t level)
+		{
+			depth = std::max(depth, level);
+			const std::uint32_t index = static_cast<std::uint32_t>(nodes.size());
+			nodes.emplace_back();
+			std::uint32_t kids[4];
+			int n = 0;
+			if (tree[root].count > 0)
+			{
+				kids[n++] = root;
+			}
+			else
+			{
+				kids[n++] = tree[root].left;
+				kids[n++] = tree[root].right;
+				while (n < 4)
+				{
+					int open = -1;
+					float openArea = -1.0f;
+					for (int k = 0; k < n; ++k)
+					{
+						const BuildNode& b = tree[kids[k]];
+						if (b.count == 0 && b.bounds.area() > openArea)
+						{
+							open = k;
+							openArea = b.bounds.area();
+						}
+					}
+					if (open < 0)
+						break;
+					std::uint32_t opened = kids[open];
+					kids[open] = tree[opened].left;
+					kids[n++] = tree[opened].right;
+				}
+			}
+
+			BvhNode node;
+			for (int k = 0; k < 4; ++k)
+			{
+				Aabb b = k < n ? tree[kids[k]].bounds : Aabb();
+				node.minX[k] = b.lo.x; node.minY[k] = b.lo.y; node.minZ[k] = b.lo.z;
+				node.maxX[k] = b.hi.x; node.maxY[k] = b.hi.y; node.maxZ[k] = b.hi.z;
+				node.child[k] = 0;
+				node.count[k] = 0;
+			}
+			for (int k = 0; k < n; ++k)
+			{
+				const BuildNode& b = tree[kids[k]];
+				if (b.count > 0)
+				{
+					node.child[k] = b.first;
+					node.count[k] = b.count;
+				}
+				else
+				{
+					node.child[k] = (*this)(kids[k], level + 1);
+				}
+			}
+			nodes[index] = node;
+			return index;
+		}
+	};
+	Collapse collapse{ tree, m_Nodes };
+	collapse(0, 1);
+	// A traversal pops a node and pushes at most its four children, so
+	// while it visits a node at level d the stack holds at most three
+	// siblings of each ancestor below the root and that node's children.
+	m_StackSize = 3 * collapse.depth + 1;
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Bvh::raycast(const Vec3& origin, const Vec3& dir, float tMax, BvhRayHit& hit)const
+{
+	if (m_SimdLevel != SimdLevel::Scalar)
+		return raycastImpl<true>(origin, dir, tMax, hit);
+	return raycastImpl<false>(origin, dir, tMax, hit);
+}
+
+bool Bvh::closestPoint(const Vec3& center, float radius, BvhPointHit& hit)const
+{
+	if (m_SimdLevel != SimdLevel::Scalar)
+		return closestPointImpl<true>(center, radius, hit);
+	return closestPointImpl<false>(center, radius, hit);
+}
+
+template<bool Wide>
+bool Bvh::raycastImpl(const Vec3& origin, const Vec3& dir, float tMax, BvhRayHit& hit)const
+{
+	if (m_Nodes.empty())
+		return false;
+	RayData r;
+	r.origin = origin;
+	r.dir = dir;
+	r.invDir = Vec3(safeInverse(dir.x), safeInverse(dir.y), safeInverse(dir.z));
+	// For a negative direction the near plane is the max bound.
+	r.nearX = dir.x < 0.0f;
+	r.nearY = dir.y < 0.0f;
+	r.nearZ = dir.z < 0.0f;
+
+	float tBest = tMax;
+	std::uint32_t best = std::numeric_limits<std::uint32_t>::max();
+	float bestU = 0.0f, bestV = 0.0f;
+
+	TraversalStack stack(m_StackSize);
+	int sp = 0;
+	stack[sp++] = { 0, 0.0f };
+	while (sp > 0)
+	{
+		const StackEntry e = stack[--sp];
+		if (e.key > tBest)
+			continue;
+		const BvhNode& node = m_Nodes[e.node];
+		float tNear[4];
+		int order[4];
+		int n = sortHits(rayNode<Wide>(node, r, tBest, tNear), tNear, order);
+		// Leaves are tested right away, nearest first; inner children are
+		// pushed far to near so the nearest is popped next.
+		for (int i = 0; i < n; ++i)
+		{
+			int k = order[i];
+			if (node.count[k] == 0 || tNear[k] > tBest)
+				continue;
+			for (std::uint32_t t = node.child[k]; t < node.child[k] + node.count[k]; ++t)
+			{
+				float th, u, v;
+				if (intersectTriangle(m_Triangles[t], r, tBest, th, u, v))
+				{
+					tBest = th;
+					best = t;
+					bestU = u;
+					bestV = v;
+				}
+			}
+		}
+		for (int i = n - 1; i >= 0; --i)
+		{
+			int k = order[i];
+			if (node.count[k] != 0 || tNear[k] > tBest)
+				continue;
+			assert(static_cast<std::uint32_t>(sp) < m_StackSize);
+			stack[sp++] = { node.child[k], tNear[k] };
+		}
+	}
+	if (best == std::numeric_limits<std::uint32_t>::max())
+		return false;
+	hit.t = tBest;
+	hit.u = bestU;
+	hit.v = bestV;
+	hit.triangle = m_TriangleIds[best];
+	return true;
+}
+
+template<bool Wide>
+bool Bvh::closestPointImpl(const Vec3& center, float radius, BvhPointHit& hit)const
+{
+	if (m_Nodes.empty())
+		return false;
+	// Finite, so empty child slots, at an infinite distance, never pass.
+	float bestSq = std::min(radius * radius, std::numeric_limits<float>::max());
+	std::uint32_t best = std::numeric_limits<std::uint32_t>::max();
+	Vec3 bestPoint;
+
+	TraversalStack stack(m_StackSize);
+	int sp = 0;
+	stack[sp++] = { 0, 0.0f };
+	while (sp > 0)
+	{
+		const StackEntry e = stack[--sp];
+		if (e.key > bestSq)
+			continue;
+		const BvhNode& node = m_Nodes[e.node];
+		float distSq[4];
+		int order[4];
+		int n = sortHits(pointNode<Wide>(node, center, bestSq, distSq), distSq, order);
+		for (int i = 0; i < n; ++i)
+		{
+			int k = order[i];
+			if (node.count[k] == 0 || distSq[k] > bestSq)
+				continue;
+			for (std::uint32_t t = node.child[k]; t < node.child[k] + node.count[k]; ++t)
+			{
+				Vec3 q = closestOnTriangle(m_Triangles[t], center);
+				float d = lengthSq(q - center);
+				if (d <= bestSq)
+				{
+					bestSq = d;
+					best = t;
+					bestPoint = q;
+				}
+			}
+		}
+		for (int i = n - 1; i >= 0; --i)
+		{
+			int k = order[i];
+			if (node.count[k] != 0 || distSq[k] > bestSq)
+				continue;
+			assert(static_cast<std::uint32_t>(sp) < m_StackSize);
+			stack[sp++] = { node.child[k], distSq[k] };
+		}
+	}
+	if (best == std::numeric_limits<std::uint32_t>::max())
+		return false;
+	const BvhTriangle& tri = m_Triangles[best];
+	hit.point = bestPoint;
+	hit.normal = normalizeOr(cross(tri.e1, tri.e2), Vec3(0.0f, 1.0f, 0.0f));
+	hit.distance = std::sqrt(bestSq);
+	hit.triangle = m_TriangleIds[best];
+	return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Simd.h"
+#include "SimMath.h"
+
+// Four child boxes stored component by component, so one SSE register holds
+// the same bound of all four children. Exactly two cache lines.
+struct alignas(64) BvhNode
+{
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	// Inner child: index of its node and count 0. Leaf child: first triangle
+	// and triangle count. Unused slot: count 0 and an empty box.
+	std::uint32_t child[4];
+	std::uint32_t count[4];
+};
+
+// Triangle in leaf order, prepared for Moller-Trumbore.
+struct BvhTriangle
+{
+	Vec3 v0;
+	Vec3 e1; // v1 - v0
+	Vec3 e2; // v2 - v0
+};
+
+struct BvhRayHit
+{
+	float t = 0.0f;
+	// Barycentric coordinates of v1 and v2.
+	float u = 0.0f;
+	float v = 0.0f;
+	std::uint32_t triangle = 0;
+};
+
+struct BvhPointHit
+{
+	Vec3 point;
+	// Unit normal of the triangle, following its winding.
+	Vec3 normal;
+	float distance = 0.0f;
+	std::uint32_t triangle = 0;
+};
+
+// Bounding volume hierarchy over a static triangle mesh. A binary tree is
+// built with the surface area heuristic over binned centroids and then
+// collapsed into 4-wide nodes, which are kept in one flat array in depth
+// first order. Traversal tests the four child boxes of a node at once.
+// Triangle indices in hits refer to the mesh passed to build().
+class Bvh
+{
+public:
+	// Most triangles in one leaf.
+	static const std::uint32_t LeafSize = 4;
+
+	Bvh();
+	Bvh(const Bvh& rhs) = delete;
+	Bvh& operator=(const Bvh& rhs) = delete;
+
+	void build(const Vec3* positions, const std::uint32_t* indices, std::uint32_t triangleCount);
+	void build(const std::vector<Vec3>& positions, const std::vector<std::uint32_t>& indices)
+	{
+		build(positions.data(), indices.data(), static_cast<std::uint32_t>(indices.size() / 3));
+	}
+
+	// Closest hit along origin + t*dir with 0 <= t <= tMax. Both triangle sides count.
+	bool raycast(const Vec3& origin, const Vec3& dir, float tMax, BvhRayHit& hit)const;
+	// Closest point of the mesh within radius of center, i.e. the deepest
+	// contact of a sphere.
+	bool closestPoint(const Vec3& center, float radius, BvhPointHit& hit)const;
+
+	// Scalar traversal is kept for comparison; anything above it uses the SSE box test.
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	bool empty()const { return m_Nodes.empty(); }
+	std::uint32_t nodeCount()const { return static_cast<std::uint32_t>(m_Nodes.size()); }
+	std::uint32_t triangleCount()const { return static_cast<std::uint32_t>(m_Triangles.size()); }
+	Vec3 boundsMin()const { return m_BoundsMin; }
+	Vec3 boundsMax()const { return m_BoundsMax; }
+	double lastBuildSeconds()const { return m_BuildSeconds; }
+
+private:
+	template<bool Wide> bool raycastImpl(const Vec3& origin, const Vec3& dir, float tMax, BvhRayHit& hit)const;
+	template<bool Wide> bool closestPointImpl(const Vec3& center, float radius, BvhPointHit& hit)const;
+
+private:
+	SimdLevel m_SimdLevel;
+	std::vector<BvhNode, AlignedAllocator<BvhNode, 64>> m_Nodes;
+	std::vector<BvhTriangle> m_Triangles;
+	// Original index of every triangle in m_Triangles.
+	std::vector<std::uint32_t> m_TriangleIds;
+	Vec3 m_BoundsMin;
+	Vec3 m_BoundsMax;
+	// Traversal stack entries the deepest path of the tree needs.
+	std::uint32_t m_StackSize = 1;
+	double m_BuildSeconds = 0.0;
+};
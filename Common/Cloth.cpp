@@ -0,0 +1,1433 @@
+#include "Cloth.h"
+#include "GreedyColoring.h"
+#include "MeshAdjacency.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Work granularity for the pool. Particle grains are multiples of 8 so
+	// every range starts on an AVX boundary.
+	const std::uint32_t ParticleGrain = 4096;
+	const std::uint32_t ConstraintGrain = 1024;
+	// The coarsest grid is cheap, so it is relaxed several times per V-cycle.
+	const int CoarsestSweeps = 4;
+	// Awake particle runs are cut to at most this many particles, so a task of
+	// RunGrain runs is no larger than ParticleGrain.
+	const std::uint32_t RunLength = 256;
+	const std::uint32_t RunGrain = ParticleGrain / RunLength;
+	const std::uint32_t TileGrain = 16;
+
+	// Greedy coloring: give every constraint the lowest color that none of the
+	// constraints already touching its two particles uses. The constraints are
+	// then counting sorted by color, keeping their relative order inside a
+	// color, and offsets gets the first constraint of every color plus the end.
+	void colorConstraints(std::vector<DistanceConstraint>& constraints, std::uint32_t particleCount,
+		std::vector<std::uint32_t>& offsets)
+	{
+		GreedyColoring coloring(particleCount);
+		std::vector<std::uint32_t> colors(constraints.size());
+		for (size_t k = 0; k < constraints.size(); ++k)
+		{
+			const std::uint32_t particles[2] = { constraints[k].p0, constraints[k].p1 };
+			colors[k] = coloring.add(particles, 2);
+		}
+
+		const std::uint32_t colorCount = coloring.colorCount();
+		offsets.assign(colorCount + 1, 0);
+		for (std::uint32_t c = 0; c < colorCount; ++c)
+			offsets[c + 1] = offsets[c] + coloring.counts()[c];
+		std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		std::vector<DistanceConstraint> sorted(constraints.size());
+		for (size_t k = 0; k < constraints.size(); ++k)
+			sorted[cursor[colors[k]]++] = constraints[k];
+		constraints.swap(sorted);
+	}
+
+	// Project one constraint, accumulating its multiplier in lambda.
+	inline void projectDistanceConstraint(ParticleStore& p, const DistanceConstraint& c, float& lambda, float invDt2)
+	{
+		float w0 = p.invMass[c.p0];
+		float w1 = p.invMass[c.p1];
+		float w = w0 + w1;
+		if (w == 0.0f)
+			return;
+		Vec3 d = p.position(c.p1) - p.position(c.p0);
+		float len = length(d);
+		if (len < 1e-9f)
+			return;
+		// XPBD update: dLambda = (-C - alpha~ * lambda) / (w + alpha~), alpha~ = alpha / dt^2.
+		float alpha = c.compliance * invDt2;
+		float C = len - c.restLength;
+		float dLambda = (-C - alpha * lambda) / (w + alpha);
+		lambda += dLambda;
+		Vec3 corr = d * (dLambda / len);
+		p.setPosition(c.p0, p.position(c.p0) - corr * w0);
+		p.setPosition(c.p1, p.position(c.p1) + corr * w1);
+	}
+
+	// Jacobi counterpart of projectDistanceConstraint: the step is scaled by
+	// scale and the correction of p1 is returned instead of applied; p0 gets
+	// its negation.
+	inline Vec3 jacobiCorrection(const ParticleStore& p, const DistanceConstraint& c, float& lambda, float invDt2, float scale)
+	{
+		float w = p.invMass[c.p0] + p.invMass[c.p1];
+		if (w == 0.0f)
+			return Vec3();
+		Vec3 d = p.position(c.p1) - p.position(c.p0);
+		float len = length(d);
+		if (len < 1e-9f)
+			return Vec3();
+		float alpha = c.compliance * invDt2;
+		float C = len - c.restLength;
+		float dLambda = scale * (-C - alpha * lambda) / (w + alpha);
+		lambda += dLambda;
+		return d * (dLambda / len);
+	}
+
+	// Project constraints [begin, end) once. No two of them may share a particle
+	// when ranges run concurrently.
+	void solveDistanceConstraints(ParticleStore& p, const DistanceConstraint* constraints, float* lambdas,
+		std::uint32_t begin, std::uint32_t end, float invDt2)
+	{
+		for (std::uint32_t k = begin; k < end; ++k)
+			projectDistanceConstraint(p, constraints[k], lambdas[k], invDt2);
+	}
+
+	// The same for the constraints listed in list[begin, end).
+	void solveDistanceConstraintList(ParticleStore& p, const DistanceConstraint* constraints, float* lambdas,
+		const std::uint32_t* list, std::uint32_t begin, std::uint32_t end, float invDt2)
+	{
+		for (std::uint32_t k = begin; k < end; ++k)
+			projectDistanceConstraint(p, constraints[list[k]], lambdas[list[k]], invDt2);
+	}
+}
+
+Cloth::Cloth(const ClothDesc& desc)
+	: m_Desc(desc), m_SimdLevel(detectSimdLevel())
+{
+	assert(desc.columns >= 2 && desc.rows >= 2);
+	assert(desc.substeps >= 1 && desc.iterations >= 1);
+	buildParticles();
+	buildConstraints();
+	buildLevels();
+	buildIndices();
+	initialize();
+}
+
+Cloth::Cloth(const ClothDesc& desc, const ObjMesh& mesh, ThreadPool* pool)
+	: m_Desc(desc), m_SimdLevel(detectSimdLevel())
+{
+	assert(mesh.positions.size() >= 2 && mesh.triangleCount() >= 1);
+	assert(desc.substeps >= 1 && desc.iterations >= 1);
+	m_Desc.columns = static_cast<int>(mesh.positions.size());
+	m_Desc.rows = 1;
+	m_Desc.coarseLevels = 0;
+	m_Desc.pinCorners = false;
+	m_Desc.sleepEnergy = 0.0f;
+	buildMesh(mesh, pool);
+	initialize();
+}
+
+void Cloth::initialize()
+{
+	const ClothDesc& desc = m_Desc;
+	m_MeshNormals.build(m_Indices, particleCount());
+	computeNormals();
+	m_Wind.build(m_Indices, particleCount());
+	m_Wind.setDesc(desc.wind);
+	if (desc.solver == ClothSolver::Jacobi)
+		buildParticleConstraints();
+	if (desc.tearStrain > 0.0f)
+	{
+		// Split particles are appended; keep room so they never reallocate.
+		const std::uint32_t capacity = maxParticleCount();
+		m_Particles.reserve(capacity);
+		m_RestPositions.reserve(capacity);
+		m_TexCoords.reserve(2 * static_cast<size_t>(capacity));
+		m_SplitStamps.assign(particleCount(), 0);
+		buildParticleConstraints();
+	}
+	if (desc.sleepEnergy > 0.0f)
+		buildTiles();
+	if (desc.integrator == ClothIntegrator::Implicit)
+		buildSprings();
+	if (desc.selfCollision)
+	{
+		m_Hash = std::make_unique<SpatialHash>(desc.thickness, maxParticleCount());
+		m_CollisionDeltas.resize(particleCount());
+	}
+}
+
+void Cloth::buildParticles()
+{
+	const int n = m_Desc.columns;
+	const int m = m_Desc.rows;
+	const float dx = m_Desc.width / (n - 1);
+	const float dz = m_Desc.depth / (m - 1);
+	const float halfWidth = 0.5f * m_Desc.width;
+	const float halfDepth = 0.5f * m_Desc.depth;
+	const size_t count = static_cast<size_t>(n) * m;
+
+	m_RestPositions.resize(count);
+	m_Particles.resize(count);
+	m_TexCoords.resize(2 * count);
+	for (int i = 0; i < m; ++i)
+	{
+		float z = halfDepth - i * dz;
+		for (int j = 0; j < n; ++j)
+		{
+			float x = -halfWidth + j * dx;
+			size_t k = index(i, j);
+			m_RestPositions[k] = m_Desc.origin + Vec3(x, 0.0f, z);
+			m_TexCoords[2 * k + 0] = static_cast<float>(j) / (n - 1);
+			m_TexCoords[2 * k + 1] = static_cast<float>(i) / (m - 1);
+		}
+	}
+
+	const float particleInvMass = static_cast<float>(count) / m_Desc.totalMass;
+	std::fill(m_Particles.invMass.begin(), m_Particles.invMass.end(), particleInvMass);
+	if (m_Desc.pinCorners)
+	{
+		m_Particles.invMass[index(0, 0)] = 0.0f;
+		m_Particles.invMass[index(0, n - 1)] = 0.0f;
+	}
+	reset();
+}
+
+void Cloth::buildMesh(const ObjMesh& mesh, ThreadPool* pool)
+{
+	const size_t count = mesh.positions.size();
+	m_RestPositions = mesh.positions;
+	m_Particles.resize(count);
+	m_TexCoords.resize(2 * count);
+	// OBJ texture coordinates are not loaded; project onto the xz bounds
+	// the way the grid lays out u and v.
+	Vec3 lo = mesh.positions[0], hi = lo;
+	for (const Vec3& p : mesh.positions)
+	{
+		lo = Vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+		hi = Vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+	}
+	const float invX = hi.x > lo.x ? 1.0f / (hi.x - lo.x) : 0.0f;
+	const float invZ = hi.z > lo.z ? 1.0f / (hi.z - lo.z) : 0.0f;
+	for (size_t k = 0; k < count; ++k)
+	{
+		m_TexCoords[2 * k + 0] = (mesh.positions[k].x - lo.x) * invX;
+		m_TexCoords[2 * k + 1] = (hi.z - mesh.positions[k].z) * invZ;
+	}
+	std::fill(m_Particles.invMass.begin(), m_Particles.invMass.end(), static_cast<float>(count) / m_Desc.totalMass);
+	reset();
+
+	MeshAdjacency adjacency;
+	adjacency.build(mesh.indices, static_cast<std::uint32_t>(count), pool);
+	m_Constraints.clear();
+	m_Constraints.reserve(2 * adjacency.edges().size());
+	for (const MeshEdge& e : adjacency.edges())
+		addConstraint(e.v0, e.v1, m_Desc.stretchCompliance, ClothConstraintType::Stretch);
+	for (const MeshEdge& e : adjacency.edges())
+	{
+		if (e.opposite[1] != MeshAdjacency::NoVertex && e.opposite[0] != e.opposite[1])
+			addConstraint(e.opposite[0], e.opposite[1], m_Desc.bendCompliance, ClothConstraintType::Bend);
+	}
+	colorConstraints();
+	m_Lambdas.assign(m_Constraints.size(), 0.0f);
+	m_Indices = mesh.indices;
+}
+
+void Cloth::addConstraint(std::uint32_t p0, std::uint32_t p1, float compliance, ClothConstraintType type)
+{
+	DistanceConstraint c;
+	c.p0 = p0;
+	c.p1 = p1;
+	c.restLength = length(m_RestPositions[p1] - m_RestPositions[p0]);
+	c.compliance = compliance;
+	c.type = type;
+	m_Constraints.push_back(c);
+}
+
+void Cloth::buildConstraints()
+{
+	const int n = m_Desc.columns;
+	const int m = m_Desc.rows;
+	m_Constraints.clear();
+	m_Constraints.reserve(static_cast<size_t>(n) * m * 6);
+	for (int i = 0; i < m; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			// Stretch: right and down neighbours.
+			if (j + 1 < n)
+				addConstraint(index(i, j), index(i, j + 1), m_Desc.stretchCompliance, ClothConstraintType::Stretch);
+			if (i + 1 < m)
+				addConstraint(index(i, j), index(i + 1, j), m_Desc.stretchCompliance, ClothConstraintType::Stretch);
+			// Shear: both diagonals of the quad.
+			if (i + 1 < m && j + 1 < n)
+			{
+				addConstraint(index(i, j), index(i + 1, j + 1), m_Desc.shearCompliance, ClothConstraintType::Shear);
+				addConstraint(index(i, j + 1), index(i + 1, j), m_Desc.shearCompliance, ClothConstraintType::Shear);
+			}
+			// Bend: skip one particle in each direction.
+			if (j + 2 < n)
+				addConstraint(index(i, j), index(i, j + 2), m_Desc.bendCompliance, ClothConstraintType::Bend);
+			if (i + 2 < m)
+				addConstraint(index(i, j), index(i + 2, j), m_Desc.bendCompliance, ClothConstraintType::Bend);
+		}
+	}
+	colorConstraints();
+	m_Lambdas.assign(m_Constraints.size(), 0.0f);
+}
+
+void Cloth::colorConstraints()
+{
+	::colorConstraints(m_Constraints, particleCount(), m_ColorOffsets);
+	resetStats();
+}
+
+void Cloth::buildLevels()
+{
+	m_Levels.clear();
+	int fineColumns = m_Desc.columns;
+	int fineRows = m_Desc.rows;
+	const std::vector<Vec3>* fineRest = &m_RestPositions;
+	const AlignedVector<float>* fineInvMass = &m_Particles.invMass;
+	m_Levels.reserve(std::max(0, m_Desc.coarseLevels));
+	for (int l = 0; l < m_Desc.coarseLevels; ++l)
+	{
+		// Every second particle, always keeping the last row and column so
+		// the corners (and the pins on them) survive on every level.
+		const int n = fineColumns / 2 + 1;
+		const int m = fineRows / 2 + 1;
+		if (n < 3 || m < 3 || (n == fineColumns && m == fineRows))
+			break;
+		m_Levels.emplace_back();
+		CoarseLevel& level = m_Levels.back();
+		level.columns = n;
+		level.rows = m;
+		level.parentColumn.resize(n);
+		level.parentRow.resize(m);
+		for (int j = 0; j < n; ++j)
+			level.parentColumn[j] = std::min(2 * j, fineColumns - 1);
+		for (int i = 0; i < m; ++i)
+			level.parentRow[i] = std::min(2 * i, fineRows - 1);
+
+		// A coarse particle stands for the four fine particles around it.
+		const size_t count = static_cast<size_t>(n) * m;
+		level.restPositions.resize(count);
+		level.particles.resize(count);
+		level.start.resize(count);
+		for (int i = 0; i < m; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				size_t k = static_cast<size_t>(i) * n + j;
+				size_t parent = static_cast<size_t>(level.parentRow[i]) * fineColumns + level.parentColumn[j];
+				level.restPositions[k] = (*fineRest)[parent];
+				level.particles.invMass[k] = 0.25f * (*fineInvMass)[parent];
+			}
+		}
+
+		// Stretch and shear only; bending is soft and local, the fine grid handles it.
+		auto add = [&level, n](int i0, int j0, int i1, int j1, float compliance, ClothConstraintType type) {
+			DistanceConstraint c;
+			c.p0 = static_cast<std::uint32_t>(i0 * n + j0);
+			c.p1 = static_cast<std::uint32_t>(i1 * n + j1);
+			c.restLength = length(level.restPositions[c.p1] - level.restPositions[c.p0]);
+			c.compliance = compliance;
+			c.type = type;
+			level.constraints.push_back(c);
+		};
+		level.constraints.reserve(count * 4);
+		for (int i = 0; i < m; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				if (j + 1 < n)
+					add(i, j, i, j + 1, m_Desc.stretchCompliance, ClothConstraintType::Stretch);
+				if (i + 1 < m)
+					add(i, j, i + 1, j, m_Desc.stretchCompliance, ClothConstraintType::Stretch);
+				if (i + 1 < m && j + 1 < n)
+				{
+					add(i, j, i + 1, j + 1, m_Desc.shearCompliance, ClothConstraintType::Shear);
+					add(i, j + 1, i + 1, j, m_Desc.shearCompliance, ClothConstraintType::Shear);
+				}
+			}
+		}
+		::colorConstraints(level.constraints, static_cast<std::uint32_t>(count), level.colorOffsets);
+		level.lambdas.assign(level.constraints.size(), 0.0f);
+
+		fineColumns = n;
+		fineRows = m;
+		fineRest = &level.restPositions;
+		fineInvMass = &level.particles.invMass;
+	}
+}
+
+void Cloth::buildIndices()
+{
+	const int n = m_Desc.columns;
+	const int m = m_Desc.rows;
+	m_Indices.clear();
+	m_Indices.reserve(static_cast<size_t>(n - 1) * (m - 1) * 6);
+	for (int i = 0; i < m - 1; ++i)
+	{
+		for (int j = 0; j < n - 1; ++j)
+		{
+			m_Indices.push_back(index(i, j));
+			m_Indices.push_back(index(i, j + 1));
+			m_Indices.push_back(index(i + 1, j));
+
+			m_Indices.push_back(index(i + 1, j));
+			m_Indices.push_back(index(i, j + 1));
+			m_Indices.push_back(index(i + 1, j + 1));
+		}
+	}
+}
+
+void Cloth::reset()
+{
+	wakeAll();
+	for (size_t i = 0; i < m_RestPositions.size(); ++i)
+	{
+		m_Particles.setPosition(i, m_RestPositions[i]);
+		m_Particles.setPrevPosition(i, m_RestPositions[i]);
+		m_Particles.setVelocity(i, Vec3());
+	}
+	m_Time = 0.0f;
+}
+
+void Cloth::setPosition(std::uint32_t i, const Vec3& p)
+{
+	wake(i);
+	m_Particles.setPosition(i, p);
+	m_Particles.setPrevPosition(i, p);
+	m_Particles.setVelocity(i, Vec3());
+}
+
+void Cloth::setVelocity(std::uint32_t i, const Vec3& v)
+{
+	wake(i);
+	m_Particles.setVelocity(i, v);
+}
+
+void Cloth::setInvMass(std::uint32_t i, float w)
+{
+	wake(i);
+	m_Particles.invMass[i] = w;
+}
+
+float Cloth::invMass(std::uint32_t i)const
+{
+	return isSleeping(i) ? m_SleepInvMass[i] : m_Particles.invMass[i];
+}
+
+void Cloth::step(float dt)
+{
+	if (dt <= 0.0f)
+		return;
+	IntegrateParams params;
+	params.dt = dt / m_Desc.substeps;
+	params.gravity = m_Desc.gravity;
+	params.damping = std::max(0.0f, 1.0f - m_Desc.damping * params.dt);
+	m_Wind.setSimdLevel(m_SimdLevel);
+	if (m_CcdMesh != nullptr)
+	{
+		m_Ccd.resetStats();
+		if (m_CcdEdgesDirty)
+			buildCcdEdges();
+	}
+	for (int s = 0; s < m_Desc.substeps; ++s)
+	{
+		if (m_ActiveDirty)
+			buildActiveSets();
+		if (m_Wind.enabled())
+			m_Wind.apply(m_Particles, params.dt, m_Time, m_Pool);
+		m_Time += params.dt;
+		if (m_Desc.integrator == ClothIntegrator::Implicit)
+		{
+			m_Implicit.setSimdLevel(m_SimdLevel);
+			m_Implicit.step(m_Particles, params, m_Pool);
+		}
+		else
+		{
+			parallelParticles([this, &params](std::uint32_t begin, std::uint32_t end, unsigned) {
+				integrateSemiImplicitEuler(m_Particles, params, m_SimdLevel, begin, end);
+			});
+			std::fill(m_Lambdas.begin(), m_Lambdas.end(), 0.0f);
+			for (CoarseLevel& level : m_Levels)
+				std::fill(level.lambdas.begin(), level.lambdas.end(), 0.0f);
+			if (m_Desc.solver == ClothSolver::Jacobi)
+			{
+				solveJacobi(params.dt);
+			}
+			else
+			{
+				for (int it = 0; it < m_Desc.iterations; ++it)
+				{
+					if (m_Levels.empty())
+						solveConstraints(params.dt);
+					else
+						vCycle(0, params.dt);
+				}
+			}
+		}
+		if (m_Hash)
+			solveSelfCollisions();
+		if (m_CcdMesh != nullptr)
+		{
+			const float friction = std::min(std::max(m_Desc.friction, 0.0f), 1.0f);
+			m_Ccd.solve(m_Particles, *m_CcdMesh, static_cast<float>(s) / m_Desc.substeps,
+				static_cast<float>(s + 1) / m_Desc.substeps, m_Desc.thickness, friction, m_Pool);
+		}
+		if (m_Collider != nullptr)
+			solveMeshCollisions();
+		if (m_Shapes != nullptr)
+			solveShapeCollisions();
+		parallelParticles([this, &params](std::uint32_t begin, std::uint32_t end, unsigned) {
+			deriveVelocities(m_Particles, params.dt, m_SimdLevel, begin, end);
+		});
+	}
+	if (m_Desc.tearStrain > 0.0f)
+	{
+		findTears();
+		applyTears();
+	}
+	if (!m_TileAsleep.empty())
+		updateSleep();
+	computeNormals();
+}
+
+void Cloth::setProfiling(bool enable)
+{
+	m_Profiling = enable;
+	if (m_Pool != nullptr)
+		m_Pool->setProfiling(enable);
+}
+
+void Cloth::resetStats()
+{
+	m_ColorStats.assign(colorCount(), ClothColorStats());
+	for (std::uint32_t c = 0; c < colorCount(); ++c)
+		m_ColorStats[c].constraints = m_ColorOffsets[c + 1] - m_ColorOffsets[c];
+}
+
+void Cloth::parallelParticles(const ThreadPool::RangeFn& fn)
+{
+	if (m_SleepingTiles == 0)
+	{
+		parallelRange(m_Pool, particleCount(), ParticleGrain, fn);
+		return;
+	}
+	parallelRange(m_Pool, static_cast<std::uint32_t>(m_ActiveRuns.size()), RunGrain,
+		[this, &fn](std::uint32_t begin, std::uint32_t end, unsigned thread) {
+		for (std::uint32_t r = begin; r < end; ++r)
+			fn(m_ActiveRuns[r].begin, m_ActiveRuns[r].end, thread);
+	});
+}
+
+void Cloth::solveConstraints(float dt)
+{
+	const float invDt2 = 1.0f / (dt * dt);
+	const bool sleeping = m_SleepingTiles > 0;
+	for (std::uint32_t c = 0; c < colorCount(); ++c)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (sleeping)
+		{
+			const std::uint32_t first = m_ActiveColorOffsets[c];
+			const std::uint32_t count = m_ActiveColorOffsets[c + 1] - first;
+			parallelRange(m_Pool, count, ConstraintGrain, [this, first, invDt2](std::uint32_t begin, std::uint32_t end, unsigned) {
+				solveDistanceConstraintList(m_Particles, m_Constraints.data(), m_Lambdas.data(),
+					m_ActiveConstraints.data(), first + begin, first + end, invDt2);
+			});
+		}
+		else
+		{
+			const std::uint32_t first = m_ColorOffsets[c];
+			const std::uint32_t count = m_ColorOffsets[c + 1] - first;
+			parallelRange(m_Pool, count, ConstraintGrain, [this, first, invDt2](std::uint32_t begin, std::uint32_t end, unsigned) {
+				solveConstraintRange(first + begin, first + end, invDt2);
+			});
+		}
+		if (m_Profiling)
+		{
+			ClothColorStats& stats = m_ColorStats[c];
+			stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			stats.imbalanceSum += m_Pool != nullptr ? m_Pool->lastImbalance() : 1.0;
+			stats.solves++;
+		}
+	}
+}
+
+void Cloth::solveConstraintRange(std::uint32_t begin, std::uint32_t end, float invDt2)
+{
+	solveDistanceConstraints(m_Particles, m_Constraints.data(), m_Lambdas.data(), begin, end, invDt2);
+}
+
+void Cloth::solveJacobi(float dt)
+{
+	const float invDt2 = 1.0f / (dt * dt);
+	const float relaxation = m_Desc.jacobiRelaxation;
+	const float rho = std::min(std::max(m_Desc.chebyshevRho, 0.0f), 0.999f);
+	const bool sleeping = m_SleepingTiles > 0;
+	const std::uint32_t count = sleeping ? m_ActiveColorOffsets.back() : static_cast<std::uint32_t>(m_Constraints.size());
+	m_JacobiCorrections.resize(m_Constraints.size());
+	m_JacobiPrevious.resize(particleCount());
+	float omega = 1.0f;
+	for (int it = 0; it < m_Desc.iterations; ++it)
+	{
+		// omega_1 = 1, omega_2 = 2 / (2 - rho^2), omega_k+1 = 4 / (4 - rho^2 omega_k).
+		if (it == 1)
+			omega = 2.0f / (2.0f - rho * rho);
+		else if (it > 1)
+			omega = 4.0f / (4.0f - rho * rho * omega);
+
+		parallelRange(m_Pool, count, ConstraintGrain, [this, sleeping, invDt2, relaxation](std::uint32_t begin, std::uint32_t end, unsigned) {
+			for (std::uint32_t e = begin; e < end; ++e)
+			{
+				const std::uint32_t k = sleeping ? m_ActiveConstraints[e] : e;
+				const DistanceConstraint& c = m_Constraints[k];
+				const std::uint32_t n0 = m_ConstraintOffsets[c.p0 + 1] - m_ConstraintOffsets[c.p0];
+				const std::uint32_t n1 = m_ConstraintOffsets[c.p1 + 1] - m_ConstraintOffsets[c.p1];
+				m_JacobiCorrections[k] = jacobiCorrection(m_Particles, c, m_Lambdas[k], invDt2, relaxation / std::max(n0, n1));
+			}
+		});
+		parallelParticles([this, it, omega](std::uint32_t begin, std::uint32_t end, unsigned) {
+			ParticleStore& p = m_Particles;
+			for (std::uint32_t i = begin; i < end; ++i)
+			{
+				const float w = p.invMass[i];
+				if (w == 0.0f)
+					continue;
+				Vec3 delta;
+				for (std::uint32_t e = m_ConstraintOffsets[i]; e < m_ConstraintOffsets[i + 1]; ++e)
+				{
+					const std::uint32_t k = m_ParticleConstraints[e];
+					if (m_Constraints[k].p1 == i)
+						delta += m_JacobiCorrections[k];
+					else
+						delta -= m_JacobiCorrections[k];
+				}
+				const Vec3 x = p.position(i);
+				Vec3 next = x + delta * w;
+				if (it > 0)
+					next = m_JacobiPrevious[i] + (next - m_JacobiPrevious[i]) * omega;
+				m_JacobiPrevious[i] = x;
+				p.setPosition(i, next);
+			}
+		});
+	}
+}
+
+void Cloth::vCycle(std::uint32_t level, float dt)
+{
+	if (level == m_Levels.size())
+	{
+		for (int sweep = 0; sweep < CoarsestSweeps; ++sweep)
+			smoothLevel(level, dt);
+		return;
+	}
+	smoothLevel(level, dt);
+	restrictLevel(level);
+	vCycle(level + 1, dt);
+	prolongateLevel(level);
+	smoothLevel(level, dt);
+}
+
+void Cloth::smoothLevel(std::uint32_t level, float dt)
+{
+	if (level == 0)
+	{
+		solveConstraints(dt);
+		return;
+	}
+	CoarseLevel& coarse = m_Levels[level - 1];
+	const float invDt2 = 1.0f / (dt * dt);
+	for (size_t c = 0; c + 1 < coarse.colorOffsets.size(); ++c)
+	{
+		const std::uint32_t first = coarse.colorOffsets[c];
+		const std::uint32_t count = coarse.colorOffsets[c + 1] - first;
+		parallelRange(m_Pool, count, ConstraintGrain, [&coarse, first, invDt2](std::uint32_t begin, std::uint32_t end, unsigned) {
+			solveDistanceConstraints(coarse.particles, coarse.constraints.data(), coarse.lambdas.data(),
+				first + begin, first + end, invDt2);
+		});
+	}
+}
+
+// Injection: a coarse particle takes the position of the fine particle it sits on.
+void Cloth::restrictLevel(std::uint32_t level)
+{
+	const ParticleStore& fine = level == 0 ? m_Particles : m_Levels[level - 1].particles;
+	const int fineColumns = level == 0 ? m_Desc.columns : m_Levels[level - 1].columns;
+	CoarseLevel& coarse = m_Levels[level];
+	const std::uint32_t count = static_cast<std::uint32_t>(coarse.particles.size());
+	parallelRange(m_Pool, count, ParticleGrain, [&fine, &coarse, fineColumns](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t k = begin; k < end; ++k)
+		{
+			const int i = static_cast<int>(k) / coarse.columns;
+			const int j = static_cast<int>(k) % coarse.columns;
+			Vec3 p = fine.position(static_cast<size_t>(coarse.parentRow[i]) * fineColumns + coarse.parentColumn[j]);
+			coarse.particles.setPosition(k, p);
+			coarse.start[k] = p;
+		}
+	});
+}
+
+// Add the coarse correction to the fine grid, bilinearly interpolated between
+// the four coarse particles around every fine particle. Pinned particles stay.
+void Cloth::prolongateLevel(std::uint32_t level)
+{
+	ParticleStore& fine = level == 0 ? m_Particles : m_Levels[level - 1].particles;
+	const int fineColumns = level == 0 ? m_Desc.columns : m_Levels[level - 1].columns;
+	const CoarseLevel& coarse = m_Levels[level];
+	// Particles split off by tearing are not on the grid and get no correction.
+	const std::uint32_t count = level == 0 ? gridParticleCount() : static_cast<std::uint32_t>(fine.size());
+
+	// Bracketing coarse index and weight of the upper one along an axis.
+	auto bracket = [](const std::vector<int>& parents, int f, int& lower, int& upper, float& t) {
+		const int last = static_cast<int>(parents.size()) - 1;
+		lower = std::min(f / 2, last);
+		upper = std::min(lower + 1, last);
+		const int span = parents[upper] - parents[lower];
+		t = span > 0 ? static_cast<float>(f - parents[lower]) / span : 0.0f;
+	};
+
+	parallelRange(m_Pool, count, ParticleGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t k = begin; k < end; ++k)
+		{
+			if (fine.invMass[k] == 0.0f)
+				continue;
+			int i0, i1, j0, j1;
+			float ti, tj;
+			bracket(coarse.parentRow, static_cast<int>(k) / fineColumns, i0, i1, ti);
+			bracket(coarse.parentColumn, static_cast<int>(k) % fineColumns, j0, j1, tj);
+			auto correction = [&coarse](int i, int j) {
+				size_t c = static_cast<size_t>(i) * coarse.columns + j;
+				return coarse.particles.position(c) - coarse.start[c];
+			};
+			Vec3 top = correction(i0, j0) * (1.0f - tj) + correction(i0, j1) * tj;
+			Vec3 bottom = correction(i1, j0) * (1.0f - tj) + correction(i1, j1) * tj;
+			fine.setPosition(k, fine.position(k) + top * (1.0f - ti) + bottom * ti);
+		}
+	});
+}
+
+float Cloth::stretchResidual()const
+{
+	double sum = 0.0;
+	size_t count = 0;
+	for (const DistanceConstraint& c : m_Constraints)
+	{
+		if (c.type == ClothConstraintType::Bend || c.restLength <= 0.0f)
+			continue;
+		float strain = (length(m_Particles.position(c.p1) - m_Particles.position(c.p0)) - c.restLength) / c.restLength;
+		sum += static_cast<double>(strain) * strain;
+		++count;
+	}
+	return count > 0 ? static_cast<float>(std::sqrt(sum / count)) : 0.0f;
+}
+
+void Cloth::solveSelfCollisions()
+{
+	const std::uint32_t count = particleCount();
+	const float thickness = m_Desc.thickness;
+	m_Hash->build(m_Particles, count, m_Pool);
+	// Pairs no closer than at rest need no correction; leaving them out keeps
+	// the neighbour list for the ones that have folded together.
+	m_Hash->queryAll(m_Particles, thickness, m_Pool, m_RestPositions.data());
+	const bool sleeping = m_SleepingTiles > 0;
+	if (sleeping)
+	{
+		m_WakeLists.resize(m_Pool != nullptr ? m_Pool->threadCount() : 1);
+		for (auto& list : m_WakeLists)
+			list.clear();
+	}
+
+	// Jacobi style: every particle only moves itself, using the positions from
+	// before the pass, so threads never write to the same particle. Sleeping
+	// particles have no mass to move; an awake particle touching one wakes its tile.
+	parallelRange(m_Pool, count, ParticleGrain, [this, thickness, sleeping](std::uint32_t begin, std::uint32_t end, unsigned thread) {
+		const ParticleStore& p = m_Particles;
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			Vec3 corr;
+			const float wi = p.invMass[i];
+			const std::uint32_t n = m_Hash->neighborCount(i);
+			const std::uint32_t* neighbors = m_Hash->neighbors(i);
+			for (std::uint32_t k = 0; k < n && wi > 0.0f; ++k)
+			{
+				std::uint32_t j = neighbors[k];
+				Vec3 d = p.position(i) - p.position(j);
+				float len = length(d);
+				// Particles that start closer than the thickness, such as grid
+				// neighbours, only need to keep their rest distance.
+				float minDist = std::min(thickness, length(m_RestPositions[i] - m_RestPositions[j]));
+				if (len >= minDist || len < 1e-9f)
+					continue;
+				if (sleeping && p.invMass[j] == 0.0f && m_TileAsleep[tileOf(j)] != 0)
+					m_WakeLists[thread].push_back(tileOf(j));
+				float share = wi / (wi + p.invMass[j]);
+				corr += d * (share * (minDist - len) / len);
+			}
+			m_CollisionDeltas[i] = corr;
+		}
+	});
+	parallelRange(m_Pool, count, ParticleGrain, [this](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+			m_Particles.setPosition(i, m_Particles.position(i) + m_CollisionDeltas[i]);
+	});
+	if (sleeping)
+	{
+		for (const auto& list : m_WakeLists)
+		{
+			for (std::uint32_t t : list)
+			{
+				if (m_TileAsleep[t] != 0)
+					wakeTile(t);
+			}
+		}
+	}
+}
+
+void Cloth::solveMeshCollisions()
+{
+	const float thickness = m_Desc.thickness;
+	const float friction = std::min(std::max(m_Desc.friction, 0.0f), 1.0f);
+	parallelParticles([this, thickness, friction](std::uint32_t begin, std::uint32_t end, unsigned) {
+		ParticleStore& p = m_Particles;
+		BvhPointHit hit;
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			if (p.invMass[i] == 0.0f)
+				continue;
+			Vec3 x = p.position(i);
+			if (!m_Collider->closestPoint(x, thickness, hit))
+				continue;
+			// Push the particle out along the contact direction. A particle
+			// behind the triangle has already passed through, so it is put
+			// back on the front side instead.
+			Vec3 d = x - hit.point;
+			Vec3 n = dot(d, hit.normal) < 0.0f || hit.distance < 1e-9f ? hit.normal : d * (1.0f / hit.distance);
+			Vec3 resolved = hit.point + n * thickness;
+			// Friction scales down the motion of this substep along the surface.
+			Vec3 motion = resolved - p.prevPosition(i);
+			Vec3 slide = motion - n * dot(motion, n);
+			p.setPosition(i, resolved - slide * friction);
+		}
+	});
+}
+
+void Cloth::setContinuousCollider(const CcdMesh* mesh)
+{
+	m_CcdMesh = mesh;
+	m_Ccd.resetStats();
+	wakeAll();
+}
+
+void Cloth::buildCcdEdges()
+{
+	MeshAdjacency adjacency;
+	adjacency.build(m_Indices, particleCount(), m_Pool);
+	std::vector<std::uint32_t> edges;
+	edges.reserve(adjacency.edges().size() * 2);
+	for (const MeshEdge& e : adjacency.edges())
+	{
+		edges.push_back(e.v0);
+		edges.push_back(e.v1);
+	}
+	m_Ccd.setEdges(std::move(edges));
+	m_CcdEdgesDirty = false;
+}
+
+void Cloth::solveShapeCollisions()
+{
+	const float thickness = m_Desc.thickness;
+	parallelParticles([this, thickness](std::uint32_t begin, std::uint32_t end, unsigned) {
+		m_Shapes->collide(m_Particles, thickness, begin, end);
+	});
+}
+
+std::uint32_t Cloth::maxParticleCount()const
+{
+	return gridParticleCount() + (m_Desc.tearStrain > 0.0f ? static_cast<std::uint32_t>(std::max(0, m_Desc.maxTearParticles)) : 0);
+}
+
+void Cloth::buildParticleConstraints()
+{
+	const std::uint32_t count = particleCount();
+	m_ConstraintOffsets.assign(static_cast<size_t>(count) + 1, 0);
+	for (const DistanceConstraint& c : m_Constraints)
+	{
+		m_ConstraintOffsets[c.p0 + 1]++;
+		m_ConstraintOffsets[c.p1 + 1]++;
+	}
+	for (std::uint32_t i = 0; i < count; ++i)
+		m_ConstraintOffsets[i + 1] += m_ConstraintOffsets[i];
+	std::vector<std::uint32_t> cursor(m_ConstraintOffsets.begin(), m_ConstraintOffsets.end() - 1);
+	m_ParticleConstraints.resize(2 * m_Constraints.size());
+	for (std::uint32_t k = 0; k < m_Constraints.size(); ++k)
+	{
+		m_ParticleConstraints[cursor[m_Constraints[k].p0]++] = k;
+		m_ParticleConstraints[cursor[m_Constraints[k].p1]++] = k;
+	}
+}
+
+void Cloth::buildSprings()
+{
+	const ImplicitDesc& desc = m_Desc.implicit;
+	std::vector<ImplicitSpring> springs(m_Constraints.size());
+	for (size_t k = 0; k < m_Constraints.size(); ++k)
+	{
+		const DistanceConstraint& c = m_Constraints[k];
+		springs[k].p0 = c.p0;
+		springs[k].p1 = c.p1;
+		springs[k].restLength = c.restLength;
+		springs[k].stiffness = c.type == ClothConstraintType::Stretch ? desc.stretchStiffness
+			: c.type == ClothConstraintType::Shear ? desc.shearStiffness : desc.bendStiffness;
+	}
+	m_Implicit.setDesc(desc);
+	m_Implicit.build(springs, particleCount());
+}
+
+void Cloth::findTears()
+{
+	const unsigned threads = m_Pool != nullptr ? m_Pool->threadCount() : 1;
+	m_TearLists.resize(threads);
+	for (auto& list : m_TearLists)
+		list.clear();
+	const float limit = m_Desc.tearStrain;
+	// Read only, so the threads need nothing but their own list.
+	parallelRange(m_Pool, static_cast<std::uint32_t>(m_Constraints.size()), ConstraintGrain,
+		[this, limit](std::uint32_t begin, std::uint32_t end, unsigned thread) {
+		const ParticleStore& p = m_Particles;
+		std::vector<std::uint32_t>& list = m_TearLists[thread];
+		for (std::uint32_t k = begin; k < end; ++k)
+		{
+			const DistanceConstraint& c = m_Constraints[k];
+			if (c.type == ClothConstraintType::Bend || c.restLength <= 0.0f)
+				continue;
+			if (length(p.position(c.p1) - p.position(c.p0)) > (1.0f + limit) * c.restLength)
+				list.push_back(k);
+		}
+	});
+}
+
+void Cloth::applyTears()
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::uint32_t> torn;
+	for (const auto& list : m_TearLists)
+		torn.insert(torn.end(), list.begin(), list.end());
+	if (torn.empty())
+		return;
+	// Which thread found what depends on scheduling; the order must not.
+	std::sort(torn.begin(), torn.end());
+
+	nextTearEpoch();
+	int splits = 0;
+	for (std::uint32_t k : torn)
+	{
+		if (splits == m_Desc.maxTearsPerStep || particleCount() == maxParticleCount())
+			break;
+		const DistanceConstraint c = m_Constraints[k];
+		if (m_SplitStamps[c.p0] == m_TearEpoch || m_SplitStamps[c.p1] == m_TearEpoch)
+			continue;
+		// A split copies the mass, which a sleeping particle has lent out.
+		wake(c.p0);
+		wake(c.p1);
+		if (splitParticle(c.p0, c.p1) || splitParticle(c.p1, c.p0))
+			++splits;
+	}
+	if (splits == 0)
+		return;
+	m_TearCount += splits;
+	finishSplits();
+	m_TopologySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::uint32_t Cloth::tear(const std::vector<ClothTear>& tears)
+{
+	if (m_Desc.tearStrain <= 0.0f)
+		return 0;
+	auto start = std::chrono::steady_clock::now();
+	const std::uint32_t grid = gridParticleCount();
+	// The constraint of a tear, from whichever particle of the first grid
+	// particle still has it. 1 when found, 2 when it may be on a particle
+	// split in this phase, whose lists are out of date, 0 when there is none.
+	auto find = [this, grid](const ClothTear& t, std::uint32_t& v, std::uint32_t& w) {
+		const std::uint32_t listed = static_cast<std::uint32_t>(m_ConstraintOffsets.size()) - 1;
+		for (std::uint32_t s = 0; s <= m_SplitFrom.size(); ++s)
+		{
+			const std::uint32_t u = s == 0 ? t.particle : grid + s - 1;
+			if (s > 0 && m_SplitFrom[s - 1] != t.particle)
+				continue;
+			if (u >= listed || m_SplitStamps[u] == m_TearEpoch)
+				return 2;
+			for (std::uint32_t e = m_ConstraintOffsets[u]; e < m_ConstraintOffsets[u + 1]; ++e)
+			{
+				const DistanceConstraint& c = m_Constraints[m_ParticleConstraints[e]];
+				if (c.type == ClothConstraintType::Bend)
+					continue;
+				const std::uint32_t other = c.p0 == u ? c.p1 : c.p0;
+				if (gridParticle(other) != t.toward)
+					continue;
+				if (m_SplitStamps[other] == m_TearEpoch)
+					return 2;
+				v = u;
+				w = other;
+				return 1;
+			}
+		}
+		return 0;
+	};
+
+	// Like the tears of a step, a particle is split at most once per phase;
+	// tears that need one split again wait for the next phase.
+	std::uint32_t splits = 0;
+	std::vector<ClothTear> pending, deferred;
+	for (const ClothTear& t : tears)
+	{
+		if (t.particle < grid && t.toward < grid && t.particle != t.toward)
+			pending.push_back(t);
+	}
+	while (!pending.empty())
+	{
+		nextTearEpoch();
+		deferred.clear();
+		std::uint32_t made = 0;
+		for (const ClothTear& t : pending)
+		{
+			if (particleCount() == maxParticleCount())
+				break;
+			std::uint32_t v, w;
+			const int found = find(t, v, w);
+			if (found == 2)
+				deferred.push_back(t);
+			if (found != 1)
+				continue;
+			wake(v);
+			wake(w);
+			if (splitParticle(v, w) || splitParticle(w, v))
+				++made;
+		}
+		if (made == 0)
+			break;
+		splits += made;
+		finishSplits();
+		pending.swap(deferred);
+	}
+	m_TearCount += splits;
+	m_TopologySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return splits;
+}
+
+void Cloth::healTears()
+{
+	const std::uint32_t grid = gridParticleCount();
+	if (particleCount() == grid)
+		return;
+	// A sleeping particle has lent out its mass.
+	wakeAll();
+	for (std::uint32_t i = grid; i < particleCount(); ++i)
+	{
+		float& w = m_Particles.invMass[m_SplitFrom[i - grid]];
+		if (w > 0.0f && m_Particles.invMass[i] > 0.0f)
+			w = 1.0f / (1.0f / w + 1.0f / m_Particles.invMass[i]);
+	}
+	for (std::uint32_t& v : m_Indices)
+		v = gridParticle(v);
+	for (DistanceConstraint& c : m_Constraints)
+	{
+		c.p0 = gridParticle(c.p0);
+		c.p1 = gridParticle(c.p1);
+	}
+	m_Particles.resize(grid);
+	m_RestPositions.resize(grid);
+	m_TexCoords.resize(2 * static_cast<size_t>(grid));
+	m_SplitFrom.clear();
+	m_SplitStamps.assign(grid, 0);
+	m_Tears.clear();
+	m_TearCount = 0;
+	m_DirtyTriangles.resize(m_Indices.size() / 3);
+	for (std::uint32_t t = 0; t < m_DirtyTriangles.size(); ++t)
+		m_DirtyTriangles[t] = t;
+	finishSplits();
+}
+
+void Cloth::nextTearEpoch()
+{
+	// A particle is split at most once per phase, which keeps the face and
+	// constraint lists of every particle not yet split valid without
+	// rebuilding them after each split.
+	if (++m_TearEpoch == 0)
+	{
+		std::fill(m_SplitStamps.begin(), m_SplitStamps.end(), 0);
+		m_TearEpoch = 1;
+	}
+}
+
+void Cloth::finishSplits()
+{
+	m_MeshNormals.build(m_Indices, particleCount());
+	m_Wind.build(m_Indices, particleCount());
+	buildParticleConstraints();
+	if (m_Desc.integrator == ClothIntegrator::Implicit)
+		buildSprings();
+	if (m_Hash)
+		m_CollisionDeltas.resize(particleCount());
+	m_CcdEdgesDirty = true;
+	if (!m_TileAsleep.empty())
+	{
+		m_SleepInvMass.resize(particleCount());
+		m_ActiveDirty = true;
+	}
+
+	// Merge the rewritten triangles into index ranges.
+	std::sort(m_DirtyTriangles.begin(), m_DirtyTriangles.end());
+	m_DirtyTriangles.erase(std::unique(m_DirtyTriangles.begin(), m_DirtyTriangles.end()), m_DirtyTriangles.end());
+	m_DirtyIndexRanges.clear();
+	for (std::uint32_t t : m_DirtyTriangles)
+	{
+		if (!m_DirtyIndexRanges.empty() && m_DirtyIndexRanges.back().first + m_DirtyIndexRanges.back().count == 3 * t)
+			m_DirtyIndexRanges.back().count += 3;
+		else
+			m_DirtyIndexRanges.push_back({ 3 * t, 3 });
+	}
+}
+
+bool Cloth::splitParticle(std::uint32_t v, std::uint32_t w)
+{
+	// The crack runs through v across the torn constraint, in the rest shape;
+	// whatever lies towards w moves to the new particle.
+	const Vec3 rest = m_RestPositions[v];
+	const Vec3 axis = m_RestPositions[w] - rest;
+	const std::vector<std::uint32_t>& faceOffsets = m_MeshNormals.faceOffsets();
+	const std::vector<std::uint32_t>& faces = m_MeshNormals.faces();
+	auto farSide = [this, &rest, &axis](std::uint32_t t) {
+		const std::uint32_t* tri = &m_Indices[3 * static_cast<size_t>(t)];
+		Vec3 center = (m_RestPositions[tri[0]] + m_RestPositions[tri[1]] + m_RestPositions[tri[2]]) * (1.0f / 3.0f);
+		return dot(center - rest, axis) > 0.0f;
+	};
+	std::uint32_t farCount = 0;
+	const std::uint32_t faceCount = faceOffsets[v + 1] - faceOffsets[v];
+	for (std::uint32_t f = faceOffsets[v]; f < faceOffsets[v + 1]; ++f)
+		farCount += farSide(faces[f]) ? 1 : 0;
+	if (farCount == 0 || farCount == faceCount)
+		return false;
+
+	// The new particle starts as a copy; the two halves share the mass.
+	const std::uint32_t split = particleCount();
+	m_Particles.resize(split + 1);
+	m_Particles.setPosition(split, m_Particles.position(v));
+	m_Particles.setPrevPosition(split, m_Particles.prevPosition(v));
+	m_Particles.setVelocity(split, m_Particles.velocity(v));
+	m_Particles.invMass[v] *= 2.0f;
+	m_Particles.invMass[split] = m_Particles.invMass[v];
+	m_RestPositions.push_back(rest);
+	m_TexCoords.push_back(m_TexCoords[2 * static_cast<size_t>(v)]);
+	m_TexCoords.push_back(m_TexCoords[2 * static_cast<size_t>(v) + 1]);
+	m_SplitFrom.push_back(gridParticle(v));
+	m_Tears.push_back({ gridParticle(v), gridParticle(w) });
+	m_SplitStamps.push_back(m_TearEpoch);
+	m_SplitStamps[v] = m_TearEpoch;
+
+	for (std::uint32_t f = faceOffsets[v]; f < faceOffsets[v + 1]; ++f)
+	{
+		const std::uint32_t t = faces[f];
+		if (!farSide(t))
+			continue;
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			if (m_Indices[3 * static_cast<size_t>(t) + corner] == v)
+				m_Indices[3 * static_cast<size_t>(t) + corner] = split;
+		}
+		m_DirtyTriangles.push_back(t);
+	}
+	for (std::uint32_t e = m_ConstraintOffsets[v]; e < m_ConstraintOffsets[v + 1]; ++e)
+	{
+		DistanceConstraint& c = m_Constraints[m_ParticleConstraints[e]];
+		const std::uint32_t other = c.p0 == v ? c.p1 : c.p0;
+		if (dot(m_RestPositions[other] - rest, axis) <= 0.0f)
+			continue;
+		(c.p0 == v ? c.p0 : c.p1) = split;
+		m_Lambdas[m_ParticleConstraints[e]] = 0.0f;
+	}
+	return true;
+}
+
+void Cloth::clearDirtyIndices()
+{
+	m_DirtyTriangles.clear();
+	m_DirtyIndexRanges.clear();
+}
+
+void Cloth::buildTiles()
+{
+	const int size = std::max(1, m_Desc.sleepTileSize);
+	m_TileColumns = (m_Desc.columns + size - 1) / size;
+	m_TileRows = (m_Desc.rows + size - 1) / size;
+	const size_t tiles = static_cast<size_t>(m_TileColumns) * m_TileRows;
+	m_TileAsleep.assign(tiles, 0);
+	m_TileCalmSteps.assign(tiles, 0);
+	m_TileEnergy.assign(tiles, 0.0f);
+	m_TileMass.assign(tiles, 0.0f);
+	m_SleepInvMass.assign(particleCount(), 0.0f);
+	m_SleepingTiles = 0;
+	m_SleepingParticles = 0;
+}
+
+std::uint32_t Cloth::tileOf(std::uint32_t i)const
+{
+	const int size = std::max(1, m_Desc.sleepTileSize);
+	const std::uint32_t g = gridParticle(i);
+	const int row = static_cast<int>(g) / m_Desc.columns;
+	const int column = static_cast<int>(g) % m_Desc.columns;
+	return static_cast<std::uint32_t>((row / size) * m_TileColumns + column / size);
+}
+
+void Cloth::tileBounds(std::uint32_t t, int& row0, int& row1, int& column0, int& column1)const
+{
+	const int size = std::max(1, m_Desc.sleepTileSize);
+	row0 = static_cast<int>(t) / m_TileColumns * size;
+	column0 = static_cast<int>(t) % m_TileColumns * size;
+	row1 = std::min(row0 + size, m_Desc.rows);
+	column1 = std::min(column0 + size, m_Desc.columns);
+}
+
+void Cloth::wake(std::uint32_t i)
+{
+	if (!m_TileAsleep.empty() && m_TileAsleep[tileOf(i)] != 0)
+		wakeTile(tileOf(i));
+}
+
+void Cloth::wakeAll()
+{
+	for (std::uint32_t t = 0; t < tileCount(); ++t)
+	{
+		if (m_TileAsleep[t] != 0)
+			wakeTile(t);
+	}
+}
+
+// The particles of a sleeping tile keep their mass aside and act as pins:
+// the integrators leave them in place with zero velocity, and constraints to
+// awake particles only move the awake end.
+void Cloth::sleepTile(std::uint32_t t)
+{
+	auto freeze = [this](std::uint32_t k) {
+		m_SleepInvMass[k] = m_Particles.invMass[k];
+		m_Particles.invMass[k] = 0.0f;
+		m_Particles.setPrevPosition(k, m_Particles.position(k));
+		m_Particles.setVelocity(k, Vec3());
+	};
+	int row0, row1, column0, column1;
+	tileBounds(t, row0, row1, column0, column1);
+	for (int i = row0; i < row1; ++i)
+	{
+		for (int j = column0; j < column1; ++j)
+			freeze(index(i, j));
+	}
+	std::uint32_t count = static_cast<std::uint32_t>((row1 - row0) * (column1 - column0));
+	for (std::uint32_t k = gridParticleCount(); k < particleCount(); ++k)
+	{
+		if (tileOf(k) == t)
+		{
+			freeze(k);
+			++count;
+		}
+	}
+	m_TileAsleep[t] = 1;
+	m_SleepingTiles++;
+	m_SleepingParticles += count;
+	m_ActiveDirty = true;
+}
+
+void Cloth::wakeTile(std::uint32_t t)
+{
+	auto thaw = [this](std::uint32_t k) {
+		m_Particles.invMass[k] = m_SleepInvMass[k];
+		m_Particles.setVelocity(k, Vec3());
+	};
+	int row0, row1, column0, column1;
+	tileBounds(t, row0, row1, column0, column1);
+	for (int i = row0; i < row1; ++i)
+	{
+		for (int j = column0; j < column1; ++j)
+			thaw(index(i, j));
+	}
+	std::uint32_t count = static_cast<std::uint32_t>((row1 - row0) * (column1 - column0));
+	for (std::uint32_t k = gridParticleCount(); k < particleCount(); ++k)
+	{
+		if (tileOf(k) == t)
+		{
+			thaw(k);
+			++count;
+		}
+	}
+	m_TileAsleep[t] = 0;
+	m_TileCalmSteps[t] = 0;
+	m_SleepingTiles--;
+	m_SleepingParticles -= count;
+	m_ActiveDirty = true;
+}
+
+void Cloth::updateSleep()
+{
+	// Gusts and a moving continuous collider change the force on every tile
+	// all the time, so nothing sleeps in them.
+	if ((m_Wind.enabled() && m_Wind.desc().turbulence > 0.0f) || (m_CcdMesh != nullptr && m_CcdMesh->moving()))
+	{
+		wakeAll();
+		std::fill(m_TileCalmSteps.begin(), m_TileCalmSteps.end(), 0);
+		return;
+	}
+	// Kinetic energy and mass of the free particles of every awake tile.
+	parallelRange(m_Pool, tileCount(), TileGrain, [this](std::uint32_t begin, std::uint32_t end, unsigned) {
+		const ParticleStore& p = m_Particles;
+		for (std::uint32_t t = begin; t < end; ++t)
+		{
+			float energy = 0.0f, mass = 0.0f;
+			int row0, row1, column0, column1;
+			tileBounds(t, row0, row1, column0, column1);
+			for (int i = row0; i < row1 && m_TileAsleep[t] == 0; ++i)
+			{
+				for (int j = column0; j < column1; ++j)
+				{
+					const std::uint32_t k = index(i, j);
+					if (p.invMass[k] == 0.0f)
+						continue;
+					const Vec3 v = p.velocity(k);
+					const float m = 1.0f / p.invMass[k];
+					energy += 0.5f * m * dot(v, v);
+					mass += m;
+				}
+			}
+			m_TileEnergy[t] = energy;
+			m_TileMass[t] = mass;
+		}
+	});
+	for (std::uint32_t k = gridParticleCount(); k < particleCount(); ++k)
+	{
+		const std::uint32_t t = tileOf(k);
+		if (m_TileAsleep[t] != 0 || m_Particles.invMass[k] == 0.0f)
+			continue;
+		const Vec3 v = m_Particles.velocity(k);
+		const float m = 1.0f / m_Particles.invMass[k];
+		m_TileEnergy[t] += 0.5f * m * dot(v, v);
+		m_TileMass[t] += m;
+	}
+
+	const float limit = m_Desc.sleepEnergy;
+	auto moving = [this, limit](std::uint32_t t) {
+		return m_TileAsleep[t] == 0 && m_TileEnergy[t] > limit * m_TileMass[t];
+	};
+	for (std::uint32_t t = 0; t < tileCount(); ++t)
+	{
+		if (m_TileAsleep[t] == 0)
+			m_TileCalmSteps[t] = moving(t) ? 0 : m_TileCalmSteps[t] + 1;
+	}
+
+	// Decide on the state before any tile changes, then apply: a sleeping tile
+	// wakes next to a moving one, and a calm tile only sleeps once none of its
+	// neighbours is moving.
+	std::vector<std::uint32_t> wakes, sleeps;
+	for (std::uint32_t t = 0; t < tileCount(); ++t)
+	{
+		const int ti = static_cast<int>(t) / m_TileColumns;
+		const int tj = static_cast<int>(t) % m_TileColumns;
+		bool neighbourMoving = false;
+		for (int di = -1; di <= 1 && !neighbourMoving; ++di)
+		{
+			for (int dj = -1; dj <= 1; ++dj)
+			{
+				const int ni = ti + di, nj = tj + dj;
+				if ((di == 0 && dj == 0) || ni < 0 || nj < 0 || ni >= m_TileRows || nj >= m_TileColumns)
+					continue;
+				if (moving(static_cast<std::uint32_t>(ni * m_TileColumns + nj)))
+				{
+					neighbourMoving = true;
+					break;
+				}
+			}
+		}
+		if (m_TileAsleep[t] != 0)
+		{
+			if (neighbourMoving)
+				wakes.push_back(t);
+		}
+		else if (m_TileCalmSteps[t] >= m_Desc.sleepSteps && !neighbourMoving)
+		{
+			sleeps.push_back(t);
+		}
+	}
+	for (std::uint32_t t : wakes)
+		wakeTile(t);
+	for (std::uint32_t t : sleeps)
+		sleepTile(t);
+}
+
+void Cloth::buildActiveSets()
+{
+	m_ActiveDirty = false;
+	m_ActiveRuns.clear();
+	m_ActiveConstraints.clear();
+	m_ActiveColorOffsets.assign(colorCount() + 1, 0);
+	if (m_SleepingTiles == 0)
+		return;
+
+	// Runs of awake particles, widened to multiples of 8 for the SIMD
+	// integrators; the sleeping particles this takes in are pinned and stay put.
+	const std::uint32_t count = particleCount();
+	auto addRun = [this, count](std::uint32_t begin, std::uint32_t end) {
+		begin &= ~std::uint32_t(7);
+		end = std::min((end + 7) & ~std::uint32_t(7), count);
+		if (!m_ActiveRuns.empty() && begin <= m_ActiveRuns.back().end)
+			m_ActiveRuns.back().end = std::max(m_ActiveRuns.back().end, end);
+		else
+			m_ActiveRuns.push_back({ begin, end });
+	};
+	const int size = std::max(1, m_Desc.sleepTileSize);
+	for (int i = 0; i < m_Desc.rows; ++i)
+	{
+		const int ti = i / size;
+		for (int tj = 0; tj < m_TileColumns; ++tj)
+		{
+			if (m_TileAsleep[ti * m_TileColumns + tj] == 0)
+				addRun(index(i, tj * size), index(i, std::min((tj + 1) * size, m_Desc.columns) - 1) + 1);
+		}
+	}
+	for (std::uint32_t k = gridParticleCount(); k < count; ++k)
+	{
+		if (m_TileAsleep[tileOf(k)] == 0)
+			addRun(k, k + 1);
+	}
+	// Cut long runs so the pool can balance them.
+	std::vector<ParticleRun> runs;
+	runs.reserve(m_ActiveRuns.size());
+	for (const ParticleRun& run : m_ActiveRuns)
+	{
+		for (std::uint32_t begin = run.begin; begin < run.end; begin += RunLength)
+			runs.push_back({ begin, std::min(begin + RunLength, run.end) });
+	}
+	m_ActiveRuns.swap(runs);
+
+	// Constraints with an awake end, keeping the colors.
+	for (std::uint32_t c = 0; c < colorCount(); ++c)
+	{
+		for (std::uint32_t k = m_ColorOffsets[c]; k < m_ColorOffsets[c + 1]; ++k)
+		{
+			const DistanceConstraint& dc = m_Constraints[k];
+			if (m_Particles.invMass[dc.p0] != 0.0f || m_Particles.invMass[dc.p1] != 0.0f)
+				m_ActiveConstraints.push_back(k);
+		}
+		m_ActiveColorOffsets[c + 1] = static_cast<std::uint32_t>(m_ActiveConstraints.size());
+	}
+}
+
+void Cloth::computeNormals()
+{
+	m_MeshNormals.setSimdLevel(m_SimdLevel);
+	m_MeshNormals.compute(m_Particles.x.data(), m_Particles.y.data(), m_Particles.z.data(), m_Pool);
+}
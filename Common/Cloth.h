@@ -0,0 +1,478 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Bvh.h"
+#include "ClothCcd.h"
+#include "ClothImplicit.h"
+#include "ClothWind.h"
+#include "MeshNormals.h"
+#include "ObjLoader.h"
+#include "ParticleStore.h"
+#include "ShapeCollider.h"
+#include "SpatialHash.h"
+#include "ThreadPool.h"
+
+enum class ClothIntegrator
+{
+	// Position based, substepped.
+	Xpbd,
+	// Backward Euler on springs, see ClothImplicit.
+	Implicit
+};
+
+enum class ClothSolver
+{
+	// Colors projected one after another, each color in parallel.
+	GaussSeidel,
+	// Every constraint projected from the same positions, then summed per particle.
+	Jacobi
+};
+
+// Description of a rectangular cloth sheet. The sheet lies in the xz-plane,
+// centered on origin, with row 0 at +z and column 0 at -x.
+struct ClothDesc
+{
+	int columns = 64;
+	int rows = 64;
+	float width = 3.0f;
+	float depth = 3.0f;
+	Vec3 origin = { 0.0f, 1.5f, 0.0f };
+	float totalMass = 1.0f;
+
+	// XPBD compliance is the inverse stiffness (m/N). 0 means infinitely stiff.
+	float stretchCompliance = 0.0f;
+	float shearCompliance = 1.0e-6f;
+	float bendCompliance = 1.0e-3f;
+
+	Vec3 gravity = { 0.0f, -9.8f, 0.0f };
+	// Fraction of the velocity removed per second.
+	float damping = 0.1f;
+	int substeps = 8;
+	int iterations = 1;
+	// Jacobi needs no order between the constraints, so every iteration is
+	// two fully parallel passes, but it converges more slowly than
+	// Gauss-Seidel and wants more iterations. The coarse levels are not used
+	// with Jacobi.
+	ClothSolver solver = ClothSolver::GaussSeidel;
+	// Estimate of the spectral radius of the Jacobi iteration, in [0, 1), for
+	// Chebyshev semi-iterative acceleration; 0 gives plain Jacobi and too
+	// high a value overshoots and diverges. The radius depends on the mesh:
+	// the grid takes 0.99, the bunny as a mesh cloth diverges there but not
+	// at 0.97.
+	float chebyshevRho = 0.99f;
+	// Scales every Jacobi step; above 2 the sheet can overshoot where it has
+	// torn into thin strips.
+	float jacobiRelaxation = 1.5f;
+	// With the implicit integrator the constraints become springs with the
+	// stiffness from implicit; the compliances, iterations and coarse levels
+	// are not used, and one substep is usually enough.
+	ClothIntegrator integrator = ClothIntegrator::Xpbd;
+	ImplicitDesc implicit;
+	// Coarser grids below the cloth, each with half the resolution of the one
+	// above it. With 0 every iteration is a flat pass over the constraints;
+	// otherwise every iteration is one V-cycle through the levels. The coarse
+	// grids do not see tears, so leave this at 0 on a cloth that tears.
+	int coarseLevels = 0;
+	// Pin the two corners of row 0 so the sheet hangs instead of falling.
+	bool pinCorners = true;
+
+	// Keep particles at least thickness apart when the sheet folds onto itself.
+	// Particles also stay thickness away from the collider mesh.
+	bool selfCollision = false;
+	float thickness = 0.02f;
+	// Fraction of the sliding motion removed from a particle touching the collider.
+	float friction = 0.3f;
+
+	// Drag and lift from the air; the default is still air, which costs nothing.
+	WindDesc wind;
+
+	// Tear stretch and shear constraints stretched past this strain, e.g. 0.5
+	// for half again their rest length. 0 disables tearing.
+	float tearStrain = 0.0f;
+	// Particles tearing may add; the sheet stops tearing once they are used up.
+	int maxTearParticles = 1024;
+	// Most vertex splits per step, which bounds the topology update.
+	int maxTearsPerStep = 32;
+
+	// Let resting parts of the sheet sleep. The grid is cut into tiles of
+	// sleepTileSize x sleepTileSize particles; a tile whose kinetic energy per
+	// unit mass (J/kg) stays below sleepEnergy for sleepSteps steps, while no
+	// neighbouring tile is above it, is neither integrated nor projected until
+	// something wakes it. Nothing sleeps in turbulent wind. 0 disables sleeping.
+	float sleepEnergy = 0.0f;
+	int sleepSteps = 30;
+	int sleepTileSize = 16;
+};
+
+enum class ClothConstraintType : std::uint8_t
+{
+	Stretch,
+	Shear,
+	Bend
+};
+
+struct DistanceConstraint
+{
+	std::uint32_t p0 = 0;
+	std::uint32_t p1 = 0;
+	float restLength = 0.0f;
+	float compliance = 0.0f;
+	ClothConstraintType type = ClothConstraintType::Stretch;
+};
+
+// A run of the index buffer, counted in indices.
+struct ClothIndexRange
+{
+	std::uint32_t first = 0;
+	std::uint32_t count = 0;
+};
+
+// One vertex split: grid particle particle was split across the torn
+// constraint towards grid particle toward, see Cloth::tears().
+struct ClothTear
+{
+	std::uint32_t particle = 0;
+	std::uint32_t toward = 0;
+};
+
+// Solver timing for one constraint color, filled when profiling is enabled.
+struct ClothColorStats
+{
+	std::uint32_t constraints = 0;
+	double seconds = 0.0;
+	// Sum of ThreadPool::lastImbalance() over all solves of this color.
+	double imbalanceSum = 0.0;
+	int solves = 0;
+};
+
+// CPU cloth simulated with XPBD (extended position based dynamics).
+// Stretch constraints link grid neighbours, shear constraints link the quad
+// diagonals and bend constraints link particles two cells apart.
+// Constraints are graph colored when the cloth is built: no two constraints of
+// one color share a particle, so a color can be projected in parallel without
+// locks, while the colors themselves are solved one after another.
+// With ClothDesc::coarseLevels the stretch and shear constraints are also
+// built on coarser grids that take every second particle. A V-cycle smooths
+// the fine grid, injects the positions into the next level, solves it the
+// same way and adds the bilinearly interpolated correction back before
+// smoothing again, so long wavelength stretch is removed in a few iterations.
+// With ClothDesc::tearStrain, overstretched constraints are found in parallel
+// after every step, each thread collecting its own list. A serial topology
+// phase then splits one end of each: a new particle takes over the triangles
+// and constraints on the far side of the crack, which runs across the torn
+// constraint in the rest shape. Both halves keep the colors of the original
+// particle, so the coloring stays valid, and only the triangles that changed
+// are reported in dirtyIndexRanges() for the renderer to upload.
+// With ClothSolver::Jacobi every iteration computes the correction of each
+// constraint from the same positions, then every particle sums the
+// corrections of its own constraints; a constraint's step is divided by the
+// most constraints either of its particles has, so the sum cannot overshoot.
+// Chebyshev acceleration then extrapolates each particle from its last two
+// iterates, after Wang, "A Chebyshev Semi-Iterative Approach for
+// Accelerating Projective and Position-based Dynamics".
+// With ClothIntegrator::Implicit every substep is one backward Euler step of
+// ClothImplicit on springs in place of the constraints; wind, collisions,
+// tearing and sleeping work the same on top of it.
+// With ClothDesc::sleepEnergy, a tile that has come to rest is put to sleep:
+// its particles are frozen and solved as if pinned, and only the runs of
+// awake particles and the constraints touching them are stepped. A sleeping
+// tile wakes when a neighbouring tile moves, when an awake particle collides
+// with it, when it tears, or when the owner moves its particles or changes
+// the forces on the cloth.
+// A cloth can also be built on a triangle mesh, such as a garment loaded
+// with loadObj(). Its vertices are stored as a single grid row, so
+// index(0, i) is vertex i and everything that walks the grid still works;
+// only the coarse levels, the pinned corners and sleeping need real rows and
+// are turned off.
+// The class has no graphics dependency; the owner copies particles() and
+// normals() into whatever vertex format it renders with.
+class Cloth
+{
+public:
+	explicit Cloth(const ClothDesc& desc);
+	// A cloth on a triangle mesh, one particle per vertex at its position.
+	// Every edge becomes a stretch constraint and every pair of triangles
+	// sharing an edge a bend constraint between their opposite vertices,
+	// using desc's compliances. desc.columns and rows are replaced; the
+	// adjacency is built on pool when one is given.
+	Cloth(const ClothDesc& desc, const ObjMesh& mesh, ThreadPool* pool = nullptr);
+	Cloth(const Cloth& rhs) = delete;
+	Cloth& operator=(const Cloth& rhs) = delete;
+
+	// Advance the simulation by dt seconds, split into desc.substeps substeps.
+	void step(float dt);
+	// Put every particle back to its rest position.
+	void reset();
+	// Simulated seconds since construction or reset(), the clock of the wind
+	// gusts. A cloth that takes over from another, like a level of ClothLod,
+	// takes its clock too so the gusts go on where they were.
+	float time()const { return m_Time; }
+	void setTime(float time) { m_Time = time; }
+
+	const ClothDesc& desc()const { return m_Desc; }
+	std::uint32_t particleCount()const { return static_cast<std::uint32_t>(m_Particles.size()); }
+	std::uint32_t index(int row, int column)const { return static_cast<std::uint32_t>(row * m_Desc.columns + column); }
+	// Particles of the grid come first; tearing appends the rest.
+	std::uint32_t gridParticleCount()const { return static_cast<std::uint32_t>(m_Desc.columns * m_Desc.rows); }
+	// Most particles the cloth can have, grid plus tearing.
+	std::uint32_t maxParticleCount()const;
+	// The grid particle that particle i was split from, or i itself.
+	std::uint32_t gridParticle(std::uint32_t i)const { return i < gridParticleCount() ? i : m_SplitFrom[i - gridParticleCount()]; }
+
+	const ParticleStore& particles()const { return m_Particles; }
+	Vec3 position(std::uint32_t i)const { return m_Particles.position(i); }
+	// Move a particle without giving it velocity.
+	void setPosition(std::uint32_t i, const Vec3& p);
+	void setVelocity(std::uint32_t i, const Vec3& v);
+	const std::vector<Vec3>& normals()const { return m_MeshNormals.normals(); }
+	const std::vector<float>& texCoords()const { return m_TexCoords; }
+	const std::vector<std::uint32_t>& indices()const { return m_Indices; }
+	const std::vector<DistanceConstraint>& constraints()const { return m_Constraints; }
+	// Number of grids including the cloth itself; 1 means the flat solver.
+	std::uint32_t levelCount()const { return static_cast<std::uint32_t>(m_Levels.size()) + 1; }
+	// Root mean square relative length error of the stretch and shear constraints.
+	float stretchResidual()const;
+
+	void setInvMass(std::uint32_t i, float w);
+	// The particle's own inverse mass, also while it sleeps.
+	float invMass(std::uint32_t i)const;
+
+	// Instruction set used by the particle integrator; defaults to detectSimdLevel().
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	// The pool is not owned. Without one, or with a single thread, the cloth steps serially.
+	void setThreadPool(ThreadPool* pool) { m_Pool = pool; }
+	ThreadPool* threadPool()const { return m_Pool; }
+
+	// Constraints of color c are constraints()[colorOffsets()[c], colorOffsets()[c + 1]).
+	std::uint32_t colorCount()const { return static_cast<std::uint32_t>(m_ColorOffsets.size()) - 1; }
+	const std::vector<std::uint32_t>& colorOffsets()const { return m_ColorOffsets; }
+
+	// Static triangle mesh the particles collide with, in world space. The
+	// collider is not owned; null disables mesh collision.
+	void setCollider(const Bvh* collider) { m_Collider = collider; wakeAll(); }
+	const Bvh* collider()const { return m_Collider; }
+
+	// Spheres, capsules and boxes the particles collide with after the mesh,
+	// with the shapes' own friction and restitution. Not owned; null disables
+	// them.
+	void setShapes(const ShapeCollider* shapes) { m_Shapes = shapes; wakeAll(); }
+	const ShapeCollider* shapes()const { return m_Shapes; }
+
+	// Triangle mesh the particles and edges are swept against every substep,
+	// before the discrete collisions, so fast cloth cannot pass through it
+	// between two substeps. It may move with CcdMesh::moveTo() once per step.
+	// Not owned; null disables continuous collision.
+	void setContinuousCollider(const CcdMesh* mesh);
+	const CcdMesh* continuousCollider()const { return m_CcdMesh; }
+	// Broad phase pairs, contacts and timings of the last step, all substeps.
+	const CcdStats& continuousStats()const { return m_Ccd.stats(); }
+
+	void setWind(const WindDesc& wind) { m_Wind.setDesc(wind); wakeAll(); }
+	const ClothWind& wind()const { return m_Wind; }
+
+	// Index buffer ranges rewritten by tearing since the last
+	// clearDirtyIndices(), in increasing order and merged where they touch.
+	const std::vector<ClothIndexRange>& dirtyIndexRanges()const { return m_DirtyIndexRanges; }
+	void clearDirtyIndices();
+	// Vertex splits so far, and the time the last topology phase took.
+	std::uint32_t tearCount()const { return m_TearCount; }
+	double lastTopologySeconds()const { return m_TopologySeconds; }
+	// Every vertex split so far in the order it was made, by grid particle,
+	// enough to tear another cloth the same way.
+	const std::vector<ClothTear>& tears()const { return m_Tears; }
+	// Undo every tear: the split particles are dropped, their mass goes back
+	// to the grid particle they came from and the triangles and constraints
+	// use the grid particles again. The whole index buffer is reported dirty.
+	void healTears();
+	// Split the grid particles as listed, each across the stretch or shear
+	// constraint to the other particle of its tear, as if that constraint
+	// had torn. Tears between particles with no such constraint left are
+	// skipped. Returns the number of splits made.
+	std::uint32_t tear(const std::vector<ClothTear>& tears);
+
+	// Sleep tiles, see ClothDesc::sleepEnergy; all zero when sleeping is disabled.
+	std::uint32_t tileCount()const { return static_cast<std::uint32_t>(m_TileAsleep.size()); }
+	std::uint32_t sleepingTileCount()const { return m_SleepingTiles; }
+	std::uint32_t sleepingParticleCount()const { return m_SleepingParticles; }
+	std::uint32_t activeParticleCount()const { return particleCount() - m_SleepingParticles; }
+	bool isSleeping(std::uint32_t i)const { return !m_TileAsleep.empty() && m_TileAsleep[tileOf(i)] != 0; }
+	// Wake the tile of particle i, or every tile, e.g. after changing a force
+	// the cloth does not know about.
+	void wake(std::uint32_t i);
+	void wakeAll();
+
+	// Solver of the implicit integrator, for its iteration counts and timings.
+	const ClothImplicit& implicitSolver()const { return m_Implicit; }
+
+	// Self collision state of the last substep, or null when it is disabled.
+	const SpatialHash* selfCollisionHash()const { return m_Hash.get(); }
+
+	void setProfiling(bool enable);
+	const std::vector<ClothColorStats>& colorStats()const { return m_ColorStats; }
+	void resetStats();
+
+	// Recompute area weighted vertex normals from the current positions, on the pool.
+	void computeNormals();
+
+private:
+	void buildParticles();
+	void buildConstraints();
+	void buildIndices();
+	// Particles, texture coordinates, constraints and indices of a mesh cloth.
+	void buildMesh(const ObjMesh& mesh, ThreadPool* pool);
+	// Everything past the particles, constraints and indices.
+	void initialize();
+	void addConstraint(std::uint32_t p0, std::uint32_t p1, float compliance, ClothConstraintType type);
+	void colorConstraints();
+	void buildLevels();
+	void buildParticleConstraints();
+	void buildTiles();
+	void buildSprings();
+
+	// Run fn over the awake particles, in runs of particles.
+	void parallelParticles(const ThreadPool::RangeFn& fn);
+	void solveConstraints(float dt);
+	void solveConstraintRange(std::uint32_t begin, std::uint32_t end, float invDt2);
+	// All iterations of the Jacobi solver.
+	void solveJacobi(float dt);
+	// One V-cycle from the given level down; level 0 is the cloth.
+	void vCycle(std::uint32_t level, float dt);
+	void smoothLevel(std::uint32_t level, float dt);
+	void restrictLevel(std::uint32_t level);
+	void prolongateLevel(std::uint32_t level);
+	void solveSelfCollisions();
+	void solveMeshCollisions();
+	void solveShapeCollisions();
+	void buildCcdEdges();
+	void findTears();
+	void applyTears();
+	// Start a topology phase, in which every particle is split at most once.
+	void nextTearEpoch();
+	// Rebuild what depends on the particles and triangles after splits, and
+	// merge the rewritten triangles into dirty index ranges.
+	void finishSplits();
+	// Split v along the crack across the constraint to w; false when all of
+	// v's triangles lie on one side of it.
+	bool splitParticle(std::uint32_t v, std::uint32_t w);
+	std::uint32_t tileOf(std::uint32_t i)const;
+	// Grid rows [row0, row1) and columns [column0, column1) of tile t.
+	void tileBounds(std::uint32_t t, int& row0, int& row1, int& column0, int& column1)const;
+	void sleepTile(std::uint32_t t);
+	void wakeTile(std::uint32_t t);
+	// Measure the awake tiles after a step and put to sleep or wake them.
+	void updateSleep();
+	// Rebuild the awake particle runs and constraint lists after tiles changed state.
+	void buildActiveSets();
+
+private:
+	// A grid of the hierarchy below the cloth. Particle (i, j) sits on
+	// particle (parentRow[i], parentColumn[j]) of the next finer grid.
+	struct CoarseLevel
+	{
+		int columns = 0;
+		int rows = 0;
+		std::vector<int> parentRow;
+		std::vector<int> parentColumn;
+		std::vector<Vec3> restPositions;
+		ParticleStore particles;
+		// Positions right after restriction; the correction is the difference.
+		std::vector<Vec3> start;
+		// Sorted by color, as m_Constraints.
+		std::vector<DistanceConstraint> constraints;
+		std::vector<std::uint32_t> colorOffsets;
+		std::vector<float> lambdas;
+	};
+
+	// Awake particles [begin, end); begin is a multiple of 8 for the SIMD integrators.
+	struct ParticleRun
+	{
+		std::uint32_t begin = 0;
+		std::uint32_t end = 0;
+	};
+
+private:
+	ClothDesc m_Desc;
+
+	SimdLevel m_SimdLevel = SimdLevel::Scalar;
+	ThreadPool* m_Pool = nullptr;
+	const Bvh* m_Collider = nullptr;
+	const ShapeCollider* m_Shapes = nullptr;
+	const CcdMesh* m_CcdMesh = nullptr;
+	ClothCcd m_Ccd;
+	// The cloth edges of m_Ccd need rebuilding after a tear.
+	bool m_CcdEdgesDirty = true;
+	bool m_Profiling = false;
+
+	ParticleStore m_Particles;
+	std::vector<Vec3> m_RestPositions;
+	MeshNormals m_MeshNormals;
+	// Interleaved (u, v) pairs, one per particle.
+	std::vector<float> m_TexCoords;
+
+	// Sorted by color.
+	std::vector<DistanceConstraint> m_Constraints;
+	std::vector<std::uint32_t> m_ColorOffsets;
+	std::vector<ClothColorStats> m_ColorStats;
+	// Accumulated Lagrange multiplier per constraint, reset every substep.
+	std::vector<float> m_Lambdas;
+	// Jacobi solver: correction of every constraint's p1 in the current
+	// iteration, and every particle's position before it.
+	std::vector<Vec3> m_JacobiCorrections;
+	std::vector<Vec3> m_JacobiPrevious;
+
+	std::vector<std::uint32_t> m_Indices;
+	ClothWind m_Wind;
+	ClothImplicit m_Implicit;
+	// Simulated seconds since construction, the clock of the wind gusts.
+	float m_Time = 0.0f;
+
+	// Coarse grids, finest first; empty for the flat solver.
+	std::vector<CoarseLevel> m_Levels;
+
+	std::unique_ptr<SpatialHash> m_Hash;
+	// Per particle self collision correction, applied after all are computed.
+	std::vector<Vec3> m_CollisionDeltas;
+
+	// Constraints around particle i are m_ParticleConstraints[m_ConstraintOffsets[i],
+	// m_ConstraintOffsets[i + 1]); only kept for tearing and the Jacobi solver.
+	std::vector<std::uint32_t> m_ConstraintOffsets;
+	std::vector<std::uint32_t> m_ParticleConstraints;
+	// Overstretched constraints found by every pool thread.
+	std::vector<std::vector<std::uint32_t>> m_TearLists;
+	// Grid particle of every particle past the grid.
+	std::vector<std::uint32_t> m_SplitFrom;
+	// A particle is split in the current topology phase when its stamp is m_TearEpoch.
+	std::vector<std::uint32_t> m_SplitStamps;
+	std::uint32_t m_TearEpoch = 0;
+	std::vector<std::uint32_t> m_DirtyTriangles;
+	std::vector<ClothIndexRange> m_DirtyIndexRanges;
+	std::uint32_t m_TearCount = 0;
+	std::vector<ClothTear> m_Tears;
+	double m_TopologySeconds = 0.0;
+
+	// Sleep tiles, row major; empty when sleeping is disabled.
+	int m_TileColumns = 0;
+	int m_TileRows = 0;
+	std::vector<std::uint8_t> m_TileAsleep;
+	// Steps an awake tile has stayed below ClothDesc::sleepEnergy.
+	std::vector<int> m_TileCalmSteps;
+	// Kinetic energy and mass of every tile after the last step.
+	std::vector<float> m_TileEnergy;
+	std::vector<float> m_TileMass;
+	// Inverse mass of a sleeping particle, whose store entry is 0 meanwhile.
+	std::vector<float> m_SleepInvMass;
+	std::uint32_t m_SleepingTiles = 0;
+	std::uint32_t m_SleepingParticles = 0;
+	// Built while any tile sleeps. Constraints with an awake end, sorted by
+	// color, and the first of every color plus the end.
+	std::vector<ParticleRun> m_ActiveRuns;
+	std::vector<std::uint32_t> m_ActiveConstraints;
+	std::vector<std::uint32_t> m_ActiveColorOffsets;
+	bool m_ActiveDirty = false;
+	// Sleeping tiles touched by awake particles, found by every pool thread.
+	std::vector<std::vector<std::uint32_t>> m_WakeLists;
+};
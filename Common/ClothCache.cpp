@@ -0,0 +1,327 @@
+#include "ClothCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const char Magic[4] = { 'C', 'C', 'A', 'C' };
+	const std::uint32_t Version = 1;
+	const size_t InitialCapacity = 1 << 20;
+	const size_t FrameHeaderBytes = 12;
+	const std::uint32_t KeyFrame = 0;
+	const std::uint32_t DeltaFrame = 1;
+	// Longest varint of a 32-bit value.
+	const size_t MaxVarintBytes = 5;
+
+	inline std::uint32_t quantize(float v, float invQuantum)
+	{
+		const float q = std::min(std::max(v * invQuantum, -2.0e9f), 2.0e9f);
+		return static_cast<std::uint32_t>(static_cast<std::int32_t>(std::lrint(q)));
+	}
+
+	inline std::uint32_t load32(const std::uint8_t* p)
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline void store32(std::uint8_t* p, std::uint32_t v)
+	{
+		std::memcpy(p, &v, sizeof(v));
+	}
+}
+
+bool ClothCacheWriter::open(const std::string& fileName, float frameSeconds, float quantum, std::uint32_t keyframeInterval)
+{
+	if (quantum <= 0.0f || !m_File.openWrite(fileName, InitialCapacity))
+		return false;
+	std::memcpy(m_Header.magic, Magic, sizeof(Magic));
+	m_Header.version = Version;
+	m_Header.quantum = quantum;
+	m_Header.frameSeconds = frameSeconds;
+	m_Header.keyframeInterval = std::max(1u, keyframeInterval);
+	m_Header.frameCount = 0;
+	m_Header.keyframeCount = 0;
+	m_Header.reserved = 0;
+	m_Header.indexOffset = 0;
+	std::memcpy(m_File.data(), &m_Header, sizeof(m_Header));
+	m_Used = sizeof(m_Header);
+	m_Frames = 0;
+	m_InvQuantum = 1.0f / quantum;
+	m_Previous.clear();
+	m_Keyframes.clear();
+	return true;
+}
+
+std::uint8_t* ClothCacheWriter::reserve(size_t bytes)
+{
+	if (m_Used + bytes > m_File.size())
+	{
+		// Double, so appending stays amortized constant per byte.
+		if (!m_File.reserve(std::max(m_File.size() * 2, m_Used + bytes)))
+			return nullptr;
+	}
+	return m_File.data() + m_Used;
+}
+
+void ClothCacheWriter::append(const float* x, const float* y, const float* z, std::uint32_t count)
+{
+	if (!isOpen())
+		return;
+	const size_t values = 3 * static_cast<size_t>(count);
+	const bool key = m_Frames % m_Header.keyframeInterval == 0 || m_Previous.size() != values;
+	std::uint8_t* out = reserve(FrameHeaderBytes + values * (key ? sizeof(std::int32_t) : MaxVarintBytes));
+	if (out == nullptr)
+	{
+		// Out of disk or address space: keep what was written so far.
+		close();
+		return;
+	}
+
+	std::uint8_t* p = out + FrameHeaderBytes;
+	if (key)
+	{
+		m_Previous.resize(values);
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			m_Previous[3 * i + 0] = static_cast<std::int32_t>(quantize(x[i], m_InvQuantum));
+			m_Previous[3 * i + 1] = static_cast<std::int32_t>(quantize(y[i], m_InvQuantum));
+			m_Previous[3 * i + 2] = static_cast<std::int32_t>(quantize(z[i], m_InvQuantum));
+		}
+		std::memcpy(p, m_Previous.data(), values * sizeof(std::int32_t));
+		p += values * sizeof(std::int32_t);
+		m_Keyframes.push_back({ m_Frames, 0, m_Used });
+	}
+	else
+	{
+		const float* components[3] = { x, y, z };
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				// Wrapping unsigned arithmetic, undone exactly by the reader.
+				const std::uint32_t q = quantize(components[c][i], m_InvQuantum);
+				const std::uint32_t d = q - static_cast<std::uint32_t>(m_Previous[3 * i + c]);
+				std::uint32_t u = (d << 1) ^ (0u - (d >> 31));
+				while (u >= 0x80)
+				{
+					*p++ = static_cast<std::uint8_t>(u | 0x80);
+					u >>= 7;
+				}
+				*p++ = static_cast<std::uint8_t>(u);
+				m_Previous[3 * i + c] = static_cast<std::int32_t>(q);
+			}
+		}
+	}
+	const size_t payload = static_cast<size_t>(p - out) - FrameHeaderBytes;
+	store32(out, static_cast<std::uint32_t>(payload));
+	store32(out + 4, count);
+	store32(out + 8, key ? KeyFrame : DeltaFrame);
+	m_Used += FrameHeaderBytes + payload;
+	m_Frames++;
+
+	// The frame is complete before the header counts it.
+	m_Header.frameCount = m_Frames;
+	std::memcpy(m_File.data(), &m_Header, sizeof(m_Header));
+}
+
+void ClothCacheWriter::close()
+{
+	if (!isOpen())
+		return;
+	m_Used = (m_Used + 7) & ~static_cast<size_t>(7);
+	const size_t indexBytes = m_Keyframes.size() * sizeof(ClothCacheKeyframe);
+	std::uint8_t* index = reserve(indexBytes);
+	if (index != nullptr)
+	{
+		if (indexBytes > 0)
+			std::memcpy(index, m_Keyframes.data(), indexBytes);
+		m_Header.keyframeCount = static_cast<std::uint32_t>(m_Keyframes.size());
+		m_Header.indexOffset = m_Used;
+		m_Used += indexBytes;
+		std::memcpy(m_File.data(), &m_Header, sizeof(m_Header));
+	}
+	m_File.close(m_Used);
+}
+
+bool ClothCacheReader::open(const std::string& fileName)
+{
+	close();
+	if (!m_File.openRead(fileName) || m_File.size() < sizeof(ClothCacheHeader))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&m_Header, m_File.data(), sizeof(m_Header));
+	if (std::memcmp(m_Header.magic, Magic, sizeof(Magic)) != 0 || m_Header.version != Version || !(m_Header.quantum > 0.0f))
+	{
+		close();
+		return false;
+	}
+
+	const size_t size = m_File.size();
+	const std::uint64_t indexBytes = static_cast<std::uint64_t>(m_Header.keyframeCount) * sizeof(ClothCacheKeyframe);
+	if (m_Header.indexOffset != 0 && m_Header.indexOffset + indexBytes <= size)
+	{
+		m_Keyframes.resize(m_Header.keyframeCount);
+		if (indexBytes > 0)
+			std::memcpy(m_Keyframes.data(), m_File.data() + m_Header.indexOffset, static_cast<size_t>(indexBytes));
+	}
+	else
+	{
+		// Never closed: walk the frames the header counts, keeping the ones
+		// that are whole.
+		size_t offset = sizeof(ClothCacheHeader);
+		std::uint32_t frames = 0;
+		while (frames < m_Header.frameCount && offset + FrameHeaderBytes <= size)
+		{
+			const std::uint8_t* record = m_File.data() + offset;
+			const size_t payload = load32(record);
+			if (offset + FrameHeaderBytes + payload > size)
+				break;
+			if (load32(record + 8) == KeyFrame)
+				m_Keyframes.push_back({ frames, 0, offset });
+			offset += FrameHeaderBytes + payload;
+			frames++;
+		}
+		m_Header.frameCount = frames;
+	}
+	m_MaxParticles = 0;
+	for (const ClothCacheKeyframe& k : m_Keyframes)
+	{
+		if (k.offset + FrameHeaderBytes > size || k.frame >= m_Header.frameCount)
+		{
+			close();
+			return false;
+		}
+		m_MaxParticles = std::max(m_MaxParticles, load32(m_File.data() + k.offset + 4));
+	}
+	if (m_Header.frameCount > 0 && (m_Keyframes.empty() || m_Keyframes[0].frame != 0))
+	{
+		close();
+		return false;
+	}
+	m_State.clear();
+	m_StateFrame = NoFrame;
+	m_NextOffset = 0;
+	return true;
+}
+
+void ClothCacheReader::close()
+{
+	m_File.close();
+	m_Header = ClothCacheHeader();
+	m_Keyframes.clear();
+	m_State.clear();
+	m_StateFrame = NoFrame;
+	m_MaxParticles = 0;
+}
+
+bool ClothCacheReader::seek(std::uint32_t frame)
+{
+	if (frame >= m_Header.frameCount)
+		return false;
+	if (frame == m_StateFrame)
+		return true;
+	auto key = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), frame,
+		[](std::uint32_t f, const ClothCacheKeyframe& k) { return f < k.frame; }) - 1;
+	// Carry on from the current frame unless the keyframe is at least as close.
+	if (m_StateFrame == NoFrame || m_StateFrame > frame || m_StateFrame < key->frame)
+	{
+		m_NextOffset = static_cast<size_t>(key->offset);
+		// Wraps to NoFrame for the first frame, and back to 0 in decodeNext().
+		m_StateFrame = key->frame - 1;
+	}
+	while (m_StateFrame != frame)
+	{
+		if (!decodeNext())
+		{
+			m_StateFrame = NoFrame;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ClothCacheReader::decodeNext()
+{
+	const size_t size = m_File.size();
+	if (m_NextOffset + FrameHeaderBytes > size)
+		return false;
+	const std::uint8_t* record = m_File.data() + m_NextOffset;
+	const size_t payload = load32(record);
+	const size_t values = 3 * static_cast<size_t>(load32(record + 4));
+	const std::uint32_t kind = load32(record + 8);
+	if (m_NextOffset + FrameHeaderBytes + payload > size)
+		return false;
+	const std::uint8_t* p = record + FrameHeaderBytes;
+	const std::uint8_t* end = p + payload;
+
+	if (kind == KeyFrame)
+	{
+		if (payload != values * sizeof(std::int32_t))
+			return false;
+		m_State.resize(values);
+		std::memcpy(m_State.data(), p, payload);
+	}
+	else
+	{
+		if (kind != DeltaFrame || m_State.size() != values)
+			return false;
+		for (size_t k = 0; k < values; ++k)
+		{
+			std::uint32_t u = 0;
+			int shift = 0;
+			for (;;)
+			{
+				if (p == end || shift > 28)
+					return false;
+				const std::uint8_t b = *p++;
+				u |= static_cast<std::uint32_t>(b & 0x7f) << shift;
+				if (b < 0x80)
+					break;
+				shift += 7;
+			}
+			const std::uint32_t d = (u >> 1) ^ (0u - (u & 1));
+			m_State[k] = static_cast<std::int32_t>(static_cast<std::uint32_t>(m_State[k]) + d);
+		}
+	}
+	m_NextOffset += FrameHeaderBytes + payload;
+	m_StateFrame++;
+	return true;
+}
+
+bool ClothCacheReader::read(std::uint32_t frame, float* x, float* y, float* z)
+{
+	if (!seek(frame))
+		return false;
+	const float quantum = m_Header.quantum;
+	const size_t count = m_State.size() / 3;
+	for (size_t i = 0; i < count; ++i)
+	{
+		x[i] = static_cast<float>(m_State[3 * i + 0]) * quantum;
+		y[i] = static_cast<float>(m_State[3 * i + 1]) * quantum;
+		z[i] = static_cast<float>(m_State[3 * i + 2]) * quantum;
+	}
+	return true;
+}
+
+bool ClothCacheReader::read(std::uint32_t frame, void* dst, size_t stride)
+{
+	if (!seek(frame))
+		return false;
+	const float quantum = m_Header.quantum;
+	const size_t count = m_State.size() / 3;
+	std::uint8_t* out = static_cast<std::uint8_t*>(dst);
+	for (size_t i = 0; i < count; ++i, out += stride)
+	{
+		const float p[3] = {
+			static_cast<float>(m_State[3 * i + 0]) * quantum,
+			static_cast<float>(m_State[3 * i + 1]) * quantum,
+			static_cast<float>(m_State[3 * i + 2]) * quantum };
+		std::memcpy(out, p, sizeof(p));
+	}
+	return true;
+}
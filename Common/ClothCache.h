@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Baked cloth animation: the particle positions of every simulated frame,
+// so a shot is simulated once and played back from disk. Positions are
+// quantized to a fixed grid, quantum metres apart. A keyframe stores the
+// grid coordinates as they are; every other frame stores the difference to
+// the frame before as zigzag varints, one to three bytes for cloth moving
+// a few centimetres per frame instead of twelve. Differences are taken
+// between quantized frames, so the error never accumulates past quantum/2.
+//
+// Layout, little endian: a ClothCacheHeader, the frames back to back, then
+// the keyframe index. Every frame is a u32 payload size, u32 particle count
+// and u32 kind, then the payload: i32 x, y and z per particle for a
+// keyframe, or three varints per particle for a delta. The writer appends
+// into a memory mapped file and keeps frameCount in the header current, so
+// a bake that never closed still plays back; its keyframe index is then
+// rebuilt by walking the frames.
+
+struct ClothCacheHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	float quantum;
+	float frameSeconds;
+	std::uint32_t keyframeInterval;
+	std::uint32_t frameCount;
+	std::uint32_t keyframeCount;
+	std::uint32_t reserved;
+	// Zero until the writer is closed.
+	std::uint64_t indexOffset;
+};
+
+struct ClothCacheKeyframe
+{
+	std::uint32_t frame;
+	std::uint32_t reserved;
+	std::uint64_t offset;
+};
+
+class ClothCacheWriter
+{
+public:
+	ClothCacheWriter() = default;
+	ClothCacheWriter(const ClothCacheWriter& rhs) = delete;
+	ClothCacheWriter& operator=(const ClothCacheWriter& rhs) = delete;
+	~ClothCacheWriter() { close(); }
+
+	// A keyframe every keyframeInterval frames bounds the cost of a seek.
+	bool open(const std::string& fileName, float frameSeconds, float quantum = 1.0e-4f,
+		std::uint32_t keyframeInterval = 30);
+	// The next frame, from separate x, y and z arrays as in ParticleStore. A
+	// change of particle count starts a keyframe.
+	void append(const float* x, const float* y, const float* z, std::uint32_t count);
+	// Writes the keyframe index and cuts the file to its contents.
+	void close();
+
+	bool isOpen()const { return m_File.isOpen(); }
+	std::uint32_t frameCount()const { return m_Frames; }
+	std::uint64_t byteCount()const { return m_Used; }
+
+private:
+	std::uint8_t* reserve(size_t bytes);
+
+private:
+	MappedFile m_File;
+	ClothCacheHeader m_Header = {};
+	size_t m_Used = 0;
+	std::uint32_t m_Frames = 0;
+	float m_InvQuantum = 1.0f;
+	// Grid coordinates of the last frame, x, y, z per particle.
+	std::vector<std::int32_t> m_Previous;
+	std::vector<ClothCacheKeyframe> m_Keyframes;
+};
+
+class ClothCacheReader
+{
+public:
+	ClothCacheReader() = default;
+	ClothCacheReader(const ClothCacheReader& rhs) = delete;
+	ClothCacheReader& operator=(const ClothCacheReader& rhs) = delete;
+
+	// Fails if the file is missing, truncated or of another version.
+	bool open(const std::string& fileName);
+	void close();
+
+	bool isOpen()const { return m_File.isOpen(); }
+	std::uint32_t frameCount()const { return m_Header.frameCount; }
+	float frameSeconds()const { return m_Header.frameSeconds; }
+	float quantum()const { return m_Header.quantum; }
+	std::uint32_t keyframeCount()const { return static_cast<std::uint32_t>(m_Keyframes.size()); }
+	// Particles of the frame last read; the count only changes at keyframes.
+	std::uint32_t particleCount()const { return static_cast<std::uint32_t>(m_State.size() / 3); }
+	// Most particles of any frame, for sizing the arrays read() fills.
+	std::uint32_t maxParticleCount()const { return m_MaxParticles; }
+
+	// Positions of a frame into separate x, y and z arrays of particleCount()
+	// floats. The frame after the last one read costs one delta; any other
+	// frame is decoded forward from the nearest keyframe at or before it, or
+	// from the last frame read when that is closer.
+	bool read(std::uint32_t frame, float* x, float* y, float* z);
+	// The same as three floats at dst, dst + stride, ..., e.g. the position
+	// of every vertex of a staging array.
+	bool read(std::uint32_t frame, void* dst, size_t stride);
+
+private:
+	// Bring m_State to frame; false on a damaged file.
+	bool seek(std::uint32_t frame);
+	// Apply the frame at m_NextOffset to m_State.
+	bool decodeNext();
+
+private:
+	static const std::uint32_t NoFrame = 0xffffffffu;
+
+	MappedFile m_File;
+	ClothCacheHeader m_Header = {};
+	std::vector<ClothCacheKeyframe> m_Keyframes;
+	std::vector<std::int32_t> m_State;
+	std::uint32_t m_StateFrame = NoFrame;
+	size_t m_NextOffset = 0;
+	std::uint32_t m_MaxParticles = 0;
+};
@@ -0,0 +1,586 @@
+#include "ClothCcd.h"
+#include "MeshAdjacency.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	const std::uint32_t QueryChunk = 2048;
+	const std::uint32_t MaxGridCells = 1u << 18;
+	// Slack of the inside tests, relative to the triangle and the edges.
+	const double InsideSlack = 1e-5;
+
+	// The narrow phase runs in double: the cubic's coefficients are products
+	// of three differences and lose too much in float.
+	struct D3
+	{
+		double x, y, z;
+	};
+
+	inline D3 d3(const Vec3& v) { return { v.x, v.y, v.z }; }
+	inline D3 operator+(const D3& a, const D3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline D3 operator-(const D3& a, const D3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline D3 operator*(const D3& a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+	inline double dot(const D3& a, const D3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline D3 cross(const D3& a, const D3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+	inline D3 lerp(const D3& a, const D3& b, double t) { return a + (b - a) * t; }
+
+	// dot(e1(t) x e2(t), q(t)) with every vector moving linearly from x0 to x0 + dx.
+	int coplanarTimes(const D3& e1, const D3& de1, const D3& e2, const D3& de2, const D3& q, const D3& dq, double roots[3])
+	{
+		const D3 n0 = cross(e1, e2);
+		const D3 n1 = cross(e1, de2) + cross(de1, e2);
+		const D3 n2 = cross(de1, de2);
+		return solveCubicInUnitInterval(dot(n2, dq), dot(n2, q) + dot(n1, dq), dot(n1, q) + dot(n0, dq), dot(n0, q), roots);
+	}
+
+	// Closest points of segments p0p1 and q0q1, as parameters along each.
+	void closestSegmentParameters(const D3& p0, const D3& p1, const D3& q0, const D3& q1, double& s, double& u)
+	{
+		const D3 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+		const double a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+		if (a <= 1e-30 && e <= 1e-30)
+		{
+			s = u = 0.0;
+			return;
+		}
+		if (a <= 1e-30)
+		{
+			s = 0.0;
+			u = std::min(1.0, std::max(0.0, f / e));
+			return;
+		}
+		const double c = dot(d1, r);
+		if (e <= 1e-30)
+		{
+			u = 0.0;
+			s = std::min(1.0, std::max(0.0, -c / a));
+			return;
+		}
+		const double b = dot(d1, d2), denom = a * e - b * b;
+		s = denom > 0.0 ? std::min(1.0, std::max(0.0, (b * f - c * e) / denom)) : 0.0;
+		u = (b * s + f) / e;
+		if (u < 0.0)
+		{
+			u = 0.0;
+			s = std::min(1.0, std::max(0.0, -c / a));
+		}
+		else if (u > 1.0)
+		{
+			u = 1.0;
+			s = std::min(1.0, std::max(0.0, (b - c) / a));
+		}
+	}
+
+	ClothCcd::Box sweptBox(const Vec3* points, int count, float margin)
+	{
+		ClothCcd::Box b;
+		b.lo = b.hi = points[0];
+		for (int k = 1; k < count; ++k)
+		{
+			b.lo = Vec3(std::min(b.lo.x, points[k].x), std::min(b.lo.y, points[k].y), std::min(b.lo.z, points[k].z));
+			b.hi = Vec3(std::max(b.hi.x, points[k].x), std::max(b.hi.y, points[k].y), std::max(b.hi.z, points[k].z));
+		}
+		b.lo -= Vec3(margin, margin, margin);
+		b.hi += Vec3(margin, margin, margin);
+		return b;
+	}
+
+	inline int cellOf(float x, float origin, float invCell, int dim)
+	{
+		const float c = (x - origin) * invCell;
+		if (!(c > 0.0f))
+			return 0;
+		return c < static_cast<float>(dim) ? static_cast<int>(c) : dim - 1;
+	}
+
+	double seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int solveCubicInUnitInterval(double a, double b, double c, double d, double roots[3])
+{
+	auto f = [=](double t) { return ((a * t + b) * t + c) * t + d; };
+
+	// The turning points, roots of 3a t^2 + 2b t + c, cut [0, 1] into pieces.
+	double cuts[4] = { 0.0 };
+	int cutCount = 1;
+	double turns[2];
+	int turnCount = 0;
+	if (a != 0.0)
+	{
+		const double disc = b * b - 3.0 * a * c;
+		if (disc > 0.0)
+		{
+			const double root = std::sqrt(disc);
+			turns[0] = (-b - root) / (3.0 * a);
+			turns[1] = (-b + root) / (3.0 * a);
+			if (turns[0] > turns[1])
+				std::swap(turns[0], turns[1]);
+			turnCount = 2;
+		}
+	}
+	else if (b != 0.0)
+	{
+		turns[0] = -c / (2.0 * b);
+		turnCount = 1;
+	}
+	for (int k = 0; k < turnCount; ++k)
+	{
+		if (turns[k] > 0.0 && turns[k] < 1.0)
+			cuts[cutCount++] = turns[k];
+	}
+	cuts[cutCount++] = 1.0;
+
+	int count = 0;
+	for (int k = 0; k + 1 < cutCount && count < 3; ++k)
+	{
+		double lo = cuts[k], hi = cuts[k + 1];
+		double flo = f(lo);
+		const double fhi = f(hi);
+		if (flo == 0.0)
+		{
+			if (count == 0 || roots[count - 1] != lo)
+				roots[count++] = lo;
+			continue;
+		}
+		// A root at hi is found as the next piece's lo, or after the loop.
+		if (fhi == 0.0 || (flo < 0.0) == (fhi < 0.0))
+			continue;
+		for (int i = 0; i < 64 && hi - lo > 1e-12; ++i)
+		{
+			const double mid = 0.5 * (lo + hi);
+			const double fmid = f(mid);
+			if ((fmid < 0.0) == (flo < 0.0))
+			{
+				lo = mid;
+				flo = fmid;
+			}
+			else
+				hi = mid;
+		}
+		roots[count++] = 0.5 * (lo + hi);
+	}
+	if (count < 3 && f(1.0) == 0.0 && (count == 0 || roots[count - 1] != 1.0))
+		roots[count++] = 1.0;
+	return count;
+}
+
+void CcdMesh::build(const std::vector<Vec3>& positions, const std::vector<std::uint32_t>& indices)
+{
+	m_Previous = positions;
+	m_Current = positions;
+	m_Indices = indices;
+	m_Moving = false;
+	m_Version++;
+
+	MeshAdjacency adjacency;
+	adjacency.build(m_Indices, vertexCount(), nullptr);
+	m_Edges.clear();
+	m_Edges.reserve(adjacency.edges().size() * 2);
+	for (const MeshEdge& e : adjacency.edges())
+	{
+		m_Edges.push_back(e.v0);
+		m_Edges.push_back(e.v1);
+	}
+}
+
+void CcdMesh::moveTo(const std::vector<Vec3>& positions)
+{
+	m_Previous.swap(m_Current);
+	m_Current = positions;
+	m_Moving = true;
+	m_Version++;
+}
+
+void ClothCcd::BoxGrid::build()
+{
+	cellStart.assign(2, 0);
+	items.clear();
+	if (boxes.empty())
+		return;
+
+	// Cells twice the mean box, coarsened until there are not too many.
+	Vec3 lo = boxes[0].lo, hi = boxes[0].hi, mean(0.0f, 0.0f, 0.0f);
+	for (const Box& b : boxes)
+	{
+		lo = Vec3(std::min(lo.x, b.lo.x), std::min(lo.y, b.lo.y), std::min(lo.z, b.lo.z));
+		hi = Vec3(std::max(hi.x, b.hi.x), std::max(hi.y, b.hi.y), std::max(hi.z, b.hi.z));
+		mean += b.hi - b.lo;
+	}
+	mean *= 1.0f / boxes.size();
+	float cell = 2.0f * std::max(std::max(mean.x, mean.y), std::max(mean.z, 1e-6f));
+	const Vec3 extent = hi - lo;
+	for (;;)
+	{
+		dims[0] = static_cast<int>(extent.x / cell) + 1;
+		dims[1] = static_cast<int>(extent.y / cell) + 1;
+		dims[2] = static_cast<int>(extent.z / cell) + 1;
+		if (static_cast<std::uint64_t>(dims[0]) * dims[1] * dims[2] <= MaxGridCells)
+			break;
+		cell *= 1.25f;
+	}
+	origin = lo;
+	invCell = 1.0f / cell;
+
+	// Count, offset and scatter, so every cell lists its boxes in id order.
+	const std::uint32_t cellCount = static_cast<std::uint32_t>(dims[0] * dims[1] * dims[2]);
+	cellStart.assign(cellCount + 1, 0);
+	auto visit = [this](const Box& b, const auto& fn) {
+		const int x0 = cellOf(b.lo.x, origin.x, invCell, dims[0]), x1 = cellOf(b.hi.x, origin.x, invCell, dims[0]);
+		const int y0 = cellOf(b.lo.y, origin.y, invCell, dims[1]), y1 = cellOf(b.hi.y, origin.y, invCell, dims[1]);
+		const int z0 = cellOf(b.lo.z, origin.z, invCell, dims[2]), z1 = cellOf(b.hi.z, origin.z, invCell, dims[2]);
+		for (int z = z0; z <= z1; ++z)
+			for (int y = y0; y <= y1; ++y)
+				for (int x = x0; x <= x1; ++x)
+					fn((z * dims[1] + y) * dims[0] + x);
+	};
+	for (const Box& b : boxes)
+		visit(b, [this](int c) { cellStart[c + 1]++; });
+	for (std::uint32_t c = 0; c < cellCount; ++c)
+		cellStart[c + 1] += cellStart[c];
+	items.resize(cellStart[cellCount]);
+	std::vector<std::uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+	for (std::uint32_t id = 0; id < boxes.size(); ++id)
+		visit(boxes[id], [&](int c) { items[cursor[c]++] = id; });
+}
+
+void ClothCcd::BoxGrid::gather(const Box& q, std::uint32_t id, std::vector<std::uint32_t>& pairs)const
+{
+	if (items.empty())
+		return;
+	const int x0 = cellOf(q.lo.x, origin.x, invCell, dims[0]), x1 = cellOf(q.hi.x, origin.x, invCell, dims[0]);
+	const int y0 = cellOf(q.lo.y, origin.y, invCell, dims[1]), y1 = cellOf(q.hi.y, origin.y, invCell, dims[1]);
+	const int z0 = cellOf(q.lo.z, origin.z, invCell, dims[2]), z1 = cellOf(q.hi.z, origin.z, invCell, dims[2]);
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				const int c = (z * dims[1] + y) * dims[0] + x;
+				for (std::uint32_t k = cellStart[c]; k < cellStart[c + 1]; ++k)
+				{
+					const Box& b = boxes[items[k]];
+					if (b.hi.x < q.lo.x || b.lo.x > q.hi.x || b.hi.y < q.lo.y || b.lo.y > q.hi.y || b.hi.z < q.lo.z || b.lo.z > q.hi.z)
+						continue;
+					// Report the pair only from the cell holding the low corner
+					// of the overlap, which both boxes cover.
+					if (cellOf(std::max(q.lo.x, b.lo.x), origin.x, invCell, dims[0]) != x
+						|| cellOf(std::max(q.lo.y, b.lo.y), origin.y, invCell, dims[1]) != y
+						|| cellOf(std::max(q.lo.z, b.lo.z), origin.z, invCell, dims[2]) != z)
+						continue;
+					pairs.push_back(id);
+					pairs.push_back(items[k]);
+				}
+			}
+		}
+	}
+}
+
+void ClothCcd::buildGrids(const CcdMesh& mesh, float s0, float s1, float thickness)
+{
+	const std::uint32_t vertexCount = mesh.vertexCount();
+	m_Start.resize(vertexCount);
+	m_End.resize(vertexCount);
+	for (std::uint32_t v = 0; v < vertexCount; ++v)
+	{
+		m_Start[v] = mesh.vertexAt(v, s0);
+		m_End[v] = mesh.vertexAt(v, s1);
+	}
+	const std::vector<std::uint32_t>& indices = mesh.indices();
+	const std::vector<std::uint32_t>& edges = mesh.edges();
+	m_TriangleGrid.boxes.resize(mesh.triangleCount());
+	for (std::uint32_t t = 0; t < mesh.triangleCount(); ++t)
+	{
+		const std::uint32_t* tri = &indices[3 * static_cast<size_t>(t)];
+		const Vec3 points[6] = { m_Start[tri[0]], m_Start[tri[1]], m_Start[tri[2]], m_End[tri[0]], m_End[tri[1]], m_End[tri[2]] };
+		m_TriangleGrid.boxes[t] = sweptBox(points, 6, thickness);
+	}
+	m_EdgeGrid.boxes.resize(mesh.edgeCount());
+	for (std::uint32_t e = 0; e < mesh.edgeCount(); ++e)
+	{
+		const Vec3 points[4] = { m_Start[edges[2 * e]], m_Start[edges[2 * e + 1]], m_End[edges[2 * e]], m_End[edges[2 * e + 1]] };
+		m_EdgeGrid.boxes[e] = sweptBox(points, 4, thickness);
+	}
+	m_TriangleGrid.build();
+	m_EdgeGrid.build();
+
+	m_GridMesh = &mesh;
+	m_GridVersion = mesh.version();
+	m_GridS0 = s0;
+	m_GridS1 = s1;
+	m_GridThickness = thickness;
+}
+
+bool ClothCcd::findContacts(const ParticleStore& p, const CcdMesh& mesh, ThreadPool* pool)
+{
+	const std::vector<std::uint32_t>& indices = mesh.indices();
+	const std::vector<std::uint32_t>& meshEdges = mesh.edges();
+
+	// Broad phase: every particle against the triangles, every cloth edge
+	// against the mesh edges. Pinned particles do not move and edges between
+	// two of them are skipped.
+	auto start = std::chrono::steady_clock::now();
+	const std::uint32_t particleCount = static_cast<std::uint32_t>(p.size());
+	const std::uint32_t clothEdgeCount = edgeCount();
+	const std::uint32_t pointChunkCount = (particleCount + QueryChunk - 1) / QueryChunk;
+	const std::uint32_t edgeChunkCount = (clothEdgeCount + QueryChunk - 1) / QueryChunk;
+	m_PointChunks.resize(pointChunkCount);
+	m_EdgeChunks.resize(edgeChunkCount);
+	parallelRange(pool, pointChunkCount + edgeChunkCount, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+		{
+			if (c < pointChunkCount)
+			{
+				std::vector<std::uint32_t>& pairs = m_PointChunks[c].pairs;
+				pairs.clear();
+				const std::uint32_t last = std::min(particleCount, (c + 1) * QueryChunk);
+				for (std::uint32_t i = c * QueryChunk; i < last; ++i)
+				{
+					if (m_Query[i] == 0 || p.invMass[i] == 0.0f)
+						continue;
+					const Vec3 points[2] = { p.prevPosition(i), p.position(i) };
+					m_TriangleGrid.gather(sweptBox(points, 2, 0.0f), i, pairs);
+				}
+			}
+			else
+			{
+				const std::uint32_t ec = c - pointChunkCount;
+				std::vector<std::uint32_t>& pairs = m_EdgeChunks[ec].pairs;
+				pairs.clear();
+				const std::uint32_t last = std::min(clothEdgeCount, (ec + 1) * QueryChunk);
+				for (std::uint32_t e = ec * QueryChunk; e < last; ++e)
+				{
+					const std::uint32_t a = m_ClothEdges[2 * e], b = m_ClothEdges[2 * e + 1];
+					if ((m_Query[a] == 0 && m_Query[b] == 0) || (p.invMass[a] == 0.0f && p.invMass[b] == 0.0f))
+						continue;
+					const Vec3 points[4] = { p.prevPosition(a), p.prevPosition(b), p.position(a), p.position(b) };
+					m_EdgeGrid.gather(sweptBox(points, 4, 0.0f), e, pairs);
+				}
+			}
+		}
+	});
+	for (const Chunk& chunk : m_PointChunks)
+		m_Stats.pointTrianglePairs += chunk.pairs.size() / 2;
+	for (const Chunk& chunk : m_EdgeChunks)
+		m_Stats.edgeEdgePairs += chunk.pairs.size() / 2;
+	m_Stats.broadSeconds += seconds(start);
+
+	// Narrow phase: the first time every pair touches. A particle keeps only
+	// its earliest triangle; its pairs are adjacent in the chunk.
+	start = std::chrono::steady_clock::now();
+	parallelRange(pool, pointChunkCount + edgeChunkCount, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+		{
+			if (c < pointChunkCount)
+			{
+				Chunk& chunk = m_PointChunks[c];
+				chunk.pointContacts.clear();
+				const std::vector<std::uint32_t>& pairs = chunk.pairs;
+				for (size_t k = 0; k < pairs.size(); k += 2)
+				{
+					const std::uint32_t i = pairs[k], t = pairs[k + 1];
+					const std::uint32_t* tri = &indices[3 * static_cast<size_t>(t)];
+					const D3 a0 = d3(m_Start[tri[0]]), b0 = d3(m_Start[tri[1]]), c0 = d3(m_Start[tri[2]]);
+					const D3 a1 = d3(m_End[tri[0]]), b1 = d3(m_End[tri[1]]), c1 = d3(m_End[tri[2]]);
+					const D3 p0 = d3(p.prevPosition(i)), p1 = d3(p.position(i));
+					const D3 e1 = b0 - a0, e2 = c0 - a0, q = p0 - a0;
+					double roots[3];
+					const int rootCount = coplanarTimes(e1, (b1 - a1) - e1, e2, (c1 - a1) - e2, q, (p1 - a1) - q, roots);
+					for (int r = 0; r < rootCount; ++r)
+					{
+						const double tc = roots[r];
+						const D3 a = lerp(a0, a1, tc), ab = lerp(b0, b1, tc) - a, ac = lerp(c0, c1, tc) - a;
+						const D3 ap = lerp(p0, p1, tc) - a;
+						const double d00 = dot(ab, ab), d01 = dot(ab, ac), d11 = dot(ac, ac);
+						const double denom = d00 * d11 - d01 * d01;
+						if (denom <= 1e-30)
+							continue;
+						const double d20 = dot(ap, ab), d21 = dot(ap, ac);
+						const double u = (d11 * d20 - d01 * d21) / denom;
+						const double v = (d00 * d21 - d01 * d20) / denom;
+						if (u < -InsideSlack || v < -InsideSlack || u + v > 1.0 + InsideSlack)
+							continue;
+						// The side the particle came from; if it started in the plane,
+						// the side it was not heading to.
+						const double before = dot(cross(e1, e2), q);
+						const double after = dot(cross(b1 - a1, c1 - a1), p1 - a1);
+						const float side = before > 0.0 || (before == 0.0 && after < 0.0) ? 1.0f : -1.0f;
+						const PointContact contact = { i, t, static_cast<float>(tc), static_cast<float>(u), static_cast<float>(v), side };
+						if (!chunk.pointContacts.empty() && chunk.pointContacts.back().particle == i)
+						{
+							if (chunk.pointContacts.back().t > contact.t)
+								chunk.pointContacts.back() = contact;
+						}
+						else
+							chunk.pointContacts.push_back(contact);
+						break;
+					}
+				}
+			}
+			else
+			{
+				Chunk& chunk = m_EdgeChunks[c - pointChunkCount];
+				chunk.edgeContacts.clear();
+				const std::vector<std::uint32_t>& pairs = chunk.pairs;
+				for (size_t k = 0; k < pairs.size(); k += 2)
+				{
+					const std::uint32_t e = pairs[k], m = pairs[k + 1];
+					const std::uint32_t va = m_ClothEdges[2 * e], vb = m_ClothEdges[2 * e + 1];
+					const std::uint32_t ma = meshEdges[2 * m], mb = meshEdges[2 * m + 1];
+					const D3 p0 = d3(p.prevPosition(va)), p1 = d3(p.prevPosition(vb));
+					const D3 p0End = d3(p.position(va)), p1End = d3(p.position(vb));
+					const D3 q0 = d3(m_Start[ma]), q1 = d3(m_Start[mb]);
+					const D3 q0End = d3(m_End[ma]), q1End = d3(m_End[mb]);
+					const D3 e1 = p1 - p0, e2 = q1 - q0, q = q0 - p0;
+					double roots[3];
+					const int rootCount = coplanarTimes(e1, (p1End - p0End) - e1, e2, (q1End - q0End) - e2, q, (q0End - p0End) - q, roots);
+					for (int r = 0; r < rootCount; ++r)
+					{
+						const double tc = roots[r];
+						const D3 a0 = lerp(p0, p0End, tc), a1 = lerp(p1, p1End, tc);
+						const D3 b0 = lerp(q0, q0End, tc), b1 = lerp(q1, q1End, tc);
+						const D3 n = cross(a1 - a0, b1 - b0);
+						const double lengths = dot(a1 - a0, a1 - a0) * dot(b1 - b0, b1 - b0);
+						// Parallel edges: the point-triangle tests cover them.
+						if (dot(n, n) <= 1e-12 * lengths)
+							continue;
+						double s, u;
+						closestSegmentParameters(a0, a1, b0, b1, s, u);
+						const D3 gap = lerp(a0, a1, s) - lerp(b0, b1, u);
+						const double slack = InsideSlack * (std::sqrt(dot(a1 - a0, a1 - a0)) + std::sqrt(dot(b1 - b0, b1 - b0)));
+						if (dot(gap, gap) > slack * slack)
+							continue;
+						const D3 before = lerp(p0, p1, s) - lerp(q0, q1, u);
+						const double side = dot(n, before) >= 0.0 ? 1.0 : -1.0;
+						const D3 normal = n * (side / std::sqrt(dot(n, n)));
+						chunk.edgeContacts.push_back({ e, m, static_cast<float>(s), static_cast<float>(u),
+							Vec3(static_cast<float>(normal.x), static_cast<float>(normal.y), static_cast<float>(normal.z)) });
+						break;
+					}
+				}
+			}
+		}
+	});
+	m_Stats.narrowSeconds += seconds(start);
+
+	for (const Chunk& chunk : m_PointChunks)
+	{
+		if (!chunk.pointContacts.empty())
+			return true;
+	}
+	for (const Chunk& chunk : m_EdgeChunks)
+	{
+		if (!chunk.edgeContacts.empty())
+			return true;
+	}
+	return false;
+}
+
+void ClothCcd::solve(ParticleStore& p, const CcdMesh& mesh, float s0, float s1, float thickness, float friction, ThreadPool* pool)
+{
+	if (mesh.triangleCount() == 0)
+		return;
+	// A static mesh keeps its grids from the last substep.
+	auto start = std::chrono::steady_clock::now();
+	if (&mesh != m_GridMesh || mesh.version() != m_GridVersion || thickness != m_GridThickness
+		|| (mesh.moving() && (s0 != m_GridS0 || s1 != m_GridS1)))
+		buildGrids(mesh, s0, s1, thickness);
+	m_Stats.broadSeconds += seconds(start);
+
+	const std::vector<std::uint32_t>& indices = mesh.indices();
+	const std::vector<std::uint32_t>& meshEdges = mesh.edges();
+	// How far the cloth edge of c is inside thickness of the mesh edge.
+	auto edgeDepth = [&](const EdgeContact& c) {
+		const Vec3 onCloth = p.position(m_ClothEdges[2 * c.clothEdge]) * (1.0f - c.s) + p.position(m_ClothEdges[2 * c.clothEdge + 1]) * c.s;
+		const Vec3 onMesh = m_End[meshEdges[2 * c.meshEdge]] * (1.0f - c.u) + m_End[meshEdges[2 * c.meshEdge + 1]] * c.u;
+		return thickness - dot(c.normal, onCloth - onMesh);
+	};
+
+	m_Query.assign(p.size(), 1);
+	m_Moved.resize(p.size());
+	for (int pass = 0; pass < MaxPasses; ++pass)
+	{
+		if (!findContacts(p, mesh, pool))
+			return;
+		std::fill(m_Moved.begin(), m_Moved.end(), 0);
+
+		if (pass + 1 == MaxPasses)
+		{
+			// Out of passes: whatever still collides goes back to where it
+			// started the substep, which was clear of the mesh.
+			for (const Chunk& chunk : m_PointChunks)
+			{
+				for (const PointContact& c : chunk.pointContacts)
+					m_Moved[c.particle] = 1;
+			}
+			for (const Chunk& chunk : m_EdgeChunks)
+			{
+				for (const EdgeContact& c : chunk.edgeContacts)
+				{
+					if (edgeDepth(c) <= 0.0f)
+						continue;
+					m_Moved[m_ClothEdges[2 * c.clothEdge]] = 1;
+					m_Moved[m_ClothEdges[2 * c.clothEdge + 1]] = 1;
+				}
+			}
+			for (std::uint32_t i = 0; i < p.size(); ++i)
+			{
+				if (m_Moved[i] != 0 && p.invMass[i] != 0.0f)
+				{
+					p.setPosition(i, p.prevPosition(i));
+					m_Stats.revertedParticles++;
+				}
+			}
+			return;
+		}
+
+		// Resolve in chunk order. A particle goes to where it hit the triangle,
+		// moved with the triangle to the end of the substep, thickness in front
+		// of it, plus what friction leaves of the rest of its tangential motion.
+		for (const Chunk& chunk : m_PointChunks)
+		{
+			for (const PointContact& c : chunk.pointContacts)
+			{
+				const std::uint32_t* tri = &indices[3 * static_cast<size_t>(c.triangle)];
+				const Vec3 a = m_End[tri[0]], b = m_End[tri[1]], cc = m_End[tri[2]];
+				const Vec3 n = normalizeOr(cross(b - a, cc - a), Vec3(0.0f, 1.0f, 0.0f)) * c.side;
+				const Vec3 hit = a * (1.0f - c.u - c.v) + b * c.u + cc * c.v;
+				const Vec3 p0 = p.prevPosition(c.particle), p1 = p.position(c.particle);
+				const Vec3 rest = (p1 - p0) * (1.0f - c.t);
+				const Vec3 slide = rest - n * dot(rest, n);
+				p.setPosition(c.particle, hit + n * thickness + slide * (1.0f - friction));
+				m_Moved[c.particle] = 1;
+			}
+			m_Stats.pointTriangleContacts += static_cast<std::uint32_t>(chunk.pointContacts.size());
+		}
+		// Edges: move the cloth edge's contact point to thickness in front of
+		// the mesh edge, split between its ends by inverse mass and parameter.
+		for (const Chunk& chunk : m_EdgeChunks)
+		{
+			for (const EdgeContact& c : chunk.edgeContacts)
+			{
+				const std::uint32_t va = m_ClothEdges[2 * c.clothEdge], vb = m_ClothEdges[2 * c.clothEdge + 1];
+				const float depth = edgeDepth(c);
+				const float wa = p.invMass[va] * (1.0f - c.s), wb = p.invMass[vb] * c.s;
+				const float denom = wa * (1.0f - c.s) + wb * c.s;
+				if (depth <= 0.0f || denom <= 0.0f)
+					continue;
+				const float lambda = depth / denom;
+				p.setPosition(va, p.position(va) + c.normal * (wa * lambda));
+				p.setPosition(vb, p.position(vb) + c.normal * (wb * lambda));
+				m_Moved[va] = 1;
+				m_Moved[vb] = 1;
+				m_Stats.edgeEdgeContacts++;
+			}
+		}
+		m_Query.swap(m_Moved);
+	}
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+#include "SimMath.h"
+#include "ThreadPool.h"
+
+// Roots of a t^3 + b t^2 + c t + d in [0, 1], ascending; returns their count.
+// [0, 1] is cut at the turning points, so the cubic is monotone on every
+// piece, and each piece with a sign change is bisected. Lower degrees work.
+int solveCubicInUnitInterval(double a, double b, double c, double d, double roots[3]);
+
+// Triangle mesh collider for continuous collision. It may move: over every
+// Cloth::step it goes linearly from its previous to its current positions.
+class CcdMesh
+{
+public:
+	CcdMesh() = default;
+	CcdMesh(const CcdMesh& rhs) = delete;
+	CcdMesh& operator=(const CcdMesh& rhs) = delete;
+
+	// Previous and current positions both start at positions.
+	void build(const std::vector<Vec3>& positions, const std::vector<std::uint32_t>& indices);
+	// The current positions become the previous ones.
+	void moveTo(const std::vector<Vec3>& positions);
+	bool moving()const { return m_Moving; }
+	// Changes with every build() and moveTo().
+	std::uint32_t version()const { return m_Version; }
+
+	// Position of vertex v at fraction s of the step.
+	Vec3 vertexAt(std::uint32_t v, float s)const { return m_Previous[v] + (m_Current[v] - m_Previous[v]) * s; }
+
+	std::uint32_t vertexCount()const { return static_cast<std::uint32_t>(m_Current.size()); }
+	std::uint32_t triangleCount()const { return static_cast<std::uint32_t>(m_Indices.size() / 3); }
+	// Every edge once, as pairs of vertices.
+	std::uint32_t edgeCount()const { return static_cast<std::uint32_t>(m_Edges.size() / 2); }
+	const std::vector<std::uint32_t>& indices()const { return m_Indices; }
+	const std::vector<std::uint32_t>& edges()const { return m_Edges; }
+
+private:
+	std::vector<Vec3> m_Previous;
+	std::vector<Vec3> m_Current;
+	std::vector<std::uint32_t> m_Indices;
+	std::vector<std::uint32_t> m_Edges;
+	bool m_Moving = false;
+	std::uint32_t m_Version = 0;
+};
+
+// Work of ClothCcd::solve() calls since the last resetStats().
+struct CcdStats
+{
+	// Candidate pairs the broad phase passed to the narrow phase.
+	std::uint64_t pointTrianglePairs = 0;
+	std::uint64_t edgeEdgePairs = 0;
+	// Contacts found and resolved, over all passes.
+	std::uint32_t pointTriangleContacts = 0;
+	std::uint32_t edgeEdgeContacts = 0;
+	// Particles still colliding after the last pass, put back where they started.
+	std::uint32_t revertedParticles = 0;
+	double broadSeconds = 0.0;
+	double narrowSeconds = 0.0;
+};
+
+// Continuous collision of cloth against a CcdMesh over one substep. Every
+// free particle is swept from its previous to its current position and every
+// cloth edge likewise, while the mesh moves between two fractions of its
+// step. The broad phase bins the swept boxes of the mesh triangles and edges
+// into uniform grids, rebuilt only when the mesh moves, and every particle
+// and edge box collects the mesh boxes of the cells it covers. The narrow
+// phase solves the cubic for the times at which a point and a triangle, or
+// two edges, become coplanar, and keeps the first time at which they touch.
+// A particle crossing a triangle is put back thickness in front of it, on the
+// side it came from, keeping what friction leaves of its sliding motion; two
+// crossing edges are pushed apart along their common normal, the cloth edge
+// taking all of the correction. A correction can push a particle through
+// another triangle, so the moved particles and their edges are tested again,
+// up to MaxPasses times; whatever still collides after that goes back to its
+// previous position. Both phases run on the pool in fixed chunks and contacts
+// are applied in chunk order, so the result does not depend on the thread
+// count.
+class ClothCcd
+{
+public:
+	static const int MaxPasses = 4;
+
+	ClothCcd() = default;
+	ClothCcd(const ClothCcd& rhs) = delete;
+	ClothCcd& operator=(const ClothCcd& rhs) = delete;
+
+	// Cloth edges to sweep, as pairs of particles.
+	void setEdges(std::vector<std::uint32_t> edges) { m_ClothEdges = std::move(edges); }
+	std::uint32_t edgeCount()const { return static_cast<std::uint32_t>(m_ClothEdges.size() / 2); }
+
+	// The mesh moves from fraction s0 to s1 of its step during this substep.
+	void solve(ParticleStore& p, const CcdMesh& mesh, float s0, float s1, float thickness, float friction, ThreadPool* pool);
+
+	const CcdStats& stats()const { return m_Stats; }
+	void resetStats() { m_Stats = CcdStats(); }
+
+public:
+	struct Box
+	{
+		Vec3 lo;
+		Vec3 hi;
+	};
+
+	// Boxes binned into the cells they overlap, in id order within a cell.
+	struct BoxGrid
+	{
+		std::vector<Box> boxes;
+		Vec3 origin;
+		float invCell = 1.0f;
+		int dims[3] = { 1, 1, 1 };
+		std::vector<std::uint32_t> cellStart;
+		std::vector<std::uint32_t> items;
+
+		void build();
+		// Appends (id, box) for every box overlapping q, once each.
+		void gather(const Box& q, std::uint32_t id, std::vector<std::uint32_t>& pairs)const;
+	};
+
+private:
+	struct PointContact
+	{
+		std::uint32_t particle;
+		std::uint32_t triangle;
+		float t;
+		// Barycentric coordinates of the contact on the triangle's second and third vertex.
+		float u, v;
+		float side;
+	};
+
+	struct EdgeContact
+	{
+		std::uint32_t clothEdge;
+		std::uint32_t meshEdge;
+		// Contact parameters along the cloth edge and the mesh edge.
+		float s, u;
+		// Unit normal pointing from the mesh edge to the cloth edge.
+		Vec3 normal;
+	};
+
+	// Per chunk of queries: candidate pairs, then contacts.
+	struct Chunk
+	{
+		std::vector<std::uint32_t> pairs;
+		std::vector<PointContact> pointContacts;
+		std::vector<EdgeContact> edgeContacts;
+	};
+
+private:
+	void buildGrids(const CcdMesh& mesh, float s0, float s1, float thickness);
+	// Broad and narrow phase for the particles flagged in m_Query and the
+	// edges touching them; false when nothing collides.
+	bool findContacts(const ParticleStore& p, const CcdMesh& mesh, ThreadPool* pool);
+
+private:
+	std::vector<std::uint32_t> m_ClothEdges;
+	BoxGrid m_TriangleGrid;
+	BoxGrid m_EdgeGrid;
+	// What the grids were built for; a static mesh keeps them.
+	const CcdMesh* m_GridMesh = nullptr;
+	std::uint32_t m_GridVersion = 0;
+	float m_GridS0 = 0.0f;
+	float m_GridS1 = 0.0f;
+	float m_GridThickness = -1.0f;
+	// Mesh vertices at the start and the end of the substep.
+	std::vector<Vec3> m_Start;
+	std::vector<Vec3> m_End;
+	// Particles to test in this pass, and the ones moved by it.
+	std::vector<std::uint8_t> m_Query;
+	std::vector<std::uint8_t> m_Moved;
+	std::vector<Chunk> m_PointChunks;
+	std::vector<Chunk> m_EdgeChunks;
+	CcdStats m_Stats;
+};
@@ -0,0 +1,421 @@
+#include "ClothImplicit.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Rows per job and per dot product chunk.
+	const std::uint32_t RowGrain = 1024;
+
+	// Blocks are column major with columns padded to four floats: element
+	// (r, c) is at 4 * c + r.
+	inline void addOuter(float* b, const Vec3& u, float s)
+	{
+		const float v[3] = { u.x, u.y, u.z };
+		for (int c = 0; c < 3; ++c)
+		{
+			for (int r = 0; r < 3; ++r)
+				b[4 * c + r] += s * v[r] * v[c];
+		}
+	}
+
+	inline void addIdentity(float* b, float s)
+	{
+		b[0] += s;
+		b[5] += s;
+		b[10] += s;
+	}
+
+	inline Vec3 multiplyBlock(const float* b, const Vec3& v)
+	{
+		return Vec3(b[0] * v.x + b[4] * v.y + b[8] * v.z,
+			b[1] * v.x + b[5] * v.y + b[9] * v.z,
+			b[2] * v.x + b[6] * v.y + b[10] * v.z);
+	}
+
+	// Inverse of a symmetric 3x3 block by cofactors; the identity for a singular one.
+	void invertBlock(const float* a, float* inv)
+	{
+		const float a00 = a[0], a01 = a[4], a02 = a[8];
+		const float a11 = a[5], a12 = a[9], a22 = a[10];
+		const float c00 = a11 * a22 - a12 * a12;
+		const float c01 = a02 * a12 - a01 * a22;
+		const float c02 = a01 * a12 - a02 * a11;
+		const float det = a00 * c00 + a01 * c01 + a02 * c02;
+		std::fill(inv, inv + 12, 0.0f);
+		if (std::fabs(det) < 1e-30f)
+		{
+			addIdentity(inv, 1.0f);
+			return;
+		}
+		const float s = 1.0f / det;
+		inv[0] = c00 * s;
+		inv[1] = inv[4] = c01 * s;
+		inv[2] = inv[8] = c02 * s;
+		inv[5] = (a00 * a22 - a02 * a02) * s;
+		inv[6] = inv[9] = (a02 * a01 - a00 * a12) * s;
+		inv[10] = (a00 * a11 - a01 * a01) * s;
+	}
+
+	inline Vec3 load3(const float* v) { return Vec3(v[0], v[1], v[2]); }
+	inline void store3(float* v, const Vec3& a) { v[0] = a.x; v[1] = a.y; v[2] = a.z; v[3] = 0.0f; }
+
+	// Force of spring s on its end a, b being the other end, with velocity damping.
+	inline Vec3 springForce(const ParticleStore& p, const ImplicitSpring& s, std::uint32_t a, std::uint32_t b, float damping)
+	{
+		Vec3 d = p.position(a) - p.position(b);
+		float len = length(d);
+		if (len < 1e-9f)
+			return Vec3();
+		Vec3 n = d * (1.0f / len);
+		float stretch = s.stiffness * (len - s.restLength);
+		float rate = damping * s.stiffness * dot(n, p.velocity(a) - p.velocity(b));
+		return n * -(stretch + rate);
+	}
+
+	void multiplyScalar(const BsrMatrix& a, const float* x, float* y, std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			Vec3 sum;
+			for (std::uint32_t k = a.rowOffsets[i]; k < a.rowOffsets[i + 1]; ++k)
+				sum += multiplyBlock(a.block(k), load3(x + 4 * static_cast<size_t>(a.columns[k])));
+			store3(y + 4 * static_cast<size_t>(i), sum);
+		}
+	}
+
+#if SIMD_X86
+	SIMD_TARGET_SSE41 void multiplySSE41(const BsrMatrix& a, const float* x, float* y, std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (std::uint32_t k = a.rowOffsets[i]; k < a.rowOffsets[i + 1]; ++k)
+			{
+				const float* b = a.block(k);
+				__m128 v = _mm_load_ps(x + 4 * static_cast<size_t>(a.columns[k]));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(b), _mm_shuffle_ps(v, v, 0x00)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(b + 4), _mm_shuffle_ps(v, v, 0x55)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(b + 8), _mm_shuffle_ps(v, v, 0xAA)));
+			}
+			_mm_store_ps(y + 4 * static_cast<size_t>(i), sum);
+		}
+	}
+
+	// The first two columns of a block go into one register against
+	// (x, x, x, x, y, y, y, y); the halves are added at the end of the row.
+	SIMD_TARGET_AVX2 void multiplyAVX2(const BsrMatrix& a, const float* x, float* y, std::uint32_t begin, std::uint32_t end)
+	{
+		const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			__m256 sum01 = _mm256_setzero_ps();
+			__m128 sum2 = _mm_setzero_ps();
+			for (std::uint32_t k = a.rowOffsets[i]; k < a.rowOffsets[i + 1]; ++k)
+			{
+				const float* b = a.block(k);
+				__m128 v = _mm_load_ps(x + 4 * static_cast<size_t>(a.columns[k]));
+				__m256 xy = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(v), spread);
+				sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(_mm256_loadu_ps(b), xy));
+				sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_load_ps(b + 8), _mm_shuffle_ps(v, v, 0xAA)));
+			}
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm256_castps256_ps128(sum01), _mm256_extractf128_ps(sum01, 1)), sum2);
+			_mm_store_ps(y + 4 * static_cast<size_t>(i), sum);
+		}
+	}
+#endif
+}
+
+void multiplyBsr(const BsrMatrix& a, const float* x, float* y, SimdLevel level, std::uint32_t begin, std::uint32_t end)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2)
+		return multiplyAVX2(a, x, y, begin, end);
+	if (level == SimdLevel::SSE41)
+		return multiplySSE41(a, x, y, begin, end);
+#endif
+	multiplyScalar(a, x, y, begin, end);
+}
+
+ClothImplicit::ClothImplicit()
+	: m_SimdLevel(detectSimdLevel())
+{
+}
+
+void ClothImplicit::build(const std::vector<ImplicitSpring>& springs, std::uint32_t particleCount)
+{
+	m_Springs = springs;
+	const std::uint32_t n = particleCount;
+
+	// Springs per particle.
+	m_RowSpringOffsets.assign(static_cast<size_t>(n) + 1, 0);
+	for (const ImplicitSpring& s : m_Springs)
+	{
+		assert(s.p0 < n && s.p1 < n && s.p0 != s.p1);
+		m_RowSpringOffsets[s.p0 + 1]++;
+		m_RowSpringOffsets[s.p1 + 1]++;
+	}
+	for (std::uint32_t i = 0; i < n; ++i)
+		m_RowSpringOffsets[i + 1] += m_RowSpringOffsets[i];
+	std::vector<std::uint32_t> cursor(m_RowSpringOffsets.begin(), m_RowSpringOffsets.end() - 1);
+	m_RowSprings.resize(2 * m_Springs.size());
+	for (std::uint32_t k = 0; k < m_Springs.size(); ++k)
+	{
+		m_RowSprings[cursor[m_Springs[k].p0]++] = k;
+		m_RowSprings[cursor[m_Springs[k].p1]++] = k;
+	}
+
+	// One block for the particle and one per distinct neighbour, in column order.
+	m_Matrix.rows = n;
+	m_Matrix.rowOffsets.assign(static_cast<size_t>(n) + 1, 0);
+	m_Matrix.columns.clear();
+	m_DiagonalBlocks.resize(n);
+	m_RowSpringBlocks.resize(m_RowSprings.size());
+	std::vector<std::uint32_t> row;
+	for (std::uint32_t i = 0; i < n; ++i)
+	{
+		row.assign(1, i);
+		for (std::uint32_t e = m_RowSpringOffsets[i]; e < m_RowSpringOffsets[i + 1]; ++e)
+		{
+			const ImplicitSpring& s = m_Springs[m_RowSprings[e]];
+			row.push_back(s.p0 == i ? s.p1 : s.p0);
+		}
+		std::sort(row.begin(), row.end());
+		row.erase(std::unique(row.begin(), row.end()), row.end());
+		const std::uint32_t first = static_cast<std::uint32_t>(m_Matrix.columns.size());
+		m_Matrix.columns.insert(m_Matrix.columns.end(), row.begin(), row.end());
+		m_Matrix.rowOffsets[i + 1] = static_cast<std::uint32_t>(m_Matrix.columns.size());
+		auto blockOf = [&row, first](std::uint32_t column) {
+			return first + static_cast<std::uint32_t>(std::lower_bound(row.begin(), row.end(), column) - row.begin());
+		};
+		m_DiagonalBlocks[i] = blockOf(i);
+		for (std::uint32_t e = m_RowSpringOffsets[i]; e < m_RowSpringOffsets[i + 1]; ++e)
+		{
+			const ImplicitSpring& s = m_Springs[m_RowSprings[e]];
+			m_RowSpringBlocks[e] = blockOf(s.p0 == i ? s.p1 : s.p0);
+		}
+	}
+	m_Matrix.blocks.assign(12 * m_Matrix.columns.size(), 0.0f);
+	m_Preconditioner.assign(12 * static_cast<size_t>(n), 0.0f);
+	for (AlignedVector<float>* v : { &m_B, &m_X, &m_R, &m_Z, &m_P, &m_Q })
+		v->assign(4 * static_cast<size_t>(n), 0.0f);
+	m_Partials.assign((n + RowGrain - 1) / RowGrain, 0.0);
+	m_SquarePartials.assign(m_Partials.size(), 0.0);
+}
+
+// Row i of (M - h D - h^2 K) dv = h (f + h K v). A spring between i and j
+// contributes G = h kd nn^T + h^2 k (nn^T + max(0, 1 - L / |d|) (I - nn^T))
+// to block (i, i), -G to block (i, j), and -h^2 G_k (v_i - v_j) to the right
+// hand side, G_k being the stiffness part of G.
+void ClothImplicit::assemble(const ParticleStore& p, float h, const Vec3& gravity, ThreadPool* pool)
+{
+	const float h2 = h * h;
+	const float damping = m_Desc.springDamping;
+	parallelRange(pool, m_Matrix.rows, RowGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			std::fill(m_Matrix.block(m_Matrix.rowOffsets[i]), m_Matrix.block(m_Matrix.rowOffsets[i + 1]), 0.0f);
+			float* diagonal = m_Matrix.block(m_DiagonalBlocks[i]);
+			float* rhs = &m_B[4 * static_cast<size_t>(i)];
+			if (p.invMass[i] == 0.0f)
+			{
+				addIdentity(diagonal, 1.0f);
+				store3(rhs, Vec3());
+				invertBlock(diagonal, &m_Preconditioner[12 * static_cast<size_t>(i)]);
+				continue;
+			}
+			const float mass = 1.0f / p.invMass[i];
+			addIdentity(diagonal, mass);
+			Vec3 force = gravity * mass;
+			Vec3 stiffnessTerm;
+			for (std::uint32_t e = m_RowSpringOffsets[i]; e < m_RowSpringOffsets[i + 1]; ++e)
+			{
+				const ImplicitSpring& s = m_Springs[m_RowSprings[e]];
+				const std::uint32_t j = s.p0 == i ? s.p1 : s.p0;
+				force += springForce(p, s, i, j, damping);
+				Vec3 d = p.position(i) - p.position(j);
+				float len = length(d);
+				if (len < 1e-9f)
+					continue;
+				Vec3 n = d * (1.0f / len);
+				const float transverse = std::max(0.0f, 1.0f - s.restLength / len);
+				// G_k = k (transverse I + (1 - transverse) nn^T).
+				float gk[12] = {};
+				addIdentity(gk, h2 * s.stiffness * transverse);
+				addOuter(gk, n, h2 * s.stiffness * (1.0f - transverse));
+				stiffnessTerm -= multiplyBlock(gk, p.velocity(i) - p.velocity(j));
+				addOuter(gk, n, h * damping * s.stiffness);
+				float* offDiagonal = p.invMass[j] != 0.0f ? m_Matrix.block(m_RowSpringBlocks[e]) : nullptr;
+				for (int c = 0; c < 12; ++c)
+				{
+					diagonal[c] += gk[c];
+					if (offDiagonal != nullptr)
+						offDiagonal[c] -= gk[c];
+				}
+			}
+			store3(rhs, force * h + stiffnessTerm);
+			invertBlock(diagonal, &m_Preconditioner[12 * static_cast<size_t>(i)]);
+		}
+	});
+}
+
+double ClothImplicit::reduceRows(ThreadPool* pool, const std::function<double(std::uint32_t, std::uint32_t)>& fn)
+{
+	const std::uint32_t rows = m_Matrix.rows;
+	const std::uint32_t chunks = static_cast<std::uint32_t>(m_Partials.size());
+	parallelRange(pool, chunks, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+			m_Partials[c] = fn(c * RowGrain, std::min((c + 1) * RowGrain, rows));
+	});
+	double sum = 0.0;
+	for (double partial : m_Partials)
+		sum += partial;
+	return sum;
+}
+
+// Preconditioned conjugate gradient on m_X, starting from the previous step's dv.
+int ClothImplicit::solve(ThreadPool* pool)
+{
+	const SimdLevel level = m_SimdLevel;
+	auto dot4 = [](const float* a, const float* b, std::uint32_t begin, std::uint32_t end) {
+		double sum = 0.0;
+		for (size_t k = 4 * static_cast<size_t>(begin); k < 4 * static_cast<size_t>(end); ++k)
+			sum += static_cast<double>(a[k]) * b[k];
+		return sum;
+	};
+	auto precondition = [this](std::uint32_t begin, std::uint32_t end) {
+		for (std::uint32_t i = begin; i < end; ++i)
+			store3(&m_Z[4 * static_cast<size_t>(i)], multiplyBlock(&m_Preconditioner[12 * static_cast<size_t>(i)], load3(&m_R[4 * static_cast<size_t>(i)])));
+	};
+
+	const double bb = reduceRows(pool, [&](std::uint32_t begin, std::uint32_t end) {
+		return dot4(m_B.data(), m_B.data(), begin, end);
+	});
+	if (bb == 0.0)
+	{
+		std::fill(m_X.begin(), m_X.end(), 0.0f);
+		m_Residual = 0.0f;
+		return 0;
+	}
+	const double limit = static_cast<double>(m_Desc.tolerance) * m_Desc.tolerance * bb;
+
+	// r = b - A x, z = P r, p = z.
+	double rz = reduceRows(pool, [&](std::uint32_t begin, std::uint32_t end) {
+		multiplyBsr(m_Matrix, m_X.data(), m_Q.data(), level, begin, end);
+		for (size_t k = 4 * static_cast<size_t>(begin); k < 4 * static_cast<size_t>(end); ++k)
+			m_R[k] = m_B[k] - m_Q[k];
+		precondition(begin, end);
+		std::copy(m_Z.begin() + 4 * static_cast<size_t>(begin), m_Z.begin() + 4 * static_cast<size_t>(end), m_P.begin() + 4 * static_cast<size_t>(begin));
+		return dot4(m_R.data(), m_Z.data(), begin, end);
+	});
+	double rr = reduceRows(pool, [&](std::uint32_t begin, std::uint32_t end) {
+		return dot4(m_R.data(), m_R.data(), begin, end);
+	});
+
+	int it = 0;
+	while (it < m_Desc.maxIterations && rr > limit)
+	{
+		const double pq = reduceRows(pool, [&](std::uint32_t begin, std::uint32_t end) {
+			multiplyBsr(m_Matrix, m_P.data(), m_Q.data(), level, begin, end);
+			return dot4(m_P.data(), m_Q.data(), begin, end);
+		});
+		if (pq <= 0.0)
+			break;
+		const float alpha = static_cast<float>(rz / pq);
+		// x += alpha p, r -= alpha q, z = P r, and both new dot products in
+		// one pass; r.r goes to its own partials.
+		const double rzNew = reduceRows(pool, [&](std::uint32_t begin, std::uint32_t end) {
+			double sum = 0.0;
+			for (size_t k = 4 * static_cast<size_t>(begin); k < 4 * static_cast<size_t>(end); ++k)
+			{
+				m_X[k] += alpha * m_P[k];
+				m_R[k] -= alpha * m_Q[k];
+				sum += static_cast<double>(m_R[k]) * m_R[k];
+			}
+			m_SquarePartials[begin / RowGrain] = sum;
+			precondition(begin, end);
+			return dot4(m_R.data(), m_Z.data(), begin, end);
+		});
+		rr = 0.0;
+		for (double partial : m_SquarePartials)
+			rr += partial;
+		++it;
+		if (rr <= limit)
+			break;
+		const float beta = static_cast<float>(rzNew / rz);
+		rz = rzNew;
+		parallelRange(pool, m_Matrix.rows, RowGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+			for (size_t k = 4 * static_cast<size_t>(begin); k < 4 * static_cast<size_t>(end); ++k)
+				m_P[k] = m_Z[k] + beta * m_P[k];
+		});
+	}
+	m_Residual = static_cast<float>(std::sqrt(rr / bb));
+	return it;
+}
+
+void ClothImplicit::step(ParticleStore& p, const IntegrateParams& params, ThreadPool* pool)
+{
+	assert(p.size() == m_Matrix.rows);
+	const float h = params.dt;
+	auto start = std::chrono::steady_clock::now();
+	assemble(p, h, params.gravity, pool);
+	auto assembled = std::chrono::steady_clock::now();
+	m_Iterations = solve(pool);
+	auto solved = std::chrono::steady_clock::now();
+	m_AssemblySeconds = std::chrono::duration<double>(assembled - start).count();
+	m_SolveSeconds = std::chrono::duration<double>(solved - assembled).count();
+
+	parallelRange(pool, m_Matrix.rows, RowGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			p.setPrevPosition(i, p.position(i));
+			if (p.invMass[i] == 0.0f)
+			{
+				p.setVelocity(i, Vec3());
+				continue;
+			}
+			Vec3 v = (p.velocity(i) + load3(&m_X[4 * static_cast<size_t>(i)])) * params.damping;
+			p.setVelocity(i, v);
+			p.setPosition(i, p.position(i) + v * h);
+		}
+	});
+}
+
+void ClothImplicit::stepExplicit(ParticleStore& p, const IntegrateParams& params, ThreadPool* pool)
+{
+	assert(p.size() == m_Matrix.rows);
+	const float h = params.dt;
+	const float damping = m_Desc.springDamping;
+	// Velocities first, from the forces at the current state, into m_X...
+	parallelRange(pool, m_Matrix.rows, RowGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			Vec3 v;
+			if (p.invMass[i] != 0.0f)
+			{
+				Vec3 force = params.gravity * (1.0f / p.invMass[i]);
+				for (std::uint32_t e = m_RowSpringOffsets[i]; e < m_RowSpringOffsets[i + 1]; ++e)
+				{
+					const ImplicitSpring& s = m_Springs[m_RowSprings[e]];
+					force += springForce(p, s, i, s.p0 == i ? s.p1 : s.p0, damping);
+				}
+				v = (p.velocity(i) + force * (h * p.invMass[i])) * params.damping;
+			}
+			store3(&m_X[4 * static_cast<size_t>(i)], v);
+		}
+	});
+	// ...then positions, once no thread reads the old velocities any more.
+	parallelRange(pool, m_Matrix.rows, RowGrain, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			Vec3 v = load3(&m_X[4 * static_cast<size_t>(i)]);
+			p.setPrevPosition(i, p.position(i));
+			p.setVelocity(i, v);
+			p.setPosition(i, p.position(i) + v * h);
+		}
+	});
+	// The next implicit solve starts from zero.
+	std::fill(m_X.begin(), m_X.end(), 0.0f);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+#include "Simd.h"
+#include "SimMath.h"
+#include "ThreadPool.h"
+
+struct ImplicitDesc
+{
+	// Stiffness (N/m) of the springs standing in for the stretch, shear and
+	// bend constraints.
+	float stretchStiffness = 2000.0f;
+	float shearStiffness = 200.0f;
+	float bendStiffness = 2.0f;
+	// Damping along every spring, as seconds of its stiffness: kd = springDamping * k.
+	float springDamping = 1.0e-4f;
+	// Conjugate gradient stops at this residual, relative to the right hand side.
+	float tolerance = 1.0e-3f;
+	int maxIterations = 100;
+};
+
+// Two particles held at restLength by a spring of the given stiffness (N/m).
+struct ImplicitSpring
+{
+	std::uint32_t p0 = 0;
+	std::uint32_t p1 = 0;
+	float restLength = 0.0f;
+	float stiffness = 0.0f;
+};
+
+// Sparse matrix of 3x3 blocks in block compressed sparse row (BSR) layout.
+// Block row i is blocks [rowOffsets[i], rowOffsets[i + 1]), block k sitting in
+// block column columns[k]. A block is stored as its three columns, each padded
+// to four floats, so a column fills one SSE register and two fill an AVX one.
+struct BsrMatrix
+{
+	std::uint32_t rows = 0;
+	std::vector<std::uint32_t> rowOffsets;
+	std::vector<std::uint32_t> columns;
+	AlignedVector<float> blocks;
+
+	float* block(std::uint32_t k) { return &blocks[12 * static_cast<size_t>(k)]; }
+	const float* block(std::uint32_t k)const { return &blocks[12 * static_cast<size_t>(k)]; }
+};
+
+// y = A x over block rows [begin, end). x and y hold four floats per row, the
+// last one padding that is written as 0.
+void multiplyBsr(const BsrMatrix& a, const float* x, float* y, SimdLevel level, std::uint32_t begin, std::uint32_t end);
+
+// Backward Euler for a mass-spring cloth, after Baraff and Witkin, "Large
+// Steps in Cloth Simulation". Every step linearizes the spring forces around
+// the current state and solves
+//   (M - h D - h^2 K) dv = h (f + h K v)
+// for the velocity change, where K and D are the position and velocity
+// Jacobians of the forces. The system is assembled into a BSR matrix, one
+// block row per particle, and solved with conjugate gradient preconditioned
+// by the inverted diagonal blocks. Assembly gathers per particle and the
+// matrix product, the dot products and the vector updates run on the pool;
+// the dot products sum fixed chunks in order, so the result does not depend
+// on the thread count. Pinned particles (invMass 0) get dv = 0 by having
+// their block rows and columns replaced with the identity.
+// The transverse part of a compressed spring's Jacobian is dropped so the
+// matrix stays positive definite, which lets large steps through stably.
+class ClothImplicit
+{
+public:
+	ClothImplicit();
+	ClothImplicit(const ClothImplicit& rhs) = delete;
+	ClothImplicit& operator=(const ClothImplicit& rhs) = delete;
+
+	// Build the sparsity pattern; the springs are kept.
+	void build(const std::vector<ImplicitSpring>& springs, std::uint32_t particleCount);
+	void setDesc(const ImplicitDesc& desc) { m_Desc = desc; }
+	const ImplicitDesc& desc()const { return m_Desc; }
+
+	// One backward Euler step of params.dt: sets the previous positions and
+	// updates velocities and positions. Gravity and damping as in the
+	// explicit integrators.
+	void step(ParticleStore& p, const IntegrateParams& params, ThreadPool* pool);
+	// One semi-implicit Euler step with the same spring forces, for comparison.
+	void stepExplicit(ParticleStore& p, const IntegrateParams& params, ThreadPool* pool);
+
+	// Instruction set of the matrix product; defaults to detectSimdLevel().
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	std::uint32_t springCount()const { return static_cast<std::uint32_t>(m_Springs.size()); }
+	const BsrMatrix& matrix()const { return m_Matrix; }
+
+	// Conjugate gradient iterations, relative residual and times of the last step.
+	int lastIterations()const { return m_Iterations; }
+	float lastResidual()const { return m_Residual; }
+	double lastAssemblySeconds()const { return m_AssemblySeconds; }
+	double lastSolveSeconds()const { return m_SolveSeconds; }
+
+private:
+	void assemble(const ParticleStore& p, float h, const Vec3& gravity, ThreadPool* pool);
+	int solve(ThreadPool* pool);
+	// Sum fn(begin, end) over fixed chunks of rows, in chunk order.
+	double reduceRows(ThreadPool* pool, const std::function<double(std::uint32_t, std::uint32_t)>& fn);
+
+private:
+	ImplicitDesc m_Desc;
+	SimdLevel m_SimdLevel;
+	std::vector<ImplicitSpring> m_Springs;
+
+	// Springs at particle i are m_RowSprings[m_RowSpringOffsets[i],
+	// m_RowSpringOffsets[i + 1]), and m_RowSpringBlocks holds the block of
+	// row i that couples it to the other end.
+	std::vector<std::uint32_t> m_RowSpringOffsets;
+	std::vector<std::uint32_t> m_RowSprings;
+	std::vector<std::uint32_t> m_RowSpringBlocks;
+	std::vector<std::uint32_t> m_DiagonalBlocks;
+
+	BsrMatrix m_Matrix;
+	// Inverted diagonal blocks, laid out as the matrix blocks.
+	AlignedVector<float> m_Preconditioner;
+	// Four floats per particle: right hand side, solution (dv), residual,
+	// preconditioned residual, search direction and its product with the matrix.
+	AlignedVector<float> m_B, m_X, m_R, m_Z, m_P, m_Q;
+	// Per chunk sums of reduceRows(), and of r.r in the fused update.
+	std::vector<double> m_Partials;
+	std::vector<double> m_SquarePartials;
+
+	int m_Iterations = 0;
+	float m_Residual = 0.0f;
+	double m_AssemblySeconds = 0.0;
+	double m_SolveSeconds = 0.0;
+};
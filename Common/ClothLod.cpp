@@ -0,0 +1,239 @@
+#include "ClothLod.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <unordered_set>
+
+namespace
+{
+	const std::uint32_t BoundsGrain = 4096;
+}
+
+ClothLod::ClothLod(const ClothLodDesc& desc)
+	: m_Desc(desc)
+{
+	assert(desc.levels >= 1);
+	for (int l = 0; l < desc.levels; ++l)
+	{
+		ClothDesc levelDesc = desc.cloth;
+		levelDesc.columns = ((desc.cloth.columns - 1) >> l) + 1;
+		levelDesc.rows = ((desc.cloth.rows - 1) >> l) + 1;
+		if (l > 0 && (levelDesc.columns < 4 || levelDesc.rows < 4))
+			break;
+		m_Levels.push_back(std::make_unique<Cloth>(levelDesc));
+		m_Spacing.push_back(std::max(levelDesc.width / (levelDesc.columns - 1), levelDesc.depth / (levelDesc.rows - 1)));
+	}
+	resetStats();
+	m_Stats[0].activations = 1;
+	updateBounds();
+}
+
+float ClothLod::screenError(int level, float distance, float pixelsPerUnit)const
+{
+	return m_Spacing[level] * pixelsPerUnit / std::max(distance, 1e-3f);
+}
+
+float ClothLod::distanceTo(const Vec3& eye)const
+{
+	Vec3 closest(std::min(std::max(eye.x, m_BoundsLo.x), m_BoundsHi.x),
+		std::min(std::max(eye.y, m_BoundsLo.y), m_BoundsHi.y),
+		std::min(std::max(eye.z, m_BoundsLo.z), m_BoundsHi.z));
+	return length(eye - closest);
+}
+
+void ClothLod::updateBounds()
+{
+	const ParticleStore& p = cloth().particles();
+	ThreadPool* pool = cloth().threadPool();
+	const unsigned threads = pool != nullptr ? pool->threadCount() : 1;
+	std::vector<Vec3> lo(threads, p.position(0)), hi(threads, p.position(0));
+	parallelRange(pool, static_cast<std::uint32_t>(p.size()), BoundsGrain,
+		[&p, &lo, &hi](std::uint32_t begin, std::uint32_t end, unsigned thread) {
+		Vec3 l = lo[thread], h = hi[thread];
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			l = Vec3(std::min(l.x, p.x[i]), std::min(l.y, p.y[i]), std::min(l.z, p.z[i]));
+			h = Vec3(std::max(h.x, p.x[i]), std::max(h.y, p.y[i]), std::max(h.z, p.z[i]));
+		}
+		lo[thread] = l;
+		hi[thread] = h;
+	});
+	m_BoundsLo = lo[0];
+	m_BoundsHi = hi[0];
+	for (unsigned t = 1; t < threads; ++t)
+	{
+		m_BoundsLo = Vec3(std::min(m_BoundsLo.x, lo[t].x), std::min(m_BoundsLo.y, lo[t].y), std::min(m_BoundsLo.z, lo[t].z));
+		m_BoundsHi = Vec3(std::max(m_BoundsHi.x, hi[t].x), std::max(m_BoundsHi.y, hi[t].y), std::max(m_BoundsHi.z, hi[t].z));
+	}
+}
+
+bool ClothLod::update(const Vec3& eye, float pixelsPerUnit)
+{
+	const float distance = distanceTo(eye);
+	int target = m_Level;
+	// Refine as soon as the active level shows too much error...
+	while (target > 0 && screenError(target, distance, pixelsPerUnit) > m_Desc.maxPixelError)
+		--target;
+	// ...but only coarsen with a margin below the limit.
+	if (target == m_Level)
+	{
+		const float coarsenError = m_Desc.maxPixelError * (1.0f - m_Desc.hysteresis);
+		while (target + 1 < levelCount() && screenError(target + 1, distance, pixelsPerUnit) <= coarsenError)
+			++target;
+	}
+	if (target == m_Level)
+		return false;
+	setLevel(target);
+	return true;
+}
+
+void ClothLod::setLevel(int level)
+{
+	assert(level >= 0 && level < levelCount());
+	if (level == m_Level)
+		return;
+	transfer(*m_Levels[m_Level], *m_Levels[level]);
+	m_Level = level;
+	m_Stats[level].activations++;
+	updateBounds();
+}
+
+void ClothLod::step(float dt)
+{
+	auto start = std::chrono::steady_clock::now();
+	cloth().step(dt);
+	updateBounds();
+	ClothLodStats& stats = m_Stats[m_Level];
+	stats.steps++;
+	stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClothLod::setThreadPool(ThreadPool* pool)
+{
+	for (auto& c : m_Levels)
+		c->setThreadPool(pool);
+}
+
+void ClothLod::setCollider(const Bvh* collider)
+{
+	for (auto& c : m_Levels)
+		c->setCollider(collider);
+}
+
+void ClothLod::setShapes(const ShapeCollider* shapes)
+{
+	for (auto& c : m_Levels)
+		c->setShapes(shapes);
+}
+
+void ClothLod::resetStats()
+{
+	m_Stats.assign(m_Levels.size(), ClothLodStats());
+	for (size_t l = 0; l < m_Levels.size(); ++l)
+		m_Stats[l].particles = m_Levels[l]->particleCount();
+}
+
+void ClothLod::transfer(const Cloth& from, Cloth& to)
+{
+	const int fromColumns = from.desc().columns, fromRows = from.desc().rows;
+	const int toColumns = to.desc().columns, toRows = to.desc().rows;
+	const ParticleStore& src = from.particles();
+	to.setTime(from.time());
+
+	// Tear the new level where the old one is torn. Every tear maps to the
+	// nearest grid particle and the next one towards the particle it was
+	// torn from; several tears of a finer grid often land on the same one.
+	to.healTears();
+	if (!from.tears().empty())
+	{
+		auto nearest = [](int t, int fromCount, int toCount) {
+			return static_cast<int>(static_cast<float>(t) * (toCount - 1) / (fromCount - 1) + 0.5f);
+		};
+		std::vector<ClothTear> tears;
+		std::unordered_set<std::uint64_t> seen;
+		for (const ClothTear& t : from.tears())
+		{
+			const int i0 = nearest(static_cast<int>(t.particle) / fromColumns, fromRows, toRows);
+			const int j0 = nearest(static_cast<int>(t.particle) % fromColumns, fromColumns, toColumns);
+			const int i1 = nearest(static_cast<int>(t.toward) / fromColumns, fromRows, toRows);
+			const int j1 = nearest(static_cast<int>(t.toward) % fromColumns, fromColumns, toColumns);
+			if (i0 == i1 && j0 == j1)
+				continue;
+			const int i = i0 + (i1 > i0 ? 1 : 0) - (i1 < i0 ? 1 : 0);
+			const int j = j0 + (j1 > j0 ? 1 : 0) - (j1 < j0 ? 1 : 0);
+			ClothTear mapped;
+			mapped.particle = to.index(i0, j0);
+			mapped.toward = to.index(i, j);
+			if (seen.insert(static_cast<std::uint64_t>(mapped.particle) << 32 | mapped.toward).second)
+				tears.push_back(mapped);
+		}
+		to.tear(tears);
+	}
+
+	// Source cell and weight of its upper neighbour along one axis.
+	auto bracket = [](int t, int toCount, int fromCount, int& lower, int& upper, float& w) {
+		float f = static_cast<float>(t) * (fromCount - 1) / (toCount - 1);
+		lower = std::min(static_cast<int>(f), fromCount - 1);
+		upper = std::min(lower + 1, fromCount - 1);
+		w = f - lower;
+	};
+
+	for (int i = 0; i < toRows; ++i)
+	{
+		int i0, i1;
+		float wi;
+		bracket(i, toRows, fromRows, i0, i1, wi);
+		for (int j = 0; j < toColumns; ++j)
+		{
+			int j0, j1;
+			float wj;
+			bracket(j, toColumns, fromColumns, j0, j1, wj);
+			const std::uint32_t a = from.index(i0, j0), b = from.index(i0, j1);
+			const std::uint32_t c = from.index(i1, j0), d = from.index(i1, j1);
+			const float wa = (1.0f - wi) * (1.0f - wj), wb = (1.0f - wi) * wj;
+			const float wc = wi * (1.0f - wj), wd = wi * wj;
+			const std::uint32_t k = to.index(i, j);
+			to.setPosition(k, src.position(a) * wa + src.position(b) * wb + src.position(c) * wc + src.position(d) * wd);
+			to.setVelocity(k, src.velocity(a) * wa + src.velocity(b) * wb + src.velocity(c) * wc + src.velocity(d) * wd);
+		}
+	}
+
+	// Particles split off by tearing follow the grid particle they came from.
+	for (std::uint32_t k = to.gridParticleCount(); k < to.particleCount(); ++k)
+	{
+		to.setPosition(k, to.position(to.gridParticle(k)));
+		to.setVelocity(k, to.particles().velocity(to.gridParticle(k)));
+	}
+
+	// Interpolation does not preserve the momentum of the free particles;
+	// shift their velocities by the difference over their mass.
+	auto momentum = [](const Cloth& cloth, Vec3& p, double& mass) {
+		const ParticleStore& s = cloth.particles();
+		p = Vec3();
+		mass = 0.0;
+		for (size_t k = 0; k < s.size(); ++k)
+		{
+			if (s.invMass[k] == 0.0f)
+				continue;
+			const float m = 1.0f / s.invMass[k];
+			p += s.velocity(k) * m;
+			mass += m;
+		}
+	};
+	Vec3 fromMomentum, toMomentum;
+	double fromMass, toMass;
+	momentum(from, fromMomentum, fromMass);
+	momentum(to, toMomentum, toMass);
+	if (toMass > 0.0)
+	{
+		const Vec3 dv = (fromMomentum - toMomentum) * static_cast<float>(1.0 / toMass);
+		const ParticleStore& dst = to.particles();
+		for (std::uint32_t k = 0; k < to.particleCount(); ++k)
+		{
+			if (dst.invMass[k] != 0.0f)
+				to.setVelocity(k, dst.velocity(k) + dv);
+		}
+	}
+	to.computeNormals();
+}
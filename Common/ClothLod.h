@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Cloth.h"
+
+struct ClothLodDesc
+{
+	// The finest level. Every coarser level halves the grid resolution and
+	// keeps everything else, including the total mass and the pins.
+	ClothDesc cloth;
+	int levels = 3;
+	// Largest particle spacing, in pixels, a level may show on screen.
+	float maxPixelError = 2.0f;
+	// A coarser level is only taken once its error is below
+	// maxPixelError * (1 - hysteresis), so a camera resting near a switch
+	// distance does not flip between two levels every frame.
+	float hysteresis = 0.3f;
+};
+
+// Simulation cost of one level while it was active.
+struct ClothLodStats
+{
+	std::uint32_t particles = 0;
+	long long steps = 0;
+	double seconds = 0.0;
+	// Times the sheet switched to this level.
+	int activations = 0;
+};
+
+// A cloth sheet simulated at one of several precomputed resolutions. Only the
+// active level is stepped; when the level changes, positions and velocities
+// are resampled bilinearly over the grid onto the new level, and velocities
+// are then shifted so the sheet keeps its linear momentum. Every level has the
+// same total mass, so mass and momentum both carry over the switch. Tears
+// carry over too: the new level drops whatever tears it had when it was last
+// active and is torn again where the old one is, mapped onto its own grid.
+// The new level also takes the old one's clock, so the wind gusts go on
+// without a jump.
+class ClothLod
+{
+public:
+	explicit ClothLod(const ClothLodDesc& desc);
+	ClothLod(const ClothLod& rhs) = delete;
+	ClothLod& operator=(const ClothLod& rhs) = delete;
+
+	// Choose the level for a camera at eye. pixelsPerUnit is the projected
+	// size in pixels of one unit at distance one, i.e. half the viewport
+	// height over tan(fovY / 2). Returns true when the level changed.
+	bool update(const Vec3& eye, float pixelsPerUnit);
+	// Switch to a level directly, carrying the state over.
+	void setLevel(int level);
+	void step(float dt);
+
+	Cloth& cloth() { return *m_Levels[m_Level]; }
+	const Cloth& cloth()const { return *m_Levels[m_Level]; }
+	const Cloth& levelCloth(int level)const { return *m_Levels[level]; }
+	int level()const { return m_Level; }
+	int levelCount()const { return static_cast<int>(m_Levels.size()); }
+	const ClothLodDesc& desc()const { return m_Desc; }
+
+	// On-screen particle spacing, in pixels, of a level seen from distance.
+	float screenError(int level, float distance, float pixelsPerUnit)const;
+	// Distance from eye to the bounding box of the active sheet, as it was
+	// after the last step or level switch.
+	float distanceTo(const Vec3& eye)const;
+
+	// Forwarded to every level.
+	void setThreadPool(ThreadPool* pool);
+	void setCollider(const Bvh* collider);
+	void setShapes(const ShapeCollider* shapes);
+
+	const std::vector<ClothLodStats>& stats()const { return m_Stats; }
+	void resetStats();
+
+private:
+	void transfer(const Cloth& from, Cloth& to);
+	// Bound the active sheet's particles, on its pool.
+	void updateBounds();
+
+private:
+	ClothLodDesc m_Desc;
+	std::vector<std::unique_ptr<Cloth>> m_Levels;
+	// Grid spacing of every level, the larger of the two axes.
+	std::vector<float> m_Spacing;
+	std::vector<ClothLodStats> m_Stats;
+	int m_Level = 0;
+	Vec3 m_BoundsLo;
+	Vec3 m_BoundsHi;
+};
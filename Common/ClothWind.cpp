@@ -0,0 +1,278 @@
+#include "ClothWind.h"
+#include "GreedyColoring.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// A multiple of 8 so AVX2 blocks never straddle two jobs.
+	const std::uint32_t TriangleGrain = 2048;
+
+	const float Pi = 3.14159265f;
+	const float TwoPi = 6.28318531f;
+	const float InvTwoPi = 0.159154943f;
+
+	// Parabolic sine, accurate to about 0.001, with the same steps as the
+	// AVX2 version so both kernels give the same bits.
+	inline float windSin(float x)
+	{
+		x = x - std::nearbyint(x * InvTwoPi) * TwoPi;
+		float y = (4.0f / Pi) * x + (-4.0f / (Pi * Pi)) * (x * std::fabs(x));
+		return 0.225f * (y * std::fabs(y) - y) + y;
+	}
+
+	struct WindPass
+	{
+		const std::uint32_t* i0;
+		const std::uint32_t* i1;
+		const std::uint32_t* i2;
+		const float* x;
+		const float* y;
+		const float* z;
+		float* vx;
+		float* vy;
+		float* vz;
+		const float* invMass;
+		Vec3 wind;
+		float turbulence;
+		// Wave number of the gusts and their phase for each axis.
+		float k;
+		float phase[3];
+		// Force scale 0.25 * density times each coefficient, see the kernel.
+		float drag;
+		float lift;
+		// dt / 3: a third of the impulse goes to each corner.
+		float dtThird;
+	};
+
+	// Gust direction at c; three sine waves travelling along different axes.
+	inline Vec3 gust(const WindPass& p, const Vec3& c)
+	{
+		return Vec3(windSin(p.k * (c.y + c.z) + p.phase[0]),
+			windSin(p.k * (1.31f * c.z - c.x) + p.phase[1]),
+			windSin(p.k * (0.87f * c.x + 1.13f * c.y) + p.phase[2]));
+	}
+
+	inline void scatter(const WindPass& p, std::uint32_t v, float fx, float fy, float fz)
+	{
+		const float w = p.invMass[v];
+		p.vx[v] += fx * w;
+		p.vy[v] += fy * w;
+		p.vz[v] += fz * w;
+	}
+
+	// With n the unnormalized triangle normal (|n| is twice the area A), u the
+	// relative wind and un = dot(u, n):
+	//   drag = 0.5 rho Cd A (u.n^) |u| n^             = 0.25 rho Cd un |u| n / |n|
+	//   lift = 0.5 rho Cl A (u.n^) (|u|^2 n^ - (u.n^) u) / |u|
+	//                                                 = 0.25 rho Cl un (|u|^2 n - un u) / (|n| |u|)
+	// Lift is perpendicular to the flow and largest at 45 degrees.
+	void windScalar(const WindPass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t t = begin; t < end; ++t)
+		{
+			const std::uint32_t a = p.i0[t], b = p.i1[t], c = p.i2[t];
+			Vec3 p0(p.x[a], p.y[a], p.z[a]);
+			Vec3 p1(p.x[b], p.y[b], p.z[b]);
+			Vec3 p2(p.x[c], p.y[c], p.z[c]);
+			Vec3 n = cross(p1 - p0, p2 - p0);
+			Vec3 center = (p0 + p1 + p2) * (1.0f / 3.0f);
+			Vec3 velocity = (Vec3(p.vx[a], p.vy[a], p.vz[a]) + Vec3(p.vx[b], p.vy[b], p.vz[b]) +
+				Vec3(p.vx[c], p.vy[c], p.vz[c])) * (1.0f / 3.0f);
+			Vec3 u = p.wind + gust(p, center) * p.turbulence - velocity;
+
+			const float nn = dot(n, n);
+			const float uu = dot(u, u);
+			if (nn <= 1e-20f || uu <= 1e-12f)
+				continue;
+			const float un = dot(u, n);
+			const float uLen = std::sqrt(uu);
+			const float s = un / std::sqrt(nn) * p.dtThird;
+			const float dragScale = p.drag * uLen;
+			const float liftScale = p.lift / uLen;
+			const float fx = s * (dragScale * n.x + liftScale * (uu * n.x - un * u.x));
+			const float fy = s * (dragScale * n.y + liftScale * (uu * n.y - un * u.y));
+			const float fz = s * (dragScale * n.z + liftScale * (uu * n.z - un * u.z));
+			scatter(p, a, fx, fy, fz);
+			scatter(p, b, fx, fy, fz);
+			scatter(p, c, fx, fy, fz);
+		}
+	}
+
+#if SIMD_X86
+	SIMD_TARGET_AVX2 inline __m256 windSinAvx2(__m256 x)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		__m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(InvTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		x = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(TwoPi)));
+		__m256 y = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f / Pi), x),
+			_mm256_mul_ps(_mm256_set1_ps(-4.0f / (Pi * Pi)), _mm256_mul_ps(x, _mm256_andnot_ps(signMask, x))));
+		__m256 yy = _mm256_sub_ps(_mm256_mul_ps(y, _mm256_andnot_ps(signMask, y)), y);
+		return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.225f), yy), y);
+	}
+
+	SIMD_TARGET_AVX2 void windAvx2(const WindPass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		const __m256 third = _mm256_set1_ps(1.0f / 3.0f);
+		const __m256 k = _mm256_set1_ps(p.k);
+		const __m256 turbulence = _mm256_set1_ps(p.turbulence);
+		std::uint32_t t = begin;
+		for (; t + 8 <= end; t += 8)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p.i0 + t));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p.i1 + t));
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p.i2 + t));
+			__m256 x0 = _mm256_i32gather_ps(p.x, a, 4), y0 = _mm256_i32gather_ps(p.y, a, 4), z0 = _mm256_i32gather_ps(p.z, a, 4);
+			__m256 x1 = _mm256_i32gather_ps(p.x, b, 4), y1 = _mm256_i32gather_ps(p.y, b, 4), z1 = _mm256_i32gather_ps(p.z, b, 4);
+			__m256 x2 = _mm256_i32gather_ps(p.x, c, 4), y2 = _mm256_i32gather_ps(p.y, c, 4), z2 = _mm256_i32gather_ps(p.z, c, 4);
+			__m256 ax = _mm256_sub_ps(x1, x0), ay = _mm256_sub_ps(y1, y0), az = _mm256_sub_ps(z1, z0);
+			__m256 bx = _mm256_sub_ps(x2, x0), by = _mm256_sub_ps(y2, y0), bz = _mm256_sub_ps(z2, z0);
+			__m256 nx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+			__m256 ny = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+			__m256 cx = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x0, x1), x2), third);
+			__m256 cy = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(y0, y1), y2), third);
+			__m256 cz = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(z0, z1), z2), third);
+			__m256 velX = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_i32gather_ps(p.vx, a, 4), _mm256_i32gather_ps(p.vx, b, 4)), _mm256_i32gather_ps(p.vx, c, 4)), third);
+			__m256 velY = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_i32gather_ps(p.vy, a, 4), _mm256_i32gather_ps(p.vy, b, 4)), _mm256_i32gather_ps(p.vy, c, 4)), third);
+			__m256 velZ = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_i32gather_ps(p.vz, a, 4), _mm256_i32gather_ps(p.vz, b, 4)), _mm256_i32gather_ps(p.vz, c, 4)), third);
+
+			__m256 gx = windSinAvx2(_mm256_add_ps(_mm256_mul_ps(k, _mm256_add_ps(cy, cz)), _mm256_set1_ps(p.phase[0])));
+			__m256 gy = windSinAvx2(_mm256_add_ps(_mm256_mul_ps(k, _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(1.31f), cz), cx)), _mm256_set1_ps(p.phase[1])));
+			__m256 gz = windSinAvx2(_mm256_add_ps(_mm256_mul_ps(k, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.87f), cx), _mm256_mul_ps(_mm256_set1_ps(1.13f), cy))), _mm256_set1_ps(p.phase[2])));
+			__m256 ux = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(p.wind.x), _mm256_mul_ps(gx, turbulence)), velX);
+			__m256 uy = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(p.wind.y), _mm256_mul_ps(gy, turbulence)), velY);
+			__m256 uz = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(p.wind.z), _mm256_mul_ps(gz, turbulence)), velZ);
+
+			__m256 nn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+			__m256 uu = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uy, uy)), _mm256_mul_ps(uz, uz));
+			__m256 valid = _mm256_and_ps(_mm256_cmp_ps(nn, _mm256_set1_ps(1e-20f), _CMP_GT_OQ),
+				_mm256_cmp_ps(uu, _mm256_set1_ps(1e-12f), _CMP_GT_OQ));
+			__m256 un = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ux, nx), _mm256_mul_ps(uy, ny)), _mm256_mul_ps(uz, nz));
+			__m256 uLen = _mm256_sqrt_ps(uu);
+			__m256 s = _mm256_mul_ps(_mm256_div_ps(un, _mm256_sqrt_ps(nn)), _mm256_set1_ps(p.dtThird));
+			__m256 dragScale = _mm256_mul_ps(_mm256_set1_ps(p.drag), uLen);
+			__m256 liftScale = _mm256_div_ps(_mm256_set1_ps(p.lift), uLen);
+			__m256 fx = _mm256_mul_ps(s, _mm256_add_ps(_mm256_mul_ps(dragScale, nx),
+				_mm256_mul_ps(liftScale, _mm256_sub_ps(_mm256_mul_ps(uu, nx), _mm256_mul_ps(un, ux)))));
+			__m256 fy = _mm256_mul_ps(s, _mm256_add_ps(_mm256_mul_ps(dragScale, ny),
+				_mm256_mul_ps(liftScale, _mm256_sub_ps(_mm256_mul_ps(uu, ny), _mm256_mul_ps(un, uy)))));
+			__m256 fz = _mm256_mul_ps(s, _mm256_add_ps(_mm256_mul_ps(dragScale, nz),
+				_mm256_mul_ps(liftScale, _mm256_sub_ps(_mm256_mul_ps(uu, nz), _mm256_mul_ps(un, uz)))));
+			// Degenerate triangles and still air may have produced NaN; drop them.
+			alignas(32) float sx[8], sy[8], sz[8];
+			_mm256_store_ps(sx, _mm256_and_ps(fx, valid));
+			_mm256_store_ps(sy, _mm256_and_ps(fy, valid));
+			_mm256_store_ps(sz, _mm256_and_ps(fz, valid));
+			// No scatter instruction in AVX2; the corners are distinct within a
+			// color, so plain stores are safe.
+			for (int l = 0; l < 8; ++l)
+			{
+				scatter(p, p.i0[t + l], sx[l], sy[l], sz[l]);
+				scatter(p, p.i1[t + l], sx[l], sy[l], sz[l]);
+				scatter(p, p.i2[t + l], sx[l], sy[l], sz[l]);
+			}
+		}
+		windScalar(p, t, end);
+	}
+#endif
+
+	void applyWind(const WindPass& p, SimdLevel level, std::uint32_t begin, std::uint32_t end)
+	{
+#if SIMD_X86
+		if (level == SimdLevel::AVX2)
+			return windAvx2(p, begin, end);
+#endif
+		windScalar(p, begin, end);
+	}
+}
+
+ClothWind::ClothWind()
+	: m_SimdLevel(detectSimdLevel())
+{
+	m_ColorOffsets.assign(1, 0);
+}
+
+void ClothWind::build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount)
+{
+	// Greedy coloring, as for the cloth constraints: the lowest color no
+	// triangle already touching one of the three corners uses.
+	GreedyColoring coloring(vertexCount);
+	std::vector<std::uint32_t> colors(triangleCount);
+	for (std::uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const std::uint32_t* tri = indices + 3 * static_cast<size_t>(t);
+		assert(tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount);
+		colors[t] = coloring.add(tri, 3);
+	}
+	const std::uint32_t colorCount = coloring.colorCount();
+	const std::vector<std::uint32_t>& counts = coloring.counts();
+
+	// Counting sort by color into the three index arrays.
+	m_ColorOffsets.assign(colorCount + 1, 0);
+	for (std::uint32_t c = 0; c < colorCount; ++c)
+		m_ColorOffsets[c + 1] = m_ColorOffsets[c] + counts[c];
+	std::vector<std::uint32_t> cursor(m_ColorOffsets.begin(), m_ColorOffsets.end() - 1);
+	m_I0.resize(triangleCount);
+	m_I1.resize(triangleCount);
+	m_I2.resize(triangleCount);
+	for (std::uint32_t t = 0; t < triangleCount; ++t)
+	{
+		std::uint32_t slot = cursor[colors[t]]++;
+		m_I0[slot] = indices[3 * static_cast<size_t>(t) + 0];
+		m_I1[slot] = indices[3 * static_cast<size_t>(t) + 1];
+		m_I2[slot] = indices[3 * static_cast<size_t>(t) + 2];
+	}
+}
+
+bool ClothWind::enabled()const
+{
+	return lengthSq(m_Desc.velocity) > 0.0f || m_Desc.turbulence > 0.0f;
+}
+
+Vec3 ClothWind::windAt(const Vec3& p, float time)const
+{
+	WindPass pass = {};
+	pass.k = TwoPi / m_Desc.turbulenceScale;
+	const float phase = TwoPi * m_Desc.turbulenceFrequency * time;
+	pass.phase[0] = phase;
+	pass.phase[1] = 1.7f * phase;
+	pass.phase[2] = 0.73f * phase;
+	return m_Desc.velocity + gust(pass, p) * m_Desc.turbulence;
+}
+
+void ClothWind::apply(ParticleStore& p, float dt, float time, ThreadPool* pool)
+{
+	WindPass pass;
+	pass.i0 = m_I0.data();
+	pass.i1 = m_I1.data();
+	pass.i2 = m_I2.data();
+	pass.x = p.x.data();
+	pass.y = p.y.data();
+	pass.z = p.z.data();
+	pass.vx = p.vx.data();
+	pass.vy = p.vy.data();
+	pass.vz = p.vz.data();
+	pass.invMass = p.invMass.data();
+	pass.wind = m_Desc.velocity;
+	pass.turbulence = m_Desc.turbulence;
+	pass.k = TwoPi / m_Desc.turbulenceScale;
+	const float phase = TwoPi * m_Desc.turbulenceFrequency * time;
+	pass.phase[0] = phase;
+	pass.phase[1] = 1.7f * phase;
+	pass.phase[2] = 0.73f * phase;
+	pass.drag = 0.25f * m_Desc.airDensity * m_Desc.dragCoefficient;
+	pass.lift = 0.25f * m_Desc.airDensity * m_Desc.liftCoefficient;
+	pass.dtThird = dt / 3.0f;
+
+	const SimdLevel level = m_SimdLevel;
+	for (std::uint32_t c = 0; c < colorCount(); ++c)
+	{
+		const std::uint32_t first = m_ColorOffsets[c];
+		const std::uint32_t count = m_ColorOffsets[c + 1] - first;
+		parallelRange(pool, count, TriangleGrain, [&pass, level, first](std::uint32_t begin, std::uint32_t end, unsigned) {
+			applyWind(pass, level, first + begin, first + end);
+		});
+	}
+}
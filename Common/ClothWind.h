@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+#include "Simd.h"
+#include "SimMath.h"
+#include "ThreadPool.h"
+
+struct WindDesc
+{
+	// Mean wind velocity (m/s).
+	Vec3 velocity = { 0.0f, 0.0f, 0.0f };
+	// Amplitude (m/s) of the procedural gusts added to the mean wind, their
+	// wavelength (m) and how often they pass (Hz).
+	float turbulence = 0.0f;
+	float turbulenceScale = 1.0f;
+	float turbulenceFrequency = 0.5f;
+	// Air density (kg/m^3) and the drag and lift coefficients of the cloth.
+	float airDensity = 1.2f;
+	float dragCoefficient = 1.0f;
+	float liftCoefficient = 0.3f;
+};
+
+// Aerodynamic forces on a triangle mesh. Every triangle gets a drag force
+// along its normal and a lift force across the flow, both from the wind
+// relative to the triangle's average velocity, and a third of the impulse goes
+// to each corner. Triangles are stored as separate index arrays, graph colored
+// so no two triangles of one color share a vertex, and sorted by color: a color
+// is scattered in parallel without atomics and the colors run one after the
+// other. Colors later in the order see the impulses of earlier ones, like a
+// Gauss-Seidel sweep.
+class ClothWind
+{
+public:
+	ClothWind();
+	ClothWind(const ClothWind& rhs) = delete;
+	ClothWind& operator=(const ClothWind& rhs) = delete;
+
+	void build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount);
+	void build(const std::vector<std::uint32_t>& indices, std::uint32_t vertexCount)
+	{
+		build(indices.data(), static_cast<std::uint32_t>(indices.size() / 3), vertexCount);
+	}
+
+	void setDesc(const WindDesc& desc) { m_Desc = desc; }
+	const WindDesc& desc()const { return m_Desc; }
+	// False when there is neither mean wind nor turbulence.
+	bool enabled()const;
+
+	// Wind velocity at p, time seconds into the simulation.
+	Vec3 windAt(const Vec3& p, float time)const;
+	// Add the wind impulse over dt to the particle velocities.
+	void apply(ParticleStore& p, float dt, float time, ThreadPool* pool);
+
+	// AVX2 gathers eight triangles at a time; lower levels run the scalar
+	// kernel, which gives the same bits.
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	std::uint32_t triangleCount()const { return static_cast<std::uint32_t>(m_I0.size()); }
+	// Triangles of color c are [colorOffsets()[c], colorOffsets()[c + 1]) in
+	// the color sorted order.
+	std::uint32_t colorCount()const { return static_cast<std::uint32_t>(m_ColorOffsets.size()) - 1; }
+	const std::vector<std::uint32_t>& colorOffsets()const { return m_ColorOffsets; }
+
+private:
+	WindDesc m_Desc;
+	SimdLevel m_SimdLevel;
+	AlignedVector<std::uint32_t> m_I0, m_I1, m_I2;
+	std::vector<std::uint32_t> m_ColorOffsets;
+};
@@ -277,7 +277,8 @@ void D3DFrame::calculateFrameStats()
 		std::wstring mspfStr = std::to_wstring(mspf);
 		std::wstring windowText = m_MainWndCaption +
 			L"    fps: " + fpsStr +
-			L"   mspf: " + mspfStr;
+			L"   mspf: " + mspfStr +
+			frameStatsText();
 		SetWindowText(m_hMainWnd, windowText.c_str());
 
 		// Reset for next average.
@@ -56,6 +56,8 @@ protected:
 	D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView()const;
 	//Calculate the frame rate
 	void calculateFrameStats();
+	//Extra text for the frame stats in the caption, called once per second
+	virtual std::wstring frameStatsText() { return L""; }
 	//Enumerate all adapters
 	void logAdapters();
 	//Enumerate all display output for the specified adapter
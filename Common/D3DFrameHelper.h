@@ -118,6 +118,12 @@ struct MeshGeo
 	UINT indexBufferByteSize = 0;
 
 	std::unordered_map<std::string, SubMeshGeo> drawArgs;
+	// Point the mesh at a vertex buffer the CPU rewrites every frame, such as
+	// the dynamic vertex buffer of the current frame resource.
+	void setDynamicVertexBuffer(ID3D12Resource* buffer)
+	{
+		vertexBufferGPU = buffer;
+	}
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
@@ -0,0 +1,47 @@
+#include "FixedStepScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+FixedStepScheduler::FixedStepScheduler(const FixedStepDesc& desc)
+	: m_Desc(desc)
+{
+	assert(desc.stepSeconds > 0.0 && desc.maxStepsPerFrame >= 1);
+}
+
+void FixedStepScheduler::advance(double frameSeconds, const StepFn& step)
+{
+	m_LastFrame = FixedStepStats();
+	m_Accumulator += std::max(0.0, frameSeconds);
+
+	const double dt = m_Desc.stepSeconds;
+	const double budget = dt * m_Desc.maxStepsPerFrame;
+	if (m_Accumulator >= budget + dt)
+	{
+		// Keep the fraction of a step so alpha stays continuous.
+		double keep = budget + std::fmod(m_Accumulator, dt);
+		m_LastFrame.droppedSeconds = m_Accumulator - keep;
+		m_Accumulator = keep;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	while (m_Accumulator >= dt)
+	{
+		step(static_cast<float>(dt));
+		m_Accumulator -= dt;
+		m_SimulatedSeconds += dt;
+		m_LastFrame.steps++;
+		m_TotalSteps++;
+	}
+	if (m_LastFrame.steps > 0)
+		m_LastFrame.stepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FixedStepScheduler::reset()
+{
+	m_Accumulator = 0.0;
+	m_SimulatedSeconds = 0.0;
+	m_TotalSteps = 0;
+	m_LastFrame = FixedStepStats();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+
+struct FixedStepDesc
+{
+	// Simulated seconds per step.
+	double stepSeconds = 1.0 / 60.0;
+	// Most steps run for one frame. When a hitch leaves more time owed than
+	// this, the excess is dropped and the simulation runs slow for a frame
+	// instead of falling further behind every frame (the spiral of death).
+	int maxStepsPerFrame = 4;
+};
+
+// What advance() did during the last frame.
+struct FixedStepStats
+{
+	int steps = 0;
+	// Wall clock time spent inside the step callback.
+	double stepSeconds = 0.0;
+	// Frame time thrown away by the maxStepsPerFrame clamp.
+	double droppedSeconds = 0.0;
+};
+
+// Accumulator based fixed timestep. Every frame the wall clock delta is added
+// to an accumulator and whole steps are taken out of it, so the simulation
+// always advances by the same dt no matter the frame rate. The remainder is
+// carried over; alpha() is that remainder as a fraction of a step, for
+// blending the last two simulation states when rendering.
+class FixedStepScheduler
+{
+public:
+	using StepFn = std::function<void(float dt)>;
+
+	explicit FixedStepScheduler(const FixedStepDesc& desc = FixedStepDesc());
+
+	const FixedStepDesc& desc()const { return m_Desc; }
+	void setDesc(const FixedStepDesc& desc) { m_Desc = desc; }
+
+	// Add frameSeconds of real time and call step(desc().stepSeconds) for
+	// every whole step that fits.
+	void advance(double frameSeconds, const StepFn& step);
+	// Forget the carried remainder and the totals.
+	void reset();
+
+	// In [0, 1): how far real time is past the last step, in steps.
+	float alpha()const { return static_cast<float>(m_Accumulator / m_Desc.stepSeconds); }
+	const FixedStepStats& lastFrame()const { return m_LastFrame; }
+	double simulatedSeconds()const { return m_SimulatedSeconds; }
+	long long totalSteps()const { return m_TotalSteps; }
+
+private:
+	FixedStepDesc m_Desc;
+	double m_Accumulator = 0.0;
+	double m_SimulatedSeconds = 0.0;
+	long long m_TotalSteps = 0;
+	FixedStepStats m_LastFrame;
+};
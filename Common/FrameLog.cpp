@@ -0,0 +1,108 @@
+#include "FrameLog.h"
+#include <cstring>
+
+namespace
+{
+	const char Magic[4] = { 'F', 'L', 'O', 'G' };
+	// 2 widened the event count from 16 bits.
+	const std::uint32_t Version = 2;
+
+	template<typename T>
+	void put(std::ofstream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool get(std::ifstream& in, T& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+bool FrameLogWriter::open(const std::string& fileName)
+{
+	m_File.open(fileName, std::ios::binary | std::ios::trunc);
+	if (!m_File)
+		return false;
+	m_File.write(Magic, sizeof(Magic));
+	put(m_File, Version);
+	m_Frames = 0;
+	return true;
+}
+
+void FrameLogWriter::write(const FrameRecord& frame)
+{
+	put(m_File, frame.deltaTime);
+	put(m_File, frame.totalTime);
+	put(m_File, static_cast<std::uint32_t>(frame.events.size()));
+	for (const FrameEvent& e : frame.events)
+	{
+		put(m_File, static_cast<std::uint8_t>(e.type));
+		put(m_File, e.buttons);
+		put(m_File, e.x);
+		put(m_File, e.y);
+	}
+	put(m_File, frame.stateHash);
+	m_Frames++;
+}
+
+void FrameLogWriter::close()
+{
+	m_File.close();
+}
+
+bool FrameLogReader::open(const std::string& fileName)
+{
+	m_File.open(fileName, std::ios::binary);
+	char magic[4] = {};
+	std::uint32_t version = 0;
+	if (!m_File || !m_File.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+		!get(m_File, version) || version != Version)
+	{
+		m_File.close();
+		return false;
+	}
+	m_Frames = 0;
+	return true;
+}
+
+bool FrameLogReader::read(FrameRecord& frame)
+{
+	std::uint32_t eventCount = 0;
+	if (!get(m_File, frame.deltaTime) || !get(m_File, frame.totalTime) || !get(m_File, eventCount))
+		return false;
+	// Appended as they are read, so a damaged count cannot allocate more
+	// than the file holds.
+	frame.events.clear();
+	for (std::uint32_t k = 0; k < eventCount; ++k)
+	{
+		FrameEvent e;
+		std::uint8_t type = 0;
+		if (!get(m_File, type) || !get(m_File, e.buttons) || !get(m_File, e.x) || !get(m_File, e.y))
+			return false;
+		e.type = static_cast<FrameEventType>(type);
+		frame.events.push_back(e);
+	}
+	if (!get(m_File, frame.stateHash))
+		return false;
+	m_Frames++;
+	return true;
+}
+
+void FrameLogReader::close()
+{
+	m_File.close();
+}
+
+std::uint64_t hashBytes(const void* data, size_t bytes, std::uint64_t seed)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	std::uint64_t h = seed;
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
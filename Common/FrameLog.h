@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary log of everything that drives a frame: the timer values and the
+// input events that arrived since the previous frame, followed by a hash of
+// the state the frame produced. Replaying a log feeds the same values back,
+// so two runs do the same work and the hashes show the first frame where
+// they disagree.
+//
+// Layout, little endian: "FLOG", u32 version, then per frame
+// f64 deltaTime, f64 totalTime, u32 event count, 6 bytes per event, u64 hash.
+// Times are stored as raw doubles so a replay is bit exact.
+
+enum class FrameEventType : std::uint8_t
+{
+	MouseDown,
+	MouseUp,
+	MouseMove
+};
+
+struct FrameEvent
+{
+	FrameEventType type = FrameEventType::MouseMove;
+	// MK_LBUTTON, MK_RBUTTON and MK_MBUTTON all fit in the low byte.
+	std::uint8_t buttons = 0;
+	std::int16_t x = 0;
+	std::int16_t y = 0;
+};
+
+struct FrameRecord
+{
+	double deltaTime = 0.0;
+	double totalTime = 0.0;
+	std::vector<FrameEvent> events;
+	std::uint64_t stateHash = 0;
+};
+
+class FrameLogWriter
+{
+public:
+	bool open(const std::string& fileName);
+	void write(const FrameRecord& frame);
+	void close();
+	bool isOpen()const { return m_File.is_open(); }
+	std::uint32_t frameCount()const { return m_Frames; }
+
+private:
+	std::ofstream m_File;
+	std::uint32_t m_Frames = 0;
+};
+
+class FrameLogReader
+{
+public:
+	// Fails if the file is missing or was written by another version.
+	bool open(const std::string& fileName);
+	// False at the end of the log.
+	bool read(FrameRecord& frame);
+	void close();
+	bool isOpen()const { return m_File.is_open(); }
+	std::uint32_t frameCount()const { return m_Frames; }
+
+private:
+	std::ifstream m_File;
+	std::uint32_t m_Frames = 0;
+};
+
+// 64-bit FNV-1a. Chain calls by passing the previous result as seed.
+const std::uint64_t FrameHashSeed = 14695981039346656037ull;
+std::uint64_t hashBytes(const void* data, size_t bytes, std::uint64_t seed = FrameHashSeed);
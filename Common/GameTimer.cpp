@@ -9,7 +9,9 @@ GameTimer::GameTimer()
 	m_StopTime(0),
 	m_PrevTime(0),
 	m_CurrTime(0),
-	m_Stopped(false)
+	m_Stopped(false),
+	m_Overridden(false),
+	m_OverrideTotalTime(0.0)
 {
 	__int64 countsPerSec;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
@@ -18,6 +20,10 @@ GameTimer::GameTimer()
 
 double GameTimer::totalTime()const
 {
+	if (m_Overridden)
+	{
+		return m_OverrideTotalTime;
+	}
 	if (m_Stopped)
 	{
 		return (double)(((m_StopTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
@@ -69,6 +75,7 @@ void GameTimer::stop()
 
 void GameTimer::tick()
 {
+	m_Overridden = false;
 	if (m_Stopped)
 	{
 		m_DeltaTime = 0.0;
@@ -83,4 +90,11 @@ void GameTimer::tick()
 	{
 		m_DeltaTime = 0.0;
 	}
+}
+
+void GameTimer::overrideFrame(double deltaTime, double totalTime)
+{
+	m_DeltaTime = deltaTime;
+	m_OverrideTotalTime = totalTime;
+	m_Overridden = true;
 }
\ No newline at end of file
@@ -12,6 +12,9 @@ public:
 	void start(); // Call when unpaused.
 	void stop();  // Call when paused.
 	void tick();  // Call every frame.
+	// Replace the measured times of the current frame until the next tick,
+	// e.g. with values read back from a recording.
+	void overrideFrame(double deltaTime, double totalTime);
 
 private:
 	double m_SecondsPerCount;
@@ -23,4 +26,6 @@ private:
 	__int64 m_CurrTime;
 
 	bool m_Stopped;
+	bool m_Overridden;
+	double m_OverrideTotalTime;
 };
\ No newline at end of file
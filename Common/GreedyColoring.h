@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Greedy graph coloring of items that each touch a few vertices, such as
+// constraints or triangles: an item takes the lowest color none of the items
+// already colored at its vertices uses, so items of one color share no
+// vertex. Every vertex keeps a bit mask of the colors used at it, one 64-bit
+// word to begin with and twice as many whenever a color past the last word
+// is needed, so a vertex shared by many items (a cone apex, a sphere pole)
+// only costs memory.
+class GreedyColoring
+{
+public:
+	explicit GreedyColoring(std::uint32_t vertexCount)
+		: m_VertexCount(vertexCount), m_Used(vertexCount, 0)
+	{
+	}
+	GreedyColoring(const GreedyColoring& rhs) = delete;
+	GreedyColoring& operator=(const GreedyColoring& rhs) = delete;
+
+	// Color the item touching vertices[0, count).
+	std::uint32_t add(const std::uint32_t* vertices, int count)
+	{
+		for (std::uint32_t w = 0;; ++w)
+		{
+			if (w == m_Words)
+				widen();
+			std::uint64_t taken = 0;
+			for (int k = 0; k < count; ++k)
+				taken |= m_Used[static_cast<size_t>(vertices[k]) * m_Words + w];
+			if (~taken == 0)
+				continue;
+			std::uint32_t bit = 0;
+			while ((taken & (std::uint64_t(1) << bit)) != 0)
+				++bit;
+			for (int k = 0; k < count; ++k)
+				m_Used[static_cast<size_t>(vertices[k]) * m_Words + w] |= std::uint64_t(1) << bit;
+			const std::uint32_t color = 64 * w + bit;
+			if (color >= m_Counts.size())
+				m_Counts.resize(color + 1, 0);
+			m_Counts[color]++;
+			return color;
+		}
+	}
+
+	std::uint32_t colorCount()const { return static_cast<std::uint32_t>(m_Counts.size()); }
+	// Items of every color.
+	const std::vector<std::uint32_t>& counts()const { return m_Counts; }
+
+private:
+	void widen()
+	{
+		std::vector<std::uint64_t> used(static_cast<size_t>(m_VertexCount) * m_Words * 2, 0);
+		for (size_t v = 0; v < m_VertexCount; ++v)
+		{
+			for (std::uint32_t w = 0; w < m_Words; ++w)
+				used[v * m_Words * 2 + w] = m_Used[v * m_Words + w];
+		}
+		m_Used.swap(used);
+		m_Words *= 2;
+	}
+
+private:
+	std::uint32_t m_VertexCount;
+	std::uint32_t m_Words = 1;
+	std::vector<std::uint64_t> m_Used;
+	std::vector<std::uint32_t> m_Counts;
+};
@@ -0,0 +1,214 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()
+{
+	close(m_Size);
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::openRead(const std::string& fileName)
+{
+	close();
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	m_File = file;
+	m_Writable = false;
+	m_Open = true;
+	if (size.QuadPart > 0 && !map(static_cast<size_t>(size.QuadPart)))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::openWrite(const std::string& fileName, size_t capacity)
+{
+	close();
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_File = file;
+	m_Writable = true;
+	m_Open = true;
+	if (!map(capacity > 0 ? capacity : 1))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::map(size_t bytes)
+{
+	unmap();
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(bytes);
+	// A write mapping of a given size extends the file to it.
+	HANDLE mapping = CreateFileMappingA(m_File, nullptr, m_Writable ? PAGE_READWRITE : PAGE_READONLY,
+		static_cast<DWORD>(size.HighPart), size.LowPart, nullptr);
+	if (mapping == nullptr)
+		return false;
+	void* data = MapViewOfFile(mapping, m_Writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+	m_Mapping = mapping;
+	m_Data = static_cast<std::uint8_t*>(data);
+	m_Size = bytes;
+	return true;
+}
+
+void MappedFile::unmap()
+{
+	if (m_Data != nullptr)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping != nullptr)
+		CloseHandle(m_Mapping);
+	m_Data = nullptr;
+	m_Mapping = nullptr;
+	m_Size = 0;
+}
+
+void MappedFile::close(size_t usedBytes)
+{
+	if (!m_Open)
+		return;
+	const bool writable = m_Writable;
+	unmap();
+	if (writable)
+	{
+		LARGE_INTEGER size;
+		size.QuadPart = static_cast<LONGLONG>(usedBytes);
+		SetFilePointerEx(m_File, size, nullptr, FILE_BEGIN);
+		SetEndOfFile(m_File);
+	}
+	CloseHandle(m_File);
+	m_File = nullptr;
+	m_Open = false;
+	m_Writable = false;
+}
+
+#else
+
+bool MappedFile::openRead(const std::string& fileName)
+{
+	close();
+	const int file = ::open(fileName.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat st;
+	if (fstat(file, &st) != 0)
+	{
+		::close(file);
+		return false;
+	}
+	m_File = file;
+	m_Writable = false;
+	m_Open = true;
+	if (st.st_size > 0 && !map(static_cast<size_t>(st.st_size)))
+	{
+		close();
+		return false;
+	}
+	if (m_Data != nullptr)
+		madvise(m_Data, m_Size, MADV_SEQUENTIAL);
+	return true;
+}
+
+bool MappedFile::openWrite(const std::string& fileName, size_t capacity)
+{
+	close();
+	const int file = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return false;
+	m_File = file;
+	m_Writable = true;
+	m_Open = true;
+	if (!map(capacity > 0 ? capacity : 1))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::map(size_t bytes)
+{
+	unmap();
+	if (m_Writable && ftruncate(m_File, static_cast<off_t>(bytes)) != 0)
+		return false;
+	void* data = mmap(nullptr, bytes, m_Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_File, 0);
+	if (data == MAP_FAILED)
+		return false;
+	m_Data = static_cast<std::uint8_t*>(data);
+	m_Size = bytes;
+	return true;
+}
+
+void MappedFile::unmap()
+{
+	if (m_Data != nullptr)
+		munmap(m_Data, m_Size);
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+void MappedFile::close(size_t usedBytes)
+{
+	if (!m_Open)
+		return;
+	const bool writable = m_Writable;
+	unmap();
+	if (writable)
+	{
+		// On failure the file keeps its capacity, which a reader of an
+		// append-only format skips anyway.
+		const int truncated = ftruncate(m_File, static_cast<off_t>(usedBytes));
+		static_cast<void>(truncated);
+	}
+	::close(m_File);
+	m_File = -1;
+	m_Open = false;
+	m_Writable = false;
+}
+
+#endif
+
+bool MappedFile::reserve(size_t capacity)
+{
+	if (!m_Writable)
+		return false;
+	if (capacity <= m_Size)
+		return true;
+	return map(capacity);
+}
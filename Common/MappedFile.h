@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A file mapped into memory, through file mappings on Windows and mmap
+// elsewhere. A read mapping covers the whole file. A write mapping starts
+// at a capacity, grows by remapping, and is cut back to the bytes actually
+// used when it is closed, so a writer can append by plain stores.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// An empty file opens with a null data().
+	bool openRead(const std::string& fileName);
+	// Creates or truncates the file. Both opens first close whatever is open
+	// with close(), so a write mapping left open keeps all it has mapped.
+	bool openWrite(const std::string& fileName, size_t capacity);
+	// Write mappings only: map at least capacity bytes. data() may move.
+	bool reserve(size_t capacity);
+	// A write mapping keeps every mapped byte, like on destruction.
+	void close();
+	// A write mapping is truncated to usedBytes first.
+	void close(size_t usedBytes);
+
+	bool isOpen()const { return m_Open; }
+	bool isWritable()const { return m_Writable; }
+	const std::uint8_t* data()const { return m_Data; }
+	std::uint8_t* data() { return m_Data; }
+	// Mapped bytes: the file size, or the capacity of a write mapping.
+	size_t size()const { return m_Size; }
+
+private:
+	bool map(size_t bytes);
+	void unmap();
+
+private:
+	std::uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+	bool m_Open = false;
+	bool m_Writable = false;
+#if defined(_WIN32)
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+};
@@ -0,0 +1,144 @@
+#include "MeshAdjacency.h"
+#include <algorithm>
+
+namespace
+{
+	const std::uint32_t TriangleChunk = 16384;
+	const std::uint32_t MaxBuckets = 256;
+	const std::uint32_t VerticesPerBucket = 1024;
+
+	inline bool degenerate(const std::uint32_t* t)
+	{
+		return t[0] == t[1] || t[1] == t[2] || t[2] == t[0];
+	}
+}
+
+void MeshAdjacency::build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount, ThreadPool* pool)
+{
+	m_Edges.clear();
+	m_BoundaryEdges = 0;
+	m_NonManifoldEdges = 0;
+	m_DegenerateTriangles = 0;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	const std::uint32_t chunkCount = (triangleCount + TriangleChunk - 1) / TriangleChunk;
+	const std::uint32_t bucketCount = std::max(1u, std::min(MaxBuckets, vertexCount / VerticesPerBucket));
+	auto bucketOf = [vertexCount, bucketCount](std::uint32_t v) {
+		return static_cast<std::uint32_t>(static_cast<std::uint64_t>(v) * bucketCount / vertexCount);
+	};
+	auto chunkTriangles = [triangleCount](std::uint32_t c, std::uint32_t& begin, std::uint32_t& end) {
+		begin = c * TriangleChunk;
+		end = std::min(begin + TriangleChunk, triangleCount);
+	};
+
+	// Count the half edges of every chunk per bucket.
+	m_ChunkCounts.assign(static_cast<size_t>(chunkCount) * bucketCount, 0);
+	m_ChunkDegenerate.assign(chunkCount, 0);
+	parallelRange(pool, chunkCount, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+		{
+			std::uint32_t* counts = &m_ChunkCounts[static_cast<size_t>(c) * bucketCount];
+			std::uint32_t first, last;
+			chunkTriangles(c, first, last);
+			for (std::uint32_t t = first; t < last; ++t)
+			{
+				const std::uint32_t* tri = indices + 3 * static_cast<size_t>(t);
+				if (degenerate(tri))
+				{
+					m_ChunkDegenerate[c]++;
+					continue;
+				}
+				for (int k = 0; k < 3; ++k)
+					counts[bucketOf(std::min(tri[k], tri[(k + 1) % 3]))]++;
+			}
+		}
+	});
+
+	// Bucket major, chunks in order inside a bucket; the counts become the
+	// first slot of every chunk.
+	m_BucketOffsets.assign(bucketCount + 1, 0);
+	std::uint32_t total = 0;
+	for (std::uint32_t b = 0; b < bucketCount; ++b)
+	{
+		m_BucketOffsets[b] = total;
+		for (std::uint32_t c = 0; c < chunkCount; ++c)
+		{
+			std::uint32_t& count = m_ChunkCounts[static_cast<size_t>(c) * bucketCount + b];
+			const std::uint32_t n = count;
+			count = total;
+			total += n;
+		}
+	}
+	m_BucketOffsets[bucketCount] = total;
+	for (std::uint32_t c = 0; c < chunkCount; ++c)
+		m_DegenerateTriangles += m_ChunkDegenerate[c];
+
+	m_HalfEdges.resize(total);
+	parallelRange(pool, chunkCount, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+		{
+			std::uint32_t* cursor = &m_ChunkCounts[static_cast<size_t>(c) * bucketCount];
+			std::uint32_t first, last;
+			chunkTriangles(c, first, last);
+			for (std::uint32_t t = first; t < last; ++t)
+			{
+				const std::uint32_t* tri = indices + 3 * static_cast<size_t>(t);
+				if (degenerate(tri))
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					const std::uint32_t a = tri[k], b = tri[(k + 1) % 3];
+					const std::uint32_t lo = std::min(a, b), hi = std::max(a, b);
+					HalfEdge& h = m_HalfEdges[cursor[bucketOf(lo)]++];
+					h.key = (static_cast<std::uint64_t>(lo) << 32) | hi;
+					h.opposite = tri[(k + 2) % 3];
+				}
+			}
+		}
+	});
+
+	// Sort every bucket on the key, keeping triangle order among equal keys,
+	// and turn every run of equal keys into one edge.
+	m_BucketEdges.resize(bucketCount);
+	m_BucketBoundary.assign(bucketCount, 0);
+	m_BucketNonManifold.assign(bucketCount, 0);
+	parallelRange(pool, bucketCount, 1, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t b = begin; b < end; ++b)
+		{
+			HalfEdge* first = m_HalfEdges.data() + m_BucketOffsets[b];
+			HalfEdge* last = m_HalfEdges.data() + m_BucketOffsets[b + 1];
+			std::stable_sort(first, last, [](const HalfEdge& x, const HalfEdge& y) { return x.key < y.key; });
+			std::vector<MeshEdge>& edges = m_BucketEdges[b];
+			edges.clear();
+			for (HalfEdge* h = first; h != last;)
+			{
+				HalfEdge* next = h + 1;
+				while (next != last && next->key == h->key)
+					++next;
+				MeshEdge e;
+				e.v0 = static_cast<std::uint32_t>(h->key >> 32);
+				e.v1 = static_cast<std::uint32_t>(h->key);
+				e.opposite[0] = h->opposite;
+				e.opposite[1] = next - h > 1 ? h[1].opposite : NoVertex;
+				if (next - h == 1)
+					m_BucketBoundary[b]++;
+				else if (next - h > 2)
+					m_BucketNonManifold[b]++;
+				edges.push_back(e);
+				h = next;
+			}
+		}
+	});
+
+	size_t edgeCount = 0;
+	for (std::uint32_t b = 0; b < bucketCount; ++b)
+	{
+		edgeCount += m_BucketEdges[b].size();
+		m_BoundaryEdges += m_BucketBoundary[b];
+		m_NonManifoldEdges += m_BucketNonManifold[b];
+	}
+	m_Edges.reserve(edgeCount);
+	for (std::uint32_t b = 0; b < bucketCount; ++b)
+		m_Edges.insert(m_Edges.end(), m_BucketEdges[b].begin(), m_BucketEdges[b].end());
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+
+// An undirected edge, v0 < v1, and the vertex opposite it in each of the
+// first two triangles that share it. On a boundary edge opposite[1] is
+// MeshAdjacency::NoVertex.
+struct MeshEdge
+{
+	std::uint32_t v0 = 0;
+	std::uint32_t v1 = 0;
+	std::uint32_t opposite[2] = { 0, 0 };
+};
+
+// Edges of a triangle mesh and the triangle pairs across them, found by
+// hashing the half edges on their sorted vertex pair. The half edges are
+// bucketed by their lower vertex: every chunk of triangles counts and then
+// scatters its half edges into the buckets, and every bucket is sorted and
+// grouped on its own, so all three passes run on the pool without locks.
+// Buckets cover ascending vertex ranges and keep triangle order inside a
+// key, so edges() comes out sorted by (v0, v1) whatever the thread count.
+class MeshAdjacency
+{
+public:
+	static const std::uint32_t NoVertex = 0xffffffffu;
+
+	MeshAdjacency() = default;
+	MeshAdjacency(const MeshAdjacency& rhs) = delete;
+	MeshAdjacency& operator=(const MeshAdjacency& rhs) = delete;
+
+	// Triangles with a repeated vertex are skipped.
+	void build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount, ThreadPool* pool);
+	void build(const std::vector<std::uint32_t>& indices, std::uint32_t vertexCount, ThreadPool* pool)
+	{
+		build(indices.data(), static_cast<std::uint32_t>(indices.size() / 3), vertexCount, pool);
+	}
+
+	const std::vector<MeshEdge>& edges()const { return m_Edges; }
+	// Edges with one triangle, and with more than two; the latter only pair
+	// up their first two triangles.
+	std::uint32_t boundaryEdgeCount()const { return m_BoundaryEdges; }
+	std::uint32_t nonManifoldEdgeCount()const { return m_NonManifoldEdges; }
+	std::uint32_t degenerateTriangleCount()const { return m_DegenerateTriangles; }
+
+private:
+	struct HalfEdge
+	{
+		// (lower vertex << 32) | upper vertex
+		std::uint64_t key;
+		std::uint32_t opposite;
+	};
+
+private:
+	std::vector<MeshEdge> m_Edges;
+	std::uint32_t m_BoundaryEdges = 0;
+	std::uint32_t m_NonManifoldEdges = 0;
+	std::uint32_t m_DegenerateTriangles = 0;
+
+	// Scratch kept between builds.
+	std::vector<HalfEdge> m_HalfEdges;
+	// Half edges of chunk c in bucket b, then the chunk's first slot in the bucket.
+	std::vector<std::uint32_t> m_ChunkCounts;
+	std::vector<std::uint32_t> m_ChunkDegenerate;
+	std::vector<std::uint32_t> m_BucketOffsets;
+	std::vector<std::vector<MeshEdge>> m_BucketEdges;
+	std::vector<std::uint32_t> m_BucketBoundary;
+	std::vector<std::uint32_t> m_BucketNonManifold;
+};
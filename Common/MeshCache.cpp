@@ -0,0 +1,272 @@
+#include "MeshCache.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include "ObjLoader.h"
+#include "VertexCache.h"
+
+namespace
+{
+	const char Magic[4] = { 'M', 'C', 'A', 'C' };
+	const std::uint32_t Version = 3;
+	const size_t BlobAlignment = 64;
+
+	inline size_t alignUp(size_t offset)
+	{
+		return (offset + BlobAlignment - 1) & ~(BlobAlignment - 1);
+	}
+
+	// Bytes per vertex of a format, 0 for one this build does not know.
+	inline std::uint32_t formatStride(std::uint32_t format)
+	{
+		switch (static_cast<MeshVertexFormat>(format))
+		{
+		case MeshVertexFormat::PosNormalTex:
+			return sizeof(ObjVertex);
+		}
+		return 0;
+	}
+
+	// Names are used as C strings, so the array has to hold the terminator.
+	inline bool terminated(const MeshCacheSubMesh& s)
+	{
+		return std::memchr(s.name, '\0', sizeof(s.name)) != nullptr;
+	}
+
+	inline std::uint64_t load64(const std::uint8_t* p)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline std::uint64_t rotl(std::uint64_t v, int r)
+	{
+		return (v << r) | (v >> (64 - r));
+	}
+
+	// Four independent multiply-rotate lanes over 32-byte blocks, in the
+	// manner of xxHash64, so hashing a large OBJ runs near memory speed.
+	// Not meant to be compatible with anything but itself.
+	std::uint64_t hashBytes(const std::uint8_t* p, size_t n)
+	{
+		const std::uint64_t P1 = 0x9e3779b185ebca87ull;
+		const std::uint64_t P2 = 0xc2b2ae3d27d4eb4full;
+		std::uint64_t lanes[4] = { P1 + P2, P2, 0, 0 - P1 };
+		const std::uint8_t* end = p + n;
+		for (; end - p >= 32; p += 32)
+		{
+			for (int k = 0; k < 4; ++k)
+				lanes[k] = rotl(lanes[k] + load64(p + 8 * k) * P2, 31) * P1;
+		}
+		std::uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + n;
+		for (; p != end; ++p)
+			h = rotl(h ^ (*p * P1), 11) * P2;
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P1;
+		h ^= h >> 32;
+		return h;
+	}
+
+	struct Bounds
+	{
+		float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void add(const std::uint8_t* vertex)
+		{
+			float p[3];
+			std::memcpy(p, vertex, sizeof(p));
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = std::min(lo[k], p[k]);
+				hi[k] = std::max(hi[k], p[k]);
+			}
+		}
+
+		// An empty box stays at the origin with no extent.
+		void store(float center[3], float extents[3])const
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const bool empty = lo[k] > hi[k];
+				center[k] = empty ? 0.0f : 0.5f * (lo[k] + hi[k]);
+				extents[k] = empty ? 0.0f : 0.5f * (hi[k] - lo[k]);
+			}
+		}
+	};
+}
+
+bool writeMeshCache(const std::string& fileName, const MeshCacheData& data)
+{
+	const std::uint32_t format = static_cast<std::uint32_t>(data.vertexFormat);
+	if (formatStride(format) == 0 || data.vertexStride != formatStride(format) || (data.indexSize != 2 && data.indexSize != 4))
+		return false;
+	const size_t vertexBytes = static_cast<size_t>(data.vertexStride) * data.vertexCount;
+	const size_t indexBytes = static_cast<size_t>(data.indexSize) * data.indexCount;
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.vertexFormat = static_cast<std::uint32_t>(data.vertexFormat);
+	header.vertexStride = data.vertexStride;
+	header.indexSize = data.indexSize;
+	header.vertexCount = data.vertexCount;
+	header.indexCount = data.indexCount;
+	header.subMeshCount = static_cast<std::uint32_t>(data.subMeshes.size());
+	header.sourceHash = data.sourceHash;
+	header.subMeshOffset = sizeof(MeshCacheHeader);
+	header.vertexOffset = alignUp(sizeof(MeshCacheHeader) + data.subMeshes.size() * sizeof(MeshCacheSubMesh));
+	header.indexOffset = alignUp(header.vertexOffset + vertexBytes);
+	header.fileSize = header.indexOffset + indexBytes;
+
+	const std::uint8_t* vertices = static_cast<const std::uint8_t*>(data.vertices);
+	Bounds all;
+	for (std::uint32_t v = 0; v < data.vertexCount; ++v)
+		all.add(vertices + static_cast<size_t>(v) * data.vertexStride);
+	all.store(header.center, header.extents);
+
+	std::vector<MeshCacheSubMesh> subMeshes = data.subMeshes;
+	for (MeshCacheSubMesh& s : subMeshes)
+	{
+		if (static_cast<std::uint64_t>(s.startIndexLocation) + s.indexCount > data.indexCount || !terminated(s))
+			return false;
+		Bounds bounds;
+		for (std::uint32_t i = 0; i < s.indexCount; ++i)
+		{
+			const size_t at = static_cast<size_t>(s.startIndexLocation) + i;
+			std::uint32_t index;
+			if (data.indexSize == 2)
+				index = static_cast<const std::uint16_t*>(data.indices)[at];
+			else
+				index = static_cast<const std::uint32_t*>(data.indices)[at];
+			const std::int64_t vertex = static_cast<std::int64_t>(index) + s.baseVertexLocation;
+			if (vertex < 0 || vertex >= data.vertexCount)
+				return false;
+			bounds.add(vertices + static_cast<size_t>(vertex) * data.vertexStride);
+		}
+		bounds.store(s.center, s.extents);
+	}
+
+	MappedFile file;
+	if (!file.openWrite(fileName, static_cast<size_t>(header.fileSize)))
+		return false;
+	std::uint8_t* out = file.data();
+	std::memset(out, 0, static_cast<size_t>(header.fileSize));
+	if (!subMeshes.empty())
+		std::memcpy(out + header.subMeshOffset, subMeshes.data(), subMeshes.size() * sizeof(MeshCacheSubMesh));
+	if (vertexBytes > 0)
+		std::memcpy(out + header.vertexOffset, vertices, vertexBytes);
+	if (indexBytes > 0)
+		std::memcpy(out + header.indexOffset, data.indices, indexBytes);
+	header.checksum = hashBytes(out + sizeof(MeshCacheHeader), static_cast<size_t>(header.fileSize) - sizeof(MeshCacheHeader));
+	// The header goes in last, so a file cut short by a crash never matches.
+	std::memcpy(out, &header, sizeof(header));
+	file.close(static_cast<size_t>(header.fileSize));
+	return true;
+}
+
+bool MeshCache::open(const std::string& fileName)
+{
+	close();
+	if (!m_File.openRead(fileName) || m_File.size() < sizeof(MeshCacheHeader))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&m_Header, m_File.data(), sizeof(m_Header));
+	const MeshCacheHeader& h = m_Header;
+	const std::uint64_t subMeshEnd = h.subMeshOffset + static_cast<std::uint64_t>(h.subMeshCount) * sizeof(MeshCacheSubMesh);
+	const std::uint64_t vertexEnd = h.vertexOffset + static_cast<std::uint64_t>(h.vertexStride) * h.vertexCount;
+	const std::uint64_t indexEnd = h.indexOffset + static_cast<std::uint64_t>(h.indexSize) * h.indexCount;
+	if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != Version || h.fileSize != m_File.size() ||
+		(h.indexSize != 2 && h.indexSize != 4) || formatStride(h.vertexFormat) == 0 || h.vertexStride != formatStride(h.vertexFormat) ||
+		h.subMeshOffset != sizeof(MeshCacheHeader) || h.vertexOffset % BlobAlignment != 0 || h.indexOffset % BlobAlignment != 0 ||
+		subMeshEnd > h.vertexOffset || vertexEnd > h.indexOffset || indexEnd > h.fileSize)
+	{
+		close();
+		return false;
+	}
+	m_SubMeshes = reinterpret_cast<const MeshCacheSubMesh*>(m_File.data() + h.subMeshOffset);
+	for (std::uint32_t s = 0; s < h.subMeshCount; ++s)
+	{
+		if (static_cast<std::uint64_t>(m_SubMeshes[s].startIndexLocation) + m_SubMeshes[s].indexCount > h.indexCount ||
+			!terminated(m_SubMeshes[s]))
+		{
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshCache::close()
+{
+	m_File.close();
+	m_Header = MeshCacheHeader();
+	m_SubMeshes = nullptr;
+}
+
+bool MeshCache::verify()const
+{
+	if (!isOpen())
+		return false;
+	const size_t bytes = static_cast<size_t>(m_Header.fileSize) - sizeof(MeshCacheHeader);
+	return hashBytes(m_File.data() + sizeof(MeshCacheHeader), bytes) == m_Header.checksum;
+}
+
+bool loadObjCached(const std::string& objFileName, const std::string& cacheFileName, const char* subMeshName,
+	MeshCache& cache, ThreadPool* pool, bool* rebuilt)
+{
+	if (rebuilt != nullptr)
+		*rebuilt = false;
+	MappedFile obj;
+	if (!obj.openRead(objFileName))
+		return false;
+	const char* text = reinterpret_cast<const char*>(obj.data());
+	const std::uint64_t sourceHash = hashBytes(obj.data(), obj.size());
+	if (cache.open(cacheFileName) && cache.header().sourceHash == sourceHash)
+		return true;
+
+	ObjMesh mesh;
+	if (!parseObj(text, obj.size(), mesh, pool))
+		return false;
+	obj.close();
+	std::vector<ObjVertex> vertices;
+	std::vector<std::uint32_t> indices;
+	buildObjIndexed(mesh, vertices, indices);
+	optimizeVertexCache(indices.data(), indices.size());
+
+	MeshCacheData data;
+	data.vertexFormat = MeshVertexFormat::PosNormalTex;
+	data.vertices = vertices.data();
+	data.vertexStride = sizeof(ObjVertex);
+	data.vertexCount = static_cast<std::uint32_t>(vertices.size());
+	data.indexCount = static_cast<std::uint32_t>(indices.size());
+	data.sourceHash = sourceHash;
+	std::vector<std::uint16_t> shortIndices;
+	if (vertices.size() <= 0x10000)
+	{
+		shortIndices.assign(indices.begin(), indices.end());
+		data.indices = shortIndices.data();
+		data.indexSize = sizeof(std::uint16_t);
+	}
+	else
+	{
+		data.indices = indices.data();
+		data.indexSize = sizeof(std::uint32_t);
+	}
+	MeshCacheSubMesh subMesh = {};
+	std::strncpy(subMesh.name, subMeshName, sizeof(subMesh.name) - 1);
+	subMesh.indexCount = data.indexCount;
+	subMesh.vertexCount = data.vertexCount;
+	data.subMeshes.push_back(subMesh);
+
+	cache.close();
+	if (!writeMeshCache(cacheFileName, data) || !cache.open(cacheFileName))
+		return false;
+	if (rebuilt != nullptr)
+		*rebuilt = true;
+	return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Meshes converted once into a file laid out like the GPU buffers, so a
+// launch maps it and hands the vertex and index blobs to createDefaultBuffer
+// as they are instead of parsing text again.
+//
+// Layout, little endian: a MeshCacheHeader, the sub-mesh table, then the
+// vertex and index blobs, each at a 64-byte aligned offset. Bounds are a
+// centre and extents, like DirectX::BoundingBox. The checksum covers every
+// byte after the header; open() checks the layout but leaves the checksum
+// to verify(), which has to read the whole file.
+
+enum class MeshVertexFormat : std::uint32_t
+{
+	// ObjVertex: float3 position, float3 normal, float2 texture coordinates.
+	PosNormalTex = 1,
+};
+
+struct MeshCacheHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t vertexFormat;
+	std::uint32_t vertexStride;
+	// Bytes per index, 2 or 4.
+	std::uint32_t indexSize;
+	std::uint32_t vertexCount;
+	std::uint32_t indexCount;
+	std::uint32_t subMeshCount;
+	float center[3];
+	float extents[3];
+	// Hash of the file the mesh was converted from.
+	std::uint64_t sourceHash;
+	std::uint64_t checksum;
+	std::uint64_t subMeshOffset;
+	std::uint64_t vertexOffset;
+	std::uint64_t indexOffset;
+	std::uint64_t fileSize;
+};
+
+// One entry of the draw-arg table, the fields of SubMeshGeo.
+struct MeshCacheSubMesh
+{
+	// NUL terminated.
+	char name[48];
+	std::uint32_t indexCount;
+	std::uint32_t vertexCount;
+	std::uint32_t startIndexLocation;
+	std::int32_t baseVertexLocation;
+	float center[3];
+	float extents[3];
+};
+
+// What writeMeshCache() stores. Positions are the first three floats of
+// every vertex; the writer derives all bounds from them.
+struct MeshCacheData
+{
+	MeshVertexFormat vertexFormat = MeshVertexFormat::PosNormalTex;
+	const void* vertices = nullptr;
+	std::uint32_t vertexStride = 0;
+	std::uint32_t vertexCount = 0;
+	const void* indices = nullptr;
+	std::uint32_t indexSize = 4;
+	std::uint32_t indexCount = 0;
+	// Only name and the counts and locations need to be filled in.
+	std::vector<MeshCacheSubMesh> subMeshes;
+	std::uint64_t sourceHash = 0;
+};
+
+// Fails, writing nothing, if the stride is not the format's, a sub-mesh name
+// is not terminated or a sub-mesh reaches past the indices or vertices.
+bool writeMeshCache(const std::string& fileName, const MeshCacheData& data);
+
+// A mesh cache file mapped for reading. The pointers stay valid until
+// close() or the next open().
+class MeshCache
+{
+public:
+	MeshCache() = default;
+	MeshCache(const MeshCache& rhs) = delete;
+	MeshCache& operator=(const MeshCache& rhs) = delete;
+
+	// Fails if the file is missing, of another version, holds a vertex
+	// format this build does not know or with another stride, has a sub-mesh
+	// name without its terminator, or its tables and blobs do not fit in it.
+	bool open(const std::string& fileName);
+	void close();
+	// Recompute the checksum.
+	bool verify()const;
+
+	bool isOpen()const { return m_File.isOpen(); }
+	const MeshCacheHeader& header()const { return m_Header; }
+	const MeshCacheSubMesh* subMeshes()const { return m_SubMeshes; }
+	std::uint32_t subMeshCount()const { return m_Header.subMeshCount; }
+	const void* vertices()const { return m_File.data() + m_Header.vertexOffset; }
+	size_t vertexByteSize()const { return static_cast<size_t>(m_Header.vertexStride) * m_Header.vertexCount; }
+	const void* indices()const { return m_File.data() + m_Header.indexOffset; }
+	size_t indexByteSize()const { return static_cast<size_t>(m_Header.indexSize) * m_Header.indexCount; }
+
+private:
+	MappedFile m_File;
+	MeshCacheHeader m_Header = {};
+	const MeshCacheSubMesh* m_SubMeshes = nullptr;
+};
+
+// Open the cache of an OBJ file, converting it first when the cache is
+// missing or was made from different contents. The OBJ is hashed on every
+// call, so an edited file is picked up whatever its timestamp. The mesh is
+// one sub-mesh named after subMeshName, built by buildObjIndexed, with its
+// triangles in vertex cache order and 16-bit indices when they fit.
+// rebuilt, when given, says whether it converted.
+bool loadObjCached(const std::string& objFileName, const std::string& cacheFileName, const char* subMeshName,
+	MeshCache& cache, ThreadPool* pool = nullptr, bool* rebuilt = nullptr);
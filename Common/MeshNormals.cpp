@@ -0,0 +1,294 @@
+#include "MeshNormals.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// Multiples of 8 so AVX2 blocks never straddle two jobs.
+	const std::uint32_t FaceGrain = 4096;
+	const std::uint32_t VertexGrain = 4096;
+
+	struct FacePass
+	{
+		const std::uint32_t* indices;
+		const float* x;
+		const float* y;
+		const float* z;
+		float* fx;
+		float* fy;
+		float* fz;
+		// Face ids to process, or null for the faces [begin, end) themselves.
+		const std::uint32_t* ids;
+	};
+
+	struct VertexPass
+	{
+		const std::uint32_t* offsets;
+		const std::uint32_t* faces;
+		const float* fx;
+		const float* fy;
+		const float* fz;
+		Vec3* normals;
+		const std::uint32_t* ids;
+	};
+
+	void faceNormalsScalar(const FacePass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			std::uint32_t f = p.ids != nullptr ? p.ids[i] : i;
+			std::uint32_t i0 = p.indices[3 * f + 0];
+			std::uint32_t i1 = p.indices[3 * f + 1];
+			std::uint32_t i2 = p.indices[3 * f + 2];
+			Vec3 p0(p.x[i0], p.y[i0], p.z[i0]);
+			Vec3 n = cross(Vec3(p.x[i1], p.y[i1], p.z[i1]) - p0, Vec3(p.x[i2], p.y[i2], p.z[i2]) - p0);
+			p.fx[f] = n.x;
+			p.fy[f] = n.y;
+			p.fz[f] = n.z;
+		}
+	}
+
+	// Sum in face order, so every kernel produces the same bits.
+	void vertexNormalsScalar(const VertexPass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			std::uint32_t v = p.ids != nullptr ? p.ids[i] : i;
+			Vec3 n;
+			for (std::uint32_t k = p.offsets[v]; k < p.offsets[v + 1]; ++k)
+			{
+				std::uint32_t f = p.faces[k];
+				n += Vec3(p.fx[f], p.fy[f], p.fz[f]);
+			}
+			p.normals[v] = normalizeOr(n, Vec3(0.0f, 1.0f, 0.0f));
+		}
+	}
+
+#if SIMD_X86
+	SIMD_TARGET_AVX2 inline __m256i blockIds(const std::uint32_t* ids, std::uint32_t i)
+	{
+		if (ids != nullptr)
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i));
+		return _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	}
+
+	SIMD_TARGET_AVX2 void faceNormalsAvx2(const FacePass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		const int* indices = reinterpret_cast<const int*>(p.indices);
+		const __m256i one = _mm256_set1_epi32(1);
+		std::uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256i f = blockIds(p.ids, i);
+			__m256i base = _mm256_add_epi32(_mm256_add_epi32(f, f), f);
+			__m256i i0 = _mm256_i32gather_epi32(indices, base, 4);
+			__m256i i1 = _mm256_i32gather_epi32(indices, _mm256_add_epi32(base, one), 4);
+			__m256i i2 = _mm256_i32gather_epi32(indices, _mm256_add_epi32(base, _mm256_add_epi32(one, one)), 4);
+			__m256 x0 = _mm256_i32gather_ps(p.x, i0, 4), y0 = _mm256_i32gather_ps(p.y, i0, 4), z0 = _mm256_i32gather_ps(p.z, i0, 4);
+			__m256 ax = _mm256_sub_ps(_mm256_i32gather_ps(p.x, i1, 4), x0);
+			__m256 ay = _mm256_sub_ps(_mm256_i32gather_ps(p.y, i1, 4), y0);
+			__m256 az = _mm256_sub_ps(_mm256_i32gather_ps(p.z, i1, 4), z0);
+			__m256 bx = _mm256_sub_ps(_mm256_i32gather_ps(p.x, i2, 4), x0);
+			__m256 by = _mm256_sub_ps(_mm256_i32gather_ps(p.y, i2, 4), y0);
+			__m256 bz = _mm256_sub_ps(_mm256_i32gather_ps(p.z, i2, 4), z0);
+			__m256 nx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+			__m256 ny = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+			if (p.ids == nullptr)
+			{
+				_mm256_storeu_ps(p.fx + i, nx);
+				_mm256_storeu_ps(p.fy + i, ny);
+				_mm256_storeu_ps(p.fz + i, nz);
+				continue;
+			}
+			// There is no scatter in AVX2.
+			alignas(32) float sx[8], sy[8], sz[8];
+			_mm256_store_ps(sx, nx);
+			_mm256_store_ps(sy, ny);
+			_mm256_store_ps(sz, nz);
+			for (int k = 0; k < 8; ++k)
+			{
+				std::uint32_t face = p.ids[i + k];
+				p.fx[face] = sx[k];
+				p.fy[face] = sy[k];
+				p.fz[face] = sz[k];
+			}
+		}
+		faceNormalsScalar(p, i, end);
+	}
+
+	// Eight vertices at a time; lanes whose vertex has fewer faces than the
+	// busiest one in the block are masked off in the gathers.
+	SIMD_TARGET_AVX2 void vertexNormalsAvx2(const VertexPass& p, std::uint32_t begin, std::uint32_t end)
+	{
+		const int* offsets = reinterpret_cast<const int*>(p.offsets);
+		const int* faces = reinterpret_cast<const int*>(p.faces);
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 tiny = _mm256_set1_ps(1e-12f);
+		std::uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256i v = blockIds(p.ids, i);
+			__m256i first = _mm256_i32gather_epi32(offsets, v, 4);
+			__m256i degree = _mm256_sub_epi32(_mm256_i32gather_epi32(offsets, _mm256_add_epi32(v, one), 4), first);
+			alignas(32) std::int32_t degrees[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(degrees), degree);
+			const std::int32_t maxDegree = *std::max_element(degrees, degrees + 8);
+
+			__m256 sx = zero, sy = zero, sz = zero;
+			for (std::int32_t k = 0; k < maxDegree; ++k)
+			{
+				__m256i kk = _mm256_set1_epi32(k);
+				__m256i active = _mm256_cmpgt_epi32(degree, kk);
+				__m256i f = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), faces, _mm256_add_epi32(first, kk), active, 4);
+				__m256 mask = _mm256_castsi256_ps(active);
+				sx = _mm256_add_ps(sx, _mm256_mask_i32gather_ps(zero, p.fx, f, mask, 4));
+				sy = _mm256_add_ps(sy, _mm256_mask_i32gather_ps(zero, p.fy, f, mask, 4));
+				sz = _mm256_add_ps(sz, _mm256_mask_i32gather_ps(zero, p.fz, f, mask, 4));
+			}
+			// Same arithmetic as normalizeOr.
+			__m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy)), _mm256_mul_ps(sz, sz)));
+			__m256 valid = _mm256_cmp_ps(len, tiny, _CMP_GT_OQ);
+			__m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), len);
+			alignas(32) float nx[8], ny[8], nz[8];
+			_mm256_store_ps(nx, _mm256_blendv_ps(zero, _mm256_mul_ps(sx, inv), valid));
+			_mm256_store_ps(ny, _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(sy, inv), valid));
+			_mm256_store_ps(nz, _mm256_blendv_ps(zero, _mm256_mul_ps(sz, inv), valid));
+			for (int k = 0; k < 8; ++k)
+				p.normals[p.ids != nullptr ? p.ids[i + k] : i + k] = Vec3(nx[k], ny[k], nz[k]);
+		}
+		vertexNormalsScalar(p, i, end);
+	}
+#endif
+
+	void faceNormals(const FacePass& p, SimdLevel level, std::uint32_t begin, std::uint32_t end)
+	{
+#if SIMD_X86
+		if (level == SimdLevel::AVX2)
+			return faceNormalsAvx2(p, begin, end);
+#endif
+		faceNormalsScalar(p, begin, end);
+	}
+
+	void vertexNormals(const VertexPass& p, SimdLevel level, std::uint32_t begin, std::uint32_t end)
+	{
+#if SIMD_X86
+		if (level == SimdLevel::AVX2)
+			return vertexNormalsAvx2(p, begin, end);
+#endif
+		vertexNormalsScalar(p, begin, end);
+	}
+}
+
+MeshNormals::MeshNormals()
+	: m_SimdLevel(detectSimdLevel())
+{
+}
+
+void MeshNormals::build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount)
+{
+	m_VertexCount = vertexCount;
+	m_Indices.assign(indices, indices + 3 * static_cast<size_t>(triangleCount));
+
+	// Counting sort of the face corners by vertex. Faces are visited in
+	// order, so each vertex lists its faces in increasing order.
+	m_FaceOffsets.assign(static_cast<size_t>(vertexCount) + 1, 0);
+	for (std::uint32_t v : m_Indices)
+	{
+		assert(v < vertexCount);
+		m_FaceOffsets[v + 1]++;
+	}
+	for (std::uint32_t v = 0; v < vertexCount; ++v)
+		m_FaceOffsets[v + 1] += m_FaceOffsets[v];
+	std::vector<std::uint32_t> cursor(m_FaceOffsets.begin(), m_FaceOffsets.end() - 1);
+	m_Faces.resize(m_Indices.size());
+	for (std::uint32_t f = 0; f < triangleCount; ++f)
+	{
+		for (int k = 0; k < 3; ++k)
+			m_Faces[cursor[m_Indices[3 * f + k]]++] = f;
+	}
+
+	m_FaceX.assign(triangleCount, 0.0f);
+	m_FaceY.assign(triangleCount, 0.0f);
+	m_FaceZ.assign(triangleCount, 0.0f);
+	m_Normals.assign(vertexCount, Vec3(0.0f, 1.0f, 0.0f));
+	m_Epoch = 0;
+	m_FaceStamps.assign(triangleCount, 0);
+	m_VertexStamps.assign(vertexCount, 0);
+	m_DirtyFaces.clear();
+	m_DirtyVertices.clear();
+}
+
+void MeshNormals::compute(const float* x, const float* y, const float* z, ThreadPool* pool)
+{
+	const std::uint32_t faceCount = static_cast<std::uint32_t>(m_FaceX.size());
+	const SimdLevel level = m_SimdLevel;
+	FacePass fp = { m_Indices.data(), x, y, z, m_FaceX.data(), m_FaceY.data(), m_FaceZ.data(), nullptr };
+	parallelRange(pool, faceCount, FaceGrain, [&fp, level](std::uint32_t begin, std::uint32_t end, unsigned) {
+		faceNormals(fp, level, begin, end);
+	});
+	VertexPass vp = { m_FaceOffsets.data(), m_Faces.data(), m_FaceX.data(), m_FaceY.data(), m_FaceZ.data(), m_Normals.data(), nullptr };
+	parallelRange(pool, m_VertexCount, VertexGrain, [&vp, level](std::uint32_t begin, std::uint32_t end, unsigned) {
+		vertexNormals(vp, level, begin, end);
+	});
+	m_LastFaceCount = faceCount;
+	m_LastVertexCount = m_VertexCount;
+}
+
+void MeshNormals::nextEpoch()
+{
+	if (++m_Epoch == 0)
+	{
+		std::fill(m_FaceStamps.begin(), m_FaceStamps.end(), 0);
+		std::fill(m_VertexStamps.begin(), m_VertexStamps.end(), 0);
+		m_Epoch = 1;
+	}
+}
+
+void MeshNormals::computeDirty(const float* x, const float* y, const float* z,
+	const std::uint32_t* moved, std::uint32_t movedCount, ThreadPool* pool)
+{
+	// Collecting the lists is serial; it is linear in the size of the dirty
+	// region and much cheaper than the normals themselves.
+	nextEpoch();
+	m_DirtyFaces.clear();
+	for (std::uint32_t i = 0; i < movedCount; ++i)
+	{
+		std::uint32_t v = moved[i];
+		for (std::uint32_t k = m_FaceOffsets[v]; k < m_FaceOffsets[v + 1]; ++k)
+		{
+			std::uint32_t f = m_Faces[k];
+			if (m_FaceStamps[f] != m_Epoch)
+			{
+				m_FaceStamps[f] = m_Epoch;
+				m_DirtyFaces.push_back(f);
+			}
+		}
+	}
+	m_DirtyVertices.clear();
+	for (std::uint32_t f : m_DirtyFaces)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			std::uint32_t v = m_Indices[3 * f + k];
+			if (m_VertexStamps[v] != m_Epoch)
+			{
+				m_VertexStamps[v] = m_Epoch;
+				m_DirtyVertices.push_back(v);
+			}
+		}
+	}
+
+	const SimdLevel level = m_SimdLevel;
+	FacePass fp = { m_Indices.data(), x, y, z, m_FaceX.data(), m_FaceY.data(), m_FaceZ.data(), m_DirtyFaces.data() };
+	parallelRange(pool, static_cast<std::uint32_t>(m_DirtyFaces.size()), FaceGrain, [&fp, level](std::uint32_t begin, std::uint32_t end, unsigned) {
+		faceNormals(fp, level, begin, end);
+	});
+	VertexPass vp = { m_FaceOffsets.data(), m_Faces.data(), m_FaceX.data(), m_FaceY.data(), m_FaceZ.data(), m_Normals.data(), m_DirtyVertices.data() };
+	parallelRange(pool, static_cast<std::uint32_t>(m_DirtyVertices.size()), VertexGrain, [&vp, level](std::uint32_t begin, std::uint32_t end, unsigned) {
+		vertexNormals(vp, level, begin, end);
+	});
+	m_LastFaceCount = static_cast<std::uint32_t>(m_DirtyFaces.size());
+	m_LastVertexCount = static_cast<std::uint32_t>(m_DirtyVertices.size());
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Simd.h"
+#include "SimMath.h"
+#include "ThreadPool.h"
+
+// Area weighted vertex normals of a triangle mesh whose vertices move but
+// whose topology does not. build() stores the faces around every vertex in
+// compressed sparse row form, so a normal is a gather over its own faces:
+// face normals are written once per face, vertex normals once per vertex,
+// and no two threads ever write the same element, so there are no atomics.
+// Positions are read from separate x, y and z arrays, as in ParticleStore.
+class MeshNormals
+{
+public:
+	MeshNormals();
+	MeshNormals(const MeshNormals& rhs) = delete;
+	MeshNormals& operator=(const MeshNormals& rhs) = delete;
+
+	void build(const std::uint32_t* indices, std::uint32_t triangleCount, std::uint32_t vertexCount);
+	void build(const std::vector<std::uint32_t>& indices, std::uint32_t vertexCount)
+	{
+		build(indices.data(), static_cast<std::uint32_t>(indices.size() / 3), vertexCount);
+	}
+
+	// Recompute every normal.
+	void compute(const float* x, const float* y, const float* z, ThreadPool* pool);
+	// Recompute only what the moved vertices affect: their faces, and every
+	// vertex of those faces.
+	void computeDirty(const float* x, const float* y, const float* z,
+		const std::uint32_t* moved, std::uint32_t movedCount, ThreadPool* pool);
+
+	// Unit normals; a vertex whose faces have no area gets +y.
+	const std::vector<Vec3>& normals()const { return m_Normals; }
+
+	// Faces around vertex v are faces()[faceOffsets()[v], faceOffsets()[v + 1]),
+	// in increasing order.
+	const std::vector<std::uint32_t>& faceOffsets()const { return m_FaceOffsets; }
+	const std::vector<std::uint32_t>& faces()const { return m_Faces; }
+
+	// AVX2 gathers faces and vertices eight at a time; SSE4.1 has no gather,
+	// so it runs the scalar kernels.
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	// Work done by the last compute or computeDirty call.
+	std::uint32_t lastFaceCount()const { return m_LastFaceCount; }
+	std::uint32_t lastVertexCount()const { return m_LastVertexCount; }
+
+private:
+	void nextEpoch();
+
+private:
+	SimdLevel m_SimdLevel;
+	std::uint32_t m_VertexCount = 0;
+	std::vector<std::uint32_t> m_Indices;
+	std::vector<std::uint32_t> m_FaceOffsets;
+	std::vector<std::uint32_t> m_Faces;
+
+	// Unnormalized face normals, twice the face area long.
+	AlignedVector<float> m_FaceX, m_FaceY, m_FaceZ;
+	std::vector<Vec3> m_Normals;
+
+	// Dirty tracking: an element is in the current list when its stamp
+	// equals m_Epoch, so nothing has to be cleared between calls.
+	std::uint32_t m_Epoch = 0;
+	std::vector<std::uint32_t> m_FaceStamps;
+	std::vector<std::uint32_t> m_VertexStamps;
+	std::vector<std::uint32_t> m_DirtyFaces;
+	std::vector<std::uint32_t> m_DirtyVertices;
+
+	std::uint32_t m_LastFaceCount = 0;
+	std::uint32_t m_LastVertexCount = 0;
+};
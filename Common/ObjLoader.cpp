@@ -0,0 +1,382 @@
+#include "ObjLoader.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include "MappedFile.h"
+#include "VertexDedup.h"
+
+namespace
+{
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p != end && isBlank(*p))
+			++p;
+		return p;
+	}
+
+	// from_chars takes no leading '+', which some exporters write.
+	inline bool parseFloat(const char*& p, const char* end, float& value)
+	{
+		p = skipBlanks(p, end);
+		if (p != end && *p == '+')
+			++p;
+		std::from_chars_result r = std::from_chars(p, end, value);
+		if (r.ptr == p)
+			return false;
+		// Out of float range: tiny values flush to zero, and so do huge ones,
+		// which no mesh has.
+		if (r.ec == std::errc::result_out_of_range)
+			value = 0.0f;
+		p = r.ptr;
+		return true;
+	}
+
+	// Parse one index of a face corner. OBJ indices are 1-based, and negative
+	// ones count back from the last element read so far.
+	bool parseIndex(const char*& p, const char* end, size_t count, std::uint32_t& index)
+	{
+		long long value = 0;
+		std::from_chars_result r = std::from_chars(p, end, value);
+		if (r.ec != std::errc())
+			return false;
+		p = r.ptr;
+		long long resolved = value > 0 ? value - 1 : static_cast<long long>(count) + value;
+		if (value == 0 || resolved < 0 || resolved >= static_cast<long long>(count))
+			return false;
+		index = static_cast<std::uint32_t>(resolved);
+		return true;
+	}
+
+	// Parse a face corner, "7", "7/2", "7//3" or "7/2/3", into its position,
+	// texture coordinate and normal index; missing ones are NoIndex.
+	bool parseCorner(const char*& p, const char* end, const size_t counts[3], std::uint32_t corner[3])
+	{
+		corner[1] = ObjMesh::NoIndex;
+		corner[2] = ObjMesh::NoIndex;
+		if (!parseIndex(p, end, counts[0], corner[0]))
+			return false;
+		for (int k = 1; k < 3 && p != end && *p == '/'; ++k)
+		{
+			++p;
+			if (p != end && *p != '/' && !isBlank(*p) && !parseIndex(p, end, counts[k], corner[k]))
+				return false;
+		}
+		while (p != end && !isBlank(*p))
+			++p;
+		p = skipBlanks(p, end);
+		return true;
+	}
+
+	// Call fn(keyword, p, lineEnd) for every "v", "vt", "vn" and "f" line of
+	// [p, end), with keyword 'v', 't', 'n' or 'f' and p past it. Comments and
+	// everything else are skipped.
+	template<typename Fn>
+	bool forEachLine(const char* p, const char* end, Fn fn)
+	{
+		while (p != end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+			if (lineEnd == nullptr)
+				lineEnd = end;
+			p = skipBlanks(p, lineEnd);
+			const ptrdiff_t length = lineEnd - p;
+			char keyword = 0;
+			if (length > 1 && isBlank(p[1]) && (p[0] == 'v' || p[0] == 'f'))
+			{
+				keyword = p[0];
+				p += 2;
+			}
+			else if (length > 2 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && isBlank(p[2]))
+			{
+				keyword = p[1];
+				p += 3;
+			}
+			if (keyword != 0 && !fn(keyword, skipBlanks(p, lineEnd), lineEnd))
+				return false;
+			p = lineEnd == end ? end : lineEnd + 1;
+		}
+		return true;
+	}
+
+	// Newline aligned piece of the text. Every chunk is counted first; a
+	// prefix sum over the counts then gives each one its place in the final
+	// arrays, which it parses into directly. Negative face indices resolve
+	// against the bases plus the elements of the chunk before them, so the
+	// result does not depend on how the text was split. Counts and bases are
+	// of positions, texture coordinates and normals.
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		size_t counts[3] = {};
+		size_t indexCount = 0;
+		size_t bases[3] = {};
+		size_t indexBase = 0;
+		bool ok = true;
+	};
+
+	// Big enough that splitting and scheduling cost nothing next to parsing.
+	const size_t ChunkBytes = 1 << 20;
+
+	void countChunk(ObjChunk& chunk)
+	{
+		chunk.ok = forEachLine(chunk.begin, chunk.end, [&chunk](char keyword, const char* p, const char* lineEnd) {
+			if (keyword != 'f')
+			{
+				chunk.counts[keyword == 'v' ? 0 : (keyword == 't' ? 1 : 2)]++;
+				return true;
+			}
+			// Corners are the runs of non-blank characters.
+			size_t corners = 0;
+			bool blank = true;
+			for (; p != lineEnd; ++p)
+			{
+				const bool b = isBlank(*p);
+				corners += blank && !b;
+				blank = b;
+			}
+			chunk.indexCount += corners > 2 ? 3 * (corners - 2) : 0;
+			return true;
+		});
+	}
+
+	// With Append, elements are appended to the mesh, for text parsed in one
+	// piece without a count pass; otherwise they go to the slots the count
+	// pass gave the chunk. Both read the text the same way and give the same
+	// mesh. Appending starts the attribute indices at the first face after a
+	// "vt" or "vn" line, as no earlier corner can refer to one.
+	template<bool Append>
+	void parseChunk(ObjChunk& chunk, ObjMesh& mesh)
+	{
+		size_t counts[3] = { chunk.bases[0], chunk.bases[1], chunk.bases[2] };
+		std::vector<std::uint32_t>* lists[3] = { &mesh.indices, &mesh.texCoordIndices, &mesh.normalIndices };
+		// Attribute indices are only kept when the file has the attribute.
+		std::uint32_t* out[3] = {
+			mesh.indices.data() + chunk.indexBase,
+			mesh.texCoordIndices.empty() ? nullptr : mesh.texCoordIndices.data() + chunk.indexBase,
+			mesh.normalIndices.empty() ? nullptr : mesh.normalIndices.data() + chunk.indexBase };
+		chunk.ok = forEachLine(chunk.begin, chunk.end, [&](char keyword, const char* p, const char* lineEnd) {
+			if (keyword == 'v')
+			{
+				Vec3& v = Append ? mesh.positions.emplace_back() : mesh.positions[counts[0]];
+				counts[0]++;
+				return parseFloat(p, lineEnd, v.x) && parseFloat(p, lineEnd, v.y) && parseFloat(p, lineEnd, v.z);
+			}
+			if (keyword == 't')
+			{
+				if (Append)
+					mesh.texCoords.resize(mesh.texCoords.size() + 2);
+				// The second coordinate is optional and defaults to 0.
+				float* t = &mesh.texCoords[2 * counts[1]++];
+				if (!parseFloat(p, lineEnd, t[0]))
+					return false;
+				t[1] = 0.0f;
+				parseFloat(p, lineEnd, t[1]);
+				return true;
+			}
+			if (keyword == 'n')
+			{
+				Vec3& n = Append ? mesh.normals.emplace_back() : mesh.normals[counts[2]];
+				counts[2]++;
+				return parseFloat(p, lineEnd, n.x) && parseFloat(p, lineEnd, n.y) && parseFloat(p, lineEnd, n.z);
+			}
+			if (Append)
+			{
+				for (int k = 1; k < 3; ++k)
+				{
+					if (counts[k] > 0 && lists[k]->empty())
+						lists[k]->resize(mesh.indices.size(), ObjMesh::NoIndex);
+				}
+			}
+			// A triangle fan around the first corner.
+			std::uint32_t first[3] = {}, previous[3] = {}, current[3] = {};
+			for (int corner = 0; p != lineEnd; ++corner)
+			{
+				if (!parseCorner(p, lineEnd, counts, current))
+					return false;
+				if (corner == 0)
+					std::memcpy(first, current, sizeof(first));
+				else if (corner >= 2)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						if (Append && (k == 0 || counts[k] > 0))
+							lists[k]->insert(lists[k]->end(), { first[k], previous[k], current[k] });
+						else if (!Append && out[k] != nullptr)
+						{
+							out[k][0] = first[k];
+							out[k][1] = previous[k];
+							out[k][2] = current[k];
+							out[k] += 3;
+						}
+					}
+				}
+				std::memcpy(previous, current, sizeof(previous));
+			}
+			return true;
+		});
+	}
+}
+
+bool loadObj(const std::string& fileName, ObjMesh& mesh, ThreadPool* pool)
+{
+	MappedFile file;
+	if (!file.openRead(fileName))
+	{
+		mesh.clear();
+		return false;
+	}
+	return parseObj(reinterpret_cast<const char*>(file.data()), file.size(), mesh, pool);
+}
+
+bool parseObj(const char* text, size_t length, ObjMesh& mesh, ThreadPool* pool)
+{
+	std::vector<ObjChunk> chunks;
+	const char* const end = text + length;
+	for (const char* p = text; p != end;)
+	{
+		ObjChunk chunk;
+		chunk.begin = p;
+		chunk.end = static_cast<size_t>(end - p) > ChunkBytes ? p + ChunkBytes : end;
+		const char* newline = static_cast<const char*>(std::memchr(chunk.end, '\n', static_cast<size_t>(end - chunk.end)));
+		chunk.end = newline != nullptr ? newline + 1 : end;
+		chunks.push_back(chunk);
+		p = chunk.end;
+	}
+	const std::uint32_t chunkCount = static_cast<std::uint32_t>(chunks.size());
+	mesh.clear();
+
+	if (pool == nullptr || pool->threadCount() == 1 || chunkCount <= 1)
+	{
+		// One thread gains nothing from the count pass, which costs about half
+		// a parse, so read the text in a single appending pass.
+		ObjChunk all;
+		all.begin = text;
+		all.end = end;
+		parseChunk<true>(all, mesh);
+		if (!all.ok)
+		{
+			mesh.clear();
+			return false;
+		}
+		// The counted parse sizes the attribute indices from the totals, so
+		// a "vt" or "vn" after the last face still gets them, all NoIndex.
+		if (!mesh.texCoords.empty())
+			mesh.texCoordIndices.resize(mesh.indices.size(), ObjMesh::NoIndex);
+		if (!mesh.normals.empty())
+			mesh.normalIndices.resize(mesh.indices.size(), ObjMesh::NoIndex);
+		return true;
+	}
+
+	pool->parallelFor(chunkCount, 1, [&chunks](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+			countChunk(chunks[c]);
+	});
+	size_t counts[3] = {}, indexCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			chunk.bases[k] = counts[k];
+			counts[k] += chunk.counts[k];
+		}
+		chunk.indexBase = indexCount;
+		indexCount += chunk.indexCount;
+	}
+	mesh.positions.resize(counts[0]);
+	mesh.texCoords.resize(2 * counts[1]);
+	mesh.normals.resize(counts[2]);
+	mesh.indices.resize(indexCount);
+	mesh.texCoordIndices.resize(counts[1] > 0 ? indexCount : 0);
+	mesh.normalIndices.resize(counts[2] > 0 ? indexCount : 0);
+
+	pool->parallelFor(chunkCount, 1, [&chunks, &mesh](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t c = begin; c < end; ++c)
+			parseChunk<false>(chunks[c], mesh);
+	});
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (!chunk.ok)
+		{
+			mesh.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void buildObjVertices(const ObjMesh& mesh, std::vector<ObjVertex>& vertices)
+{
+	std::vector<Vec3> normals(mesh.positions.size());
+	// The cross product is twice the area, which weights each face normal.
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		const Vec3& p0 = mesh.positions[mesh.indices[t]];
+		Vec3 n = cross(mesh.positions[mesh.indices[t + 1]] - p0, mesh.positions[mesh.indices[t + 2]] - p0);
+		for (int k = 0; k < 3; ++k)
+			normals[mesh.indices[t + k]] += n;
+	}
+	vertices.resize(mesh.positions.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vec3& p = mesh.positions[i];
+		const Vec3 n = normalizeOr(normals[i], Vec3(0.0f, 1.0f, 0.0f));
+		vertices[i] = { { p.x, p.y, p.z }, { n.x, n.y, n.z }, { 0.0f, 0.0f } };
+	}
+}
+
+void buildObjIndexed(const ObjMesh& mesh, std::vector<ObjVertex>& vertices, std::vector<std::uint32_t>& indices,
+	float weldEpsilon)
+{
+	const std::uint32_t corners = static_cast<std::uint32_t>(mesh.indices.size());
+	std::vector<std::uint32_t> remap;
+	std::vector<Vec3> welded;
+	const bool weld = weldEpsilon > 0.0f;
+	if (weld)
+		weldPositions(mesh.positions.data(), static_cast<std::uint32_t>(mesh.positions.size()), weldEpsilon, remap, &welded);
+	const std::vector<Vec3>& positions = weld ? welded : mesh.positions;
+	auto positionOf = [&](std::uint32_t corner) { return weld ? remap[mesh.indices[corner]] : mesh.indices[corner]; };
+
+	const bool hasTexCoords = !mesh.texCoordIndices.empty();
+	const bool hasNormals = !mesh.normalIndices.empty();
+	std::vector<Vec3> faceNormals;
+	if (!hasNormals || std::find(mesh.normalIndices.begin(), mesh.normalIndices.end(), ObjMesh::NoIndex) != mesh.normalIndices.end())
+	{
+		faceNormals.resize(positions.size());
+		for (std::uint32_t t = 0; t + 2 < corners; t += 3)
+		{
+			const std::uint32_t a = positionOf(t), b = positionOf(t + 1), c = positionOf(t + 2);
+			const Vec3 n = cross(positions[b] - positions[a], positions[c] - positions[a]);
+			faceNormals[a] += n;
+			faceNormals[b] += n;
+			faceNormals[c] += n;
+		}
+	}
+
+	// A mesh with shared vertices has about as many as positions.
+	VertexDedupTable table(positions.size());
+	vertices.clear();
+	vertices.reserve(positions.size());
+	indices.resize(corners);
+	for (std::uint32_t i = 0; i < corners; ++i)
+	{
+		const std::uint32_t position = positionOf(i);
+		const std::uint32_t texCoord = hasTexCoords ? mesh.texCoordIndices[i] : ObjMesh::NoIndex;
+		const std::uint32_t normal = hasNormals ? mesh.normalIndices[i] : ObjMesh::NoIndex;
+		bool inserted;
+		indices[i] = table.insert(position, texCoord, normal, static_cast<std::uint32_t>(vertices.size()), inserted);
+		if (!inserted)
+			continue;
+		const Vec3& p = positions[position];
+		const Vec3 n = normal != ObjMesh::NoIndex ? normalizeOr(mesh.normals[normal], Vec3(0.0f, 1.0f, 0.0f)) :
+			normalizeOr(faceNormals[position], Vec3(0.0f, 1.0f, 0.0f));
+		const float u = texCoord != ObjMesh::NoIndex ? mesh.texCoords[2 * texCoord] : 0.0f;
+		const float v = texCoord != ObjMesh::NoIndex ? 1.0f - mesh.texCoords[2 * texCoord + 1] : 0.0f;
+		vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { u, v } });
+	}
+}
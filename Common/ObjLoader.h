@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SimMath.h"
+#include "ThreadPool.h"
+
+// Triangle mesh read from a Wavefront OBJ file: positions, texture
+// coordinates, normals and faces. Faces with more than three corners are
+// split into a triangle fan. indices holds the position index of every
+// corner; texCoordIndices and normalIndices run parallel to it, and are
+// only filled when the file has "vt" or "vn" lines. A corner without a
+// texture coordinate or normal holds NoIndex.
+struct ObjMesh
+{
+	static constexpr std::uint32_t NoIndex = 0xffffffffu;
+
+	std::vector<Vec3> positions;
+	// u, v pairs as written, with v pointing up.
+	std::vector<float> texCoords;
+	std::vector<Vec3> normals;
+	std::vector<std::uint32_t> indices;
+	std::vector<std::uint32_t> texCoordIndices;
+	std::vector<std::uint32_t> normalIndices;
+
+	std::uint32_t triangleCount()const { return static_cast<std::uint32_t>(indices.size() / 3); }
+	void clear()
+	{
+		positions.clear();
+		texCoords.clear();
+		normals.clear();
+		indices.clear();
+		texCoordIndices.clear();
+		normalIndices.clear();
+	}
+};
+
+// Position, normal and texture coordinates, laid out like the Vertex of the
+// samples, so an array of them is uploaded as it is.
+struct ObjVertex
+{
+	float pos[3];
+	float normal[3];
+	float texC[2];
+};
+
+// Returns false, with an empty mesh, if the file cannot be opened, a vertex
+// or normal has fewer than three coordinates, or a face refers to an
+// element that does not exist. The file is mapped into memory and parsed in
+// place, in chunks spread over the pool when there is one; the mesh is the
+// same either way.
+bool loadObj(const std::string& fileName, ObjMesh& mesh, ThreadPool* pool = nullptr);
+// The same for OBJ text already in memory; it need not end in a newline.
+bool parseObj(const char* text, size_t length, ObjMesh& mesh, ThreadPool* pool = nullptr);
+
+// One vertex per position, with the area weighted normal of the faces
+// around it and zero texture coordinates.
+void buildObjVertices(const ObjMesh& mesh, std::vector<ObjVertex>& vertices);
+// One vertex per distinct position, texture coordinate and normal index of
+// the corners, in the order they first appear, and an index per corner. A
+// positive weldEpsilon first merges positions closer than it, which joins
+// the duplicated positions along seams. Corners without a normal get the
+// area weighted normal of the faces around their position, and v is flipped
+// to the Direct3D convention.
+void buildObjIndexed(const ObjMesh& mesh, std::vector<ObjVertex>& vertices, std::vector<std::uint32_t>& indices,
+	float weldEpsilon = 0.0f);
@@ -0,0 +1,256 @@
+#include "ParticleStore.h"
+
+void ParticleStore::resize(size_t count)
+{
+	x.resize(count); y.resize(count); z.resize(count);
+	px.resize(count); py.resize(count); pz.resize(count);
+	vx.resize(count); vy.resize(count); vz.resize(count);
+	invMass.resize(count);
+}
+
+void ParticleStore::reserve(size_t count)
+{
+	x.reserve(count); y.reserve(count); z.reserve(count);
+	px.reserve(count); py.reserve(count); pz.reserve(count);
+	vx.reserve(count); vy.reserve(count); vz.reserve(count);
+	invMass.reserve(count);
+}
+
+namespace
+{
+	// Scalar kernels work on [begin, end) so the SIMD kernels can reuse them for the tail.
+
+	void eulerScalar(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const float dt = params.dt;
+		const Vec3 gdt = params.gravity * dt;
+		for (size_t i = begin; i < end; ++i)
+		{
+			p.px[i] = p.x[i];
+			p.py[i] = p.y[i];
+			p.pz[i] = p.z[i];
+			if (p.invMass[i] == 0.0f)
+			{
+				p.vx[i] = p.vy[i] = p.vz[i] = 0.0f;
+				continue;
+			}
+			p.vx[i] = (p.vx[i] + gdt.x) * params.damping;
+			p.vy[i] = (p.vy[i] + gdt.y) * params.damping;
+			p.vz[i] = (p.vz[i] + gdt.z) * params.damping;
+			p.x[i] += p.vx[i] * dt;
+			p.y[i] += p.vy[i] * dt;
+			p.z[i] += p.vz[i] * dt;
+		}
+	}
+
+	void verletScalar(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const Vec3 gdt2 = params.gravity * (params.dt * params.dt);
+		for (size_t i = begin; i < end; ++i)
+		{
+			float x = p.x[i], y = p.y[i], z = p.z[i];
+			if (p.invMass[i] != 0.0f)
+			{
+				p.x[i] = x + (x - p.px[i]) * params.damping + gdt2.x;
+				p.y[i] = y + (y - p.py[i]) * params.damping + gdt2.y;
+				p.z[i] = z + (z - p.pz[i]) * params.damping + gdt2.z;
+			}
+			p.px[i] = x;
+			p.py[i] = y;
+			p.pz[i] = z;
+		}
+	}
+
+	void velocitiesScalar(ParticleStore& p, float invDt, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			p.vx[i] = (p.x[i] - p.px[i]) * invDt;
+			p.vy[i] = (p.y[i] - p.py[i]) * invDt;
+			p.vz[i] = (p.z[i] - p.pz[i]) * invDt;
+		}
+	}
+
+#if SIMD_X86
+	SIMD_TARGET_SSE41 void eulerSSE41(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(3));
+		const __m128 dt = _mm_set1_ps(params.dt);
+		const __m128 damping = _mm_set1_ps(params.damping);
+		const __m128 gx = _mm_set1_ps(params.gravity.x * params.dt);
+		const __m128 gy = _mm_set1_ps(params.gravity.y * params.dt);
+		const __m128 gz = _mm_set1_ps(params.gravity.z * params.dt);
+		const __m128 zero = _mm_setzero_ps();
+		for (size_t i = begin; i < simdEnd; i += 4)
+		{
+			// All lanes with invMass > 0 are free; the rest are pinned.
+			__m128 free = _mm_cmpgt_ps(_mm_load_ps(&p.invMass[i]), zero);
+			__m128 x = _mm_load_ps(&p.x[i]);
+			__m128 y = _mm_load_ps(&p.y[i]);
+			__m128 z = _mm_load_ps(&p.z[i]);
+			_mm_store_ps(&p.px[i], x);
+			_mm_store_ps(&p.py[i], y);
+			_mm_store_ps(&p.pz[i], z);
+			__m128 vx = _mm_and_ps(free, _mm_mul_ps(_mm_add_ps(_mm_load_ps(&p.vx[i]), gx), damping));
+			__m128 vy = _mm_and_ps(free, _mm_mul_ps(_mm_add_ps(_mm_load_ps(&p.vy[i]), gy), damping));
+			__m128 vz = _mm_and_ps(free, _mm_mul_ps(_mm_add_ps(_mm_load_ps(&p.vz[i]), gz), damping));
+			_mm_store_ps(&p.vx[i], vx);
+			_mm_store_ps(&p.vy[i], vy);
+			_mm_store_ps(&p.vz[i], vz);
+			_mm_store_ps(&p.x[i], _mm_add_ps(x, _mm_mul_ps(vx, dt)));
+			_mm_store_ps(&p.y[i], _mm_add_ps(y, _mm_mul_ps(vy, dt)));
+			_mm_store_ps(&p.z[i], _mm_add_ps(z, _mm_mul_ps(vz, dt)));
+		}
+		eulerScalar(p, params, simdEnd, end);
+	}
+
+	SIMD_TARGET_AVX2 void eulerAVX2(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(7));
+		const __m256 dt = _mm256_set1_ps(params.dt);
+		const __m256 damping = _mm256_set1_ps(params.damping);
+		const __m256 gx = _mm256_set1_ps(params.gravity.x * params.dt);
+		const __m256 gy = _mm256_set1_ps(params.gravity.y * params.dt);
+		const __m256 gz = _mm256_set1_ps(params.gravity.z * params.dt);
+		const __m256 zero = _mm256_setzero_ps();
+		for (size_t i = begin; i < simdEnd; i += 8)
+		{
+			__m256 free = _mm256_cmp_ps(_mm256_load_ps(&p.invMass[i]), zero, _CMP_GT_OQ);
+			__m256 x = _mm256_load_ps(&p.x[i]);
+			__m256 y = _mm256_load_ps(&p.y[i]);
+			__m256 z = _mm256_load_ps(&p.z[i]);
+			_mm256_store_ps(&p.px[i], x);
+			_mm256_store_ps(&p.py[i], y);
+			_mm256_store_ps(&p.pz[i], z);
+			__m256 vx = _mm256_and_ps(free, _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.vx[i]), gx), damping));
+			__m256 vy = _mm256_and_ps(free, _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.vy[i]), gy), damping));
+			__m256 vz = _mm256_and_ps(free, _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.vz[i]), gz), damping));
+			_mm256_store_ps(&p.vx[i], vx);
+			_mm256_store_ps(&p.vy[i], vy);
+			_mm256_store_ps(&p.vz[i], vz);
+			_mm256_store_ps(&p.x[i], _mm256_add_ps(x, _mm256_mul_ps(vx, dt)));
+			_mm256_store_ps(&p.y[i], _mm256_add_ps(y, _mm256_mul_ps(vy, dt)));
+			_mm256_store_ps(&p.z[i], _mm256_add_ps(z, _mm256_mul_ps(vz, dt)));
+		}
+		eulerScalar(p, params, simdEnd, end);
+	}
+
+	SIMD_TARGET_SSE41 void verletSSE41(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(3));
+		const float dt2 = params.dt * params.dt;
+		const __m128 damping = _mm_set1_ps(params.damping);
+		const __m128 gx = _mm_set1_ps(params.gravity.x * dt2);
+		const __m128 gy = _mm_set1_ps(params.gravity.y * dt2);
+		const __m128 gz = _mm_set1_ps(params.gravity.z * dt2);
+		const __m128 zero = _mm_setzero_ps();
+		for (size_t i = begin; i < simdEnd; i += 4)
+		{
+			__m128 free = _mm_cmpgt_ps(_mm_load_ps(&p.invMass[i]), zero);
+			__m128 x = _mm_load_ps(&p.x[i]);
+			__m128 y = _mm_load_ps(&p.y[i]);
+			__m128 z = _mm_load_ps(&p.z[i]);
+			__m128 nx = _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(x, _mm_load_ps(&p.px[i])), damping)), gx);
+			__m128 ny = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(_mm_sub_ps(y, _mm_load_ps(&p.py[i])), damping)), gy);
+			__m128 nz = _mm_add_ps(_mm_add_ps(z, _mm_mul_ps(_mm_sub_ps(z, _mm_load_ps(&p.pz[i])), damping)), gz);
+			_mm_store_ps(&p.px[i], x);
+			_mm_store_ps(&p.py[i], y);
+			_mm_store_ps(&p.pz[i], z);
+			_mm_store_ps(&p.x[i], _mm_blendv_ps(x, nx, free));
+			_mm_store_ps(&p.y[i], _mm_blendv_ps(y, ny, free));
+			_mm_store_ps(&p.z[i], _mm_blendv_ps(z, nz, free));
+		}
+		verletScalar(p, params, simdEnd, end);
+	}
+
+	SIMD_TARGET_AVX2 void verletAVX2(ParticleStore& p, const IntegrateParams& params, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(7));
+		const float dt2 = params.dt * params.dt;
+		const __m256 damping = _mm256_set1_ps(params.damping);
+		const __m256 gx = _mm256_set1_ps(params.gravity.x * dt2);
+		const __m256 gy = _mm256_set1_ps(params.gravity.y * dt2);
+		const __m256 gz = _mm256_set1_ps(params.gravity.z * dt2);
+		const __m256 zero = _mm256_setzero_ps();
+		for (size_t i = begin; i < simdEnd; i += 8)
+		{
+			__m256 free = _mm256_cmp_ps(_mm256_load_ps(&p.invMass[i]), zero, _CMP_GT_OQ);
+			__m256 x = _mm256_load_ps(&p.x[i]);
+			__m256 y = _mm256_load_ps(&p.y[i]);
+			__m256 z = _mm256_load_ps(&p.z[i]);
+			__m256 nx = _mm256_add_ps(_mm256_add_ps(x, _mm256_mul_ps(_mm256_sub_ps(x, _mm256_load_ps(&p.px[i])), damping)), gx);
+			__m256 ny = _mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(_mm256_sub_ps(y, _mm256_load_ps(&p.py[i])), damping)), gy);
+			__m256 nz = _mm256_add_ps(_mm256_add_ps(z, _mm256_mul_ps(_mm256_sub_ps(z, _mm256_load_ps(&p.pz[i])), damping)), gz);
+			_mm256_store_ps(&p.px[i], x);
+			_mm256_store_ps(&p.py[i], y);
+			_mm256_store_ps(&p.pz[i], z);
+			_mm256_store_ps(&p.x[i], _mm256_blendv_ps(x, nx, free));
+			_mm256_store_ps(&p.y[i], _mm256_blendv_ps(y, ny, free));
+			_mm256_store_ps(&p.z[i], _mm256_blendv_ps(z, nz, free));
+		}
+		verletScalar(p, params, simdEnd, end);
+	}
+
+	SIMD_TARGET_SSE41 void velocitiesSSE41(ParticleStore& p, float invDt, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(3));
+		const __m128 s = _mm_set1_ps(invDt);
+		for (size_t i = begin; i < simdEnd; i += 4)
+		{
+			_mm_store_ps(&p.vx[i], _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&p.x[i]), _mm_load_ps(&p.px[i])), s));
+			_mm_store_ps(&p.vy[i], _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&p.y[i]), _mm_load_ps(&p.py[i])), s));
+			_mm_store_ps(&p.vz[i], _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&p.z[i]), _mm_load_ps(&p.pz[i])), s));
+		}
+		velocitiesScalar(p, invDt, simdEnd, end);
+	}
+
+	SIMD_TARGET_AVX2 void velocitiesAVX2(ParticleStore& p, float invDt, size_t begin, size_t end)
+	{
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(7));
+		const __m256 s = _mm256_set1_ps(invDt);
+		for (size_t i = begin; i < simdEnd; i += 8)
+		{
+			_mm256_store_ps(&p.vx[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(&p.x[i]), _mm256_load_ps(&p.px[i])), s));
+			_mm256_store_ps(&p.vy[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(&p.y[i]), _mm256_load_ps(&p.py[i])), s));
+			_mm256_store_ps(&p.vz[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(&p.z[i]), _mm256_load_ps(&p.pz[i])), s));
+		}
+		velocitiesScalar(p, invDt, simdEnd, end);
+	}
+#endif
+}
+
+void integrateSemiImplicitEuler(ParticleStore& p, const IntegrateParams& params, SimdLevel level,
+	size_t begin, size_t end)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2)
+		return eulerAVX2(p, params, begin, end);
+	if (level == SimdLevel::SSE41)
+		return eulerSSE41(p, params, begin, end);
+#endif
+	eulerScalar(p, params, begin, end);
+}
+
+void integrateVerlet(ParticleStore& p, const IntegrateParams& params, SimdLevel level,
+	size_t begin, size_t end)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2)
+		return verletAVX2(p, params, begin, end);
+	if (level == SimdLevel::SSE41)
+		return verletSSE41(p, params, begin, end);
+#endif
+	verletScalar(p, params, begin, end);
+}
+
+void deriveVelocities(ParticleStore& p, float dt, SimdLevel level, size_t begin, size_t end)
+{
+	const float invDt = 1.0f / dt;
+#if SIMD_X86
+	if (level == SimdLevel::AVX2)
+		return velocitiesAVX2(p, invDt, begin, end);
+	if (level == SimdLevel::SSE41)
+		return velocitiesSSE41(p, invDt, begin, end);
+#endif
+	velocitiesScalar(p, invDt, begin, end);
+}
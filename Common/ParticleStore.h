@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Simd.h"
+#include "SimMath.h"
+
+// Structure-of-arrays particle state. Each component lives in its own 32-byte
+// aligned array so the integrators can process 4 (SSE) or 8 (AVX2) particles
+// per instruction. A particle with invMass == 0 is pinned.
+struct ParticleStore
+{
+	AlignedVector<float> x, y, z;
+	AlignedVector<float> px, py, pz; // position at the start of the step
+	AlignedVector<float> vx, vy, vz;
+	AlignedVector<float> invMass;
+
+	void resize(size_t count);
+	void reserve(size_t count);
+	size_t size()const { return x.size(); }
+
+	Vec3 position(size_t i)const { return Vec3(x[i], y[i], z[i]); }
+	Vec3 prevPosition(size_t i)const { return Vec3(px[i], py[i], pz[i]); }
+	Vec3 velocity(size_t i)const { return Vec3(vx[i], vy[i], vz[i]); }
+	void setPosition(size_t i, const Vec3& p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+	void setPrevPosition(size_t i, const Vec3& p) { px[i] = p.x; py[i] = p.y; pz[i] = p.z; }
+	void setVelocity(size_t i, const Vec3& v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+};
+
+struct IntegrateParams
+{
+	float dt = 1.0f / 60.0f;
+	Vec3 gravity = { 0.0f, -9.8f, 0.0f };
+	// Velocity scale applied every step, 1 means no damping.
+	float damping = 1.0f;
+};
+
+// The integrators work on particles [begin, end) so callers can split the
+// store across threads; begin must be a multiple of 8 to keep SIMD loads aligned.
+
+// Semi-implicit Euler: v += g*dt, x += v*dt. The old position is saved in px/py/pz.
+// Pinned particles keep their position and get zero velocity.
+void integrateSemiImplicitEuler(ParticleStore& p, const IntegrateParams& params, SimdLevel level,
+	size_t begin, size_t end);
+// Position Verlet: x' = x + (x - prev)*damping + g*dt^2, prev = x. Velocities are not touched.
+void integrateVerlet(ParticleStore& p, const IntegrateParams& params, SimdLevel level,
+	size_t begin, size_t end);
+// v = (x - prev) / dt, used after a position based solve.
+void deriveVelocities(ParticleStore& p, float dt, SimdLevel level, size_t begin, size_t end);
+
+inline void integrateSemiImplicitEuler(ParticleStore& p, const IntegrateParams& params, SimdLevel level)
+{
+	integrateSemiImplicitEuler(p, params, level, 0, p.size());
+}
+inline void integrateVerlet(ParticleStore& p, const IntegrateParams& params, SimdLevel level)
+{
+	integrateVerlet(p, params, level, 0, p.size());
+}
+inline void deriveVelocities(ParticleStore& p, float dt, SimdLevel level)
+{
+	deriveVelocities(p, dt, level, 0, p.size());
+}
@@ -0,0 +1,426 @@
+#include "ShapeCollider.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	struct ContactParams
+	{
+		float thickness;
+		float friction;
+		float restitution;
+	};
+
+	// Put x on the surface offset along n, dist being its signed distance to
+	// the surface, then add the bounce and take off the friction.
+	inline Vec3 resolveContact(const Vec3& x, const Vec3& prev, const Vec3& n, float dist, const ContactParams& c)
+	{
+		Vec3 surface = x - n * dist;
+		Vec3 resolved = surface + n * c.thickness;
+		Vec3 motion = resolved - prev;
+		float approach = dot(x - prev, n);
+		float bounce = c.restitution * std::max(0.0f, -approach);
+		Vec3 slide = motion - n * dot(motion, n);
+		return resolved + n * bounce - slide * c.friction;
+	}
+
+	// Unit direction of d and its length, or straight up for a point at the center.
+	inline Vec3 direction(const Vec3& d, float& len)
+	{
+		len = std::sqrt(dot(d, d));
+		if (len > 1e-9f)
+		{
+			float inv = 1.0f / len;
+			return Vec3(d.x * inv, d.y * inv, d.z * inv);
+		}
+		return Vec3(0.0f, 1.0f, 0.0f);
+	}
+
+	inline bool inside(const Vec3& x, const Vec3& lo, const Vec3& hi, float margin)
+	{
+		return x.x >= lo.x - margin && x.x <= hi.x + margin && x.y >= lo.y - margin && x.y <= hi.y + margin &&
+			x.z >= lo.z - margin && x.z <= hi.z + margin;
+	}
+
+	// Signed distance from x to the box and the outward normal. Outside, the
+	// normal points from the closest point; inside, through the nearest face.
+	inline Vec3 boxNormal(const ColliderBox& b, const Vec3& x, float& dist)
+	{
+		Vec3 d = x - b.center;
+		Vec3 l(dot(d, b.axis[0]), dot(d, b.axis[1]), dot(d, b.axis[2]));
+		Vec3 q(std::min(std::max(l.x, -b.extents.x), b.extents.x),
+			std::min(std::max(l.y, -b.extents.y), b.extents.y),
+			std::min(std::max(l.z, -b.extents.z), b.extents.z));
+		Vec3 dl = l - q;
+		float dist2 = dot(dl, dl);
+		Vec3 nl;
+		if (dist2 > 0.0f)
+		{
+			dist = std::sqrt(dist2);
+			float inv = 1.0f / dist;
+			nl = Vec3(dl.x * inv, dl.y * inv, dl.z * inv);
+		}
+		else
+		{
+			float pen[3] = { b.extents.x - std::fabs(l.x), b.extents.y - std::fabs(l.y), b.extents.z - std::fabs(l.z) };
+			float side[3] = { l.x >= 0.0f ? 1.0f : -1.0f, l.y >= 0.0f ? 1.0f : -1.0f, l.z >= 0.0f ? 1.0f : -1.0f };
+			int axis = 0;
+			if (pen[1] < pen[axis])
+				axis = 1;
+			if (pen[2] < pen[axis])
+				axis = 2;
+			dist = -pen[axis];
+			nl = Vec3(axis == 0 ? side[0] : 0.0f, axis == 1 ? side[1] : 0.0f, axis == 2 ? side[2] : 0.0f);
+		}
+		return b.axis[0] * nl.x + b.axis[1] * nl.y + b.axis[2] * nl.z;
+	}
+
+	struct ShapeLists
+	{
+		const ColliderSphere* spheres;
+		const ColliderCapsule* capsules;
+		const ColliderBox* boxes;
+		size_t sphereCount;
+		size_t capsuleCount;
+		size_t boxCount;
+		const ShapeCollider::Bounds* sphereBounds;
+		const ShapeCollider::Bounds* capsuleBounds;
+		const ShapeCollider::Bounds* boxBounds;
+	};
+
+	void collideScalar(ParticleStore& p, const ShapeLists& s, const ContactParams& c, size_t begin, size_t end)
+	{
+		const ShapeCollider::Bounds* sphereBounds = s.sphereBounds;
+		const ShapeCollider::Bounds* capsuleBounds = s.capsuleBounds;
+		const ShapeCollider::Bounds* boxBounds = s.boxBounds;
+		const float t = c.thickness;
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (p.invMass[i] == 0.0f)
+				continue;
+			Vec3 x = p.position(i);
+			const Vec3 prev = p.prevPosition(i);
+			for (size_t k = 0; k < s.sphereCount; ++k)
+			{
+				if (!inside(x, sphereBounds[k].lo, sphereBounds[k].hi, t))
+					continue;
+				float len;
+				Vec3 n = direction(x - s.spheres[k].center, len);
+				float dist = len - s.spheres[k].radius;
+				if (dist < t)
+					x = resolveContact(x, prev, n, dist, c);
+			}
+			for (size_t k = 0; k < s.capsuleCount; ++k)
+			{
+				if (!inside(x, capsuleBounds[k].lo, capsuleBounds[k].hi, t))
+					continue;
+				const ColliderCapsule& cap = s.capsules[k];
+				Vec3 ab = cap.b - cap.a;
+				float len2 = dot(ab, ab);
+				float invLen2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+				float u = std::min(std::max(dot(x - cap.a, ab) * invLen2, 0.0f), 1.0f);
+				Vec3 q = cap.a + ab * u;
+				float len;
+				Vec3 n = direction(x - q, len);
+				float dist = len - cap.radius;
+				if (dist < t)
+					x = resolveContact(x, prev, n, dist, c);
+			}
+			for (size_t k = 0; k < s.boxCount; ++k)
+			{
+				if (!inside(x, boxBounds[k].lo, boxBounds[k].hi, t))
+					continue;
+				float dist;
+				Vec3 n = boxNormal(s.boxes[k], x, dist);
+				if (dist < t)
+					x = resolveContact(x, prev, n, dist, c);
+			}
+			p.setPosition(i, x);
+		}
+	}
+
+#if SIMD_X86
+	struct Lanes
+	{
+		__m256 x, y, z;
+		__m256 px, py, pz;
+	};
+
+	SIMD_TARGET_AVX2 inline __m256 dot8(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+	}
+
+	SIMD_TARGET_AVX2 inline float laneMin(__m256 v)
+	{
+		__m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+		m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+		return _mm_cvtss_f32(m);
+	}
+
+	SIMD_TARGET_AVX2 inline float laneMax(__m256 v)
+	{
+		__m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+		m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+		return _mm_cvtss_f32(m);
+	}
+
+	// resolveContact for the lanes in mask.
+	SIMD_TARGET_AVX2 inline void resolveAvx2(Lanes& l, __m256 mask, __m256 nx, __m256 ny, __m256 nz, __m256 dist,
+		const ContactParams& c)
+	{
+		const __m256 t = _mm256_set1_ps(c.thickness);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		__m256 rx = _mm256_add_ps(_mm256_sub_ps(l.x, _mm256_mul_ps(nx, dist)), _mm256_mul_ps(nx, t));
+		__m256 ry = _mm256_add_ps(_mm256_sub_ps(l.y, _mm256_mul_ps(ny, dist)), _mm256_mul_ps(ny, t));
+		__m256 rz = _mm256_add_ps(_mm256_sub_ps(l.z, _mm256_mul_ps(nz, dist)), _mm256_mul_ps(nz, t));
+		__m256 mx = _mm256_sub_ps(rx, l.px);
+		__m256 my = _mm256_sub_ps(ry, l.py);
+		__m256 mz = _mm256_sub_ps(rz, l.pz);
+		__m256 approach = dot8(_mm256_sub_ps(l.x, l.px), _mm256_sub_ps(l.y, l.py), _mm256_sub_ps(l.z, l.pz), nx, ny, nz);
+		__m256 bounce = _mm256_mul_ps(_mm256_set1_ps(c.restitution), _mm256_max_ps(zero, _mm256_xor_ps(approach, sign)));
+		__m256 mn = dot8(mx, my, mz, nx, ny, nz);
+		__m256 sx = _mm256_sub_ps(mx, _mm256_mul_ps(nx, mn));
+		__m256 sy = _mm256_sub_ps(my, _mm256_mul_ps(ny, mn));
+		__m256 sz = _mm256_sub_ps(mz, _mm256_mul_ps(nz, mn));
+		const __m256 f = _mm256_set1_ps(c.friction);
+		__m256 ox = _mm256_sub_ps(_mm256_add_ps(rx, _mm256_mul_ps(nx, bounce)), _mm256_mul_ps(sx, f));
+		__m256 oy = _mm256_sub_ps(_mm256_add_ps(ry, _mm256_mul_ps(ny, bounce)), _mm256_mul_ps(sy, f));
+		__m256 oz = _mm256_sub_ps(_mm256_add_ps(rz, _mm256_mul_ps(nz, bounce)), _mm256_mul_ps(sz, f));
+		l.x = _mm256_blendv_ps(l.x, ox, mask);
+		l.y = _mm256_blendv_ps(l.y, oy, mask);
+		l.z = _mm256_blendv_ps(l.z, oz, mask);
+	}
+
+	// direction() on eight lanes.
+	SIMD_TARGET_AVX2 inline __m256 direction8(__m256 dx, __m256 dy, __m256 dz, __m256& nx, __m256& ny, __m256& nz)
+	{
+		__m256 len = _mm256_sqrt_ps(dot8(dx, dy, dz, dx, dy, dz));
+		__m256 valid = _mm256_cmp_ps(len, _mm256_set1_ps(1e-9f), _CMP_GT_OQ);
+		__m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), len);
+		nx = _mm256_and_ps(valid, _mm256_mul_ps(dx, inv));
+		ny = _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(dy, inv), valid);
+		nz = _mm256_and_ps(valid, _mm256_mul_ps(dz, inv));
+		return len;
+	}
+
+	SIMD_TARGET_AVX2 void collideAvx2(ParticleStore& p, const ShapeLists& s, const ContactParams& c, size_t begin, size_t end)
+	{
+		const ShapeCollider::Bounds* sphereBounds = s.sphereBounds;
+		const ShapeCollider::Bounds* capsuleBounds = s.capsuleBounds;
+		const ShapeCollider::Bounds* boxBounds = s.boxBounds;
+		const size_t simdEnd = begin + ((end - begin) & ~size_t(7));
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 t = _mm256_set1_ps(c.thickness);
+		const float margin = c.thickness;
+		for (size_t i = begin; i < simdEnd; i += 8)
+		{
+			const __m256 free = _mm256_cmp_ps(_mm256_load_ps(&p.invMass[i]), zero, _CMP_GT_OQ);
+			if (_mm256_movemask_ps(free) == 0)
+				continue;
+			Lanes l;
+			l.x = _mm256_load_ps(&p.x[i]);
+			l.y = _mm256_load_ps(&p.y[i]);
+			l.z = _mm256_load_ps(&p.z[i]);
+			l.px = _mm256_load_ps(&p.px[i]);
+			l.py = _mm256_load_ps(&p.py[i]);
+			l.pz = _mm256_load_ps(&p.pz[i]);
+
+			// Bounding box of the block, refreshed after every contact.
+			Vec3 lo, hi;
+			auto blockBounds = [&]() {
+				lo = Vec3(laneMin(l.x) - margin, laneMin(l.y) - margin, laneMin(l.z) - margin);
+				hi = Vec3(laneMax(l.x) + margin, laneMax(l.y) + margin, laneMax(l.z) + margin);
+			};
+			auto overlaps = [&lo, &hi](const ShapeCollider::Bounds& b) {
+				return b.lo.x <= hi.x && b.hi.x >= lo.x && b.lo.y <= hi.y && b.hi.y >= lo.y && b.lo.z <= hi.z && b.hi.z >= lo.z;
+			};
+			blockBounds();
+
+			for (size_t k = 0; k < s.sphereCount; ++k)
+			{
+				if (!overlaps(sphereBounds[k]))
+					continue;
+				const ColliderSphere& sp = s.spheres[k];
+				__m256 nx, ny, nz;
+				__m256 len = direction8(_mm256_sub_ps(l.x, _mm256_set1_ps(sp.center.x)), _mm256_sub_ps(l.y, _mm256_set1_ps(sp.center.y)),
+					_mm256_sub_ps(l.z, _mm256_set1_ps(sp.center.z)), nx, ny, nz);
+				__m256 dist = _mm256_sub_ps(len, _mm256_set1_ps(sp.radius));
+				__m256 hit = _mm256_and_ps(free, _mm256_cmp_ps(dist, t, _CMP_LT_OQ));
+				if (_mm256_movemask_ps(hit) == 0)
+					continue;
+				resolveAvx2(l, hit, nx, ny, nz, dist, c);
+				blockBounds();
+			}
+			for (size_t k = 0; k < s.capsuleCount; ++k)
+			{
+				if (!overlaps(capsuleBounds[k]))
+					continue;
+				const ColliderCapsule& cap = s.capsules[k];
+				Vec3 ab = cap.b - cap.a;
+				float len2 = dot(ab, ab);
+				float invLen2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+				__m256 abx = _mm256_set1_ps(ab.x), aby = _mm256_set1_ps(ab.y), abz = _mm256_set1_ps(ab.z);
+				__m256 ax = _mm256_set1_ps(cap.a.x), ay = _mm256_set1_ps(cap.a.y), az = _mm256_set1_ps(cap.a.z);
+				__m256 u = _mm256_mul_ps(dot8(_mm256_sub_ps(l.x, ax), _mm256_sub_ps(l.y, ay), _mm256_sub_ps(l.z, az), abx, aby, abz),
+					_mm256_set1_ps(invLen2));
+				u = _mm256_min_ps(_mm256_max_ps(u, zero), one);
+				__m256 qx = _mm256_add_ps(ax, _mm256_mul_ps(abx, u));
+				__m256 qy = _mm256_add_ps(ay, _mm256_mul_ps(aby, u));
+				__m256 qz = _mm256_add_ps(az, _mm256_mul_ps(abz, u));
+				__m256 nx, ny, nz;
+				__m256 len = direction8(_mm256_sub_ps(l.x, qx), _mm256_sub_ps(l.y, qy), _mm256_sub_ps(l.z, qz), nx, ny, nz);
+				__m256 dist = _mm256_sub_ps(len, _mm256_set1_ps(cap.radius));
+				__m256 hit = _mm256_and_ps(free, _mm256_cmp_ps(dist, t, _CMP_LT_OQ));
+				if (_mm256_movemask_ps(hit) == 0)
+					continue;
+				resolveAvx2(l, hit, nx, ny, nz, dist, c);
+				blockBounds();
+			}
+			for (size_t k = 0; k < s.boxCount; ++k)
+			{
+				if (!overlaps(boxBounds[k]))
+					continue;
+				const ColliderBox& b = s.boxes[k];
+				__m256 dx = _mm256_sub_ps(l.x, _mm256_set1_ps(b.center.x));
+				__m256 dy = _mm256_sub_ps(l.y, _mm256_set1_ps(b.center.y));
+				__m256 dz = _mm256_sub_ps(l.z, _mm256_set1_ps(b.center.z));
+				__m256 local[3], delta[3], extent[3];
+				for (int a = 0; a < 3; ++a)
+				{
+					local[a] = dot8(dx, dy, dz, _mm256_set1_ps(b.axis[a].x), _mm256_set1_ps(b.axis[a].y), _mm256_set1_ps(b.axis[a].z));
+					const float e = a == 0 ? b.extents.x : a == 1 ? b.extents.y : b.extents.z;
+					extent[a] = _mm256_set1_ps(e);
+					__m256 q = _mm256_min_ps(_mm256_max_ps(local[a], _mm256_set1_ps(-e)), extent[a]);
+					delta[a] = _mm256_sub_ps(local[a], q);
+				}
+				__m256 dist2 = dot8(delta[0], delta[1], delta[2], delta[0], delta[1], delta[2]);
+				__m256 outside = _mm256_cmp_ps(dist2, zero, _CMP_GT_OQ);
+				// Outside: normal from the closest point.
+				__m256 outDist = _mm256_sqrt_ps(dist2);
+				__m256 inv = _mm256_div_ps(one, outDist);
+				// Inside: the face of least penetration, x before y before z on ties.
+				const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+				__m256 pen[3], side[3];
+				for (int a = 0; a < 3; ++a)
+				{
+					pen[a] = _mm256_sub_ps(extent[a], _mm256_and_ps(local[a], absMask));
+					side[a] = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), one, _mm256_cmp_ps(local[a], zero, _CMP_GE_OQ));
+				}
+				__m256 pickY = _mm256_cmp_ps(pen[1], pen[0], _CMP_LT_OQ);
+				__m256 best = _mm256_blendv_ps(pen[0], pen[1], pickY);
+				__m256 pickZ = _mm256_cmp_ps(pen[2], best, _CMP_LT_OQ);
+				best = _mm256_blendv_ps(best, pen[2], pickZ);
+				__m256 useX = _mm256_andnot_ps(_mm256_or_ps(pickY, pickZ), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+				__m256 useY = _mm256_andnot_ps(pickZ, pickY);
+				__m256 nl[3];
+				nl[0] = _mm256_blendv_ps(_mm256_and_ps(useX, side[0]), _mm256_mul_ps(delta[0], inv), outside);
+				nl[1] = _mm256_blendv_ps(_mm256_and_ps(useY, side[1]), _mm256_mul_ps(delta[1], inv), outside);
+				nl[2] = _mm256_blendv_ps(_mm256_and_ps(pickZ, side[2]), _mm256_mul_ps(delta[2], inv), outside);
+				__m256 dist = _mm256_blendv_ps(_mm256_xor_ps(best, _mm256_set1_ps(-0.0f)), outDist, outside);
+				__m256 hit = _mm256_and_ps(free, _mm256_cmp_ps(dist, t, _CMP_LT_OQ));
+				if (_mm256_movemask_ps(hit) == 0)
+					continue;
+				__m256 n[3];
+				const float* axisX = &b.axis[0].x;
+				const float* axisY = &b.axis[1].x;
+				const float* axisZ = &b.axis[2].x;
+				for (int a = 0; a < 3; ++a)
+				{
+					n[a] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axisX[a]), nl[0]), _mm256_mul_ps(_mm256_set1_ps(axisY[a]), nl[1])),
+						_mm256_mul_ps(_mm256_set1_ps(axisZ[a]), nl[2]));
+				}
+				resolveAvx2(l, hit, n[0], n[1], n[2], dist, c);
+				blockBounds();
+			}
+			_mm256_store_ps(&p.x[i], l.x);
+			_mm256_store_ps(&p.y[i], l.y);
+			_mm256_store_ps(&p.z[i], l.z);
+		}
+		collideScalar(p, s, c, simdEnd, end);
+	}
+#endif
+}
+
+ColliderBox ColliderBox::fromQuaternion(const Vec3& center, const Vec3& extents, float qx, float qy, float qz, float qw)
+{
+	ColliderBox box;
+	box.center = center;
+	box.extents = extents;
+	// Columns of the rotation matrix of the unit quaternion.
+	box.axis[0] = Vec3(1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy + qz * qw), 2.0f * (qx * qz - qy * qw));
+	box.axis[1] = Vec3(2.0f * (qx * qy - qz * qw), 1.0f - 2.0f * (qx * qx + qz * qz), 2.0f * (qy * qz + qx * qw));
+	box.axis[2] = Vec3(2.0f * (qx * qz + qy * qw), 2.0f * (qy * qz - qx * qw), 1.0f - 2.0f * (qx * qx + qy * qy));
+	return box;
+}
+
+ShapeCollider::ShapeCollider()
+	: m_SimdLevel(detectSimdLevel())
+{
+}
+
+void ShapeCollider::clear()
+{
+	m_Spheres.clear();
+	m_Capsules.clear();
+	m_Boxes.clear();
+	m_SphereBounds.clear();
+	m_CapsuleBounds.clear();
+	m_BoxBounds.clear();
+}
+
+void ShapeCollider::addSphere(const ColliderSphere& sphere)
+{
+	const Vec3 r(sphere.radius, sphere.radius, sphere.radius);
+	m_Spheres.push_back(sphere);
+	m_SphereBounds.push_back({ sphere.center - r, sphere.center + r });
+}
+
+void ShapeCollider::addCapsule(const ColliderCapsule& capsule)
+{
+	const Vec3 r(capsule.radius, capsule.radius, capsule.radius);
+	Vec3 lo(std::min(capsule.a.x, capsule.b.x), std::min(capsule.a.y, capsule.b.y), std::min(capsule.a.z, capsule.b.z));
+	Vec3 hi(std::max(capsule.a.x, capsule.b.x), std::max(capsule.a.y, capsule.b.y), std::max(capsule.a.z, capsule.b.z));
+	m_Capsules.push_back(capsule);
+	m_CapsuleBounds.push_back({ lo - r, hi + r });
+}
+
+void ShapeCollider::addBox(const ColliderBox& box)
+{
+	// Half size of the world box around the oriented one.
+	Vec3 half;
+	const float e[3] = { box.extents.x, box.extents.y, box.extents.z };
+	for (int a = 0; a < 3; ++a)
+		half += Vec3(std::fabs(box.axis[a].x), std::fabs(box.axis[a].y), std::fabs(box.axis[a].z)) * e[a];
+	m_Boxes.push_back(box);
+	m_BoxBounds.push_back({ box.center - half, box.center + half });
+}
+
+void ShapeCollider::collide(ParticleStore& p, float thickness, std::uint32_t begin, std::uint32_t end)const
+{
+	if (shapeCount() == 0)
+		return;
+	ShapeLists s;
+	s.spheres = m_Spheres.data();
+	s.capsules = m_Capsules.data();
+	s.boxes = m_Boxes.data();
+	s.sphereCount = m_Spheres.size();
+	s.capsuleCount = m_Capsules.size();
+	s.boxCount = m_Boxes.size();
+	s.sphereBounds = m_SphereBounds.data();
+	s.capsuleBounds = m_CapsuleBounds.data();
+	s.boxBounds = m_BoxBounds.data();
+	ContactParams c;
+	c.thickness = thickness;
+	c.friction = std::min(std::max(m_Friction, 0.0f), 1.0f);
+	c.restitution = std::min(std::max(m_Restitution, 0.0f), 1.0f);
+#if SIMD_X86
+	if (m_SimdLevel == SimdLevel::AVX2)
+		return collideAvx2(p, s, c, begin, end);
+#endif
+	collideScalar(p, s, c, begin, end);
+}
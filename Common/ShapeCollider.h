@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ParticleStore.h"
+#include "Simd.h"
+#include "SimMath.h"
+
+struct ColliderSphere
+{
+	Vec3 center;
+	float radius = 0.0f;
+};
+
+// The points within radius of the segment [a, b].
+struct ColliderCapsule
+{
+	Vec3 a;
+	Vec3 b;
+	float radius = 0.0f;
+};
+
+// A box of half size extents along three orthonormal axes. This is
+// DirectX::BoundingOrientedBox with the orientation quaternion turned into
+// axes; fromQuaternion() takes its Center, Extents and Orientation as they are.
+struct ColliderBox
+{
+	Vec3 center;
+	Vec3 extents;
+	Vec3 axis[3] = { Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f), Vec3(0.0f, 0.0f, 1.0f) };
+
+	static ColliderBox fromQuaternion(const Vec3& center, const Vec3& extents, float qx, float qy, float qz, float qw);
+};
+
+// Analytic collision proxies, the cheap stand-ins for characters and props.
+// collide() keeps particles at least thickness outside every sphere, capsule
+// and box, in that order, each shape seeing the particle as the ones before it
+// left it. A contact puts the particle on the surface offset, returns
+// restitution of its approach along the normal and removes friction of its
+// sliding motion since the previous position, as the triangle mesh collider
+// does. The AVX2 kernel takes 8 particles at a time and skips every shape whose
+// bounds miss the block's bounding box; it gives the same bits as the scalar
+// kernel.
+class ShapeCollider
+{
+public:
+	// World space bounds of a shape.
+	struct Bounds
+	{
+		Vec3 lo;
+		Vec3 hi;
+	};
+
+public:
+	ShapeCollider();
+
+	void clear();
+	void addSphere(const ColliderSphere& sphere);
+	void addCapsule(const ColliderCapsule& capsule);
+	void addBox(const ColliderBox& box);
+
+	const std::vector<ColliderSphere>& spheres()const { return m_Spheres; }
+	const std::vector<ColliderCapsule>& capsules()const { return m_Capsules; }
+	const std::vector<ColliderBox>& boxes()const { return m_Boxes; }
+	std::uint32_t shapeCount()const { return static_cast<std::uint32_t>(m_Spheres.size() + m_Capsules.size() + m_Boxes.size()); }
+
+	// Fraction of the sliding motion removed at a contact, in [0, 1].
+	void setFriction(float friction) { m_Friction = friction; }
+	float friction()const { return m_Friction; }
+	// Fraction of the approach along the normal turned into separation, in [0, 1].
+	void setRestitution(float restitution) { m_Restitution = restitution; }
+	float restitution()const { return m_Restitution; }
+
+	void setSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+	SimdLevel simdLevel()const { return m_SimdLevel; }
+
+	// Resolve particles [begin, end) against every shape; begin must be a
+	// multiple of 8. Pinned particles are left alone.
+	void collide(ParticleStore& p, float thickness, std::uint32_t begin, std::uint32_t end)const;
+
+private:
+	std::vector<ColliderSphere> m_Spheres;
+	std::vector<ColliderCapsule> m_Capsules;
+	std::vector<ColliderBox> m_Boxes;
+	std::vector<Bounds> m_SphereBounds;
+	std::vector<Bounds> m_CapsuleBounds;
+	std::vector<Bounds> m_BoxBounds;
+	float m_Friction = 0.3f;
+	float m_Restitution = 0.0f;
+	SimdLevel m_SimdLevel;
+};
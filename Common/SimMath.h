@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+
+// Small vector type for the simulation code. The simulation does not depend on
+// DirectXMath or any Windows header, so it can be stepped headless on any platform.
+struct Vec3
+{
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+
+	Vec3() = default;
+	Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+	Vec3& operator+=(const Vec3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vec3& operator-=(const Vec3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vec3& operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator-(const Vec3& a) { return Vec3(-a.x, -a.y, -a.z); }
+inline Vec3 operator*(const Vec3& a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, const Vec3& a) { return Vec3(a.x * s, a.y * s, a.z * s); }
+
+inline float dot(const Vec3& a, const Vec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b)
+{
+	return Vec3(
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x);
+}
+
+inline float lengthSq(const Vec3& a)
+{
+	return dot(a, a);
+}
+
+inline float length(const Vec3& a)
+{
+	return std::sqrt(dot(a, a));
+}
+
+// Return a unit vector, or the fallback when the input is degenerate.
+inline Vec3 normalizeOr(const Vec3& a, const Vec3& fallback)
+{
+	float len = length(a);
+	return len > 1e-12f ? a * (1.0f / len) : fallback;
+}
@@ -0,0 +1,52 @@
+#include "Simd.h"
+
+#if SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#if SIMD_X86 && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+	// AVX state must also be enabled by the OS in XCR0.
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	if (avx2)
+		return SimdLevel::AVX2;
+	if (sse41)
+		return SimdLevel::SSE41;
+	return SimdLevel::Scalar;
+#elif SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return SimdLevel::SSE41;
+	return SimdLevel::Scalar;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX2:
+		return "avx2";
+	case SimdLevel::SSE41:
+		return "sse4.1";
+	default:
+		return "scalar";
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// x86 SIMD support shared by the simulation code. Kernels for each instruction
+// set live side by side in the same translation unit and are picked at run time,
+// so the project needs no per-file /arch or -m flags.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+// GCC and Clang only emit intrinsics inside functions compiled for the target;
+// MSVC accepts them anywhere.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#endif
+
+enum class SimdLevel
+{
+	Scalar,
+	SSE41,
+	AVX2
+};
+
+// Highest level supported by both the CPU and the OS.
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// Allocator for SIMD arrays. 32 bytes covers one AVX register and keeps every
+// 8-float block inside a single cache line.
+template<typename T, std::size_t Alignment = 32>
+struct AlignedAllocator
+{
+	using value_type = T;
+	template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		std::size_t bytes = (n * sizeof(T) + Alignment - 1) & ~(Alignment - 1);
+#if defined(_MSC_VER)
+		void* p = _aligned_malloc(bytes, Alignment);
+#else
+		void* p = std::aligned_alloc(Alignment, bytes);
+#endif
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, std::size_t)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+
+	template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&)const { return true; }
+	template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&)const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
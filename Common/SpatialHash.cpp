@@ -0,0 +1,189 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	const std::uint32_t ParticleGrain = 2048;
+	const std::uint32_t CellGrain = 8192;
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+// Twice as many table entries as particles keeps hash collisions between
+// occupied cells rare without making the table sparse to scan.
+SpatialHash::SpatialHash(float spacing, std::uint32_t maxParticles)
+	: m_Spacing(spacing),
+	m_TableSize(std::max(1u, 2 * maxParticles)),
+	m_ParticleCell(maxParticles),
+	m_CellStart(new std::atomic<std::uint32_t>[m_TableSize + 1]),
+	m_CellEntries(maxParticles),
+	m_Neighbors(static_cast<size_t>(maxParticles) * MaxNeighbors),
+	m_NeighborCounts(maxParticles, 0)
+{
+}
+
+int SpatialHash::cellCoord(float v)const
+{
+	return static_cast<int>(std::floor(v / m_Spacing));
+}
+
+std::uint32_t SpatialHash::hashCell(int ix, int iy, int iz)const
+{
+	std::uint32_t h = (static_cast<std::uint32_t>(ix) * 92837111u) ^
+		(static_cast<std::uint32_t>(iy) * 689287499u) ^
+		(static_cast<std::uint32_t>(iz) * 283923481u);
+	return h % m_TableSize;
+}
+
+void SpatialHash::build(const ParticleStore& p, std::uint32_t count, ThreadPool* pool)
+{
+	assert(count <= m_ParticleCell.size());
+	auto start = std::chrono::steady_clock::now();
+	m_Count = count;
+	const std::uint32_t cells = m_TableSize + 1;
+
+	parallelRange(pool, cells, CellGrain, [this](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t h = begin; h < end; ++h)
+			m_CellStart[h].store(0, std::memory_order_relaxed);
+	});
+
+	// Count particles per cell.
+	parallelRange(pool, count, ParticleGrain, [this, &p](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			std::uint32_t h = hashCell(cellCoord(p.x[i]), cellCoord(p.y[i]), cellCoord(p.z[i]));
+			m_ParticleCell[i] = h;
+			m_CellStart[h].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// Inclusive prefix sum in blocks: sum each block, scan the block sums,
+	// then scan each block again from its offset.
+	const std::uint32_t blockCount = (cells + CellGrain - 1) / CellGrain;
+	std::vector<std::uint32_t> blockSums(blockCount + 1, 0);
+	parallelRange(pool, cells, CellGrain, [this, &blockSums](std::uint32_t begin, std::uint32_t end, unsigned) {
+		std::uint32_t sum = 0;
+		for (std::uint32_t h = begin; h < end; ++h)
+			sum += m_CellStart[h].load(std::memory_order_relaxed);
+		blockSums[begin / CellGrain + 1] = sum;
+	});
+	for (std::uint32_t b = 0; b < blockCount; ++b)
+		blockSums[b + 1] += blockSums[b];
+	parallelRange(pool, cells, CellGrain, [this, &blockSums](std::uint32_t begin, std::uint32_t end, unsigned) {
+		std::uint32_t sum = blockSums[begin / CellGrain];
+		for (std::uint32_t h = begin; h < end; ++h)
+		{
+			sum += m_CellStart[h].load(std::memory_order_relaxed);
+			m_CellStart[h].store(sum, std::memory_order_relaxed);
+		}
+	});
+
+	// Scatter. Every cell cursor counts down from its end, so once all
+	// particles are placed it holds the start of the cell.
+	parallelRange(pool, count, ParticleGrain, [this](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			std::uint32_t slot = m_CellStart[m_ParticleCell[i]].fetch_sub(1, std::memory_order_relaxed) - 1;
+			m_CellEntries[slot] = i;
+		}
+	});
+
+	// Put every cell in particle order so results are reproducible.
+	parallelRange(pool, m_TableSize, CellGrain, [this](std::uint32_t begin, std::uint32_t end, unsigned) {
+		for (std::uint32_t h = begin; h < end; ++h)
+		{
+			std::uint32_t first = m_CellStart[h].load(std::memory_order_relaxed);
+			std::uint32_t last = m_CellStart[h + 1].load(std::memory_order_relaxed);
+			if (last - first > 1)
+				std::sort(m_CellEntries.begin() + first, m_CellEntries.begin() + last);
+		}
+	});
+	m_BuildSeconds = secondsSince(start);
+}
+
+void SpatialHash::queryAll(const ParticleStore& p, float maxDist, ThreadPool* pool, const Vec3* restPositions)
+{
+	assert(maxDist <= m_Spacing);
+	auto start = std::chrono::steady_clock::now();
+	const float maxDist2 = maxDist * maxDist;
+	const unsigned threads = pool != nullptr ? pool->threadCount() : 1;
+	std::vector<std::uint64_t> found(threads, 0);
+
+	parallelRange(pool, m_Count, ParticleGrain, [this, &p, maxDist2, restPositions, &found](std::uint32_t begin, std::uint32_t end, unsigned thread) {
+		std::uint64_t total = 0;
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			const float x = p.x[i], y = p.y[i], z = p.z[i];
+			const int cx = cellCoord(x), cy = cellCoord(y), cz = cellCoord(z);
+			std::uint32_t* out = &m_Neighbors[static_cast<size_t>(i) * MaxNeighbors];
+			// Squared distance of every kept neighbour; once the list is full
+			// a closer one replaces the farthest.
+			float dist2[MaxNeighbors];
+			std::uint32_t n = 0;
+			std::uint32_t farthest = 0;
+			// Two of the 27 cells may hash to the same entry; scan it only once.
+			std::uint32_t visited[27];
+			std::uint32_t visitedCount = 0;
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						std::uint32_t h = hashCell(cx + dx, cy + dy, cz + dz);
+						if (std::find(visited, visited + visitedCount, h) != visited + visitedCount)
+							continue;
+						visited[visitedCount++] = h;
+						std::uint32_t first = m_CellStart[h].load(std::memory_order_relaxed);
+						std::uint32_t last = m_CellStart[h + 1].load(std::memory_order_relaxed);
+						for (std::uint32_t e = first; e < last; ++e)
+						{
+							std::uint32_t j = m_CellEntries[e];
+							if (j == i)
+								continue;
+							float ex = p.x[j] - x, ey = p.y[j] - y, ez = p.z[j] - z;
+							float d2 = ex * ex + ey * ey + ez * ez;
+							if (d2 >= maxDist2)
+								continue;
+							if (restPositions != nullptr && lengthSq(restPositions[i] - restPositions[j]) <= d2)
+								continue;
+							if (n < MaxNeighbors)
+							{
+								out[n] = j;
+								dist2[n] = d2;
+								if (n == 0 || d2 > dist2[farthest])
+									farthest = n;
+								++n;
+								continue;
+							}
+							if (d2 >= dist2[farthest])
+								continue;
+							out[farthest] = j;
+							dist2[farthest] = d2;
+							for (std::uint32_t k = 0; k < MaxNeighbors; ++k)
+							{
+								if (dist2[k] > dist2[farthest])
+									farthest = k;
+							}
+						}
+					}
+				}
+			}
+			m_NeighborCounts[i] = n;
+			total += n;
+		}
+		found[thread] += total;
+	});
+
+	std::uint64_t total = 0;
+	for (std::uint64_t f : found)
+		total += f;
+	m_AverageNeighbors = m_Count > 0 ? static_cast<double>(total) / m_Count : 0.0;
+	m_QuerySeconds = secondsSince(start);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ParticleStore.h"
+#include "ThreadPool.h"
+
+// Uniform grid hashed into a dense table, for particle-particle proximity.
+// build() bins the particles with a parallel counting sort: cell counts are
+// bumped with atomic increments and particles are scattered with atomic
+// cursors, so insertion never takes a lock. Each cell is sorted afterwards so
+// the neighbour lists do not depend on thread timing.
+class SpatialHash
+{
+public:
+	// Up to this many neighbours are kept per particle, the closest ones.
+	static const std::uint32_t MaxNeighbors = 16;
+
+	SpatialHash(float spacing, std::uint32_t maxParticles);
+	SpatialHash(const SpatialHash& rhs) = delete;
+	SpatialHash& operator=(const SpatialHash& rhs) = delete;
+
+	float spacing()const { return m_Spacing; }
+	void setSpacing(float spacing) { m_Spacing = spacing; }
+
+	// Bin the current positions of the first count particles of p.
+	void build(const ParticleStore& p, std::uint32_t count, ThreadPool* pool);
+	// Find, for every binned particle, the particles closer than maxDist.
+	// maxDist must not exceed spacing(). With restPositions, particles that
+	// are no closer now than at rest are left out before the closest are
+	// kept, so the grid neighbours around a particle do not crowd out the
+	// ones it actually touches.
+	void queryAll(const ParticleStore& p, float maxDist, ThreadPool* pool, const Vec3* restPositions = nullptr);
+
+	std::uint32_t neighborCount(std::uint32_t i)const { return m_NeighborCounts[i]; }
+	const std::uint32_t* neighbors(std::uint32_t i)const { return &m_Neighbors[static_cast<size_t>(i) * MaxNeighbors]; }
+
+	double lastBuildSeconds()const { return m_BuildSeconds; }
+	double lastQuerySeconds()const { return m_QuerySeconds; }
+	// Mean neighbours per particle found by the last queryAll.
+	double averageNeighbors()const { return m_AverageNeighbors; }
+
+private:
+	std::uint32_t hashCell(int ix, int iy, int iz)const;
+	int cellCoord(float v)const;
+
+private:
+	float m_Spacing;
+	std::uint32_t m_Count = 0;
+	std::uint32_t m_TableSize;
+
+	std::vector<std::uint32_t> m_ParticleCell;
+	// Count, then start offset, of every table entry; one extra for the end.
+	std::unique_ptr<std::atomic<std::uint32_t>[]> m_CellStart;
+	std::vector<std::uint32_t> m_CellEntries;
+
+	std::vector<std::uint32_t> m_Neighbors;
+	std::vector<std::uint32_t> m_NeighborCounts;
+
+	double m_BuildSeconds = 0.0;
+	double m_QuerySeconds = 0.0;
+	double m_AverageNeighbors = 0.0;
+};
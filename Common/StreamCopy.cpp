@@ -0,0 +1,83 @@
+#include "StreamCopy.h"
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+#if SIMD_X86
+	// Bytes to copy normally until dst is aligned to alignment.
+	inline size_t headBytes(const void* dst, size_t alignment, size_t bytes)
+	{
+		size_t misalign = reinterpret_cast<std::uintptr_t>(dst) & (alignment - 1);
+		size_t head = misalign == 0 ? 0 : alignment - misalign;
+		return head < bytes ? head : bytes;
+	}
+
+	SIMD_TARGET_SSE41 void streamCopySse(char* dst, const char* src, size_t bytes)
+	{
+		size_t head = headBytes(dst, 16, bytes);
+		std::memcpy(dst, src, head);
+		dst += head;
+		src += head;
+		bytes -= head;
+		// One 64-byte line per iteration.
+		for (; bytes >= 64; bytes -= 64, dst += 64, src += 64)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 0));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 0), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+		}
+		for (; bytes >= 16; bytes -= 16, dst += 16, src += 16)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+		std::memcpy(dst, src, bytes);
+		_mm_sfence();
+	}
+
+	SIMD_TARGET_AVX2 void streamCopyAvx2(char* dst, const char* src, size_t bytes)
+	{
+		size_t head = headBytes(dst, 32, bytes);
+		std::memcpy(dst, src, head);
+		dst += head;
+		src += head;
+		bytes -= head;
+		// Two 64-byte lines per iteration.
+		for (; bytes >= 128; bytes -= 128, dst += 128, src += 128)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 0));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+			__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 0), a);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+		}
+		for (; bytes >= 32; bytes -= 32, dst += 32, src += 32)
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+		std::memcpy(dst, src, bytes);
+		_mm_sfence();
+	}
+#endif
+}
+
+void streamCopy(void* dst, const void* src, size_t bytes, SimdLevel level)
+{
+#if SIMD_X86
+	if (level == SimdLevel::AVX2)
+		return streamCopyAvx2(static_cast<char*>(dst), static_cast<const char*>(src), bytes);
+	if (level == SimdLevel::SSE41)
+		return streamCopySse(static_cast<char*>(dst), static_cast<const char*>(src), bytes);
+#endif
+	std::memcpy(dst, src, bytes);
+}
+
+void streamCopy(void* dst, const void* src, size_t bytes)
+{
+	static const SimdLevel level = detectSimdLevel();
+	streamCopy(dst, src, bytes, level);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include "Simd.h"
+
+// Copy with non-temporal stores, for memory the CPU writes once and never
+// reads back, such as a mapped upload heap. Upload heaps are write-combined:
+// full-line streaming stores fill the combining buffers without reading the
+// destination first, whereas a regular memcpy of small elements can leave
+// partial lines behind. The stores are fenced before returning, so the data
+// is visible to the GPU once the command list is submitted.
+void streamCopy(void* dst, const void* src, size_t bytes, SimdLevel level);
+// Uses the level detected once at startup.
+void streamCopy(void* dst, const void* src, size_t bytes);
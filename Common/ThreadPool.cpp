@@ -0,0 +1,202 @@
+#include "ThreadPool.h"
+#include "Simd.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	inline std::uint64_t packRange(std::uint32_t begin, std::uint32_t end)
+	{
+		return static_cast<std::uint64_t>(begin) | (static_cast<std::uint64_t>(end) << 32);
+	}
+	inline std::uint32_t rangeBegin(std::uint64_t r) { return static_cast<std::uint32_t>(r); }
+	inline std::uint32_t rangeEnd(std::uint64_t r) { return static_cast<std::uint32_t>(r >> 32); }
+
+	inline void cpuRelax()
+	{
+#if SIMD_X86
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	// How long an idle worker polls for the next job before it blocks. Solver
+	// loops issue many short jobs back to back, so waking from the condition
+	// variable every time would cost more than the work itself.
+	const int SpinCount = 1 << 12;
+	// Pause this many times before yielding, so an oversubscribed machine
+	// still lets the threads that hold work run.
+	const int PauseCount = 64;
+
+	inline void backoff(int iteration)
+	{
+		if (iteration < PauseCount)
+			cpuRelax();
+		else
+			std::this_thread::yield();
+	}
+}
+
+ThreadPool::ThreadPool(unsigned threadCount)
+	: m_Slots(std::max(1u, threadCount))
+{
+	for (unsigned i = 1; i < m_Slots.size(); ++i)
+		m_Threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WakeCV.notify_all();
+	for (auto& t : m_Threads)
+		t.join();
+}
+
+void ThreadPool::parallelFor(std::uint32_t count, std::uint32_t grain, const RangeFn& fn)
+{
+	if (count == 0)
+		return;
+	grain = std::max(1u, grain);
+	const std::uint32_t chunks = (count + grain - 1) / grain;
+	const unsigned n = threadCount();
+	for (auto& slot : m_Slots)
+		slot.busySeconds = 0.0;
+	if (n == 1 || chunks == 1)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn(0, count, 0);
+		if (m_Profiling)
+			m_Slots[0].busySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	m_Fn = &fn;
+	m_Count = count;
+	m_Grain = grain;
+	for (unsigned i = 0; i < n; ++i)
+	{
+		std::uint32_t begin = static_cast<std::uint32_t>(static_cast<std::uint64_t>(chunks) * i / n);
+		std::uint32_t end = static_cast<std::uint32_t>(static_cast<std::uint64_t>(chunks) * (i + 1) / n);
+		m_Slots[i].range.store(packRange(begin, end), std::memory_order_relaxed);
+	}
+	m_Pending.store(n - 1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Generation.fetch_add(1, std::memory_order_release);
+	}
+	m_WakeCV.notify_all();
+
+	runChunks(0);
+	for (int i = 0; m_Pending.load(std::memory_order_acquire) != 0; ++i)
+		backoff(i);
+	m_Fn = nullptr;
+}
+
+double ThreadPool::lastImbalance()const
+{
+	double total = 0.0;
+	double slowest = 0.0;
+	for (const auto& slot : m_Slots)
+	{
+		total += slot.busySeconds;
+		slowest = std::max(slowest, slot.busySeconds);
+	}
+	if (total <= 0.0)
+		return 1.0;
+	return slowest / (total / m_Slots.size());
+}
+
+void ThreadPool::workerLoop(unsigned index)
+{
+	std::uint64_t seen = 0;
+	for (;;)
+	{
+		bool ready = false;
+		for (int i = 0; i < SpinCount && !ready; ++i)
+		{
+			ready = m_Generation.load(std::memory_order_acquire) != seen;
+			if (!ready)
+				backoff(i);
+		}
+		if (!ready)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCV.wait(lock, [&]() { return m_Quit || m_Generation.load(std::memory_order_acquire) != seen; });
+		}
+		if (m_Quit)
+			return;
+		seen = m_Generation.load(std::memory_order_acquire);
+		runChunks(index);
+		m_Pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void ThreadPool::runChunks(unsigned index)
+{
+	std::uint32_t chunk = 0;
+	do
+	{
+		while (popChunk(index, chunk))
+		{
+			std::uint32_t begin = chunk * m_Grain;
+			std::uint32_t end = std::min(m_Count, begin + m_Grain);
+			if (m_Profiling)
+			{
+				auto start = std::chrono::steady_clock::now();
+				(*m_Fn)(begin, end, index);
+				m_Slots[index].busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			else
+			{
+				(*m_Fn)(begin, end, index);
+			}
+		}
+	} while (stealChunks(index));
+}
+
+bool ThreadPool::popChunk(unsigned index, std::uint32_t& chunk)
+{
+	std::atomic<std::uint64_t>& range = m_Slots[index].range;
+	std::uint64_t r = range.load(std::memory_order_acquire);
+	for (;;)
+	{
+		std::uint32_t begin = rangeBegin(r);
+		std::uint32_t end = rangeEnd(r);
+		if (begin >= end)
+			return false;
+		if (range.compare_exchange_weak(r, packRange(begin + 1, end), std::memory_order_acq_rel))
+		{
+			chunk = begin;
+			return true;
+		}
+	}
+}
+
+bool ThreadPool::stealChunks(unsigned index)
+{
+	const unsigned n = threadCount();
+	for (unsigned k = 1; k < n; ++k)
+	{
+		std::atomic<std::uint64_t>& victim = m_Slots[(index + k) % n].range;
+		std::uint64_t r = victim.load(std::memory_order_acquire);
+		for (;;)
+		{
+			std::uint32_t begin = rangeBegin(r);
+			std::uint32_t end = rangeEnd(r);
+			if (begin >= end)
+				break;
+			// Take the back half, rounding up so a single chunk can be stolen too.
+			std::uint32_t take = (end - begin + 1) / 2;
+			if (victim.compare_exchange_weak(r, packRange(begin, end - take), std::memory_order_acq_rel))
+			{
+				m_Slots[index].range.store(packRange(end - take, end), std::memory_order_release);
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool for data parallel loops.
+// parallelFor splits [0, count) into chunks and hands every thread a contiguous
+// run of them. A thread takes chunks from the front of its own run and, once
+// that is empty, steals the back half of another thread's run. Both operations
+// are a single CAS on a packed (begin, end) pair, so no lock is taken while
+// the loop body runs. The calling thread works as thread 0.
+class ThreadPool
+{
+public:
+	// Body of a parallel loop: fn(begin, end, threadIndex). threadIndex is in
+	// [0, threadCount()) and can index per-thread scratch data.
+	using RangeFn = std::function<void(std::uint32_t, std::uint32_t, unsigned)>;
+
+	explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+	unsigned threadCount()const { return static_cast<unsigned>(m_Slots.size()); }
+
+	// Run fn over [0, count) in chunks of at most grain items and wait for it.
+	void parallelFor(std::uint32_t count, std::uint32_t grain, const RangeFn& fn);
+
+	// When profiling is on, each thread's busy time is recorded so the caller
+	// can read how evenly the last parallelFor was spread.
+	void setProfiling(bool enable) { m_Profiling = enable; }
+	// Slowest thread's busy time over the mean busy time of the last
+	// parallelFor; 1 is perfectly balanced. Needs profiling.
+	double lastImbalance()const;
+
+private:
+	struct alignas(64) Slot
+	{
+		// Chunk range [begin, end) packed as begin | end << 32.
+		std::atomic<std::uint64_t> range{ 0 };
+		double busySeconds = 0.0;
+	};
+
+	void workerLoop(unsigned index);
+	void runChunks(unsigned index);
+	bool popChunk(unsigned index, std::uint32_t& chunk);
+	bool stealChunks(unsigned index);
+
+private:
+	std::vector<Slot> m_Slots;
+	std::vector<std::thread> m_Threads;
+
+	// Current job.
+	const RangeFn* m_Fn = nullptr;
+	std::uint32_t m_Count = 0;
+	std::uint32_t m_Grain = 1;
+	bool m_Profiling = false;
+
+	std::atomic<std::uint64_t> m_Generation{ 0 };
+	// Background threads that have not finished the current job yet.
+	std::atomic<unsigned> m_Pending{ 0 };
+	std::atomic<bool> m_Quit{ false };
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCV;
+};
+
+// Run fn over [0, count) on the pool, or inline as thread 0 when there is no
+// pool or it has a single thread. Nothing runs when count is 0.
+inline void parallelRange(ThreadPool* pool, std::uint32_t count, std::uint32_t grain, const ThreadPool::RangeFn& fn)
+{
+	if (pool != nullptr && pool->threadCount() > 1)
+		pool->parallelFor(count, grain, fn);
+	else if (count > 0)
+		fn(0, count, 0);
+}
@@ -1,13 +1,15 @@
 #pragma once
 
+#include <cassert>
 #include "D3DFrameHelper.h"
+#include "StreamCopy.h"
 
 template<typename T>
 class UploadBuffer
 {
 public:
 	UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) :
-		m_IsConstantuUffer(isConstantBuffer)
+		m_ElementCount(elementCount), m_IsConstantuUffer(isConstantBuffer)
 	{
 		m_ElementByteSize = sizeof(T);
 		if (isConstantBuffer)
@@ -35,13 +37,35 @@ public:
 	{
 		return m_UploadBuffer.Get();
 	}
+	UINT elementCount()const
+	{
+		return m_ElementCount;
+	}
 	void copyData(int elementIndex, const T& data)
 	{
 		memcpy(&m_MappedData[elementIndex*m_ElementByteSize], &data, sizeof(T));
 	}
+	// Write count elements starting at firstElement with non-temporal stores.
+	// Use it to refill whole ranges every frame, e.g. the vertices of a
+	// deforming mesh; for a handful of constants copyData is just as good.
+	void streamData(UINT firstElement, const T* data, UINT count)
+	{
+		assert(firstElement + count <= m_ElementCount);
+		if (m_ElementByteSize == sizeof(T))
+		{
+			streamCopy(&m_MappedData[firstElement*m_ElementByteSize], data, sizeof(T)*count);
+			return;
+		}
+		// Constant buffer elements are padded to 256 bytes. Streaming them
+		// one by one would pay a fence per element and stream copies often
+		// shorter than a cache line, so they are copied plainly.
+		for (UINT i = 0; i < count; ++i)
+			copyData(static_cast<int>(firstElement + i), data[i]);
+	}
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_UploadBuffer;
 	BYTE *m_MappedData = nullptr;
 	UINT m_ElementByteSize = 0;
+	UINT m_ElementCount = 0;
 	bool m_IsConstantuUffer = false;
 };
\ No newline at end of file
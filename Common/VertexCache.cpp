@@ -0,0 +1,244 @@
+#include "VertexCache.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Forsyth's constants.
+	const int CacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+	const std::uint32_t MaxTabledValence = 64;
+
+	struct ScoreTables
+	{
+		float cache[CacheSize];
+		float valence[MaxTabledValence];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < CacheSize; ++i)
+			{
+				// The three vertices of the last triangle score the same, and
+				// a bit lower, so the next triangle does not just turn back.
+				cache[i] = i < 3 ? LastTriangleScore :
+					std::pow(1.0f - static_cast<float>(i - 3) / (CacheSize - 3), CacheDecayPower);
+			}
+			valence[0] = 0.0f;
+			for (std::uint32_t n = 1; n < MaxTabledValence; ++n)
+				valence[n] = ValenceBoostScale * std::pow(static_cast<float>(n), -ValenceBoostPower);
+		}
+
+		// Vertices with few triangles left score higher, so lone triangles
+		// are not left behind to be picked up later at a miss each.
+		float score(int cachePosition, std::uint32_t remaining)const
+		{
+			if (remaining == 0)
+				return -1.0f;
+			const float boost = remaining < MaxTabledValence ? valence[remaining] :
+				ValenceBoostScale * std::pow(static_cast<float>(remaining), -ValenceBoostPower);
+			return (cachePosition >= 0 ? cache[cachePosition] : 0.0f) + boost;
+		}
+	};
+
+	template<typename Index>
+	std::uint32_t vertexRange(const Index* indices, size_t indexCount)
+	{
+		std::uint32_t top = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+			top = std::max<std::uint32_t>(top, indices[i]);
+		return indexCount > 0 ? top + 1 : 0;
+	}
+
+	template<typename Index>
+	void optimize(Index* indices, size_t indexCount)
+	{
+		static const ScoreTables tables;
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount < 2)
+			return;
+		const std::uint32_t vertexCount = vertexRange(indices, indexCount);
+
+		// The triangles of every vertex, packed; remaining[v] of them are
+		// still to be emitted and sit at the front of its range.
+		std::vector<std::uint32_t> remaining(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			remaining[indices[i]]++;
+		std::vector<std::uint32_t> first(vertexCount + 1, 0);
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+			first[v + 1] = first[v] + remaining[v];
+		std::vector<std::uint32_t> triangles(triangleCount * 3);
+		{
+			std::vector<std::uint32_t> fill(first.begin(), first.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; ++i)
+				triangles[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+			vertexScore[v] = tables.score(-1, remaining[v]);
+		std::vector<std::uint8_t> emitted(triangleCount, 0);
+		size_t best = 0;
+		float bestScore = -1.0f;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const Index* tri = indices + 3 * t;
+			const float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = t;
+			}
+		}
+
+		std::vector<Index> order(triangleCount * 3);
+		// Three more than the cache, for the vertices the last triangle pushes out.
+		std::uint32_t cache[CacheSize + 3], nextCache[CacheSize + 3];
+		int cacheCount = 0;
+		size_t deadEndCursor = 0;
+		for (size_t out = 0; out < triangleCount; ++out)
+		{
+			if (best == triangleCount)
+			{
+				// Nothing left around the cache: take the first triangle left,
+				// which keeps the whole pass linear.
+				while (emitted[deadEndCursor])
+					deadEndCursor++;
+				best = deadEndCursor;
+			}
+			const Index* tri = indices + 3 * best;
+			emitted[best] = 1;
+			int nextCount = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				const std::uint32_t v = tri[k];
+				order[3 * out + k] = tri[k];
+				std::uint32_t* list = triangles.data() + first[v];
+				const std::uint32_t n = remaining[v]--;
+				std::swap(*std::find(list, list + n, static_cast<std::uint32_t>(best)), list[n - 1]);
+				if (std::find(nextCache, nextCache + nextCount, v) == nextCache + nextCount)
+					nextCache[nextCount++] = v;
+			}
+			for (int i = 0; i < cacheCount; ++i)
+			{
+				const std::uint32_t v = cache[i];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					nextCache[nextCount++] = v;
+			}
+
+			// Rescore what moved in or dropped out of the cache, and the
+			// triangles around it, the next one being the best of those.
+			for (int i = 0; i < nextCount; ++i)
+			{
+				const std::uint32_t v = nextCache[i];
+				cachePosition[v] = i < CacheSize ? i : -1;
+				vertexScore[v] = tables.score(cachePosition[v], remaining[v]);
+			}
+			best = triangleCount;
+			bestScore = -1.0f;
+			for (int i = 0; i < nextCount; ++i)
+			{
+				const std::uint32_t v = nextCache[i];
+				const std::uint32_t* list = triangles.data() + first[v];
+				for (std::uint32_t j = 0; j < remaining[v]; ++j)
+				{
+					const std::uint32_t t = list[j];
+					const Index* other = indices + 3 * t;
+					const float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			cacheCount = std::min(nextCount, CacheSize);
+			std::copy(nextCache, nextCache + cacheCount, cache);
+		}
+		std::copy(order.begin(), order.end(), indices);
+	}
+
+	template<typename Index>
+	VertexCacheStats simulate(const Index* indices, size_t indexCount, VertexCacheModel model, unsigned cacheSize)
+	{
+		VertexCacheStats stats;
+		stats.triangleCount = static_cast<std::uint32_t>(indexCount / 3);
+		const size_t corners = static_cast<size_t>(stats.triangleCount) * 3;
+		const std::uint32_t vertexCount = vertexRange(indices, corners);
+		std::vector<std::uint8_t> used(vertexCount, 0);
+		for (size_t i = 0; i < corners; ++i)
+		{
+			stats.vertexCount += used[indices[i]] == 0 ? 1 : 0;
+			used[indices[i]] = 1;
+		}
+		if (cacheSize == 0)
+		{
+			stats.missCount = static_cast<std::uint32_t>(corners);
+			return stats;
+		}
+
+		if (model == VertexCacheModel::Fifo)
+		{
+			// A vertex is still cached while fewer than cacheSize misses
+			// came after its own.
+			std::vector<std::uint32_t> missedAt(vertexCount, 0);
+			std::uint32_t clock = cacheSize + 1;
+			for (size_t i = 0; i < corners; ++i)
+			{
+				const Index v = indices[i];
+				if (clock - missedAt[v] > cacheSize)
+				{
+					missedAt[v] = clock++;
+					stats.missCount++;
+				}
+			}
+		}
+		else
+		{
+			// Most recent first; caches are small enough to search.
+			std::vector<std::uint32_t> cache;
+			cache.reserve(cacheSize + 1);
+			for (size_t i = 0; i < corners; ++i)
+			{
+				const std::uint32_t v = indices[i];
+				auto at = std::find(cache.begin(), cache.end(), v);
+				if (at == cache.end())
+				{
+					stats.missCount++;
+					cache.insert(cache.begin(), v);
+					if (cache.size() > cacheSize)
+						cache.pop_back();
+				}
+				else
+				{
+					std::rotate(cache.begin(), at, at + 1);
+				}
+			}
+		}
+		return stats;
+	}
+}
+
+void optimizeVertexCache(std::uint16_t* indices, size_t indexCount)
+{
+	optimize(indices, indexCount);
+}
+
+void optimizeVertexCache(std::uint32_t* indices, size_t indexCount)
+{
+	optimize(indices, indexCount);
+}
+
+VertexCacheStats simulateVertexCache(const std::uint16_t* indices, size_t indexCount, VertexCacheModel model, unsigned cacheSize)
+{
+	return simulate(indices, indexCount, model, cacheSize);
+}
+
+VertexCacheStats simulateVertexCache(const std::uint32_t* indices, size_t indexCount, VertexCacheModel model, unsigned cacheSize)
+{
+	return simulate(indices, indexCount, model, cacheSize);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Triangle order for the post-transform vertex cache, which lets the GPU
+// reuse a shaded vertex that a recent triangle already referenced. Indices
+// in scan order, like the bunny's, keep little in it.
+
+// Reorder the triangles of a triangle list in place, with Tom Forsyth's
+// linear-speed vertex cache optimisation: every vertex is scored by its
+// position in a simulated 32 entry LRU cache and by how few triangles it
+// has left, and the next triangle is the best scored one among those using
+// the cached vertices, or the first one left when none of them has any.
+// Corners keep their winding. Works on a sub-mesh of any MeshGeo index
+// buffer, 16 or 32 bit: pass its indices from startIndexLocation on.
+void optimizeVertexCache(std::uint16_t* indices, size_t indexCount);
+void optimizeVertexCache(std::uint32_t* indices, size_t indexCount);
+
+enum class VertexCacheModel
+{
+	// First in, first out: a hit does not refresh the entry. Closest to
+	// most hardware.
+	Fifo,
+	// Least recently used, which Forsyth's scores assume.
+	Lru,
+};
+
+struct VertexCacheStats
+{
+	std::uint32_t triangleCount = 0;
+	// Distinct vertices the triangles use.
+	std::uint32_t vertexCount = 0;
+	std::uint32_t missCount = 0;
+
+	// Average cache miss ratio: vertices shaded per triangle, 3 at worst
+	// and about 0.5 at best on a closed mesh.
+	float acmr()const { return triangleCount > 0 ? static_cast<float>(missCount) / triangleCount : 0.0f; }
+	// Average transformed vertex ratio: times each vertex is shaded, 1 at
+	// best.
+	float atvr()const { return vertexCount > 0 ? static_cast<float>(missCount) / vertexCount : 0.0f; }
+};
+
+// Count the vertices a cache of cacheSize entries would shade for the
+// triangle list.
+VertexCacheStats simulateVertexCache(const std::uint16_t* indices, size_t indexCount,
+	VertexCacheModel model = VertexCacheModel::Fifo, unsigned cacheSize = 16);
+VertexCacheStats simulateVertexCache(const std::uint32_t* indices, size_t indexCount,
+	VertexCacheModel model = VertexCacheModel::Fifo, unsigned cacheSize = 16);
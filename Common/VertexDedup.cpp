@@ -0,0 +1,239 @@
+#include "VertexDedup.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SSE2 is part of x86-64, so the group compare needs no runtime check.
+#if SIMD_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DEDUP_SSE 1
+#else
+#define DEDUP_SSE 0
+#endif
+
+namespace
+{
+	const size_t GroupSize = 16;
+	const std::uint32_t NoMatch = 0xffffffffu;
+
+	inline std::uint64_t hashKey(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		std::uint64_t h = (static_cast<std::uint64_t>(a) | static_cast<std::uint64_t>(b) << 32) * 0x9e3779b97f4a7c15ull;
+		h ^= (static_cast<std::uint64_t>(c) + 0x632be59bd9b4e019ull) * 0xc2b2ae3d27d4eb4full;
+		h ^= h >> 29;
+		h *= 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 32;
+		return h;
+	}
+
+	// Group from the low bits, tag from the top seven.
+	inline std::uint8_t tagOf(std::uint64_t hash)
+	{
+		return static_cast<std::uint8_t>(0x80 | (hash >> 57));
+	}
+
+	inline unsigned lowestBit(unsigned mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+
+	// Bit k set where tags[k] == tag.
+	inline unsigned matchGroup(const std::uint8_t* tags, std::uint8_t tag)
+	{
+#if DEDUP_SSE
+		const __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(tags));
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag)))));
+#else
+		unsigned mask = 0;
+		for (size_t k = 0; k < GroupSize; ++k)
+			mask |= static_cast<unsigned>(tags[k] == tag) << k;
+		return mask;
+#endif
+	}
+}
+
+VertexDedupTable::VertexDedupTable(size_t expectedKeys)
+{
+	reserve(expectedKeys);
+}
+
+void VertexDedupTable::reserve(size_t keys)
+{
+	// At most 7/8 full, in a power of two groups.
+	size_t groups = 1;
+	while (groups * GroupSize * 7 / 8 < keys)
+		groups *= 2;
+	if (groups * GroupSize > m_Tags.size())
+		rehash(groups);
+}
+
+void VertexDedupTable::clear()
+{
+	std::fill(m_Tags.begin(), m_Tags.end(), static_cast<std::uint8_t>(0));
+	m_Size = 0;
+}
+
+size_t VertexDedupTable::probe(const Key& key, std::uint64_t hash, bool& found)const
+{
+	const std::uint8_t tag = tagOf(hash);
+	for (size_t group = hash & m_GroupMask;; group = (group + 1) & m_GroupMask)
+	{
+		const std::uint8_t* tags = m_Tags.data() + group * GroupSize;
+		for (unsigned match = matchGroup(tags, tag); match != 0; match &= match - 1)
+		{
+			const size_t slot = group * GroupSize + lowestBit(match);
+			const Key& k = m_Slots[slot].key;
+			if (k.a == key.a && k.b == key.b && k.c == key.c)
+			{
+				found = true;
+				return slot;
+			}
+		}
+		const unsigned empty = matchGroup(tags, 0);
+		if (empty != 0)
+		{
+			found = false;
+			return group * GroupSize + lowestBit(empty);
+		}
+	}
+}
+
+void VertexDedupTable::rehash(size_t groupCount)
+{
+	AlignedVector<std::uint8_t> tags(groupCount * GroupSize, 0);
+	std::vector<Slot> slots(groupCount * GroupSize);
+	m_Tags.swap(tags);
+	m_Slots.swap(slots);
+	m_GroupMask = groupCount - 1;
+	for (size_t slot = 0; slot < tags.size(); ++slot)
+	{
+		if (tags[slot] == 0)
+			continue;
+		const Key& key = slots[slot].key;
+		bool found;
+		const size_t to = probe(key, hashKey(key.a, key.b, key.c), found);
+		m_Tags[to] = tags[slot];
+		m_Slots[to] = slots[slot];
+	}
+}
+
+std::uint32_t VertexDedupTable::insert(std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t value, bool& inserted)
+{
+	if ((m_Size + 1) * 8 > m_Tags.size() * 7)
+		rehash(std::max<size_t>(1, m_Tags.size() / GroupSize * 2));
+	const Key key = { a, b, c };
+	const std::uint64_t hash = hashKey(a, b, c);
+	bool found;
+	const size_t slot = probe(key, hash, found);
+	inserted = !found;
+	if (found)
+		return m_Slots[slot].value;
+	m_Tags[slot] = tagOf(hash);
+	m_Slots[slot] = { key, value };
+	m_Size++;
+	return value;
+}
+
+std::uint32_t* VertexDedupTable::find(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+{
+	if (m_Size == 0)
+		return nullptr;
+	bool found;
+	const size_t slot = probe({ a, b, c }, hashKey(a, b, c), found);
+	return found ? &m_Slots[slot].value : nullptr;
+}
+
+std::uint32_t weldPositions(const Vec3* positions, std::uint32_t count, float epsilon,
+	std::vector<std::uint32_t>& remap, std::vector<Vec3>* welded)
+{
+	remap.resize(count);
+	std::vector<Vec3> kept;
+	kept.reserve(count / 4);
+	VertexDedupTable table(count / 4);
+
+	if (!(epsilon > 0.0f))
+	{
+		// Identical positions only: the bits are the key, with -0 as +0.
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const Vec3& p = positions[i];
+			std::uint32_t bits[3];
+			const float v[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+			std::memcpy(bits, v, sizeof(bits));
+			bool inserted;
+			remap[i] = table.insert(bits[0], bits[1], bits[2], static_cast<std::uint32_t>(kept.size()), inserted);
+			if (inserted)
+				kept.push_back(p);
+		}
+	}
+	else
+	{
+		// Kept positions are chained per cell, the table holding the newest.
+		// Cells are twice epsilon wide, so a position within epsilon of this
+		// one lies in its cell or the neighbour on the nearer side along each
+		// axis: eight cells to search.
+		std::vector<std::uint32_t> next;
+		next.reserve(count / 4);
+		const float invCell = 0.5f / epsilon;
+		const float epsilonSq = epsilon * epsilon;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const Vec3& p = positions[i];
+			std::int32_t cell[3], side[3];
+			const float v[3] = { p.x, p.y, p.z };
+			for (int k = 0; k < 3; ++k)
+			{
+				const float f = std::min(std::max(v[k] * invCell, -1.0e9f), 1.0e9f);
+				const float lo = std::floor(f);
+				cell[k] = static_cast<std::int32_t>(lo);
+				side[k] = f - lo < 0.5f ? -1 : 1;
+			}
+			std::uint32_t match = NoMatch;
+			for (int n = 0; n < 8 && match == NoMatch; ++n)
+			{
+				const std::uint32_t* head = table.find(
+					static_cast<std::uint32_t>(cell[0] + ((n & 1) ? side[0] : 0)),
+					static_cast<std::uint32_t>(cell[1] + ((n & 2) ? side[1] : 0)),
+					static_cast<std::uint32_t>(cell[2] + ((n & 4) ? side[2] : 0)));
+				for (std::uint32_t k = head != nullptr ? *head : NoMatch; k != NoMatch; k = next[k])
+				{
+					if (lengthSq(kept[k] - p) <= epsilonSq)
+					{
+						match = k;
+						break;
+					}
+				}
+			}
+			if (match == NoMatch)
+			{
+				match = static_cast<std::uint32_t>(kept.size());
+				kept.push_back(p);
+				const std::uint32_t ux = static_cast<std::uint32_t>(cell[0]), uy = static_cast<std::uint32_t>(cell[1]), uz = static_cast<std::uint32_t>(cell[2]);
+				if (std::uint32_t* head = table.find(ux, uy, uz))
+				{
+					next.push_back(*head);
+					*head = match;
+				}
+				else
+				{
+					bool inserted;
+					table.insert(ux, uy, uz, match, inserted);
+					next.push_back(NoMatch);
+				}
+			}
+			remap[i] = match;
+		}
+	}
+	const std::uint32_t keptCount = static_cast<std::uint32_t>(kept.size());
+	if (welded != nullptr)
+		welded->swap(kept);
+	return keptCount;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SimMath.h"
+#include "Simd.h"
+
+// Flat open addressing map from a key of three 32-bit words, such as the
+// position, texture coordinate and normal index of an OBJ corner, to a
+// 32-bit value. Each key sits with its value in a 16-byte slot, beside a
+// byte per slot that holds seven bits of the key's hash with the top bit
+// set, or 0 for an empty slot. Slots are probed in aligned groups of sixteen: one SSE2
+// compare finds every candidate of a group before a key is read, and at
+// most 7/8 full, a probe rarely leaves its first group. Nothing is erased.
+class VertexDedupTable
+{
+public:
+	explicit VertexDedupTable(size_t expectedKeys = 0);
+	VertexDedupTable(const VertexDedupTable& rhs) = delete;
+	VertexDedupTable& operator=(const VertexDedupTable& rhs) = delete;
+
+	// Room for keys without growing again.
+	void reserve(size_t keys);
+	void clear();
+
+	// The value stored for the key; a new key stores value first and sets
+	// inserted.
+	std::uint32_t insert(std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t value, bool& inserted);
+	// The value stored for the key, or nullptr. Valid until the next insert.
+	std::uint32_t* find(std::uint32_t a, std::uint32_t b, std::uint32_t c);
+
+	size_t size()const { return m_Size; }
+	size_t capacity()const { return m_Tags.size(); }
+
+private:
+	struct Key
+	{
+		std::uint32_t a, b, c;
+	};
+	struct Slot
+	{
+		Key key;
+		std::uint32_t value;
+	};
+
+	// The slot holding the key, or the empty slot it would go in.
+	size_t probe(const Key& key, std::uint64_t hash, bool& found)const;
+	void rehash(size_t groupCount);
+
+private:
+	AlignedVector<std::uint8_t> m_Tags;
+	std::vector<Slot> m_Slots;
+	size_t m_GroupMask = 0;
+	size_t m_Size = 0;
+};
+
+// Merge positions closer than epsilon. Positions are kept in the order they
+// first appear; remap[i] is the kept position that position i became, and
+// welded, when given, receives the kept positions. A position joins a kept
+// one within epsilon, found through a grid of cells twice epsilon wide, or
+// is kept itself. An epsilon of 0 merges only identical positions. Returns how
+// many were kept.
+std::uint32_t weldPositions(const Vec3* positions, std::uint32_t count, float epsilon,
+	std::vector<std::uint32_t>& remap, std::vector<Vec3>* welded = nullptr);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "../../Common/ObjLoader.h"
+
+// Headless benchmarks for the simulation code in Common/. Nothing here touches
+// Direct3D, so the same sources build on the Linux machines used for sizing.
+
+struct BenchOptions
+{
+	// Smaller problem sizes and shorter runs, for smoke testing.
+	bool quick = false;
+	// bunny.obj, when it is not found from the repository root or the project folder.
+	std::string bunnyPath;
+};
+
+// Wall clock stopwatch. GameTimer sits on QueryPerformanceCounter, so the
+// benchmarks use std::chrono instead.
+class BenchTimer
+{
+public:
+	BenchTimer() { reset(); }
+	void reset() { m_Start = std::chrono::steady_clock::now(); }
+	double seconds()const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+	}
+	double milliseconds()const { return seconds() * 1000.0; }
+
+private:
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+// Path of the Stanford bunny shipped in bunny/, or empty if it is not found.
+std::string findBunny(const BenchOptions& opt);
+// Load the Stanford bunny shipped in bunny/.
+bool loadBunny(const BenchOptions& opt, ObjMesh& mesh);
+// Split every triangle into four at its edge midpoints. Vertices are not
+// shared between triangles, which does not matter to the consumers here.
+void subdivideMesh(ObjMesh& mesh);
+// Write a side x side grid of vertices, two triangles per cell, as an OBJ
+// file in the notation of bunny.obj. Returns the file size, 0 on failure.
+size_t writeGridObj(const char* fileName, int side);
+
+void benchCloth(const BenchOptions& opt);
+void benchParticles(const BenchOptions& opt);
+void benchThreads(const BenchOptions& opt);
+void benchSelfCollision(const BenchOptions& opt);
+void benchBvh(const BenchOptions& opt);
+void benchNormals(const BenchOptions& opt);
+void benchStream(const BenchOptions& opt);
+void benchMultigrid(const BenchOptions& opt);
+void benchLod(const BenchOptions& opt);
+void benchWind(const BenchOptions& opt);
+void benchTear(const BenchOptions& opt);
+void benchSleep(const BenchOptions& opt);
+void benchImplicit(const BenchOptions& opt);
+void benchShapes(const BenchOptions& opt);
+void benchJacobi(const BenchOptions& opt);
+void benchGarment(const BenchOptions& opt);
+void benchCcd(const BenchOptions& opt);
+void benchCache(const BenchOptions& opt);
+void benchObj(const BenchOptions& opt);
+void benchMeshCache(const BenchOptions& opt);
+void benchDedup(const BenchOptions& opt);
+void benchVertexCache(const BenchOptions& opt);
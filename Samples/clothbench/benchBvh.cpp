@@ -0,0 +1,165 @@
+#include "bench.h"
+#include "../../Common/Bvh.h"
+#include "../../Common/ThreadPool.h"
+#include <atomic>
+#include <random>
+
+namespace
+{
+	struct Queries
+	{
+		std::vector<Vec3> rayOrigins;
+		std::vector<Vec3> rayDirs;
+		std::vector<Vec3> sphereCenters;
+		float radius = 0.0f;
+	};
+
+	// Rays from a sphere around the mesh towards random points of its bounds,
+	// and spheres placed near random points of the surface.
+	Queries makeQueries(const ObjMesh& mesh, const Bvh& bvh, size_t count)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const Vec3 lo = bvh.boundsMin();
+		const Vec3 hi = bvh.boundsMax();
+		const Vec3 center = (lo + hi) * 0.5f;
+		const float diagonal = length(hi - lo);
+		Queries q;
+		q.radius = 0.01f * diagonal;
+		for (size_t i = 0; i < count; ++i)
+		{
+			Vec3 dir = normalizeOr(Vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f), Vec3(1.0f, 0.0f, 0.0f));
+			Vec3 origin = center + dir * diagonal;
+			Vec3 target(lo.x + unit(rng) * (hi.x - lo.x), lo.y + unit(rng) * (hi.y - lo.y), lo.z + unit(rng) * (hi.z - lo.z));
+			q.rayOrigins.push_back(origin);
+			q.rayDirs.push_back(normalizeOr(target - origin, -dir));
+
+			size_t t = rng() % mesh.triangleCount();
+			float u = unit(rng), v = unit(rng);
+			if (u + v > 1.0f)
+			{
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			const Vec3& a = mesh.positions[mesh.indices[3 * t + 0]];
+			const Vec3& b = mesh.positions[mesh.indices[3 * t + 1]];
+			const Vec3& c = mesh.positions[mesh.indices[3 * t + 2]];
+			Vec3 offset = Vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) * (4.0f * q.radius);
+			q.sphereCenters.push_back(a + (b - a) * u + (c - a) * v + offset);
+		}
+		return q;
+	}
+
+	// Brute force over every triangle, to check the tree on a sample of rays.
+	bool bruteRaycast(const ObjMesh& mesh, const Vec3& o, const Vec3& d, float& tBest)
+	{
+		bool found = false;
+		for (std::uint32_t t = 0; t < mesh.triangleCount(); ++t)
+		{
+			Vec3 v0 = mesh.positions[mesh.indices[3 * t + 0]];
+			Vec3 e1 = mesh.positions[mesh.indices[3 * t + 1]] - v0;
+			Vec3 e2 = mesh.positions[mesh.indices[3 * t + 2]] - v0;
+			Vec3 p = cross(d, e2);
+			float det = dot(e1, p);
+			if (std::abs(det) < 1e-12f)
+				continue;
+			Vec3 s = o - v0;
+			float u = dot(s, p) / det;
+			Vec3 q = cross(s, e1);
+			float v = dot(d, q) / det;
+			float th = dot(e2, q) / det;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && th >= 0.0f && th < tBest)
+			{
+				tBest = th;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// Million queries per second of fn(i) over [0, count), on one thread or the pool.
+	template<typename Fn>
+	double measure(ThreadPool* pool, size_t count, std::atomic<std::uint64_t>& hits, Fn fn)
+	{
+		hits = 0;
+		BenchTimer timer;
+		auto range = [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+			std::uint64_t n = 0;
+			for (std::uint32_t i = begin; i < end; ++i)
+				n += fn(i) ? 1 : 0;
+			hits += n;
+		};
+		if (pool != nullptr)
+			pool->parallelFor(static_cast<std::uint32_t>(count), 1024, range);
+		else
+			range(0, static_cast<std::uint32_t>(count), 0);
+		return count / timer.seconds() / 1.0e6;
+	}
+
+	void runMesh(const char* name, const ObjMesh& mesh, const BenchOptions& opt, ThreadPool& pool)
+	{
+		Bvh bvh;
+		bvh.build(mesh.positions, mesh.indices);
+		std::printf("%s: %u triangles, %u nodes (%zu KB), build %.1f ms\n", name, bvh.triangleCount(), bvh.nodeCount(),
+			bvh.nodeCount() * sizeof(BvhNode) / 1024, bvh.lastBuildSeconds() * 1000.0);
+
+		const size_t count = opt.quick ? 50000 : 1000000;
+		Queries q = makeQueries(mesh, bvh, count);
+
+		if (mesh.triangleCount() < 100000)
+		{
+			int mismatches = 0;
+			for (size_t i = 0; i < 200; ++i)
+			{
+				float tBrute = 1e30f;
+				bool bruteHit = bruteRaycast(mesh, q.rayOrigins[i], q.rayDirs[i], tBrute);
+				BvhRayHit hit;
+				bool treeHit = bvh.raycast(q.rayOrigins[i], q.rayDirs[i], 1e30f, hit);
+				if (bruteHit != treeHit || (treeHit && std::abs(hit.t - tBrute) > 1e-5f * tBrute))
+					++mismatches;
+			}
+			std::printf("  ray check against brute force: %d of 200 differ\n", mismatches);
+		}
+
+		std::printf("  %-8s %8s %14s %14s %9s\n", "simd", "threads", "rays Mq/s", "spheres Mq/s", "hit rate");
+		const SimdLevel levels[] = { SimdLevel::Scalar, detectSimdLevel() };
+		for (int l = 0; l < 2; ++l)
+		{
+			if (l == 1 && levels[1] == SimdLevel::Scalar)
+				break;
+			bvh.setSimdLevel(levels[l]);
+			for (ThreadPool* p : { static_cast<ThreadPool*>(nullptr), &pool })
+			{
+				if (p != nullptr && pool.threadCount() == 1)
+					continue;
+				std::atomic<std::uint64_t> rayHits(0), sphereHits(0);
+				double rays = measure(p, count, rayHits, [&](std::uint32_t i) {
+					BvhRayHit hit;
+					return bvh.raycast(q.rayOrigins[i], q.rayDirs[i], 1e30f, hit);
+				});
+				double spheres = measure(p, count, sphereHits, [&](std::uint32_t i) {
+					BvhPointHit hit;
+					return bvh.closestPoint(q.sphereCenters[i], q.radius, hit);
+				});
+				std::printf("  %-8s %8u %14.2f %14.2f %4.0f%%/%2.0f%%\n", levels[l] == SimdLevel::Scalar ? "scalar" : "sse",
+					p != nullptr ? p->threadCount() : 1u, rays, spheres,
+					100.0 * rayHits / count, 100.0 * sphereHits / count);
+			}
+		}
+	}
+}
+
+// BVH build time and ray / sphere query throughput on the bunny, as shipped
+// and subdivided to over a million triangles.
+void benchBvh(const BenchOptions& opt)
+{
+	ObjMesh mesh;
+	if (!loadBunny(opt, mesh))
+		return;
+	ThreadPool pool;
+	runMesh("bunny", mesh, opt, pool);
+	const int levels = opt.quick ? 2 : 4;
+	for (int i = 0; i < levels; ++i)
+		subdivideMesh(mesh);
+	runMesh("subdivided bunny", mesh, opt, pool);
+}
@@ -0,0 +1,115 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include "../../Common/ClothCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+namespace
+{
+	// Position, normal and texture coordinates, laid out like the vertices
+	// of the samples.
+	struct BenchVertex
+	{
+		float pos[3];
+		float normal[3];
+		float uv[2];
+	};
+}
+
+// Bakes a windblown sheet into a cloth cache and plays it back: the cost of
+// simulating a frame against appending it and against decoding it straight
+// into a vertex array, both in order and seeking to random frames, with the
+// file size and the worst quantization error.
+void benchCache(const BenchOptions& opt)
+{
+	const int side = opt.quick ? 48 : 96;
+	const std::uint32_t frames = opt.quick ? 120 : 600;
+	const float dt = 1.0f / 60.0f;
+	const char* fileName = "clothbench.ccache";
+
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	ClothDesc desc;
+	desc.columns = side;
+	desc.rows = side;
+	desc.wind.velocity = Vec3(2.0f, 0.0f, 1.0f);
+	desc.wind.turbulence = 1.0f;
+	Cloth cloth(desc);
+	cloth.setThreadPool(&pool);
+	const std::uint32_t count = cloth.particleCount();
+
+	ClothCacheWriter writer;
+	if (!writer.open(fileName, dt))
+	{
+		std::printf("cannot write %s\n", fileName);
+		return;
+	}
+	std::vector<float> reference;
+	reference.reserve(static_cast<size_t>(frames) * count * 3);
+	double simMs = 0.0, writeMs = 0.0;
+	for (std::uint32_t f = 0; f < frames; ++f)
+	{
+		BenchTimer timer;
+		cloth.step(dt);
+		simMs += timer.milliseconds();
+		const ParticleStore& p = cloth.particles();
+		timer.reset();
+		writer.append(p.x.data(), p.y.data(), p.z.data(), count);
+		writeMs += timer.milliseconds();
+		for (std::uint32_t i = 0; i < count; ++i)
+			reference.insert(reference.end(), { p.x[i], p.y[i], p.z[i] });
+	}
+	const double bytes = static_cast<double>(writer.byteCount());
+	BenchTimer closeTimer;
+	writer.close();
+	writeMs += closeTimer.milliseconds();
+
+	ClothCacheReader reader;
+	if (!reader.open(fileName))
+	{
+		std::printf("cannot read %s\n", fileName);
+		return;
+	}
+	std::vector<BenchVertex> vertices(reader.maxParticleCount());
+	double worst = 0.0;
+	auto check = [&](std::uint32_t f) {
+		const float* expected = &reference[static_cast<size_t>(f) * count * 3];
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				worst = std::max(worst, static_cast<double>(std::fabs(vertices[i].pos[c] - expected[3 * i + c])));
+		}
+	};
+
+	BenchTimer timer;
+	for (std::uint32_t f = 0; f < frames; ++f)
+		reader.read(f, vertices.data(), sizeof(BenchVertex));
+	const double playMs = timer.milliseconds() / frames;
+	for (std::uint32_t f = 0; f < frames; f += 7)
+	{
+		reader.read(f, vertices.data(), sizeof(BenchVertex));
+		check(f);
+	}
+
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<std::uint32_t> pick(0, frames - 1);
+	const int seeks = opt.quick ? 50 : 200;
+	timer.reset();
+	for (int s = 0; s < seeks; ++s)
+	{
+		const std::uint32_t f = pick(rng);
+		reader.read(f, vertices.data(), sizeof(BenchVertex));
+	}
+	const double seekMs = timer.milliseconds() / seeks;
+	const std::uint32_t keyframes = reader.keyframeCount();
+	reader.close();
+	std::remove(fileName);
+
+	std::printf("%u particles, %u frames, %u keyframes, %u threads\n", count, frames, keyframes, pool.threadCount());
+	std::printf("file %.2f MB, %.2f bytes per particle per frame (raw float3: 12), max error %.1f um\n",
+		bytes / (1024.0 * 1024.0), bytes / (static_cast<double>(count) * frames), worst * 1.0e6);
+	std::printf("%12s %12s %12s %12s %12s\n", "sim ms", "append ms", "play ms", "seek ms", "sim/play");
+	std::printf("%12.3f %12.3f %12.3f %12.3f %11.1fx\n", simMs / frames, writeMs / frames, playMs, seekMs, simMs / frames / playMs);
+}
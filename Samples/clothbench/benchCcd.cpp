@@ -0,0 +1,99 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include <algorithm>
+#include <thread>
+
+// Stress test of continuous collision: a free sheet thrown down onto the
+// bunny, scaled up 6 times, at 10 to 60 m/s. The cloth steps one substep at
+// a time at 480 Hz, so at the top speed a particle moves 12 cm per substep,
+// more than the ears are thick. After every substep each particle's motion
+// is raycast against the bunny: a hit is a particle that went through the
+// surface. Runs with the discrete collider alone and with continuous
+// collision in front of it, and reports the broad phase pairs and the time
+// of both phases per substep.
+void benchCcd(const BenchOptions& opt)
+{
+	ObjMesh bunny;
+	if (!loadBunny(opt, bunny))
+		return;
+	for (Vec3& v : bunny.positions)
+		v = v * 6.0f;
+	Vec3 lo = bunny.positions[0], hi = bunny.positions[0];
+	for (const Vec3& v : bunny.positions)
+	{
+		lo = Vec3(std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z));
+		hi = Vec3(std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z));
+	}
+	Bvh bvh;
+	bvh.build(bunny.positions, bunny.indices);
+	CcdMesh ccdMesh;
+	ccdMesh.build(bunny.positions, bunny.indices);
+
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	const int side = opt.quick ? 32 : 64;
+	const int steps = opt.quick ? 120 : 240;
+	const float dt = 1.0f / 480.0f;
+	const float speeds[] = { 10.0f, 30.0f, 60.0f };
+	std::printf("bunny %u triangles, %u edges; %dx%d sheet, %d substeps of %.2f ms, %u threads\n", bunny.triangleCount(),
+		ccdMesh.edgeCount(), side, side, steps, dt * 1000.0f, pool.threadCount());
+	std::printf("%6s %9s %9s %11s %11s %8s %8s %8s %9s %10s %9s\n", "m/s", "mode", "crossings", "pt-tri/sub",
+		"edge/sub", "pt hits", "ee hits", "reverted", "broad ms", "narrow ms", "step ms");
+
+	for (float speed : speeds)
+	{
+		for (int continuous = 0; continuous < 2; ++continuous)
+		{
+			ClothDesc desc;
+			desc.columns = side;
+			desc.rows = side;
+			desc.width = 1.2f * (hi.x - lo.x);
+			desc.depth = 1.2f * (hi.z - lo.z);
+			desc.origin = Vec3(0.5f * (lo.x + hi.x), hi.y + 0.3f, 0.5f * (lo.z + hi.z));
+			desc.pinCorners = false;
+			desc.substeps = 1;
+			desc.iterations = 4;
+			desc.thickness = 0.01f;
+			Cloth cloth(desc);
+			cloth.setThreadPool(&pool);
+			cloth.setCollider(&bvh);
+			if (continuous != 0)
+				cloth.setContinuousCollider(&ccdMesh);
+			for (std::uint32_t i = 0; i < cloth.particleCount(); ++i)
+				cloth.setVelocity(i, Vec3(0.0f, -speed, 0.0f));
+
+			std::uint64_t crossings = 0, pointPairs = 0, edgePairs = 0, pointHits = 0, edgeHits = 0, reverted = 0;
+			double broadMs = 0.0, narrowMs = 0.0, stepMs = 0.0;
+			for (int s = 0; s < steps; ++s)
+			{
+				BenchTimer timer;
+				cloth.step(dt);
+				stepMs += timer.milliseconds();
+				const CcdStats& stats = cloth.continuousStats();
+				if (continuous != 0)
+				{
+					pointPairs += stats.pointTrianglePairs;
+					edgePairs += stats.edgeEdgePairs;
+					pointHits += stats.pointTriangleContacts;
+					edgeHits += stats.edgeEdgeContacts;
+					reverted += stats.revertedParticles;
+					broadMs += stats.broadSeconds * 1000.0;
+					narrowMs += stats.narrowSeconds * 1000.0;
+				}
+				const ParticleStore& p = cloth.particles();
+				for (std::uint32_t i = 0; i < cloth.particleCount(); ++i)
+				{
+					BvhRayHit hit;
+					const Vec3 from = p.prevPosition(i), motion = p.position(i) - from;
+					if (lengthSq(motion) > 0.0f && bvh.raycast(from, motion, 1.0f, hit))
+						++crossings;
+				}
+			}
+			std::printf("%6.0f %9s %9llu %11.0f %11.0f %8llu %8llu %8llu %9.3f %10.3f %9.3f\n", speed,
+				continuous != 0 ? "ccd" : "discrete", static_cast<unsigned long long>(crossings),
+				static_cast<double>(pointPairs) / steps, static_cast<double>(edgePairs) / steps,
+				static_cast<unsigned long long>(pointHits), static_cast<unsigned long long>(edgeHits),
+				static_cast<unsigned long long>(reverted),
+				broadMs / steps, narrowMs / steps, stepMs / steps);
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+
+// Steps per second of the full cloth step for a few square grid sizes.
+void benchCloth(const BenchOptions& opt)
+{
+	const int sizes[] = { 64, 256, 1024 };
+	const float dt = 1.0f / 60.0f;
+	const double minSeconds = opt.quick ? 0.2 : 2.0;
+	std::printf("%10s %12s %12s %10s %12s\n", "grid", "particles", "constraints", "steps/s", "ms/step");
+	for (int n : sizes)
+	{
+		if (opt.quick && n > 256)
+			continue;
+		ClothDesc desc;
+		desc.columns = n;
+		desc.rows = n;
+		Cloth cloth(desc);
+		// Let the sheet start moving so the first steps are not a special case.
+		cloth.step(dt);
+
+		int steps = 0;
+		BenchTimer timer;
+		do
+		{
+			cloth.step(dt);
+			++steps;
+		} while (timer.seconds() < minSeconds || steps < 3);
+		double elapsed = timer.seconds();
+		std::printf("%5dx%-4d %12u %12zu %10.2f %12.3f\n", n, n, cloth.particleCount(),
+			cloth.constraints().size(), steps / elapsed, 1000.0 * elapsed / steps);
+	}
+}
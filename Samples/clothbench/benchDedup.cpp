@@ -0,0 +1,172 @@
+#include "bench.h"
+#include "../../Common/VertexDedup.h"
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	struct CornerKey
+	{
+		std::uint32_t a, b, c;
+		bool operator==(const CornerKey& rhs)const { return a == rhs.a && b == rhs.b && c == rhs.c; }
+	};
+
+	// The mix VertexDedupTable uses, so the two differ only in layout.
+	struct CornerKeyHash
+	{
+		size_t operator()(const CornerKey& k)const
+		{
+			std::uint64_t h = (static_cast<std::uint64_t>(k.a) | static_cast<std::uint64_t>(k.b) << 32) * 0x9e3779b97f4a7c15ull;
+			h ^= (static_cast<std::uint64_t>(k.c) + 0x632be59bd9b4e019ull) * 0xc2b2ae3d27d4eb4full;
+			h ^= h >> 29;
+			h *= 0xbf58476d1ce4e5b9ull;
+			h ^= h >> 32;
+			return static_cast<size_t>(h);
+		}
+	};
+
+	// A side x side grid of cells as an OBJ with "f v/vt/vn" corners. Texture
+	// coordinates follow the positions except along a seam every 64 columns,
+	// where the cells on either side use their own copy, and every 8 x 8
+	// block of cells is a flat facet with one normal. Corners repeat about
+	// five times over, like a scanned mesh with seams and hard edges.
+	void makeFacetedGrid(int side, ObjMesh& mesh)
+	{
+		mesh.clear();
+		const int stride = side + 1;
+		const int blocks = (side + 7) / 8;
+		for (int y = 0; y <= side; ++y)
+			for (int x = 0; x <= side; ++x)
+				mesh.positions.push_back(Vec3(static_cast<float>(x), 0.0f, static_cast<float>(y)));
+		// The second copy of a seam column starts after the shared ones.
+		const std::uint32_t seamBase = static_cast<std::uint32_t>(mesh.positions.size());
+		for (int y = 0; y <= side; ++y)
+		{
+			for (int x = 0; x <= side; ++x)
+			{
+				mesh.texCoords.push_back(static_cast<float>(x) / side);
+				mesh.texCoords.push_back(static_cast<float>(y) / side);
+			}
+		}
+		for (int y = 0; y <= side; ++y)
+		{
+			for (int x = 64; x < side; x += 64)
+			{
+				mesh.texCoords.push_back(static_cast<float>(x) / side);
+				mesh.texCoords.push_back(static_cast<float>(y) / side);
+			}
+		}
+		const int seamsPerRow = (side - 1) / 64;
+		for (int b = 0; b < blocks * blocks; ++b)
+			mesh.normals.push_back(normalizeOr(Vec3(0.1f * (b % 7), 1.0f, 0.1f * (b % 5)), Vec3(0.0f, 1.0f, 0.0f)));
+
+		const size_t corners = static_cast<size_t>(side) * side * 6;
+		mesh.indices.reserve(corners);
+		mesh.texCoordIndices.reserve(corners);
+		mesh.normalIndices.reserve(corners);
+		for (int y = 0; y < side; ++y)
+		{
+			for (int x = 0; x < side; ++x)
+			{
+				const std::uint32_t normal = static_cast<std::uint32_t>((y / 8) * blocks + x / 8);
+				auto corner = [&](int cx, int cy)
+				{
+					std::uint32_t texCoord = static_cast<std::uint32_t>(cy * stride + cx);
+					// The cell right of a seam takes the second copy.
+					if (cx % 64 == 0 && cx > 0 && cx < side && cx == x)
+						texCoord = seamBase + static_cast<std::uint32_t>(cy * seamsPerRow + cx / 64 - 1);
+					mesh.indices.push_back(static_cast<std::uint32_t>(cy * stride + cx));
+					mesh.texCoordIndices.push_back(texCoord);
+					mesh.normalIndices.push_back(normal);
+				};
+				corner(x, y);
+				corner(x + 1, y);
+				corner(x + 1, y + 1);
+				corner(x, y);
+				corner(x + 1, y + 1);
+				corner(x, y + 1);
+			}
+		}
+	}
+}
+
+// Indexed mesh building: deduplicating the v/vt/vn corners of a grid of
+// 10M triangles (1M with --quick) into vertices, with VertexDedupTable and
+// with a reserved std::unordered_map on the same hash, and checking both
+// give the same indices. Then welding the positions of the same grid
+// written out per corner with a jitter of a quarter of the epsilon, which
+// has to give back one position per grid vertex, and building the vertices
+// with buildObjIndexed end to end.
+void benchDedup(const BenchOptions& opt)
+{
+	const int side = opt.quick ? 708 : 2236;
+	ObjMesh mesh;
+	makeFacetedGrid(side, mesh);
+	const std::uint32_t corners = static_cast<std::uint32_t>(mesh.indices.size());
+	std::printf("%u triangles, %u corners, %zu positions\n", mesh.triangleCount(), corners, mesh.positions.size());
+
+	// Both reserved for the same count, enough that neither grows.
+	const size_t expected = mesh.positions.size() * 3 / 2;
+	std::vector<std::uint32_t> tableIndices(corners), mapIndices(corners);
+	BenchTimer timer;
+	VertexDedupTable table(expected);
+	std::uint32_t tableVertices = 0;
+	for (std::uint32_t i = 0; i < corners; ++i)
+	{
+		bool inserted;
+		tableIndices[i] = table.insert(mesh.indices[i], mesh.texCoordIndices[i], mesh.normalIndices[i], tableVertices, inserted);
+		tableVertices += inserted ? 1 : 0;
+	}
+	const double tableMs = timer.milliseconds();
+
+	timer.reset();
+	std::unordered_map<CornerKey, std::uint32_t, CornerKeyHash> map;
+	map.reserve(expected);
+	std::uint32_t mapVertices = 0;
+	for (std::uint32_t i = 0; i < corners; ++i)
+	{
+		const auto result = map.emplace(CornerKey{ mesh.indices[i], mesh.texCoordIndices[i], mesh.normalIndices[i] }, mapVertices);
+		mapIndices[i] = result.first->second;
+		mapVertices += result.second ? 1 : 0;
+	}
+	const double mapMs = timer.milliseconds();
+	const bool same = tableVertices == mapVertices && tableIndices == mapIndices;
+
+	std::printf("%-14s %10s %10s %12s %10s\n", "dedup", "vertices", "ms", "Mcorners/s", "speedup");
+	std::printf("%-14s %10u %10.1f %12.1f %10s\n", "unordered_map", mapVertices, mapMs, corners / (mapMs * 1000.0), "1.0x");
+	std::printf("%-14s %10u %10.1f %12.1f %9.1fx%s\n", "open table", tableVertices, tableMs, corners / (tableMs * 1000.0),
+		mapMs / tableMs, same ? "" : "  index mismatch");
+	map = {};
+	tableIndices = {};
+	mapIndices = {};
+
+	const float epsilon = 1.0e-3f;
+	std::vector<Vec3> soup(corners);
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> jitter(-0.25f * epsilon, 0.25f * epsilon);
+	for (std::uint32_t i = 0; i < corners; ++i)
+		soup[i] = mesh.positions[mesh.indices[i]] + Vec3(jitter(rng), jitter(rng), jitter(rng));
+	std::vector<std::uint32_t> remap;
+	timer.reset();
+	const std::uint32_t exact = weldPositions(soup.data(), corners, 0.0f, remap);
+	const double exactMs = timer.milliseconds();
+	timer.reset();
+	const std::uint32_t kept = weldPositions(soup.data(), corners, epsilon, remap);
+	const double weldMs = timer.milliseconds();
+	std::printf("%-14s %10s %10s %12s\n", "weld", "kept", "ms", "Mpoints/s");
+	std::printf("%-14s %10u %10.1f %12.1f\n", "exact", exact, exactMs, corners / (exactMs * 1000.0));
+	std::printf("%-14s %10u %10.1f %12.1f%s\n", "epsilon 1e-3", kept, weldMs, corners / (weldMs * 1000.0),
+		kept == mesh.positions.size() ? "" : "  weld mismatch");
+	soup = {};
+	remap = {};
+
+	std::vector<ObjVertex> vertices;
+	std::vector<std::uint32_t> indices;
+	timer.reset();
+	buildObjIndexed(mesh, vertices, indices);
+	const double buildMs = timer.milliseconds();
+	std::printf("buildObjIndexed: %zu vertices in %.1f ms%s\n", vertices.size(), buildMs,
+		vertices.size() == tableVertices ? "" : "  vertex count mismatch");
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include "../../Common/MeshAdjacency.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+namespace
+{
+	// An open tube, a skirt of sorts, with segments around and rings down;
+	// 2 * segments * (rings - 1) triangles sharing their vertices.
+	void buildTube(int segments, int rings, ObjMesh& mesh)
+	{
+		const float radius = 0.5f, height = 1.0f;
+		mesh.positions.clear();
+		mesh.indices.clear();
+		mesh.positions.reserve(static_cast<size_t>(segments) * rings);
+		mesh.indices.reserve(static_cast<size_t>(segments) * (rings - 1) * 6);
+		for (int i = 0; i < rings; ++i)
+		{
+			const float y = height * (1.0f - static_cast<float>(i) / (rings - 1));
+			for (int j = 0; j < segments; ++j)
+			{
+				const float a = 6.2831853f * j / segments;
+				mesh.positions.push_back(Vec3(radius * std::cos(a), y, radius * std::sin(a)));
+			}
+		}
+		for (int i = 0; i + 1 < rings; ++i)
+		{
+			for (int j = 0; j < segments; ++j)
+			{
+				const std::uint32_t a = static_cast<std::uint32_t>(i * segments + j);
+				const std::uint32_t b = static_cast<std::uint32_t>(i * segments + (j + 1) % segments);
+				const std::uint32_t c = a + segments, d = b + segments;
+				mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+			}
+		}
+	}
+
+	// A cone of segments around and rings down to an open rim. Every
+	// triangle of the top ring shares the apex, far more than the 64 colors
+	// one word of mask holds.
+	void buildCone(int segments, int rings, ObjMesh& mesh)
+	{
+		const float radius = 0.5f, height = 1.0f;
+		mesh.positions.clear();
+		mesh.indices.clear();
+		mesh.positions.push_back(Vec3(0.0f, height, 0.0f));
+		for (int i = 1; i <= rings; ++i)
+		{
+			const float t = static_cast<float>(i) / rings;
+			for (int j = 0; j < segments; ++j)
+			{
+				const float a = 6.2831853f * j / segments;
+				mesh.positions.push_back(Vec3(t * radius * std::cos(a), height * (1.0f - t), t * radius * std::sin(a)));
+			}
+		}
+		for (int j = 0; j < segments; ++j)
+		{
+			const std::uint32_t a = static_cast<std::uint32_t>(1 + j);
+			const std::uint32_t b = static_cast<std::uint32_t>(1 + (j + 1) % segments);
+			mesh.indices.insert(mesh.indices.end(), { 0, b, a });
+		}
+		for (int i = 1; i < rings; ++i)
+		{
+			for (int j = 0; j < segments; ++j)
+			{
+				const std::uint32_t a = static_cast<std::uint32_t>(1 + (i - 1) * segments + j);
+				const std::uint32_t b = static_cast<std::uint32_t>(1 + (i - 1) * segments + (j + 1) % segments);
+				const std::uint32_t c = a + segments, d = b + segments;
+				mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+			}
+		}
+	}
+
+	void report(const char* name, const ObjMesh& mesh, ThreadPool& pool, int repeats)
+	{
+		const std::uint32_t vertexCount = static_cast<std::uint32_t>(mesh.positions.size());
+		MeshAdjacency adjacency;
+		double serialMs = 0.0, parallelMs = 0.0;
+		for (int r = 0; r < repeats; ++r)
+		{
+			BenchTimer timer;
+			adjacency.build(mesh.indices, vertexCount, nullptr);
+			serialMs += timer.milliseconds();
+			timer.reset();
+			adjacency.build(mesh.indices, vertexCount, &pool);
+			parallelMs += timer.milliseconds();
+		}
+		serialMs /= repeats;
+		parallelMs /= repeats;
+
+		// The whole cloth build: adjacency, constraints, coloring, normals and wind.
+		ClothDesc desc;
+		BenchTimer timer;
+		Cloth cloth(desc, mesh, &pool);
+		const double clothMs = timer.milliseconds();
+		size_t bends = 0;
+		for (const DistanceConstraint& c : cloth.constraints())
+			bends += c.type == ClothConstraintType::Bend ? 1 : 0;
+
+		std::printf("%8s %9u %9u %9zu %9zu %7u %10.2f %10.2f %10.2f\n", name, mesh.triangleCount(), vertexCount,
+			adjacency.edges().size(), bends, cloth.colorCount(), serialMs, parallelMs, clothMs);
+		if (adjacency.boundaryEdgeCount() + adjacency.nonManifoldEdgeCount() + adjacency.degenerateTriangleCount() > 0)
+		{
+			std::printf("%8s %u boundary edges, %u non-manifold edges, %u degenerate triangles\n", "",
+				adjacency.boundaryEdgeCount(), adjacency.nonManifoldEdgeCount(), adjacency.degenerateTriangleCount());
+		}
+	}
+}
+
+// Load time of a mesh cloth: the edge adjacency on one thread and on the
+// pool, then the whole Cloth constructor, on the bunny, on tubes of 10k to
+// 1M triangles, and on a cone whose apex is shared by 200 triangles, which
+// needs more than 64 colors.
+void benchGarment(const BenchOptions& opt)
+{
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	const int repeats = opt.quick ? 2 : 5;
+	std::printf("%u threads\n", pool.threadCount());
+	std::printf("%8s %9s %9s %9s %9s %7s %10s %10s %10s\n", "mesh", "triangles", "vertices", "stretch", "bend", "colors",
+		"adj 1t ms", "adj ms", "cloth ms");
+
+	ObjMesh mesh;
+	if (loadBunny(opt, mesh))
+		report("bunny", mesh, pool, repeats);
+
+	const int sides[] = { 71, 224, 708 };
+	for (int side : sides)
+	{
+		if (opt.quick && side > 224)
+			break;
+		buildTube(side, side + 1, mesh);
+		char name[32];
+		std::snprintf(name, sizeof(name), "tube%d", side);
+		report(name, mesh, pool, repeats);
+	}
+	buildCone(200, 50, mesh);
+	report("cone200", mesh, pool, repeats);
+}
@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include "../../Common/ClothImplicit.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	struct SheetResult
+	{
+		double msPerFrame = 0.0;
+		double iterations = 0.0;
+		double solveMs = 0.0;
+		float maxStrain = 0.0f;
+		bool finite = true;
+	};
+
+	// Largest relative stretch over the springs, or infinity once a position is not finite.
+	float maxStrain(const ParticleStore& p, const std::vector<ImplicitSpring>& springs)
+	{
+		float strain = 0.0f;
+		for (const ImplicitSpring& s : springs)
+		{
+			float len = length(p.position(s.p1) - p.position(s.p0));
+			if (!std::isfinite(len))
+				return INFINITY;
+			strain = std::max(strain, std::fabs(len - s.restLength) / s.restLength);
+		}
+		return strain;
+	}
+}
+
+// A stiff sheet hanging from two corners, stepped at 60 Hz for two seconds:
+// backward Euler with one or two steps per frame against semi-implicit Euler
+// on the same springs with more and more substeps. A run counts as stable
+// while every position stays finite and no spring stretches past 50%.
+void benchImplicit(const BenchOptions& opt)
+{
+	ClothDesc desc;
+	desc.columns = opt.quick ? 32 : 64;
+	desc.rows = desc.columns;
+	desc.implicit.stretchStiffness = 5000.0f;
+	desc.implicit.shearStiffness = 500.0f;
+	desc.implicit.bendStiffness = 5.0f;
+	desc.integrator = ClothIntegrator::Implicit;
+	Cloth sheet(desc);
+	std::vector<ImplicitSpring> springs;
+	for (const DistanceConstraint& c : sheet.constraints())
+	{
+		ImplicitSpring s;
+		s.p0 = c.p0;
+		s.p1 = c.p1;
+		s.restLength = c.restLength;
+		s.stiffness = c.type == ClothConstraintType::Stretch ? desc.implicit.stretchStiffness
+			: c.type == ClothConstraintType::Shear ? desc.implicit.shearStiffness : desc.implicit.bendStiffness;
+		springs.push_back(s);
+	}
+
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	const int frames = opt.quick ? 60 : 120;
+	const float frameDt = 1.0f / 60.0f;
+
+	auto run = [&](bool implicit, int substeps) {
+		ParticleStore p = sheet.particles();
+		ClothImplicit solver;
+		solver.setDesc(desc.implicit);
+		solver.build(springs, static_cast<std::uint32_t>(p.size()));
+		IntegrateParams params;
+		params.dt = frameDt / substeps;
+		params.gravity = desc.gravity;
+		params.damping = std::max(0.0f, 1.0f - desc.damping * params.dt);
+		SheetResult result;
+		long long solves = 0;
+		BenchTimer timer;
+		for (int f = 0; f < frames && result.finite; ++f)
+		{
+			for (int s = 0; s < substeps; ++s)
+			{
+				if (implicit)
+				{
+					solver.step(p, params, &pool);
+					result.iterations += solver.lastIterations();
+					result.solveMs += 1000.0 * solver.lastSolveSeconds();
+					++solves;
+				}
+				else
+				{
+					solver.stepExplicit(p, params, &pool);
+				}
+			}
+			float strain = maxStrain(p, springs);
+			result.maxStrain = std::max(result.maxStrain, strain);
+			result.finite = strain < 0.5f;
+		}
+		result.msPerFrame = timer.milliseconds() / frames;
+		if (solves > 0)
+		{
+			result.iterations /= solves;
+			result.solveMs /= solves;
+		}
+		return result;
+	};
+
+	std::printf("%dx%d particles, %zu springs, %u block nonzeros\n", desc.columns, desc.rows, springs.size(),
+		static_cast<unsigned>(sheet.implicitSolver().matrix().columns.size()));
+	std::printf("%10s %9s %8s %10s %11s %11s %10s\n", "integrator", "substeps", "stable", "ms/frame", "CG it/step", "CG ms/step", "max strain");
+	const int implicitSteps[] = { 1, 2 };
+	for (int substeps : implicitSteps)
+	{
+		SheetResult r = run(true, substeps);
+		std::printf("%10s %9d %8s %10.3f %11.1f %11.3f %10.4f\n", "implicit", substeps, r.finite ? "yes" : "no",
+			r.msPerFrame, r.iterations, r.solveMs, r.maxStrain);
+	}
+	const int explicitSteps[] = { 1, 8, 32, 64, 128, 256 };
+	for (int substeps : explicitSteps)
+	{
+		SheetResult r = run(false, substeps);
+		std::printf("%10s %9d %8s %10.3f %11s %11s %10.4f\n", "explicit", substeps, r.finite ? "yes" : "no",
+			r.msPerFrame, "-", "-", r.finite ? r.maxStrain : INFINITY);
+	}
+
+	// The SpMV kernel alone.
+	const BsrMatrix& a = sheet.implicitSolver().matrix();
+	AlignedVector<float> x(4 * static_cast<size_t>(a.rows), 1.0f), y(x.size());
+	const int repeats = opt.quick ? 50 : 200;
+	std::printf("%10s %8s %10s %12s\n", "spmv", "threads", "ms", "Gblock/s");
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, detectSimdLevel() };
+	for (SimdLevel level : levels)
+	{
+		for (int threaded = 0; threaded < 2; ++threaded)
+		{
+			BenchTimer timer;
+			for (int r = 0; r < repeats; ++r)
+			{
+				if (threaded != 0)
+				{
+					pool.parallelFor(a.rows, 1024, [&](std::uint32_t begin, std::uint32_t end, unsigned) {
+						multiplyBsr(a, x.data(), y.data(), level, begin, end);
+					});
+				}
+				else
+				{
+					multiplyBsr(a, x.data(), y.data(), level, 0, a.rows);
+				}
+			}
+			double ms = timer.milliseconds() / repeats;
+			std::printf("%10s %8u %10.4f %12.3f\n", simdLevelName(level), threaded != 0 ? pool.threadCount() : 1u, ms,
+				a.columns.size() / (ms * 1.0e6));
+		}
+	}
+}
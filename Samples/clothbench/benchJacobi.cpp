@@ -0,0 +1,122 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// The same stretched, weightless sheet as the multigrid benchmark: every
+	// particle at 120% of its rest offset plus some noise.
+	void stretchSheet(Cloth& cloth, const ClothDesc& desc)
+	{
+		std::uint32_t seed = 12345;
+		auto noise = [&seed]() {
+			seed = seed * 1664525u + 1013904223u;
+			return static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+		};
+		const float amplitude = 0.3f * desc.width / (desc.columns - 1);
+		for (int i = 0; i < desc.rows; ++i)
+		{
+			for (int j = 0; j < desc.columns; ++j)
+			{
+				std::uint32_t k = cloth.index(i, j);
+				Vec3 offset = cloth.position(k) - desc.origin;
+				Vec3 p = desc.origin + offset * 1.2f + Vec3(noise(), noise(), noise()) * amplitude;
+				cloth.setPosition(k, p);
+			}
+		}
+	}
+
+	struct Variant
+	{
+		const char* name;
+		ClothSolver solver;
+		float rho;
+	};
+
+	ClothDesc sheetDesc(int n, int iterations, const Variant& v)
+	{
+		ClothDesc desc;
+		desc.columns = n;
+		desc.rows = n;
+		desc.gravity = Vec3();
+		desc.damping = 0.0f;
+		desc.substeps = 1;
+		desc.iterations = iterations;
+		desc.pinCorners = false;
+		desc.solver = v.solver;
+		desc.chebyshevRho = v.rho;
+		return desc;
+	}
+}
+
+// Gauss-Seidel against Jacobi, plain and with Chebyshev acceleration at a few
+// spectral radius estimates. The first table takes one step of the stretched
+// sheet with a growing number of iterations and gives the residual left; the
+// second gives the time per iteration on 1 to 32 threads.
+void benchJacobi(const BenchOptions& opt)
+{
+	const Variant variants[] = {
+		{ "gs", ClothSolver::GaussSeidel, 0.0f },
+		{ "jacobi", ClothSolver::Jacobi, 0.0f },
+		{ "cheb .90", ClothSolver::Jacobi, 0.90f },
+		{ "cheb .99", ClothSolver::Jacobi, 0.99f },
+		{ "cheb .995", ClothSolver::Jacobi, 0.995f },
+	};
+	const int n = opt.quick ? 64 : 128;
+	const int iterationCounts[] = { 4, 8, 16, 32, 64, 128, 256 };
+	std::printf("grid %dx%d, stretch residual after one step\n", n, n);
+	std::printf("%10s", "iterations");
+	for (const Variant& v : variants)
+		std::printf(" %10s", v.name);
+	std::printf("\n");
+	for (int it : iterationCounts)
+	{
+		if (opt.quick && it > 64)
+			break;
+		std::printf("%10d", it);
+		for (const Variant& v : variants)
+		{
+			ClothDesc desc = sheetDesc(n, it, v);
+			Cloth cloth(desc);
+			stretchSheet(cloth, desc);
+			cloth.step(1.0f / 60.0f);
+			std::printf(" %10.2e", cloth.stretchResidual());
+		}
+		std::printf("\n");
+	}
+
+	const int big = opt.quick ? 128 : 512;
+	const int iterations = 16;
+	const double minSeconds = opt.quick ? 0.2 : 1.0;
+	const unsigned threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+	std::printf("grid %dx%d, %d iterations per step, %u hardware threads, ms per iteration\n", big, big, iterations,
+		std::thread::hardware_concurrency());
+	std::printf("%8s %10s %10s %10s %10s\n", "threads", "gs", "speedup", variants[3].name, "speedup");
+	double baseline[2] = { 0.0, 0.0 };
+	for (unsigned threads : threadCounts)
+	{
+		if (opt.quick && threads > 4)
+			break;
+		ThreadPool pool(threads);
+		double ms[2];
+		for (int j = 0; j < 2; ++j)
+		{
+			Cloth cloth(sheetDesc(big, iterations, variants[j == 0 ? 0 : 3]));
+			cloth.setThreadPool(&pool);
+			cloth.step(1.0f / 60.0f);
+			int steps = 0;
+			BenchTimer timer;
+			do
+			{
+				cloth.step(1.0f / 60.0f);
+				++steps;
+			} while (timer.seconds() < minSeconds || steps < 3);
+			ms[j] = timer.milliseconds() / (steps * static_cast<double>(iterations));
+			if (threads == 1)
+				baseline[j] = ms[j];
+		}
+		std::printf("%8u %10.3f %10.2f %10.3f %10.2f\n", threads, ms[0], baseline[0] / ms[0], ms[1], baseline[1] / ms[1]);
+	}
+}
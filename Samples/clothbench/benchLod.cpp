@@ -0,0 +1,109 @@
+#include "bench.h"
+#include "../../Common/ClothLod.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	Vec3 totalMomentum(const Cloth& cloth)
+	{
+		const ParticleStore& p = cloth.particles();
+		Vec3 sum;
+		for (size_t i = 0; i < p.size(); ++i)
+		{
+			if (p.invMass[i] != 0.0f)
+				sum += p.velocity(i) * (1.0f / p.invMass[i]);
+		}
+		return sum;
+	}
+
+	// Walk the camera back and forth across the distance where level 0 hands
+	// over to level 1, with a little jitter, and count the switches.
+	int countSwitches(float hysteresis, float pixelsPerUnit)
+	{
+		ClothLodDesc desc;
+		desc.cloth.columns = 32;
+		desc.cloth.rows = 32;
+		desc.hysteresis = hysteresis;
+		ClothLod lod(desc);
+		// Level 1 shows exactly the largest allowed error here.
+		const float switchDistance = lod.screenError(1, 1.0f, pixelsPerUnit) / desc.maxPixelError;
+		const Vec3 center = desc.cloth.origin;
+		int switches = 0;
+		for (int frame = 0; frame < 600; ++frame)
+		{
+			float d = switchDistance * (1.0f + 0.5f * std::sin(0.02f * frame) + 0.03f * std::sin(1.7f * frame));
+			if (lod.update(center + Vec3(0.0f, d, 0.0f), pixelsPerUnit))
+				++switches;
+		}
+		return switches;
+	}
+
+	// Largest change, over the particles of the new level, of the wind they
+	// feel when a gusty sheet switches level: the wind at the time the old
+	// level reached against the wind at the new level's own time.
+	float windJump()
+	{
+		ClothLodDesc desc;
+		desc.cloth.columns = 32;
+		desc.cloth.rows = 32;
+		desc.cloth.wind.velocity = Vec3(1.0f, 0.0f, 0.5f);
+		desc.cloth.wind.turbulence = 1.0f;
+		ClothLod lod(desc);
+		for (int s = 0; s < 90; ++s)
+			lod.step(1.0f / 60.0f);
+		const float before = lod.cloth().time();
+		lod.setLevel(1);
+		const Cloth& cloth = lod.cloth();
+		float jump = 0.0f;
+		for (std::uint32_t i = 0; i < cloth.particleCount(); ++i)
+		{
+			const Vec3 p = cloth.position(i);
+			jump = std::max(jump, length(cloth.wind().windAt(p, cloth.time()) - cloth.wind().windAt(p, before)));
+		}
+		return jump;
+	}
+}
+
+// Particle count and step time of every level, the momentum and wind carried
+// through a switch, and how often a jittering camera switches with and
+// without hysteresis.
+void benchLod(const BenchOptions& opt)
+{
+	const float dt = 1.0f / 60.0f;
+	const double minSeconds = opt.quick ? 0.2 : 1.0;
+	ClothLodDesc desc;
+	desc.cloth.columns = opt.quick ? 128 : 256;
+	desc.cloth.rows = desc.cloth.columns;
+	desc.levels = 4;
+	ClothLod lod(desc);
+	// Let the sheet fall and swing for a second so there is momentum to carry.
+	for (int s = 0; s < 60; ++s)
+		lod.step(dt);
+
+	std::printf("%6s %10s %12s %16s %16s\n", "level", "grid", "ms/step", "momentum before", "momentum after");
+	for (int l = 0; l < lod.levelCount(); ++l)
+	{
+		Vec3 before = totalMomentum(lod.cloth());
+		lod.setLevel(l);
+		Vec3 after = totalMomentum(lod.cloth());
+		lod.resetStats();
+		BenchTimer timer;
+		do
+		{
+			lod.step(dt);
+		} while (timer.seconds() < minSeconds || lod.stats()[l].steps < 3);
+		const ClothLodStats& stats = lod.stats()[l];
+		const ClothDesc& c = lod.levelCloth(l).desc();
+		std::printf("%6d %4dx%-5d %12.3f %16.5f %16.5f\n", l, c.columns, c.rows,
+			1000.0 * stats.seconds / stats.steps, length(before), length(after));
+	}
+	for (int l = 0; l < lod.levelCount(); ++l)
+		std::printf("level %d: %u particles\n", l, lod.stats()[l].particles);
+	std::printf("wind jump across a switch in 1 m/s gusts: %.5f m/s\n", windJump());
+
+	// 600 pixel viewport with the 45 degree field of view of the samples.
+	const float pixelsPerUnit = 300.0f / std::tan(0.125f * 3.14159265f);
+	std::printf("switches while jittering around a switch distance: %d without hysteresis, %d with 0.3\n",
+		countSwitches(0.0f, pixelsPerUnit), countSwitches(0.3f, pixelsPerUnit));
+}
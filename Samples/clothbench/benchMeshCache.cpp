@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "../../Common/MeshCache.h"
+#include "../../Common/VertexCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void report(const char* name, const std::string& objFileName, ThreadPool& pool)
+	{
+		const char* cacheFileName = "clothbench.mcache";
+		std::remove(cacheFileName);
+
+		// Without a cache: parse, build and order the vertices and indices,
+		// and copy them into the staging memory createDefaultBuffer would fill.
+		std::vector<std::uint8_t> staging;
+		BenchTimer timer;
+		ObjMesh mesh;
+		loadObj(objFileName, mesh, &pool);
+		std::vector<ObjVertex> vertices;
+		std::vector<std::uint32_t> indices;
+		buildObjIndexed(mesh, vertices, indices);
+		optimizeVertexCache(indices.data(), indices.size());
+		staging.resize(vertices.size() * sizeof(ObjVertex) + indices.size() * sizeof(std::uint32_t));
+		std::memcpy(staging.data(), vertices.data(), vertices.size() * sizeof(ObjVertex));
+		std::memcpy(staging.data() + vertices.size() * sizeof(ObjVertex), indices.data(), indices.size() * sizeof(std::uint32_t));
+		const double textMs = timer.milliseconds();
+
+		MeshCache cache;
+		bool rebuilt = false;
+		timer.reset();
+		const bool converted = loadObjCached(objFileName, cacheFileName, name, cache, &pool, &rebuilt) && rebuilt;
+		const double coldMs = timer.milliseconds();
+		cache.close();
+
+		timer.reset();
+		const bool reused = loadObjCached(objFileName, cacheFileName, name, cache, &pool, &rebuilt) && !rebuilt;
+		const double warmMs = timer.milliseconds();
+		timer.reset();
+		std::memcpy(staging.data(), cache.vertices(), cache.vertexByteSize());
+		std::memcpy(staging.data() + cache.vertexByteSize(), cache.indices(), cache.indexByteSize());
+		const double uploadMs = timer.milliseconds();
+		timer.reset();
+		const bool valid = cache.verify();
+		const double verifyMs = timer.milliseconds();
+		const double cacheMB = static_cast<double>(cache.header().fileSize) / (1024.0 * 1024.0);
+		const bool same = cache.vertexByteSize() == vertices.size() * sizeof(ObjVertex) &&
+			std::memcmp(cache.vertices(), vertices.data(), cache.vertexByteSize()) == 0;
+		cache.close();
+
+		timer.reset();
+		cache.open(cacheFileName);
+		const double openMs = timer.milliseconds();
+		cache.close();
+		std::remove(cacheFileName);
+
+		std::printf("%-8s %9.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %9.1fx%s\n", name, cacheMB, textMs, coldMs,
+			warmMs, openMs, warmMs + uploadMs, verifyMs, textMs / (warmMs + uploadMs),
+			converted && reused && valid && same ? "" : "  cache mismatch");
+	}
+}
+
+// Startup cost of a mesh, cold against warm: parsing the OBJ into uploadable
+// vertices, converting it into a mesh cache, and a launch that finds the
+// cache valid. Warm hashes the OBJ to check the cache and maps it; open is
+// the mapping alone, and warm + copy adds the copy into staging memory that
+// createDefaultBuffer makes either way. Verify reads the whole cache to
+// check its checksum. On the bunny and on a grid of about 500 MB of OBJ
+// text (20 MB with --quick).
+void benchMeshCache(const BenchOptions& opt)
+{
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	std::printf("%u threads\n", pool.threadCount());
+	std::printf("%-8s %9s %10s %10s %10s %10s %10s %10s %10s\n", "file", "cache MB", "text ms", "cold ms",
+		"warm ms", "open ms", "warm+copy", "verify ms", "speedup");
+	const std::string bunny = findBunny(opt);
+	if (bunny.empty())
+		std::printf("bunny.obj not found, pass --bunny <path>\n");
+	else
+		report("bunny", bunny, pool);
+
+	const char* fileName = "clothbench.obj";
+	if (writeGridObj(fileName, opt.quick ? 460 : 2300) == 0)
+	{
+		std::printf("cannot write %s\n", fileName);
+		return;
+	}
+	report("grid", fileName, pool);
+	std::remove(fileName);
+}
@@ -0,0 +1,120 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// A weightless sheet with its particles scattered to 120% of the rest
+	// size plus some noise, so the stretch error covers every wavelength.
+	void stretchSheet(Cloth& cloth, const ClothDesc& desc)
+	{
+		std::uint32_t seed = 12345;
+		auto noise = [&seed]() {
+			seed = seed * 1664525u + 1013904223u;
+			return static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+		};
+		const float amplitude = 0.3f * desc.width / (desc.columns - 1);
+		for (int i = 0; i < desc.rows; ++i)
+		{
+			for (int j = 0; j < desc.columns; ++j)
+			{
+				std::uint32_t k = cloth.index(i, j);
+				Vec3 offset = cloth.position(k) - desc.origin;
+				Vec3 p = desc.origin + offset * 1.2f + Vec3(noise(), noise(), noise()) * amplitude;
+				cloth.setPosition(k, p);
+			}
+		}
+	}
+
+	ClothDesc sheetDesc(int n, int iterations, int coarseLevels)
+	{
+		ClothDesc desc;
+		desc.columns = n;
+		desc.rows = n;
+		desc.gravity = Vec3();
+		desc.damping = 0.0f;
+		desc.substeps = 1;
+		desc.iterations = iterations;
+		desc.coarseLevels = coarseLevels;
+		desc.pinCorners = false;
+		return desc;
+	}
+
+	struct Sample
+	{
+		int iterations = 0;
+		double ms = 0.0;
+		float residual = 0.0f;
+	};
+
+	Sample solve(int n, int iterations, int coarseLevels)
+	{
+		ClothDesc desc = sheetDesc(n, iterations, coarseLevels);
+		Cloth cloth(desc);
+		stretchSheet(cloth, desc);
+		BenchTimer timer;
+		cloth.step(1.0f / 60.0f);
+		Sample s;
+		s.iterations = iterations;
+		s.ms = timer.milliseconds();
+		s.residual = cloth.stretchResidual();
+		return s;
+	}
+
+	// First sample at or below the target residual.
+	const Sample* reach(const std::vector<Sample>& samples, float target)
+	{
+		for (const Sample& s : samples)
+		{
+			if (s.residual <= target)
+				return &s;
+		}
+		return nullptr;
+	}
+}
+
+// Residual against wall clock time for the flat solver and the V-cycle. Both
+// start from the same stretched sheet and take one step with a growing
+// number of iterations; the table at the end compares the time each needs
+// to reach the same residual.
+void benchMultigrid(const BenchOptions& opt)
+{
+	const int sizes[] = { 256, 1024 };
+	const int iterationCounts[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	const int levels = 8;
+	for (int n : sizes)
+	{
+		if (opt.quick && n > 256)
+			continue;
+		{
+			Cloth probe(sheetDesc(n, 1, levels));
+			std::printf("grid %dx%d, %u levels\n", n, n, probe.levelCount());
+		}
+		std::printf("%10s %12s %12s %12s %12s\n", "iterations", "flat ms", "flat resid", "vcycle ms", "vcycle resid");
+		std::vector<Sample> flat, vcycle;
+		for (int it : iterationCounts)
+		{
+			if (opt.quick && it > 32)
+				break;
+			flat.push_back(solve(n, it, 0));
+			vcycle.push_back(solve(n, it, levels));
+			std::printf("%10d %12.2f %12.2e %12.2f %12.2e\n", it, flat.back().ms, flat.back().residual,
+				vcycle.back().ms, vcycle.back().residual);
+		}
+
+		std::printf("%12s %16s %16s\n", "residual", "flat ms", "vcycle ms");
+		const float targets[] = { 1e-1f, 3e-2f, 1e-2f, 3e-3f, 1e-3f };
+		for (float target : targets)
+		{
+			const Sample* f = reach(flat, target);
+			const Sample* v = reach(vcycle, target);
+			char flatText[32] = "-", vcycleText[32] = "-";
+			if (f != nullptr)
+				std::snprintf(flatText, sizeof(flatText), "%.2f (%d it)", f->ms, f->iterations);
+			if (v != nullptr)
+				std::snprintf(vcycleText, sizeof(vcycleText), "%.2f (%d it)", v->ms, v->iterations);
+			std::printf("%12.0e %16s %16s\n", target, flatText, vcycleText);
+		}
+	}
+}
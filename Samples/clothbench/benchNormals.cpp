@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "../../Common/MeshNormals.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	struct GridMesh
+	{
+		int n = 0;
+		AlignedVector<float> x, y, z;
+		std::vector<std::uint32_t> indices;
+	};
+
+	GridMesh makeGrid(int n)
+	{
+		GridMesh g;
+		g.n = n;
+		const size_t count = static_cast<size_t>(n) * n;
+		g.x.resize(count);
+		g.y.resize(count);
+		g.z.resize(count);
+		for (int i = 0; i < n; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				size_t k = static_cast<size_t>(i) * n + j;
+				g.x[k] = static_cast<float>(j) / n;
+				g.y[k] = 0.05f * std::sin(0.1f * i) * std::cos(0.13f * j);
+				g.z[k] = static_cast<float>(i) / n;
+			}
+		}
+		g.indices.reserve(static_cast<size_t>(n - 1) * (n - 1) * 6);
+		for (int i = 0; i + 1 < n; ++i)
+		{
+			for (int j = 0; j + 1 < n; ++j)
+			{
+				std::uint32_t a = i * n + j, b = a + 1, c = a + n, d = c + 1;
+				const std::uint32_t quad[6] = { a, b, c, c, b, d };
+				g.indices.insert(g.indices.end(), quad, quad + 6);
+			}
+		}
+		return g;
+	}
+
+	// Raise a square patch holding about fraction of the vertices and list them.
+	std::vector<std::uint32_t> movePatch(GridMesh& g, double fraction, float lift)
+	{
+		const int side = std::max(1, static_cast<int>(std::sqrt(fraction) * g.n));
+		const int first = (g.n - side) / 2;
+		std::vector<std::uint32_t> moved;
+		for (int i = first; i < first + side; ++i)
+		{
+			for (int j = first; j < first + side; ++j)
+			{
+				std::uint32_t k = i * g.n + j;
+				g.y[k] += lift;
+				moved.push_back(k);
+			}
+		}
+		return moved;
+	}
+
+	template<typename Fn>
+	double averageMs(int repeats, Fn fn)
+	{
+		BenchTimer timer;
+		for (int r = 0; r < repeats; ++r)
+			fn();
+		return timer.milliseconds() / repeats;
+	}
+}
+
+// Full vertex normal rebuild against the dirty region rebuild on a grid with
+// a million vertices.
+void benchNormals(const BenchOptions& opt)
+{
+	const int n = opt.quick ? 256 : 1000;
+	const int repeats = opt.quick ? 5 : 20;
+	GridMesh g = makeGrid(n);
+	MeshNormals normals;
+	BenchTimer buildTimer;
+	normals.build(g.indices, static_cast<std::uint32_t>(g.x.size()));
+	std::printf("%zu vertices, %zu triangles, adjacency built in %.1f ms\n",
+		g.x.size(), g.indices.size() / 3, buildTimer.milliseconds());
+
+	ThreadPool pool;
+	const SimdLevel best = detectSimdLevel();
+	std::printf("%-8s %8s %12s\n", "simd", "threads", "full ms");
+	for (SimdLevel level : { SimdLevel::Scalar, best })
+	{
+		normals.setSimdLevel(level);
+		for (ThreadPool* p : { static_cast<ThreadPool*>(nullptr), &pool })
+		{
+			if (p != nullptr && pool.threadCount() == 1)
+				continue;
+			double ms = averageMs(repeats, [&]() { normals.compute(g.x.data(), g.y.data(), g.z.data(), p); });
+			std::printf("%-8s %8u %12.3f\n", simdLevelName(level), p != nullptr ? p->threadCount() : 1u, ms);
+		}
+		if (best == SimdLevel::Scalar)
+			break;
+	}
+
+	normals.setSimdLevel(best);
+	ThreadPool* p = pool.threadCount() > 1 ? &pool : nullptr;
+	std::printf("%-10s %10s %10s %12s %12s %10s\n", "moved", "faces", "vertices", "dirty ms", "full ms", "max diff");
+	for (double fraction : { 0.001, 0.01, 0.1 })
+	{
+		normals.compute(g.x.data(), g.y.data(), g.z.data(), p);
+		std::vector<std::uint32_t> moved = movePatch(g, fraction, 0.01f);
+		double dirtyMs = averageMs(repeats, [&]() {
+			normals.computeDirty(g.x.data(), g.y.data(), g.z.data(), moved.data(), static_cast<std::uint32_t>(moved.size()), p);
+		});
+		std::uint32_t faces = normals.lastFaceCount();
+		std::uint32_t vertices = normals.lastVertexCount();
+		std::vector<Vec3> dirty = normals.normals();
+		double fullMs = averageMs(repeats, [&]() { normals.compute(g.x.data(), g.y.data(), g.z.data(), p); });
+		float maxDiff = 0.0f;
+		for (size_t i = 0; i < dirty.size(); ++i)
+			maxDiff = std::max(maxDiff, length(dirty[i] - normals.normals()[i]));
+		std::printf("%9.1f%% %10u %10u %12.3f %12.3f %10.2g\n", 100.0 * fraction, faces, vertices, dirtyMs, fullMs, maxDiff);
+	}
+}
@@ -0,0 +1,189 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// The loader as it was before: getline into a string, then an
+	// istringstream per line. Kept as the reference for speed and results.
+	bool loadObjStream(const std::string& fileName, ObjMesh& mesh)
+	{
+		std::ifstream fin(fileName);
+		if (!fin)
+			return false;
+		mesh.positions.clear();
+		mesh.indices.clear();
+		std::string line, token;
+		std::vector<std::uint32_t> face;
+		while (std::getline(fin, line))
+		{
+			std::istringstream ss(line);
+			if (!(ss >> token))
+				continue;
+			if (token == "v")
+			{
+				Vec3 p;
+				ss >> p.x >> p.y >> p.z;
+				mesh.positions.push_back(p);
+			}
+			else if (token == "f")
+			{
+				face.clear();
+				while (ss >> token)
+					face.push_back(static_cast<std::uint32_t>(std::stol(token) - 1));
+				for (size_t k = 2; k < face.size(); ++k)
+					mesh.indices.insert(mesh.indices.end(), { face[0], face[k - 1], face[k] });
+			}
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool identicalArray(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	bool identicalMesh(const ObjMesh& a, const ObjMesh& b)
+	{
+		return identicalArray(a.positions, b.positions) && identicalArray(a.texCoords, b.texCoords) &&
+			identicalArray(a.normals, b.normals) && identicalArray(a.indices, b.indices) &&
+			identicalArray(a.texCoordIndices, b.texCoordIndices) && identicalArray(a.normalIndices, b.normalIndices);
+	}
+
+	// A grid of v lines and "f v//vn" faces over several parse chunks, with
+	// the normals halfway through and a single vt line after the last face:
+	// the corners before the normals and every texture coordinate index are
+	// NoIndex, whichever way the text is split.
+	std::string attributeObj(int side)
+	{
+		std::string text;
+		char line[96];
+		for (int y = 0; y <= side; ++y)
+		{
+			for (int x = 0; x <= side; ++x)
+			{
+				std::snprintf(line, sizeof(line), "v %d 0 %d\n", x, y);
+				text += line;
+			}
+		}
+		for (int y = 0; y < side; ++y)
+		{
+			if (y == side / 2)
+				text += "vn 0 1 0\n";
+			for (int x = 0; x < side; ++x)
+			{
+				const int a = y * (side + 1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+				if (y < side / 2)
+					std::snprintf(line, sizeof(line), "f %d %d %d %d\n", a, c, d, b);
+				else
+					std::snprintf(line, sizeof(line), "f %d//1 %d//1 %d//1 %d//1\n", a, c, d, b);
+				text += line;
+			}
+		}
+		text += "vt 0.5 0.5\n";
+		return text;
+	}
+
+	bool sameMesh(const ObjMesh& a, const ObjMesh& b)
+	{
+		if (a.positions.size() != b.positions.size() || a.indices != b.indices)
+			return false;
+		for (size_t i = 0; i < a.positions.size(); ++i)
+		{
+			if (a.positions[i].x != b.positions[i].x || a.positions[i].y != b.positions[i].y || a.positions[i].z != b.positions[i].z)
+				return false;
+		}
+		return true;
+	}
+
+	void report(const char* name, const std::string& fileName, double megabytes, int repeats)
+	{
+		ObjMesh mesh, reference;
+		BenchTimer timer;
+		for (int r = 0; r < repeats; ++r)
+			loadObjStream(fileName, reference);
+		const double streamSeconds = timer.seconds() / repeats;
+		timer.reset();
+		for (int r = 0; r < repeats; ++r)
+			loadObj(fileName, mesh);
+		const double mappedSeconds = timer.seconds() / repeats;
+		timer.reset();
+		std::vector<ObjVertex> vertices;
+		buildObjVertices(mesh, vertices);
+		const double vertexMs = timer.milliseconds();
+		std::printf("%-8s %9.2f %10zu %10u %12.1f %12.1f %9.1fx %10.2f%s\n", name, megabytes, mesh.positions.size(), mesh.triangleCount(),
+			megabytes / streamSeconds, megabytes / mappedSeconds, streamSeconds / mappedSeconds, vertexMs,
+			sameMesh(mesh, reference) ? "" : "  mismatch");
+	}
+}
+
+// OBJ parsing throughput: the loader mapping the file and parsing it in
+// place against the getline and istringstream loader it replaced, on the
+// bunny and on a generated grid of about 500 MB (20 MB with --quick), with
+// the time to build the uploadable vertex array. Then the strong scaling of
+// the chunked parse on the grid, checked byte for byte against the serial
+// parse, and the same check on a file whose normals and texture coordinates
+// are declared after the faces that start using them.
+void benchObj(const BenchOptions& opt)
+{
+	std::printf("%-8s %9s %10s %10s %12s %12s %10s %10s\n", "file", "MB", "vertices", "triangles",
+		"stream MB/s", "mapped MB/s", "speedup", "vertex ms");
+	const std::string bunny = findBunny(opt);
+	if (bunny.empty())
+	{
+		std::printf("bunny.obj not found, pass --bunny <path>\n");
+	}
+	else
+	{
+		std::ifstream probe(bunny, std::ios::binary | std::ios::ate);
+		report("bunny", bunny, static_cast<double>(probe.tellg()) / (1024.0 * 1024.0), opt.quick ? 5 : 50);
+	}
+
+	const char* fileName = "clothbench.obj";
+	const int side = opt.quick ? 460 : 2300;
+	const size_t bytes = writeGridObj(fileName, side);
+	if (bytes == 0)
+	{
+		std::printf("cannot write %s\n", fileName);
+		return;
+	}
+	const double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+	report("grid", fileName, megabytes, 1);
+
+	ObjMesh serial;
+	loadObj(fileName, serial);
+	const unsigned threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+	const int repeats = opt.quick ? 3 : 2;
+	std::printf("\n%u hardware threads\n", std::thread::hardware_concurrency());
+	std::printf("%8s %12s %10s\n", "threads", "MB/s", "speedup");
+	double baseline = 0.0;
+	for (unsigned threads : threadCounts)
+	{
+		if (opt.quick && threads > 4)
+			break;
+		ThreadPool pool(threads);
+		ObjMesh mesh;
+		BenchTimer timer;
+		for (int r = 0; r < repeats; ++r)
+			loadObj(fileName, mesh, &pool);
+		const double rate = megabytes * repeats / timer.seconds();
+		if (threads == 1)
+			baseline = rate;
+		std::printf("%8u %12.1f %10.2f%s\n", threads, rate, rate / baseline, identicalMesh(mesh, serial) ? "" : "  differs from serial");
+	}
+	std::remove(fileName);
+
+	// Attributes declared late must come out the same serially and chunked.
+	const std::string text = attributeObj(opt.quick ? 300 : 600);
+	ThreadPool pool(4);
+	ObjMesh chunked;
+	const bool parsed = parseObj(text.data(), text.size(), serial) && parseObj(text.data(), text.size(), chunked, &pool);
+	std::printf("\nlate vt/vn, %.1f MB: %zu texture coordinate and %zu normal indices, %s\n",
+		static_cast<double>(text.size()) / (1024.0 * 1024.0), chunked.texCoordIndices.size(), chunked.normalIndices.size(),
+		parsed && identicalMesh(serial, chunked) ? "serial and chunked identical" : "serial and chunked differ");
+}
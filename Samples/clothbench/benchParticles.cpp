@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "../../Common/ParticleStore.h"
+#include <vector>
+
+namespace
+{
+	// The layout the integrator would see if it worked on Vertex-like structs.
+	struct AosParticle
+	{
+		Vec3 pos;
+		Vec3 prev;
+		Vec3 vel;
+		float invMass;
+	};
+
+	void eulerAos(std::vector<AosParticle>& particles, const IntegrateParams& params)
+	{
+		const Vec3 gdt = params.gravity * params.dt;
+		for (auto& p : particles)
+		{
+			p.prev = p.pos;
+			if (p.invMass == 0.0f)
+			{
+				p.vel = Vec3();
+				continue;
+			}
+			p.vel = (p.vel + gdt) * params.damping;
+			p.pos += p.vel * params.dt;
+		}
+	}
+
+	template<typename Fn>
+	double runFor(double minSeconds, Fn&& fn, int& iterations)
+	{
+		iterations = 0;
+		BenchTimer timer;
+		do
+		{
+			fn();
+			++iterations;
+		} while (timer.seconds() < minSeconds);
+		return timer.seconds();
+	}
+}
+
+// Integrator throughput: scalar AoS loop against the SoA kernels at every
+// SIMD level the machine supports.
+void benchParticles(const BenchOptions& opt)
+{
+	const size_t count = opt.quick ? (1 << 16) : (1 << 20);
+	const double minSeconds = opt.quick ? 0.1 : 1.0;
+	IntegrateParams params;
+	params.dt = 1.0f / 240.0f;
+	params.damping = 0.999f;
+
+	std::vector<AosParticle> aos(count);
+	ParticleStore soa;
+	soa.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float w = (i % 97 == 0) ? 0.0f : 1.0f;
+		Vec3 p(float(i % 1024), 0.0f, float(i / 1024));
+		aos[i] = { p, p, Vec3(), w };
+		soa.setPosition(i, p);
+		soa.setPrevPosition(i, p);
+		soa.setVelocity(i, Vec3());
+		soa.invMass[i] = w;
+	}
+
+	std::printf("%zu particles, cpu supports %s\n", count, simdLevelName(detectSimdLevel()));
+	std::printf("%-24s %14s %10s\n", "kernel", "Mparticles/s", "speedup");
+	int iterations = 0;
+	double seconds = runFor(minSeconds, [&]() { eulerAos(aos, params); }, iterations);
+	const double baseline = count * double(iterations) / seconds;
+	std::printf("%-24s %14.1f %10.2f\n", "euler aos scalar", baseline * 1e-6, 1.0);
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 };
+	for (SimdLevel level : levels)
+	{
+		if (level > detectSimdLevel())
+			break;
+		char name[64];
+		std::snprintf(name, sizeof(name), "euler soa %s", simdLevelName(level));
+		seconds = runFor(minSeconds, [&]() { integrateSemiImplicitEuler(soa, params, level); }, iterations);
+		double rate = count * double(iterations) / seconds;
+		std::printf("%-24s %14.1f %10.2f\n", name, rate * 1e-6, rate / baseline);
+
+		std::snprintf(name, sizeof(name), "verlet soa %s", simdLevelName(level));
+		seconds = runFor(minSeconds, [&]() { integrateVerlet(soa, params, level); }, iterations);
+		rate = count * double(iterations) / seconds;
+		std::printf("%-24s %14.1f %10.2f\n", name, rate * 1e-6, rate / baseline);
+	}
+}
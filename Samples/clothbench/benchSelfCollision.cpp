@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include "../../Common/SpatialHash.h"
+#include <thread>
+
+namespace
+{
+	// An n x n sheet folded in half along z, the second half lying just above
+	// the first, which is what the hash sees when a cloth folds onto itself.
+	void buildFoldedSheet(ParticleStore& p, int n, float spacing, float gap)
+	{
+		p.resize(static_cast<size_t>(n) * n);
+		for (int i = 0; i < n; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				size_t k = static_cast<size_t>(i) * n + j;
+				bool folded = i >= n / 2;
+				float row = folded ? static_cast<float>(n - 1 - i) + 0.5f : static_cast<float>(i);
+				p.setPosition(k, Vec3(j * spacing, folded ? gap : 0.0f, row * spacing));
+				p.invMass[k] = 1.0f;
+			}
+		}
+	}
+}
+
+// Rebuild and neighbour query cost of the self collision hash, and the cost
+// it adds to a full cloth step.
+void benchSelfCollision(const BenchOptions& opt)
+{
+	const int sizes[] = { 64, 256, 1024 };
+	const float spacing = 0.01f;
+	const float thickness = 0.015f;
+	const int repeats = opt.quick ? 3 : 10;
+	ThreadPool pool;
+	std::printf("%u threads, thickness %.3f, particle spacing %.3f\n", pool.threadCount(), thickness, spacing);
+	std::printf("%10s %12s %12s %12s %16s\n", "grid", "particles", "rebuild ms", "query ms", "neighbors/query");
+	for (int n : sizes)
+	{
+		if (opt.quick && n > 256)
+			continue;
+		ParticleStore p;
+		buildFoldedSheet(p, n, spacing, 0.6f * thickness);
+		SpatialHash hash(thickness, static_cast<std::uint32_t>(p.size()));
+		double build = 0.0;
+		double query = 0.0;
+		for (int r = 0; r < repeats; ++r)
+		{
+			hash.build(p, static_cast<std::uint32_t>(p.size()), &pool);
+			hash.queryAll(p, thickness, &pool);
+			build += hash.lastBuildSeconds();
+			query += hash.lastQuerySeconds();
+		}
+		std::printf("%5dx%-4d %12zu %12.3f %12.3f %16.2f\n", n, n, p.size(),
+			1000.0 * build / repeats, 1000.0 * query / repeats, hash.averageNeighbors());
+	}
+
+	const int n = opt.quick ? 64 : 256;
+	const float dt = 1.0f / 60.0f;
+	std::printf("cloth step %dx%d:\n", n, n);
+	for (int enabled = 0; enabled < 2; ++enabled)
+	{
+		ClothDesc desc;
+		desc.columns = n;
+		desc.rows = n;
+		desc.selfCollision = enabled != 0;
+		Cloth cloth(desc);
+		cloth.setThreadPool(&pool);
+		cloth.step(dt);
+		BenchTimer timer;
+		for (int r = 0; r < repeats; ++r)
+			cloth.step(dt);
+		std::printf("  self collision %-3s %10.3f ms/step\n", enabled ? "on" : "off", timer.milliseconds() / repeats);
+	}
+}
@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "../../Common/ShapeCollider.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// A wavy 4 m sheet of particles, stored row by row like the cloth, through a
+// mix of spheres, capsules and oriented boxes, a third of each, resolved once
+// per repeat from the same starting state. Every particle carries some motion
+// since its previous position so restitution and friction both do work.
+// Compares the scalar kernel with the widest one and checks they agree.
+void benchShapes(const BenchOptions& opt)
+{
+	const int side = opt.quick ? 128 : 256;
+	const size_t count = static_cast<size_t>(side) * side;
+	const float thickness = 0.01f;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	ParticleStore start;
+	start.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float u = static_cast<float>(i % side) / (side - 1), v = static_cast<float>(i / side) / (side - 1);
+		Vec3 x(4.0f * u - 2.0f, 0.4f * std::sin(9.0f * u) * std::cos(7.0f * v), 4.0f * v - 2.0f);
+		start.setPosition(i, x);
+		start.setPrevPosition(i, x + Vec3(0.02f * unit(rng), 0.03f, 0.02f * unit(rng)));
+		start.setVelocity(i, Vec3());
+		start.invMass[i] = i % 97 == 0 ? 0.0f : 1.0f;
+	}
+
+	const SimdLevel widest = detectSimdLevel() == SimdLevel::AVX2 ? SimdLevel::AVX2 : SimdLevel::Scalar;
+	const int repeats = opt.quick ? 5 : 20;
+	const std::uint32_t shapeCounts[] = { 1, 4, 16, 64, 256 };
+	std::printf("%zu particles, thickness %.3f\n", count, thickness);
+	std::printf("%7s %8s %10s %10s %9s %10s %10s\n", "shapes", "contacts", "scalar ms", "avx2 ms", "speedup", "Mtests/s", "max diff");
+	for (std::uint32_t shapes : shapeCounts)
+	{
+		ShapeCollider collider;
+		collider.setFriction(0.4f);
+		collider.setRestitution(0.2f);
+		std::mt19937 shapeRng(shapes);
+		auto point = [&]() { return Vec3(2.0f * unit(shapeRng), 0.5f * unit(shapeRng), 2.0f * unit(shapeRng)); };
+		// Shapes shrink as they multiply so about the same share of the slab is covered.
+		const float size = 0.6f / std::cbrt(static_cast<float>(shapes));
+		for (std::uint32_t k = 0; k < shapes; ++k)
+		{
+			if (k % 3 == 0)
+			{
+				collider.addSphere({ point(), size });
+			}
+			else if (k % 3 == 1)
+			{
+				Vec3 a = point();
+				Vec3 axis = normalizeOr(Vec3(unit(shapeRng), unit(shapeRng), unit(shapeRng)), Vec3(0.0f, 1.0f, 0.0f));
+				collider.addCapsule({ a, a + axis * (2.0f * size), 0.5f * size });
+			}
+			else
+			{
+				float qx = unit(shapeRng), qy = unit(shapeRng), qz = unit(shapeRng), qw = unit(shapeRng);
+				float inv = 1.0f / std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+				collider.addBox(ColliderBox::fromQuaternion(point(), Vec3(size, 0.5f * size, 0.8f * size),
+					qx * inv, qy * inv, qz * inv, qw * inv));
+			}
+		}
+
+		auto run = [&](SimdLevel level, ParticleStore& p) {
+			collider.setSimdLevel(level);
+			double ms = 0.0;
+			for (int r = 0; r < repeats; ++r)
+			{
+				p = start;
+				BenchTimer timer;
+				collider.collide(p, thickness, 0, static_cast<std::uint32_t>(count));
+				ms += timer.milliseconds();
+			}
+			return ms / repeats;
+		};
+		ParticleStore scalar, wide;
+		double scalarMs = run(SimdLevel::Scalar, scalar);
+		double wideMs = run(widest, wide);
+
+		size_t contacts = 0;
+		float maxDiff = 0.0f;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (length(scalar.position(i) - start.position(i)) > 0.0f)
+				++contacts;
+			maxDiff = std::max(maxDiff, length(scalar.position(i) - wide.position(i)));
+		}
+		std::printf("%7u %8zu %10.3f %10.3f %8.2fx %10.1f %10.2e\n", shapes, contacts, scalarMs, wideMs, scalarMs / wideMs,
+			count * static_cast<double>(shapes) / (wideMs * 1.0e3), maxDiff);
+	}
+}
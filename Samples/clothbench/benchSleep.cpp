@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "../../Common/Bvh.h"
+#include "../../Common/Cloth.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// A sheet dropped onto a floor, with one corner lifted up and down by hand
+// for the whole run, so most of the sheet comes to rest while a small region
+// keeps moving. Runs the same scene without and with sleeping.
+void benchSleep(const BenchOptions& opt)
+{
+	ClothDesc desc;
+	desc.columns = opt.quick ? 96 : 256;
+	desc.rows = desc.columns;
+	desc.pinCorners = false;
+	desc.friction = 0.8f;
+	desc.damping = 1.0f;
+
+	// Two triangles a little below the sheet.
+	const float floorY = desc.origin.y - 0.05f;
+	std::vector<Vec3> floorPositions = { Vec3(-10.0f, floorY, -10.0f), Vec3(10.0f, floorY, -10.0f),
+		Vec3(-10.0f, floorY, 10.0f), Vec3(10.0f, floorY, 10.0f) };
+	std::vector<std::uint32_t> floorIndices = { 0, 2, 1, 1, 2, 3 };
+	Bvh floor;
+	floor.build(floorPositions, floorIndices);
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+	const int blocks = opt.quick ? 6 : 10;
+	const int stepsPerBlock = 30;
+	const float dt = 1.0f / 60.0f;
+	const float sleepEnergies[] = { 0.0f, 1.0e-4f };
+	std::printf("%8s %6s %10s %10s %10s %8s\n", "sleep", "steps", "ms/step", "active", "sleeping", "tiles");
+	for (float sleepEnergy : sleepEnergies)
+	{
+		desc.sleepEnergy = sleepEnergy;
+		Cloth cloth(desc);
+		cloth.setThreadPool(&pool);
+		cloth.setCollider(&floor);
+		float time = 0.0f;
+		for (int b = 0; b < blocks; ++b)
+		{
+			BenchTimer timer;
+			for (int s = 0; s < stepsPerBlock; ++s)
+			{
+				// The hand holds the 4 x 4 corner particles at rows 0-3, columns 0-3.
+				const float lift = 0.3f * (1.0f - std::cos(2.0f * time));
+				for (int i = 0; i < 4; ++i)
+				{
+					for (int j = 0; j < 4; ++j)
+					{
+						const std::uint32_t k = cloth.index(i, j);
+						Vec3 p = cloth.position(k);
+						cloth.setPosition(k, Vec3(p.x, desc.origin.y + lift, p.z));
+					}
+				}
+				cloth.step(dt);
+				time += dt;
+			}
+			double ms = timer.milliseconds() / stepsPerBlock;
+			std::printf("%8s %6d %10.3f %10u %10u %4u/%-4u\n", sleepEnergy > 0.0f ? "on" : "off", (b + 1) * stepsPerBlock, ms,
+				cloth.activeParticleCount(), cloth.sleepingParticleCount(), cloth.sleepingTileCount(), cloth.tileCount());
+		}
+	}
+}
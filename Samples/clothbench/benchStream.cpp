@@ -0,0 +1,70 @@
+#include "bench.h"
+#include "../../Common/StreamCopy.h"
+#include <cstring>
+
+namespace
+{
+	// Same size as the Vertex of the samples: position, normal and uv.
+	struct StreamVertex
+	{
+		float pos[3];
+		float normal[3];
+		float uv[2];
+	};
+
+	template<typename Fn>
+	double gigabytesPerSecond(size_t bytes, double minSeconds, Fn fn)
+	{
+		fn();
+		int runs = 0;
+		BenchTimer timer;
+		do
+		{
+			fn();
+			++runs;
+		} while (timer.seconds() < minSeconds);
+		return static_cast<double>(bytes) * runs / timer.seconds() / 1.0e9;
+	}
+}
+
+// Vertex streaming bandwidth into host memory: one memcpy per element as
+// UploadBuffer::copyData does, one bulk memcpy, and streamCopy per SIMD level.
+// Host memory is cached, not write-combined like an upload heap, so this
+// measures the cost of the stores themselves and of skipping the cache.
+void benchStream(const BenchOptions& opt)
+{
+	const size_t sizes[] = { 128 << 10, 4 << 20, 64 << 20 };
+	const double minSeconds = opt.quick ? 0.05 : 0.5;
+	std::printf("%10s %14s %12s %12s %12s %12s\n", "bytes", "per element", "memcpy", "scalar", "sse4.1", "avx2");
+	for (size_t bytes : sizes)
+	{
+		if (opt.quick && bytes > (4u << 20))
+			continue;
+		const size_t count = bytes / sizeof(StreamVertex);
+		AlignedVector<StreamVertex> src(count);
+		AlignedVector<StreamVertex> dst(count);
+		for (size_t i = 0; i < count; ++i)
+			src[i] = { { float(i), 1.0f, 2.0f }, { 0.0f, 1.0f, 0.0f }, { 0.5f, 0.5f } };
+
+		double perElement = gigabytesPerSecond(bytes, minSeconds, [&]() {
+			char* out = reinterpret_cast<char*>(dst.data());
+			for (size_t i = 0; i < count; ++i)
+				std::memcpy(out + i * sizeof(StreamVertex), &src[i], sizeof(StreamVertex));
+		});
+		double bulk = gigabytesPerSecond(bytes, minSeconds, [&]() { std::memcpy(dst.data(), src.data(), bytes); });
+		std::printf("%10zu %9.2f GB/s %7.2f GB/s", bytes, perElement, bulk);
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 })
+		{
+			if (level > detectSimdLevel())
+			{
+				std::printf(" %12s", "-");
+				continue;
+			}
+			double streamed = gigabytesPerSecond(bytes, minSeconds, [&]() { streamCopy(dst.data(), src.data(), bytes, level); });
+			std::printf(" %7.2f GB/s", streamed);
+		}
+		std::printf("\n");
+		if (std::memcmp(src.data(), dst.data(), bytes) != 0)
+			std::printf("  copy mismatch\n");
+	}
+}
@@ -0,0 +1,47 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include <thread>
+
+// A sheet hanging from its two pinned corners under heavy gravity, so it tears
+// from the corners inwards. Per block of steps: vertex splits, time of the
+// topology phase, and the share of the index buffer that has to be uploaded.
+void benchTear(const BenchOptions& opt)
+{
+	ClothDesc desc;
+	desc.columns = opt.quick ? 64 : 256;
+	desc.rows = desc.columns;
+	desc.gravity = Vec3(0.0f, -40.0f, 0.0f);
+	desc.tearStrain = 0.3f;
+	desc.maxTearParticles = desc.columns * desc.rows / 4;
+	desc.maxTearsPerStep = 256;
+	Cloth cloth(desc);
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	cloth.setThreadPool(&pool);
+
+	const int blocks = opt.quick ? 6 : 12;
+	const int stepsPerBlock = 10;
+	const double totalIndices = static_cast<double>(cloth.indices().size());
+	std::printf("%6s %10s %10s %12s %12s %14s %12s\n", "steps", "particles", "splits", "ms/step", "topology ms", "dirty indices", "of buffer");
+	std::uint32_t lastTears = 0;
+	for (int b = 0; b < blocks; ++b)
+	{
+		double topologyMs = 0.0;
+		size_t dirty = 0;
+		BenchTimer timer;
+		for (int s = 0; s < stepsPerBlock; ++s)
+		{
+			std::uint32_t before = cloth.tearCount();
+			cloth.step(1.0f / 60.0f);
+			if (cloth.tearCount() != before)
+				topologyMs += 1000.0 * cloth.lastTopologySeconds();
+			// What a renderer would upload after this step.
+			for (const ClothIndexRange& r : cloth.dirtyIndexRanges())
+				dirty += r.count;
+			cloth.clearDirtyIndices();
+		}
+		double ms = timer.milliseconds() / stepsPerBlock;
+		std::printf("%6d %10u %10u %12.3f %12.3f %14zu %11.2f%%\n", (b + 1) * stepsPerBlock, cloth.particleCount(),
+			cloth.tearCount() - lastTears, ms, topologyMs, dirty, 100.0 * dirty / (totalIndices * stepsPerBlock));
+		lastTears = cloth.tearCount();
+	}
+}
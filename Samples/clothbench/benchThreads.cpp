@@ -0,0 +1,66 @@
+#include "bench.h"
+#include "../../Common/Cloth.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+// Strong scaling of the colored constraint solver on a 512x512 sheet.
+void benchThreads(const BenchOptions& opt)
+{
+	const int n = opt.quick ? 128 : 512;
+	const float dt = 1.0f / 60.0f;
+	const double minSeconds = opt.quick ? 0.2 : 2.0;
+	const unsigned threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+	ClothDesc desc;
+	desc.columns = n;
+	desc.rows = n;
+	std::printf("%dx%d sheet, %u hardware threads\n", n, n, std::thread::hardware_concurrency());
+	std::printf("%8s %10s %10s %16s %16s\n", "threads", "steps/s", "speedup", "mean imbalance", "worst imbalance");
+
+	double baseline = 0.0;
+	for (unsigned threads : threadCounts)
+	{
+		if (opt.quick && threads > 4)
+			break;
+		ThreadPool pool(threads);
+		Cloth cloth(desc);
+		cloth.setThreadPool(&pool);
+		cloth.step(dt);
+
+		int steps = 0;
+		BenchTimer timer;
+		do
+		{
+			cloth.step(dt);
+			++steps;
+		} while (timer.seconds() < minSeconds || steps < 3);
+		double rate = steps / timer.seconds();
+		if (threads == 1)
+			baseline = rate;
+
+		// Imbalance is measured on separate steps so the timers do not skew the rate.
+		cloth.setProfiling(true);
+		cloth.resetStats();
+		for (int i = 0; i < 3; ++i)
+			cloth.step(dt);
+		double mean = 0.0;
+		double worst = 0.0;
+		for (const auto& stats : cloth.colorStats())
+		{
+			double imbalance = stats.imbalanceSum / std::max(1, stats.solves);
+			mean += imbalance;
+			worst = std::max(worst, imbalance);
+		}
+		mean /= cloth.colorCount();
+		std::printf("%8u %10.2f %10.2f %16.3f %16.3f\n", threads, rate, rate / baseline, mean, worst);
+
+		if (threads == 1)
+		{
+			std::printf("  %u colors:", cloth.colorCount());
+			for (const auto& stats : cloth.colorStats())
+				std::printf(" %u", stats.constraints);
+			std::printf("\n");
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#include "bench.h"
+#include "../../Common/ClothWind.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// A rippled n x n sheet with some velocity, so every triangle sees a
+	// different relative wind.
+	void makeSheet(int n, ParticleStore& p, std::vector<std::uint32_t>& indices)
+	{
+		p.resize(static_cast<size_t>(n) * n);
+		for (int i = 0; i < n; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				size_t k = static_cast<size_t>(i) * n + j;
+				float x = 3.0f * j / (n - 1), z = 3.0f * i / (n - 1);
+				p.setPosition(k, Vec3(x, 0.1f * std::sin(4.0f * x) * std::cos(3.0f * z), z));
+				p.setPrevPosition(k, p.position(k));
+				p.setVelocity(k, Vec3(0.0f, 0.5f * std::sin(7.0f * z), 0.0f));
+				p.invMass[k] = 1.0f;
+			}
+		}
+		indices.clear();
+		indices.reserve(static_cast<size_t>(n - 1) * (n - 1) * 6);
+		for (int i = 0; i + 1 < n; ++i)
+		{
+			for (int j = 0; j + 1 < n; ++j)
+			{
+				std::uint32_t a = i * n + j, b = a + 1, c = a + n, d = c + 1;
+				const std::uint32_t quad[6] = { a, b, c, c, b, d };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	float maxVelocityDiff(const ParticleStore& a, const ParticleStore& b)
+	{
+		float diff = 0.0f;
+		for (size_t i = 0; i < a.size(); ++i)
+			diff = std::max(diff, length(a.velocity(i) - b.velocity(i)));
+		return diff;
+	}
+}
+
+// The wind stage alone: scalar and AVX2 kernels, serial and on the pool, at
+// about 100k and 1M triangles.
+void benchWind(const BenchOptions& opt)
+{
+	// 2 (n - 1)^2 triangles.
+	const int sizes[] = { 225, 708 };
+	const int repeats = opt.quick ? 5 : 20;
+	const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	WindDesc wind;
+	wind.velocity = Vec3(4.0f, 0.0f, 1.0f);
+	wind.turbulence = 2.0f;
+
+	std::printf("%10s %7s %8s %8s %10s %12s %12s\n", "triangles", "colors", "simd", "threads", "ms", "Mtri/s", "max diff");
+	for (int n : sizes)
+	{
+		if (opt.quick && n > 225)
+			continue;
+		ParticleStore sheet;
+		std::vector<std::uint32_t> indices;
+		makeSheet(n, sheet, indices);
+		ClothWind stage;
+		stage.build(indices, static_cast<std::uint32_t>(sheet.size()));
+		stage.setDesc(wind);
+
+		// Velocities after one application with the scalar kernel, for the check.
+		ParticleStore reference = sheet;
+		stage.setSimdLevel(SimdLevel::Scalar);
+		stage.apply(reference, 1.0f / 60.0f, 0.5f, nullptr);
+
+		const SimdLevel levels[] = { SimdLevel::Scalar, detectSimdLevel() };
+		for (SimdLevel level : levels)
+		{
+			for (unsigned threads : { 1u, hardware })
+			{
+				ThreadPool pool(threads);
+				stage.setSimdLevel(level);
+				ParticleStore p = sheet;
+				stage.apply(p, 1.0f / 60.0f, 0.5f, &pool);
+				const float diff = maxVelocityDiff(p, reference);
+				BenchTimer timer;
+				for (int r = 0; r < repeats; ++r)
+					stage.apply(p, 1.0f / 60.0f, 0.5f, &pool);
+				double ms = timer.milliseconds() / repeats;
+				std::printf("%10u %7u %8s %8u %10.3f %12.1f %12.2e\n", stage.triangleCount(), stage.colorCount(),
+					simdLevelName(level), threads, ms, stage.triangleCount() / (1000.0 * ms), diff);
+				if (hardware == 1)
+					break;
+			}
+		}
+	}
+}
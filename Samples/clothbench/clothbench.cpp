@@ -0,0 +1,169 @@
+#include "bench.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+
+struct BenchEntry
+{
+	const char* name;
+	void(*run)(const BenchOptions& opt);
+};
+
+static const BenchEntry gBenches[] =
+{
+	{ "cloth", benchCloth },
+	{ "particles", benchParticles },
+	{ "threads", benchThreads },
+	{ "selfcollision", benchSelfCollision },
+	{ "bvh", benchBvh },
+	{ "normals", benchNormals },
+	{ "stream", benchStream },
+	{ "multigrid", benchMultigrid },
+	{ "lod", benchLod },
+	{ "wind", benchWind },
+	{ "tear", benchTear },
+	{ "sleep", benchSleep },
+	{ "implicit", benchImplicit },
+	{ "shapes", benchShapes },
+	{ "jacobi", benchJacobi },
+	{ "garment", benchGarment },
+	{ "ccd", benchCcd },
+	{ "cache", benchCache },
+	{ "obj", benchObj },
+	{ "meshcache", benchMeshCache },
+	{ "dedup", benchDedup },
+	{ "vcache", benchVertexCache },
+};
+
+std::string findBunny(const BenchOptions& opt)
+{
+	if (!opt.bunnyPath.empty())
+		return opt.bunnyPath;
+	const char* candidates[] = { "bunny/bunny.obj", "../../bunny/bunny.obj" };
+	for (const char* path : candidates)
+	{
+		if (std::FILE* f = std::fopen(path, "rb"))
+		{
+			std::fclose(f);
+			return path;
+		}
+	}
+	return std::string();
+}
+
+bool loadBunny(const BenchOptions& opt, ObjMesh& mesh)
+{
+	const std::string path = findBunny(opt);
+	if (!path.empty() && loadObj(path, mesh))
+		return true;
+	std::printf("bunny.obj not found, pass --bunny <path>\n");
+	return false;
+}
+
+void subdivideMesh(ObjMesh& mesh)
+{
+	ObjMesh result;
+	result.positions.reserve(mesh.indices.size() * 2);
+	result.indices.reserve(mesh.indices.size() * 4);
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		Vec3 a = mesh.positions[mesh.indices[t + 0]];
+		Vec3 b = mesh.positions[mesh.indices[t + 1]];
+		Vec3 c = mesh.positions[mesh.indices[t + 2]];
+		const Vec3 corners[6] = { a, b, c, (a + b) * 0.5f, (b + c) * 0.5f, (c + a) * 0.5f };
+		const std::uint32_t base = static_cast<std::uint32_t>(result.positions.size());
+		result.positions.insert(result.positions.end(), corners, corners + 6);
+		const std::uint32_t tris[12] = { 0, 3, 5, 3, 1, 4, 5, 4, 2, 3, 4, 5 };
+		for (std::uint32_t k : tris)
+			result.indices.push_back(base + k);
+	}
+	mesh = std::move(result);
+}
+
+size_t writeGridObj(const char* fileName, int side)
+{
+	FILE* f = std::fopen(fileName, "wb");
+	if (f == nullptr)
+		return 0;
+	std::vector<char> buffer(1 << 20);
+	size_t used = 0, total = 0;
+	auto flush = [&]() {
+		std::fwrite(buffer.data(), 1, used, f);
+		total += used;
+		used = 0;
+	};
+	for (int j = 0; j < side; ++j)
+	{
+		for (int i = 0; i < side; ++i)
+		{
+			if (used + 128 > buffer.size())
+				flush();
+			const float x = i / float(side), z = j / float(side);
+			used += std::snprintf(&buffer[used], 128, "v %.7e %.7e %.7e\n", x, 0.1f * x * z - 0.05f, z);
+		}
+	}
+	for (int j = 0; j + 1 < side; ++j)
+	{
+		for (int i = 0; i + 1 < side; ++i)
+		{
+			if (used + 128 > buffer.size())
+				flush();
+			const int a = j * side + i + 1, b = a + 1, c = a + side, d = c + 1;
+			used += std::snprintf(&buffer[used], 128, "f %d %d %d\nf %d %d %d\n", a, c, b, b, c, d);
+		}
+	}
+	flush();
+	std::fclose(f);
+	return total;
+}
+
+static void printUsage()
+{
+	std::printf("usage: clothbench [--quick] [--bunny <path>] [benchmark...]\n");
+	std::printf("benchmarks:");
+	for (const auto& b : gBenches)
+		std::printf(" %s", b.name);
+	std::printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions opt;
+	std::vector<const BenchEntry*> selected;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--quick") == 0)
+		{
+			opt.quick = true;
+			continue;
+		}
+		if (std::strcmp(argv[i], "--bunny") == 0 && i + 1 < argc)
+		{
+			opt.bunnyPath = argv[++i];
+			continue;
+		}
+		const BenchEntry* found = nullptr;
+		for (const auto& b : gBenches)
+		{
+			if (std::strcmp(argv[i], b.name) == 0)
+				found = &b;
+		}
+		if (found == nullptr)
+		{
+			printUsage();
+			return 1;
+		}
+		selected.push_back(found);
+	}
+	if (selected.empty())
+	{
+		for (const auto& b : gBenches)
+			selected.push_back(&b);
+	}
+	for (const BenchEntry* b : selected)
+	{
+		std::printf("== %s\n", b->name);
+		b->run(opt);
+	}
+	return 0;
+}
@@ -1,6 +1,6 @@
 #include "FrameResouce.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT dynamicVertexCount, UINT indexPatchCount)
 {
 	ThrowIfFailed(device->CreateCommandAllocator
 	(
@@ -10,6 +10,8 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 	passCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
 	materialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
 	objectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, false);
+	dynamicVB = std::make_unique<UploadBuffer<Vertex>>(device, dynamicVertexCount, false);
+	indexPatch = std::make_unique<UploadBuffer<std::uint32_t>>(device, indexPatchCount, false);
 }
 
 FrameResource::~FrameResource() {}
\ No newline at end of file
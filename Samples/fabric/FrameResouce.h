@@ -37,7 +37,7 @@ struct Vertex
 
 struct FrameResource
 {
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT dynamicVertexCount, UINT indexPatchCount);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
@@ -45,5 +45,13 @@ struct FrameResource
 	std::unique_ptr<UploadBuffer<PassConstants>> passCB = nullptr;
 	std::unique_ptr<UploadBuffer<ObjectConstants>> objectCB = nullptr;
 	std::unique_ptr<UploadBuffer<MaterialConstants>> materialCB = nullptr;
+	// Vertices of meshes simulated on the CPU, such as the cloth. Every frame
+	// resource gets its own copy; we cannot overwrite a buffer the GPU is still
+	// reading. Refill it with streamData and point the MeshGeo at it with
+	// setDynamicVertexBuffer.
+	std::unique_ptr<UploadBuffer<Vertex>> dynamicVB = nullptr;
+	// Staging for index buffer ranges rewritten on the CPU, e.g. when the cloth
+	// tears; the command list copies them into the default heap index buffer.
+	std::unique_ptr<UploadBuffer<std::uint32_t>> indexPatch = nullptr;
 	UINT64 fence = 0;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "fabric.h"
+#include <sstream>
 
 Fabric::Fabric(HINSTANCE hInstance) : D3DFrame(hInstance) {}
 Fabric::~Fabric()
@@ -18,6 +19,8 @@ bool Fabric::initialize()
 	buildDescriptorHeaps();
 	buildShadersAndInputLayout();
 	buildShape();
+	buildCloth();
+	buildBunny();
 	buildMaterials();
 	buildRenderItems();
 	buildFrameResources();
@@ -39,6 +42,7 @@ void Fabric::onResize()
 
 void Fabric::update(const GameTimer& gt)
 {
+	beginLogFrame();
 	updateCamera(gt);
 	m_CurrFrameResourceIndex = (m_CurrFrameResourceIndex + 1) % gNumFrameResources;
 	m_CurrFrameResource= m_FrameResources[m_CurrFrameResourceIndex].get();
@@ -52,39 +56,170 @@ void Fabric::update(const GameTimer& gt)
 	updateObjectCBs(gt);
 	updateMaterialCBs(gt);
 	updateMainPassCB(gt);
+	updateCloth(gt);
+	endLogFrame();
+}
+
+bool Fabric::startRecording(const std::string& fileName)
+{
+	return m_LogWriter.open(fileName);
+}
+
+bool Fabric::startReplay(const std::string& fileName)
+{
+	return m_LogReader.open(fileName);
+}
+
+bool Fabric::startBake(const std::string& fileName)
+{
+	return m_CacheWriter.open(fileName, static_cast<float>(m_ClothScheduler.desc().stepSeconds));
+}
+
+bool Fabric::startPlayback(const std::string& fileName)
+{
+	return m_CacheReader.open(fileName) && m_CacheReader.frameCount() > 0;
+}
+
+void Fabric::beginLogFrame()
+{
+	if (m_LogReader.isOpen())
+	{
+		if (!m_LogReader.read(m_LogFrame))
+		{
+			std::string summary = "replay finished: " + std::to_string(m_LogReader.frameCount()) + " frames, " +
+				std::to_string(1000.0 * m_ReplaySimSeconds) + " ms simulating, " +
+				(m_DivergedFrame != 0 ? "diverged at frame " + std::to_string(m_DivergedFrame) : std::string("no divergence")) + "\n";
+			::OutputDebugStringA(summary.c_str());
+			m_LogReader.close();
+			PostQuitMessage(0);
+			return;
+		}
+		// The frame runs on the recorded clock and input only.
+		m_Timer.overrideFrame(m_LogFrame.deltaTime, m_LogFrame.totalTime);
+		for (const FrameEvent& e : m_LogFrame.events)
+			applyMouseEvent(e);
+	}
+	else if (m_LogWriter.isOpen())
+	{
+		m_LogFrame.deltaTime = m_Timer.deltaTime();
+		m_LogFrame.totalTime = m_Timer.totalTime();
+		m_LogFrame.events.swap(m_PendingEvents);
+		m_PendingEvents.clear();
+		for (const FrameEvent& e : m_LogFrame.events)
+			applyMouseEvent(e);
+	}
+}
+
+void Fabric::endLogFrame()
+{
+	if (m_LogReader.isOpen())
+	{
+		m_ReplaySimSeconds += m_ClothScheduler.lastFrame().stepSeconds;
+		if (m_DivergedFrame == 0 && stateHash() != m_LogFrame.stateHash)
+		{
+			m_DivergedFrame = m_LogReader.frameCount();
+			std::string message = "replay diverged at frame " + std::to_string(m_DivergedFrame) + "\n";
+			::OutputDebugStringA(message.c_str());
+		}
+	}
+	else if (m_LogWriter.isOpen())
+	{
+		m_LogFrame.stateHash = stateHash();
+		m_LogWriter.write(m_LogFrame);
+	}
+}
+
+std::uint64_t Fabric::stateHash()const
+{
+	const float camera[3] = { m_Theta, m_Phi, m_Radius };
+	std::uint64_t h = hashBytes(camera, sizeof(camera));
+	const ParticleStore& p = m_ClothLod->cloth().particles();
+	const size_t bytes = p.size() * sizeof(float);
+	h = hashBytes(p.x.data(), bytes, h);
+	h = hashBytes(p.y.data(), bytes, h);
+	return hashBytes(p.z.data(), bytes, h);
 }
 
 void Fabric::onMouseDown(WPARAM btnState, int x, int y)
 {
-	m_LastMousePos.x = x;
-	m_LastMousePos.y = y;
 	SetCapture(m_hMainWnd);
+	handleMouseEvent(FrameEventType::MouseDown, btnState, x, y);
 }
 
 void Fabric::onMouseUp(WPARAM btnState, int x, int y)
 {
 	ReleaseCapture();
+	handleMouseEvent(FrameEventType::MouseUp, btnState, x, y);
 }
 
 void Fabric::onMouseMove(WPARAM btnState, int x, int y)
 {
-	if ((btnState & MK_LBUTTON) != 0)
+	handleMouseEvent(FrameEventType::MouseMove, btnState, x, y);
+}
+
+void Fabric::handleMouseEvent(FrameEventType type, WPARAM btnState, int x, int y)
+{
+	FrameEvent e;
+	e.type = type;
+	e.buttons = static_cast<std::uint8_t>(btnState);
+	e.x = static_cast<std::int16_t>(x);
+	e.y = static_cast<std::int16_t>(y);
+	// Live input is ignored while replaying, and queued while recording.
+	if (m_LogReader.isOpen())
+		return;
+	if (m_LogWriter.isOpen())
+		m_PendingEvents.push_back(e);
+	else
+		applyMouseEvent(e);
+}
+
+void Fabric::applyMouseEvent(const FrameEvent& e)
+{
+	if (e.type == FrameEventType::MouseDown)
 	{
-		float dx = XMConvertToRadians(0.25f*static_cast<float>(x - m_LastMousePos.x));
-		float dy = XMConvertToRadians(0.25f*static_cast<float>(y - m_LastMousePos.y));
+		m_LastMousePos.x = e.x;
+		m_LastMousePos.y = e.y;
+		return;
+	}
+	if (e.type != FrameEventType::MouseMove)
+		return;
+	if ((e.buttons & MK_LBUTTON) != 0)
+	{
+		float dx = XMConvertToRadians(0.25f*static_cast<float>(e.x - m_LastMousePos.x));
+		float dy = XMConvertToRadians(0.25f*static_cast<float>(e.y - m_LastMousePos.y));
 		m_Theta += dx;
 		m_Phi += dy;
 		m_Phi = MathHelper::clamp(m_Phi, 0.1f, XM_PI - 0.1f);
 	}
-	else if ((btnState & MK_RBUTTON) != 0)
+	else if ((e.buttons & MK_RBUTTON) != 0)
 	{
-		float dx = 0.05f*static_cast<float>(x - m_LastMousePos.x);
-		float dy = 0.05f*static_cast<float>(y - m_LastMousePos.y);
+		float dx = 0.05f*static_cast<float>(e.x - m_LastMousePos.x);
+		float dy = 0.05f*static_cast<float>(e.y - m_LastMousePos.y);
 		m_Radius += dx - dy;
 		m_Radius = MathHelper::clamp(m_Radius, 5.0f, 150.0f);
 	}
-	m_LastMousePos.x = x;
-	m_LastMousePos.y  =y;
+	m_LastMousePos.x = e.x;
+	m_LastMousePos.y = e.y;
+}
+
+std::wstring Fabric::frameStatsText()
+{
+	if (m_SimFrames == 0)
+		return L"";
+	std::wstring text = L"   sim steps/frame: " + std::to_wstring(static_cast<double>(m_SimSteps) / m_SimFrames) +
+		L"   sim ms/frame: " + std::to_wstring(1000.0 * m_SimSeconds / m_SimFrames) +
+		L"   lod: " + std::to_wstring(m_ClothLod->level()) +
+		L" (" + std::to_wstring(m_ClothLod->cloth().particleCount()) + L" particles)" +
+		L"   tears: " + std::to_wstring(m_ClothLod->cloth().tearCount());
+	// Average step time of every level that has run so far.
+	const std::vector<ClothLodStats>& lodStats = m_ClothLod->stats();
+	text += L"   lod ms/step:";
+	for (const ClothLodStats& level : lodStats)
+		text += level.steps > 0 ? L" " + std::to_wstring(1000.0 * level.seconds / level.steps) : std::wstring(L" -");
+	m_SimFrames = 0;
+	m_SimSteps = 0;
+	m_SimSeconds = 0.0;
+	return text;
 }
 
 void Fabric::updateCamera(const GameTimer& gt)
@@ -172,6 +307,113 @@ void Fabric::updateMainPassCB(const GameTimer& gt)
 	currPassCB->copyData(0, m_MainPassCB);
 }
 
+void Fabric::updateCloth(const GameTimer& gt)
+{
+	if (m_CacheReader.isOpen())
+	{
+		playClothCache(gt);
+		return;
+	}
+	updateClothLod();
+	const Cloth& cloth = m_ClothLod->cloth();
+	const ParticleStore& particles = cloth.particles();
+	m_ClothScheduler.advance(gt.deltaTime(), [this, &cloth, &particles](float dt) {
+		const UINT count = cloth.particleCount();
+		for (UINT i = 0; i < count; ++i)
+			m_ClothPrevPositions[i] = particles.position(i);
+		m_ClothLod->step(dt);
+		// Particles split off by tearing have no previous position yet.
+		for (UINT i = count; i < cloth.particleCount(); ++i)
+			m_ClothPrevPositions[i] = particles.position(i);
+		if (m_CacheWriter.isOpen())
+			m_CacheWriter.append(particles.x.data(), particles.y.data(), particles.z.data(), cloth.particleCount());
+	});
+	uploadClothIndices();
+	const FixedStepStats& stats = m_ClothScheduler.lastFrame();
+	m_SimFrames++;
+	m_SimSteps += stats.steps;
+	m_SimSeconds += stats.stepSeconds;
+	uploadClothVertices(particles.x.data(), particles.y.data(), particles.z.data(), cloth.normals(), cloth.particleCount());
+}
+
+void Fabric::playClothCache(const GameTimer& gt)
+{
+	// The baked frames are the steps of the simulation, so they advance on
+	// the same schedule; playback loops at the end of the cache.
+	const UINT count = m_ClothLod->cloth().particleCount();
+	m_ClothScheduler.advance(gt.deltaTime(), [this, count](float) {
+		for (UINT i = 0; i < count; ++i)
+			m_ClothPrevPositions[i] = Vec3(m_CacheX[i], m_CacheY[i], m_CacheZ[i]);
+		m_CacheFrame = (m_CacheFrame + 1) % m_CacheReader.frameCount();
+		m_CacheReader.read(m_CacheFrame, m_CacheX.data(), m_CacheY.data(), m_CacheZ.data());
+	});
+	m_CacheNormals.compute(m_CacheX.data(), m_CacheY.data(), m_CacheZ.data(), m_ThreadPool.get());
+	uploadClothVertices(m_CacheX.data(), m_CacheY.data(), m_CacheZ.data(), m_CacheNormals.normals(), count);
+}
+
+void Fabric::uploadClothVertices(const float* x, const float* y, const float* z, const std::vector<Vec3>& normals, UINT count)
+{
+	// Interleave the particles into the staging array, which stays in cache,
+	// then stream it into this frame's vertex buffer in one pass.
+	const float alpha = m_ClothScheduler.alpha();
+	const std::vector<float>& texCoords = m_ClothLod->cloth().texCoords();
+	for (UINT i = 0; i < count; ++i)
+	{
+		Vertex& v = m_ClothVertices[i];
+		Vec3 p = m_ClothPrevPositions[i] + (Vec3(x[i], y[i], z[i]) - m_ClothPrevPositions[i]) * alpha;
+		v.Pos = XMFLOAT3(p.x, p.y, p.z);
+		v.Normal = XMFLOAT3(normals[i].x, normals[i].y, normals[i].z);
+		v.TexC = XMFLOAT2(texCoords[2 * i], texCoords[2 * i + 1]);
+	}
+	auto currDynamicVB = m_CurrFrameResource->dynamicVB.get();
+	currDynamicVB->streamData(0, m_ClothVertices.data(), count);
+	m_ClothRitem->geo->setDynamicVertexBuffer(currDynamicVB->resource());
+}
+
+void Fabric::uploadClothIndices()
+{
+	Cloth& cloth = m_ClothLod->cloth();
+	const std::vector<ClothIndexRange>& ranges = cloth.dirtyIndexRanges();
+	if (ranges.empty())
+		return;
+	// Only the triangles tearing rewrote are staged; draw() copies them into
+	// the index buffer, so the upload grows with the damage, not the sheet.
+	MeshGeo* geo = m_ClothRitem->geo;
+	const SubMeshGeo& sheet = geo->drawArgs["sheet" + std::to_string(m_ClothLod->level())];
+	const std::vector<std::uint32_t>& indices = cloth.indices();
+	auto currIndexPatch = m_CurrFrameResource->indexPatch.get();
+	UINT staged = 0;
+	for (const ClothIndexRange& range : ranges)
+	{
+		currIndexPatch->streamData(staged, &indices[range.first], range.count);
+		const UINT64 dstOffset = (sheet.startIndexLocation + range.first) * sizeof(std::uint32_t);
+		m_IndexPatches.push_back({ dstOffset, staged * sizeof(std::uint32_t), range.count * sizeof(std::uint32_t) });
+		CopyMemory(static_cast<BYTE*>(geo->indexBufferCPU->GetBufferPointer()) + dstOffset,
+			&indices[range.first], range.count * sizeof(std::uint32_t));
+		staged += range.count;
+	}
+	cloth.clearDirtyIndices();
+}
+
+void Fabric::updateClothLod()
+{
+	if (m_CacheWriter.isOpen())
+		return;
+	// Pixels covered by one unit at distance one: half the viewport height
+	// over tan(fovY / 2), and m_Proj._22 is 1 / tan(fovY / 2).
+	const float pixelsPerUnit = 0.5f * m_ClientHeight * m_Proj._22;
+	if (!m_ClothLod->update(Vec3(m_EyePos.x, m_EyePos.y, m_EyePos.z), pixelsPerUnit))
+		return;
+	const SubMeshGeo& sheet = m_ClothRitem->geo->drawArgs["sheet" + std::to_string(m_ClothLod->level())];
+	m_ClothRitem->indexCount = sheet.indexCount;
+	m_ClothRitem->startIndexLocation = sheet.startIndexLocation;
+	m_ClothRitem->baseVertexLocation = sheet.baseVertexLocation;
+	// The new level has no previous step to blend from.
+	const Cloth& cloth = m_ClothLod->cloth();
+	for (UINT i = 0; i < cloth.particleCount(); ++i)
+		m_ClothPrevPositions[i] = cloth.position(i);
+}
+
 void Fabric::loadTextures()
 {
 	auto woodTex=std::make_unique<Texture>();
@@ -319,6 +561,156 @@ void Fabric::buildShape()
 	m_Geo[geo->name] = std::move(geo);
 }
 
+void Fabric::buildCloth()
+{
+	ClothLodDesc desc;
+	desc.cloth.columns = 64;
+	desc.cloth.rows = 64;
+	desc.cloth.selfCollision = true;
+	// A light gusty breeze across the box.
+	desc.cloth.wind.velocity = Vec3(1.0f, 0.0f, 0.5f);
+	desc.cloth.wind.turbulence = 1.0f;
+	// The pinned corners see the most strain; tear only well past it.
+	desc.cloth.tearStrain = m_CacheWriter.isOpen() || m_CacheReader.isOpen() ? 0.0f : 2.0f;
+	desc.levels = 3;
+	m_ClothLod = std::make_unique<ClothLod>(desc);
+	m_ThreadPool = std::make_unique<ThreadPool>();
+	m_ClothLod->setThreadPool(m_ThreadPool.get());
+	// The box under the bunny, drawn with the identity world matrix.
+	BoundingOrientedBox box(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	m_ShapeCollider.addBox(ColliderBox::fromQuaternion(Vec3(box.Center.x, box.Center.y, box.Center.z),
+		Vec3(box.Extents.x, box.Extents.y, box.Extents.z), box.Orientation.x, box.Orientation.y, box.Orientation.z, box.Orientation.w));
+	m_ClothLod->setShapes(&m_ShapeCollider);
+	// Every level uses the front of the buffers, which are sized for the
+	// largest one once tearing has used up all its particles.
+	for (int l = 0; l < m_ClothLod->levelCount(); ++l)
+	{
+		const Cloth& cloth = m_ClothLod->levelCloth(l);
+		m_ClothMaxParticles = (std::max)(m_ClothMaxParticles, cloth.maxParticleCount());
+		m_ClothMaxIndices = (std::max)(m_ClothMaxIndices, (UINT)cloth.indices().size());
+	}
+	m_ClothVertices.resize(m_ClothMaxParticles);
+	m_ClothPrevPositions.resize(m_ClothMaxParticles);
+	for (UINT i = 0; i < m_ClothLod->cloth().particleCount(); ++i)
+		m_ClothPrevPositions[i] = m_ClothLod->cloth().position(i);
+	if (m_CacheReader.isOpen())
+	{
+		// A cache baked from another sheet is dropped, and the sheet simulates.
+		const Cloth& cloth = m_ClothLod->cloth();
+		const UINT count = cloth.particleCount();
+		m_CacheX.resize(count);
+		m_CacheY.resize(count);
+		m_CacheZ.resize(count);
+		if (m_CacheReader.maxParticleCount() == count && m_CacheReader.read(0, m_CacheX.data(), m_CacheY.data(), m_CacheZ.data()))
+		{
+			m_CacheNormals.build(cloth.indices(), count);
+			for (UINT i = 0; i < count; ++i)
+				m_ClothPrevPositions[i] = Vec3(m_CacheX[i], m_CacheY[i], m_CacheZ[i]);
+		}
+		else
+		{
+			m_CacheReader.close();
+		}
+	}
+
+	// 32-bit indices, so sheets beyond 256x256 particles still fit. The
+	// levels are stored one after another.
+	std::vector<std::uint32_t> indices;
+	std::vector<SubMeshGeo> sheets;
+	for (int l = 0; l < m_ClothLod->levelCount(); ++l)
+	{
+		const Cloth& cloth = m_ClothLod->levelCloth(l);
+		SubMeshGeo sheet;
+		sheet.indexCount = (UINT)cloth.indices().size();
+		sheet.startIndexLocation = (UINT)indices.size();
+		sheet.baseVertexLocation = 0;
+		sheet.vertexCount = cloth.particleCount();
+		sheets.push_back(sheet);
+		indices.insert(indices.end(), cloth.indices().begin(), cloth.indices().end());
+	}
+	const UINT vbByteSize = m_ClothMaxParticles * sizeof(Vertex);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
+	auto geo = std::make_unique<MeshGeo>();
+	geo->name = "clothGeo";
+	// The vertex buffer is set dynamically every frame.
+	geo->vertexBufferCPU = nullptr;
+	geo->vertexBufferGPU = nullptr;
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->indexBufferCPU));
+	CopyMemory(geo->indexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	geo->indexBufferGPU = D3DUtil::createDefaultBuffer(m_d3dDevice.Get(), m_CommandList.Get(),
+		indices.data(), ibByteSize, geo->indexBufferUploader);
+	geo->vertexByteStride = sizeof(Vertex);
+	geo->vertexBufferByteSize = vbByteSize;
+	geo->indexFormat = DXGI_FORMAT_R32_UINT;
+	geo->indexBufferByteSize = ibByteSize;
+	for (size_t l = 0; l < sheets.size(); ++l)
+		geo->drawArgs["sheet" + std::to_string(l)] = sheets[l];
+	m_Geo[geo->name] = std::move(geo);
+}
+
+void Fabric::buildBunny()
+{
+	// The first launch converts the OBJ; later ones map the cache and upload
+	// its blobs in place.
+	MeshCache cache;
+	if (!loadObjCached("../../bunny/bunny.obj", "bunny.mcache", "bunny", cache, m_ThreadPool.get()))
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+	const MeshCacheHeader& header = cache.header();
+
+	// The model is about 0.15 units tall; scale it up and stand it on the box,
+	// just below the middle of the sheet.
+	const float scale = 6.0f;
+	XMMATRIX world = XMMatrixScaling(scale, scale, scale) * XMMatrixTranslation(0.1f, 0.3f, 0.0f);
+	XMStoreFloat4x4(&m_BunnyWorld, world);
+
+	// ObjVertex has the layout of Vertex, normals included.
+	static_assert(sizeof(ObjVertex) == sizeof(Vertex), "ObjVertex must match Vertex");
+	const ObjVertex* vertices = static_cast<const ObjVertex*>(cache.vertices());
+	std::vector<Vec3> worldPositions(header.vertexCount);
+	for (UINT i = 0; i < header.vertexCount; ++i)
+	{
+		const float* p = vertices[i].pos;
+		XMFLOAT3 w;
+		XMStoreFloat3(&w, XMVector3TransformCoord(XMVectorSet(p[0], p[1], p[2], 1.0f), world));
+		worldPositions[i] = Vec3(w.x, w.y, w.z);
+	}
+	std::vector<std::uint32_t> colliderIndices(header.indexCount);
+	for (UINT i = 0; i < header.indexCount; ++i)
+	{
+		colliderIndices[i] = header.indexSize == sizeof(std::uint16_t) ?
+			static_cast<const std::uint16_t*>(cache.indices())[i] : static_cast<const std::uint32_t*>(cache.indices())[i];
+	}
+	m_BunnyCollider.build(worldPositions, colliderIndices);
+	m_ClothLod->setCollider(&m_BunnyCollider);
+
+	// The mesh is static and never read back, so like the cloth it keeps no
+	// CPU copy.
+	const UINT vbByteSize = (UINT)cache.vertexByteSize();
+	const UINT ibByteSize = (UINT)cache.indexByteSize();
+	auto geo = std::make_unique<MeshGeo>();
+	geo->name = "bunnyGeo";
+	geo->vertexBufferGPU = D3DUtil::createDefaultBuffer(m_d3dDevice.Get(), m_CommandList.Get(),
+		cache.vertices(), vbByteSize, geo->vertexBufferUploader);
+	geo->indexBufferGPU = D3DUtil::createDefaultBuffer(m_d3dDevice.Get(), m_CommandList.Get(),
+		cache.indices(), ibByteSize, geo->indexBufferUploader);
+	geo->indexFormat = header.indexSize == sizeof(std::uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->indexBufferByteSize = ibByteSize;
+	geo->vertexBufferByteSize = vbByteSize;
+	geo->vertexByteStride = header.vertexStride;
+	for (UINT s = 0; s < cache.subMeshCount(); ++s)
+	{
+		const MeshCacheSubMesh& sub = cache.subMeshes()[s];
+		SubMeshGeo draw;
+		draw.baseVertexLocation = sub.baseVertexLocation;
+		draw.indexCount = sub.indexCount;
+		draw.startIndexLocation = sub.startIndexLocation;
+		draw.vertexCount = sub.vertexCount;
+		draw.bounds = BoundingBox(XMFLOAT3(sub.center), XMFLOAT3(sub.extents));
+		geo->drawArgs[sub.name] = draw;
+	}
+	m_Geo[geo->name] = std::move(geo);
+}
+
 void Fabric::buildMaterials()
 {
 	auto wood = std::make_unique<Material>();
@@ -329,6 +721,24 @@ void Fabric::buildMaterials()
 	wood->constants.fresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	wood->constants.roughness = 0.2f;
 	m_Materials["wood"] = std::move(wood);
+
+	auto cloth = std::make_unique<Material>();
+	cloth->name = "cloth";
+	cloth->matCBIndex = 1;
+	cloth->diffuseSrvHeapIndex = 0;
+	cloth->constants.diffuseAlbedo = XMFLOAT4(0.8f, 0.3f, 0.3f, 1.0f);
+	cloth->constants.fresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
+	cloth->constants.roughness = 0.8f;
+	m_Materials["cloth"] = std::move(cloth);
+
+	auto bunny = std::make_unique<Material>();
+	bunny->name = "bunny";
+	bunny->matCBIndex = 2;
+	bunny->diffuseSrvHeapIndex = 0;
+	bunny->constants.diffuseAlbedo = XMFLOAT4(0.9f, 0.9f, 0.85f, 1.0f);
+	bunny->constants.fresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
+	bunny->constants.roughness = 0.5f;
+	m_Materials["bunny"] = std::move(bunny);
 }
 
 void Fabric::buildRenderItems()
@@ -342,6 +752,28 @@ void Fabric::buildRenderItems()
 	boxRitem->baseVertexLocation = boxRitem->geo->drawArgs["box"].baseVertexLocation;
 	m_RitemLayer.push_back(boxRitem.get());
 	m_AllRitems.push_back(std::move(boxRitem));
+
+	auto clothRitem = std::make_unique<RenderItem>();
+	clothRitem->objCBIndex = 1;
+	clothRitem->geo = m_Geo["clothGeo"].get();
+	clothRitem->mat = m_Materials["cloth"].get();
+	clothRitem->indexCount = clothRitem->geo->drawArgs["sheet0"].indexCount;
+	clothRitem->startIndexLocation = clothRitem->geo->drawArgs["sheet0"].startIndexLocation;
+	clothRitem->baseVertexLocation = clothRitem->geo->drawArgs["sheet0"].baseVertexLocation;
+	m_ClothRitem = clothRitem.get();
+	m_RitemLayer.push_back(clothRitem.get());
+	m_AllRitems.push_back(std::move(clothRitem));
+
+	auto bunnyRitem = std::make_unique<RenderItem>();
+	bunnyRitem->world = m_BunnyWorld;
+	bunnyRitem->objCBIndex = 2;
+	bunnyRitem->geo = m_Geo["bunnyGeo"].get();
+	bunnyRitem->mat = m_Materials["bunny"].get();
+	bunnyRitem->indexCount = bunnyRitem->geo->drawArgs["bunny"].indexCount;
+	bunnyRitem->startIndexLocation = bunnyRitem->geo->drawArgs["bunny"].startIndexLocation;
+	bunnyRitem->baseVertexLocation = bunnyRitem->geo->drawArgs["bunny"].baseVertexLocation;
+	m_RitemLayer.push_back(bunnyRitem.get());
+	m_AllRitems.push_back(std::move(bunnyRitem));
 }
 
 void Fabric::buildFrameResources()
@@ -349,7 +781,8 @@ void Fabric::buildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(),
-			1, static_cast<UINT>(m_AllRitems.size()), static_cast<UINT>(m_Materials.size())));
+			1, static_cast<UINT>(m_AllRitems.size()), static_cast<UINT>(m_Materials.size()),
+			m_ClothMaxParticles, m_ClothMaxIndices));
 	}
 }
 
@@ -370,6 +803,8 @@ void Fabric::buildPSOs()
 		m_psByteCode->GetBufferSize()
 	};
 	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	// The cloth sheet is seen from both sides.
+	psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
 	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
 	psoDesc.SampleMask = UINT_MAX;
@@ -401,6 +836,18 @@ void Fabric::draw(const GameTimer& gt)
 	m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
 	auto passCB = m_CurrFrameResource->passCB->resource();
 	m_CommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	if (!m_IndexPatches.empty())
+	{
+		ID3D12Resource* clothIB = m_ClothRitem->geo->indexBufferGPU.Get();
+		m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(clothIB,
+			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+		for (const IndexPatch& patch : m_IndexPatches)
+			m_CommandList->CopyBufferRegion(clothIB, patch.dstOffset, m_CurrFrameResource->indexPatch->resource(),
+				patch.srcOffset, patch.bytes);
+		m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(clothIB,
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+		m_IndexPatches.clear();
+	}
 	drawRenderItems(m_CommandList.Get(), m_RitemLayer);
 	m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
 		currentBackBuffer(),
@@ -500,6 +947,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	try
 	{
 		Fabric theApp(hInstance);
+		// fabric.exe -record <file> | -replay <file> | -bake <file> | -play <file>
+		std::istringstream args(cmdLine);
+		std::string option, fileName;
+		if (args >> option >> fileName)
+		{
+			bool ok = option == "-record" ? theApp.startRecording(fileName) :
+				option == "-replay" ? theApp.startReplay(fileName) :
+				option == "-bake" ? theApp.startBake(fileName) :
+				option == "-play" ? theApp.startPlayback(fileName) : false;
+			if (!ok)
+			{
+				MessageBoxA(nullptr, ("Cannot " + option + " " + fileName).c_str(), "fabric", MB_OK);
+				return 0;
+			}
+		}
 		if(!theApp.initialize())
 			return 0;
 		return theApp.run();
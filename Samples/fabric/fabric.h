@@ -2,6 +2,12 @@
 #include "../../Common/D3DFrame.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/DDSTextureLoader.h"
+#include "../../Common/ClothCache.h"
+#include "../../Common/ClothLod.h"
+#include "../../Common/FixedStepScheduler.h"
+#include "../../Common/FrameLog.h"
+#include "../../Common/MeshCache.h"
+#include "../../Common/ObjLoader.h"
 #include "FrameResouce.h"
 
 using Microsoft::WRL::ComPtr;
@@ -33,6 +39,14 @@ public:
 	Fabric(const Fabric& rhs) = delete;
 	Fabric& operator=(const Fabric& rhs) = delete;
 	virtual bool initialize() override;
+	// Write the timing, input and state hash of every frame to a log, or
+	// drive the frames from a log written earlier. Call before run().
+	bool startRecording(const std::string& fileName);
+	bool startReplay(const std::string& fileName);
+	// Write the cloth of every step to a cloth cache, or draw the frames of
+	// one baked earlier in place of the simulation. Call before run().
+	bool startBake(const std::string& fileName);
+	bool startPlayback(const std::string& fileName);
 
 private:
 	virtual void onResize() override;
@@ -42,17 +56,32 @@ private:
 	virtual void onMouseDown(WPARAM btnState, int x, int y) override;
 	virtual void onMouseUp(WPARAM btnState, int x, int y) override;
 	virtual void onMouseMove(WPARAM btnState, int x, int y) override;
+	virtual std::wstring frameStatsText() override;
 
 	void updateCamera(const GameTimer& gt);
 	void updateObjectCBs(const GameTimer& gt);
 	void updateMaterialCBs(const GameTimer& gt);
 	void updateMainPassCB(const GameTimer& gt);
+	void updateCloth(const GameTimer& gt);
+	void playClothCache(const GameTimer& gt);
+	// Blend the previous positions towards x, y and z by the scheduler's
+	// alpha and stream the vertices into this frame's buffer.
+	void uploadClothVertices(const float* x, const float* y, const float* z, const std::vector<Vec3>& normals, UINT count);
+	void updateClothLod();
+	void uploadClothIndices();
+	void beginLogFrame();
+	void endLogFrame();
+	void handleMouseEvent(FrameEventType type, WPARAM btnState, int x, int y);
+	void applyMouseEvent(const FrameEvent& e);
+	std::uint64_t stateHash()const;
 
 	void loadTextures();
 	void buildRootSignature();
 	void buildDescriptorHeaps();
 	void buildShadersAndInputLayout();
 	void buildShape();
+	void buildCloth();
+	void buildBunny();
 	void buildPSOs();
 	void buildFrameResources();
 	void buildMaterials();
@@ -76,12 +105,61 @@ private:
 	ComPtr<ID3D12PipelineState> m_PSO = nullptr;
 	std::vector<std::unique_ptr<RenderItem>> m_AllRitems;
 	std::vector<RenderItem*> m_RitemLayer;
+	std::unique_ptr<ThreadPool> m_ThreadPool;
+	// World space copy of the bunny the cloth collides with.
+	Bvh m_BunnyCollider;
+	// Analytic proxies for the rest of the scene.
+	ShapeCollider m_ShapeCollider;
+	XMFLOAT4X4 m_BunnyWorld = MathHelper::Identity4x4();
+	// The sheet switches resolution with its on-screen size; the index buffer
+	// holds every level, drawn through the "sheet<level>" draw args.
+	std::unique_ptr<ClothLod> m_ClothLod;
+	RenderItem* m_ClothRitem = nullptr;
+	// CPU side copy of the cloth vertices, streamed to the GPU every frame.
+	std::vector<Vertex> m_ClothVertices;
+	// The cloth steps at a fixed rate; frames draw it between the positions
+	// before and after the last step.
+	FixedStepScheduler m_ClothScheduler;
+	std::vector<Vec3> m_ClothPrevPositions;
+	// Most particles and indices of any level, tearing included.
+	UINT m_ClothMaxParticles = 0;
+	UINT m_ClothMaxIndices = 0;
+	// Index buffer ranges staged in this frame's indexPatch buffer, copied
+	// into the cloth index buffer when the frame is drawn.
+	struct IndexPatch
+	{
+		UINT64 dstOffset;
+		UINT64 srcOffset;
+		UINT64 bytes;
+	};
+	std::vector<IndexPatch> m_IndexPatches;
+	// A cache holds positions only, so baking and playback keep the sheet
+	// at its finest level and untorn. Playback keeps its own normals.
+	ClothCacheWriter m_CacheWriter;
+	ClothCacheReader m_CacheReader;
+	std::uint32_t m_CacheFrame = 0;
+	std::vector<float> m_CacheX;
+	std::vector<float> m_CacheY;
+	std::vector<float> m_CacheZ;
+	MeshNormals m_CacheNormals;
+	FrameLogWriter m_LogWriter;
+	FrameLogReader m_LogReader;
+	// Recorded input that arrived since the last frame; it is applied at the
+	// start of the next frame, just as a replay applies it.
+	std::vector<FrameEvent> m_PendingEvents;
+	FrameRecord m_LogFrame;
+	std::uint32_t m_DivergedFrame = 0;
+	double m_ReplaySimSeconds = 0.0;
+	// Simulation totals since the caption was last updated.
+	int m_SimFrames = 0;
+	int m_SimSteps = 0;
+	double m_SimSeconds = 0.0;
 	PassConstants m_MainPassCB;
 	XMFLOAT3 m_EyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 m_View = MathHelper::Identity4x4();
 	XMFLOAT4X4 m_Proj = MathHelper::Identity4x4();
 	float m_Theta = 1.5f * XM_PI;
 	float m_Phi = XM_PIDIV4;
-	float m_Radius = 2.5f;
+	float m_Radius = 6.0f;
 	POINT m_LastMousePos;
 };
\ No newline at end of file